@@ -32,6 +32,7 @@
 #include "types.h"
 #include "equation_parser.h"
 #include "globals.h"
+#include "time_service.h"
 #include "led_buzzer.h"
 #include "sensors.h"
 #include "users.h"
@@ -50,6 +51,7 @@
 #include "chart_archiver.h"
 #include "chart_web_handlers.h"
 #include "chart_event_points.h"
+#include "web_routes.h"
 
 // ============================================================================
 // SETUP - INITIALISATION DU SYSTÈME
@@ -82,9 +84,9 @@ void setup() {
   LOG_I(LOG_SYSTEM, "Phase 2: Complete");
   
   // Initialisation capteurs et dual-core
-  LOG_I(LOG_SYSTEM, "Phase 3: Initialisation capteurs et dual-core...");
+  LOG_I(LOG_SYSTEM, "Phase 3: Initialisation capteurs et taches...");
   initSensors();
-  initCore1();
+  initTasks();
   LOG_I(LOG_SYSTEM, "Phase 3: Complete");
   
   // Connexion réseau
@@ -99,120 +101,13 @@ void setup() {
   
   LOG_I(LOG_SYSTEM, "Phase 5: Configuration du serveur web...");
   
-  // Fichiers statiques
-  server.on("/", handleRoot);
-  server.on("/style.css", handleCss);
-  server.on("/app.js", handleJs);
-
-  server.on("/modules/auth.js", handleJSauth);
-  server.on("/modules/backup.js", handleJsbackup);
-  server.on("/modules/calibration.js", handleJscalib);
-  server.on("/modules/chart.js", handleJschart);
-  server.on("/modules/control.js", handleJscontrol);
-  server.on("/modules/dashboard.js", handleJsdashboard);
-  server.on("/modules/preferences.js", handleJspref);
-  server.on("/modules/scenarios.js", handleJsscenar);
-  server.on("/modules/settings.js", handleJssettings);
-  server.on("/modules/theme.js", handleJstheme);
-  server.on("/modules/timers.js", handleJstimers);
-  server.on("/modules/units.js", handleJsunits);
-  server.on("/modules/users.js", handleJsusers);
-  server.on("/modules/translations.js", handlelangageJs);
-  server.on("/modules/ota.js", handleotaJs);
-
-  server.on("/img/logo.png", handleLogo);
-  server.on("/img/favicon.png", handleFavicon);
-  
-  // API Basique
-  server.on("/api/time", handleApiTime);
-  server.on("/api/temp", handleApiTemp);
-  server.on("/api/relays", handleApiRelays);
-  server.on("/api/relay", handleApiRelay);
-  server.on("/api/sensors", handleApiSensors);
-  server.on("/api/buzzer/mute", handleApiBuzzerMute);
-  server.on("/api/pump/status", handleApiPumpStatus);
-  
-  // API MQTT
-  server.on("/api/mqtt/config", HTTP_GET, handleApiMQTTConfig);
-  server.on("/api/saveMQTT", HTTP_POST, handleApiSaveMQTT);
-  server.on("/api/mqtt/status", HTTP_GET, handleApiMQTTStatus);
-  server.on("/api/mqtt/rediscover", HTTP_POST, handleApiMQTTRediscover);
-  
-  // API Météo
-  server.on("/api/weather/config", HTTP_GET, handleApiWeatherConfig);
-  server.on("/api/weather/save", HTTP_POST, handleApiWeatherSave);
-  
-  // API Système
-  server.on("/api/system", HTTP_GET, handleApiSystem);
-  server.on("/api/system/config", HTTP_GET, handleApiGetSystemConfig);
-  server.on("/api/system/config", HTTP_POST, handleApiSaveSystemConfig);
-  server.on("/api/system/restart", HTTP_POST, handleApiRestart);
-  
-  // API Calibration
-  server.on("/api/calibration", HTTP_GET, handleApiGetCalibration);
-  server.on("/api/calibration", HTTP_POST, handleApiSaveCalibration);
-  server.on("/api/calibration/reset", HTTP_POST, handleApiResetCalibration);
-  
-  // API Historique
-  server.on("/api/history", HTTP_GET, handleApiHistory);
-
-  // API Configuration Graphique
-  server.on("/api/chart/config", handleApiChartConfig);
-
-  // API Chart Data (nouveau système d'historique)
-  server.on("/api/chart/data", HTTP_GET, handleApiChartData);
-  server.on("/api/chart/available-dates", HTTP_GET, handleApiChartAvailableDates);
-  server.on("/api/chart/storage-info", HTTP_GET, handleApiChartStorageInfo);
-  server.on("/api/chart/force-archive", HTTP_POST, handleApiChartForceArchive);
-  server.on("/api/chart/data", HTTP_DELETE, handleApiChartDeleteDay);
-  server.on("/api/chart/export-csv", HTTP_GET, handleApiChartExportCSV);
+  // En-têtes lus par les handlers (ETag, compression, upload OTA)
+  const char* collectedHeaders[] = { "If-None-Match", "Accept-Encoding", "X-File-Size" };
+  server.collectHeaders(collectedHeaders, 3);
   
-  // API Authentification & Utilisateurs
-  server.on("/api/auth", HTTP_POST, handleApiAuth);
-  server.on("/api/users", HTTP_GET, handleApiGetUsers);
-  server.on("/api/users/add", HTTP_POST, handleApiAddUser);
-  server.on("/api/users/delete", HTTP_POST, handleApiDeleteUser);
-  server.on("/api/users/change-password", HTTP_POST, handleApiChangePassword);
-  
-  // API Timers Flexibles
-  server.on("/api/timers/flex", HTTP_GET, handleApiFlexTimers);
-  server.on("/api/timers/flex", HTTP_POST, handleApiAddFlexTimer);
-
-  // API Backup/Restore
-  server.on("/api/backup/download", HTTP_GET, handleBackupDownload);
-  server.on("/api/backup/upload", HTTP_POST, handleBackupUpload);
-  server.on("/api/backup/list", HTTP_GET, handleBackupList);
-  server.on("/api/backup/save", HTTP_POST, handleBackupSave);
-  
-  // API Scénarios
-  server.on("/api/scenarios", HTTP_GET, handleGetScenarios);
-  server.on("/api/scenarios/apply", HTTP_POST, handleApplyScenario);
-
-  // API Préférence
-  server.on("/api/preferences", HTTP_GET, handleApiGetPreferences);
-  server.on("/api/preferences", HTTP_POST, handleApiSavePreferences);
-
-  // Routes dynamiques (PUT/DELETE sur /api/timers/flex/{id})
-  server.onNotFound([]() {
-    String uri = server.uri();
-    
-    if (uri.startsWith("/api/timers/flex/") && uri.endsWith("/toggle") && 
-        server.method() == HTTP_POST) {
-      handleApiToggleFlexTimer();
-    } 
-    else if (uri.startsWith("/api/timers/flex/") && server.method() == HTTP_PUT) {
-      handleApiUpdateFlexTimer();
-    } 
-    else if (uri.startsWith("/api/timers/flex/") && server.method() == HTTP_DELETE) {
-      handleApiDeleteFlexTimer();
-    } 
-    else {
-      LOG_W(LOG_WEB, "Route non trouvee: %s", uri.c_str());
-      server.send(404, "text/plain", "Not Found");
-    }
-  });
-
-  LOG_I(LOG_SYSTEM, "Serveur web configure: 40+ endpoints enregistres");
+  // Fichiers statiques et routes API (web_routes.h)
+  initStaticAssets();
+  registerWebRoutes();
   
   // ========================================================================
   // CONFIGURATION OTA UPDATE
@@ -236,6 +131,7 @@ void setup() {
       server.send(200, "text/plain", success ? "OK" : "FAIL"); 
       
       if (success) {
+        flushPersistenceBeforeRestart();
         LOG_I(LOG_SYSTEM, "Redemarrage dans 2 secondes...");
         delay(2000);
         ESP.restart();
@@ -275,7 +171,6 @@ void setup() {
   LOG_I(LOG_SYSTEM, "Phase 6: Configuration finale...");
   initNTP();
   initMQTT();
-  updateWeatherData();
 
     // Initialisation du système de graphique
   LOG_I(LOG_SYSTEM, "Initialisation du systeme de graphique...");
@@ -287,25 +182,31 @@ void setup() {
 
   setLEDStatus(LED_RUNNING);
 
-  checkAutoBackup();
+  // Démarre la tâche maintenance (persistance, archivage, backup)
+  postSystemEvent(EVT_SYSTEM_READY);
+  
+  // Les requêtes HTTP sont servies une fois tous les modules initialisés
+  startTask(webTask, "WebTask", WEB_TASK_STACK, WEB_TASK_PRIORITY, &webTaskHandle, WEB_TASK_CORE);
 
   LOG_SEPARATOR();
   LOG_I(LOG_SYSTEM, "========================================");
   LOG_I(LOG_SYSTEM, "SETUP TERMINE AVEC SUCCES!");
   LOG_I(LOG_SYSTEM, "========================================");
-  LOG_I(LOG_SYSTEM, "Systeme pret - Core 0: Web/OTA, Core 1: Capteurs/Timers");
+  LOG_I(LOG_SYSTEM, "Systeme pret - Core 0: Web/OTA/Maintenance, Core 1: Controle/Reseau");
   LOG_SEPARATOR();
   
   LOG_MEMORY();
+  
+  // Logs différés : écrits par LogTask à partir d'ici
+  startLogTask();
+  registerMetricsTask(logTaskHandle, LOG_TASK_STACK);
 }
 
 // ============================================================================
-// LOOP - BOUCLE PRINCIPALE (Core 0 - Web & OTA uniquement)
+// LOOP - BOUCLE PRINCIPALE (inutilisée, voir core_tasks.h)
 // ============================================================================
 
 void loop() {
-  server.handleClient();
-  checkAutoBackup();
-  checkMemoryPeriodic();
-  delay(10);
+  // Tout le travail est fait par les tâches (contrôle, réseau, maintenance, web)
+  vTaskDelay(pdMS_TO_TICKS(1000));
 }
\ No newline at end of file
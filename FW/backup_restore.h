@@ -1,7 +1,7 @@
 /* 
  * POOL CONNECT - BACKUP/RESTORE SYSTEM
  * Sauvegarde et restauration complète de la configuration
- * backup_restor.h   V0.3
+ * backup_restor.h   V0.7
  */
 
 #ifndef BACKUP_RESTORE_H
@@ -11,8 +11,11 @@
 #include <LittleFS.h>
 #include <ArduinoJson.h>
 #include "globals.h"
+#include "time_service.h"
 #include "config.h"
 #include "logging.h"
+#include "energy_meter.h"
+#include "heat_pump_control.h"
 
 // ============================================================================
 // GÉNÉRATION BACKUP JSON
@@ -30,7 +33,7 @@ String generateBackupJSON() {
   LOG_V(LOG_BACKUP, "Version: %s, Timestamp: %lu", FIRMWARE_VERSION, millis() / 1000);
   
   struct tm timeinfo;
-  if (getLocalTime(&timeinfo)) {
+  if (getCachedTime(&timeinfo)) {
     char timeStr[32];
     strftime(timeStr, sizeof(timeStr), "%Y-%m-%d %H:%M:%S", &timeinfo);
     doc["date"] = timeStr;
@@ -122,6 +125,8 @@ String generateBackupJSON() {
     start["minute"] = timer->startTime.minute;
     start["sunriseOffset"] = timer->startTime.sunriseOffset;
     
+    recurrenceToJson(timer->recurrence, t.createNestedObject("recurrence"));
+    
     JsonArray conds = t.createNestedArray("conditions");
     for (int c = 0; c < timer->conditionCount; c++) {
       JsonObject cond = conds.createNestedObject();
@@ -145,7 +150,7 @@ String generateBackupJSON() {
       act["ledMode"] = timer->actions[a].ledMode;
       act["ledDuration"] = timer->actions[a].ledDuration;
       
-      if (timer->actions[a].type == ACTION_AUTO_DURATION) {
+      if (timer->actions[a].type == ACTION_AUTO_DURATION || timer->actions[a].type == ACTION_PLANNED_FILTRATION) {
         JsonObject eq = act.createNestedObject("customEquation");
         eq["useCustom"] = timer->actions[a].customEquation.useCustom;
         eq["expression"] = timer->actions[a].customEquation.expression;
@@ -178,6 +183,14 @@ String generateBackupJSON() {
         latitude.c_str(), longitude.c_str(), 
         weatherApiKey.length() > 0 ? "configure" : "non configure");
   
+  // Énergie (puissances, calendrier tarifaire ; pas les compteurs)
+  LOG_D(LOG_BACKUP, "Sauvegarde de la configuration energie...");
+  writeEnergyConfigJson(doc.createNestedObject("energy"));
+  
+  // Thermostat PAC
+  LOG_D(LOG_BACKUP, "Sauvegarde du thermostat PAC...");
+  writeHeatPumpJson(doc.createNestedObject("heatpump"));
+  
   // Historique (limité aux 50 dernières entrées)
   LOG_D(LOG_BACKUP, "Sauvegarde de l'historique...");
   JsonArray histArr = doc.createNestedArray("history");
@@ -423,6 +436,9 @@ bool restoreFromJSON(String json) {
       timer->startTime.minute = start["minute"];
       timer->startTime.sunriseOffset = start["sunriseOffset"] | 0;
       
+      // Sauvegardes antérieures : pas de récurrence (une fois par jour)
+      recurrenceFromJson(timer->recurrence, t["recurrence"]);
+      
       JsonArray conds = t["conditions"];
       timer->conditionCount = conds.size();
       LOG_V(LOG_BACKUP, "Timer '%s': %d conditions", timer->name.c_str(), timer->conditionCount);
@@ -460,6 +476,7 @@ bool restoreFromJSON(String json) {
       timer->context.state = TIMER_IDLE;
       timer->context.currentActionIndex = 0;
       timer->lastTriggeredDay = -1;
+      timer->lastTriggeredStart = -1;
       
       LOG_V(LOG_BACKUP, "Timer %d restaure: '%s' (enabled=%d)", 
             flexTimerCount, timer->name.c_str(), timer->enabled);
@@ -478,7 +495,12 @@ bool restoreFromJSON(String json) {
     mqttPort = doc["mqtt"]["port"] | 1883;
     mqttUser = doc["mqtt"]["user"].as<String>();
     mqttPassword = doc["mqtt"]["password"].as<String>();
-    mqttTopic = doc["mqtt"]["topic"].as<String>();
+    String topic = doc["mqtt"]["topic"].as<String>();
+    if (isValidMqttBaseTopic(topic)) {
+      mqttTopic = topic;
+    } else {
+      LOG_W(LOG_BACKUP, "Topic MQTT trop long ignore (%d caracteres)", topic.length());
+    }
     saveMQTTConfig();
     LOG_I(LOG_BACKUP, "MQTT restaure: serveur=%s:%d, user=%s", 
           mqttServer.c_str(), mqttPort, mqttUser.c_str());
@@ -499,6 +521,28 @@ bool restoreFromJSON(String json) {
     LOG_W(LOG_BACKUP, "Pas de configuration meteo dans le backup");
   }
   
+  // Énergie
+  if (doc.containsKey("energy")) {
+    LOG_D(LOG_BACKUP, "Restauration de la configuration energie...");
+    readEnergyConfigJson(doc["energy"].as<JsonObject>());
+    saveEnergyConfig();
+    LOG_I(LOG_BACKUP, "Energie restauree: HP=%.4f, HC=%.4f",
+          energyConfig.tariff.pricePeak, energyConfig.tariff.priceOffPeak);
+  } else {
+    LOG_W(LOG_BACKUP, "Pas de configuration energie dans le backup");
+  }
+  
+  // Thermostat PAC
+  if (doc.containsKey("heatpump")) {
+    LOG_D(LOG_BACKUP, "Restauration du thermostat PAC...");
+    readHeatPumpJson(doc["heatpump"].as<JsonObject>());
+    saveHeatPumpConfig();
+    LOG_I(LOG_BACKUP, "Thermostat PAC restaure: mode %s, consigne %.1fC",
+          getThermostatModeName(heatPumpParams.mode), heatPumpParams.setpoint);
+  } else {
+    LOG_W(LOG_BACKUP, "Pas de thermostat PAC dans le backup");
+  }
+  
   // Historique
   if (doc.containsKey("history")) {
     LOG_D(LOG_BACKUP, "Restauration de l'historique...");
@@ -541,7 +585,7 @@ void checkAutoBackup() {
     LOG_I(LOG_BACKUP, "Declenchement du backup automatique (intervalle 24h atteint)");
     
     struct tm timeinfo;
-    if (getLocalTime(&timeinfo)) {
+    if (getCachedTime(&timeinfo)) {
       char filename[32];
       strftime(filename, sizeof(filename), "/backup_%Y%m%d.json", &timeinfo);
       LOG_I(LOG_BACKUP, "Fichier de backup date: %s", filename);
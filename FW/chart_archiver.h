@@ -13,6 +13,7 @@
 #include "config.h"
 #include "logging.h"
 #include "chart_storage.h"
+#include "time_service.h"
 
 // ============================================================================
 // CONSTANTES
@@ -25,7 +26,7 @@
 // VARIABLES GLOBALES
 // ============================================================================
 
-int lastCheckDay = -1;
+uint32_t archiveDaySeen = 0;   // Compteur de jours du service horaire
 unsigned long lastMemoryCheck = 0;
 
 // ============================================================================
@@ -35,27 +36,22 @@ unsigned long lastMemoryCheck = 0;
 void checkAndPurgeOldData();
 
 // ============================================================================
-// VÉRIFICATION QUOTIDIENNE (À MINUIT)
+// VÉRIFICATION QUOTIDIENNE (CHANGEMENT DE JOUR)
 // ============================================================================
 
 void checkDailyArchive() {
-  time_t now;
-  time(&now);
-  struct tm* timeinfo = localtime(&now);
-  
-  int currentDay = timeinfo->tm_mday;
-  int currentHour = timeinfo->tm_hour;
-  int currentMinute = timeinfo->tm_min;
-  
-  // Vérifier si on vient de passer minuit (entre 00:00 et 00:05)
-  if (currentDay != lastCheckDay && currentHour == 0 && currentMinute < 5) {
+  // Événement fourni par le service horaire : pas de fenêtre à manquer
+  if (consumeDayRollover(&archiveDaySeen)) {
+    struct tm timeinfo;
+    getCachedTime(&timeinfo);
+    
     LOG_SEPARATOR();
     LOG_I(LOG_CHART, "========================================");
     LOG_I(LOG_CHART, "ARCHIVAGE AUTOMATIQUE - NOUVEAU JOUR");
     LOG_I(LOG_CHART, "========================================");
     LOG_I(LOG_CHART, "Date actuelle: %04d-%02d-%02d %02d:%02d", 
-          timeinfo->tm_year + 1900, timeinfo->tm_mon + 1, currentDay,
-          currentHour, currentMinute);
+          timeinfo.tm_year + 1900, timeinfo.tm_mon + 1, timeinfo.tm_mday,
+          timeinfo.tm_hour, timeinfo.tm_min);
     LOG_SEPARATOR();
     
     // Archiver le jour précédent
@@ -65,8 +61,6 @@ void checkDailyArchive() {
       LOG_E(LOG_CHART, "Echec de l'archivage quotidien");
     }
     
-    lastCheckDay = currentDay;
-    
     // Vérifier l'espace disque et purger si nécessaire
     checkAndPurgeOldData();
     
@@ -275,15 +269,10 @@ void checkMemoryPeriodic() {
 void initChartArchiver() {
   LOG_I(LOG_CHART, "Initialisation du systeme d'archivage...");
   
-  time_t now;
-  time(&now);
-  struct tm* timeinfo = localtime(&now);
-  
-  lastCheckDay = timeinfo->tm_mday;
+  archiveDaySeen = timeDayCounter;
   lastMemoryCheck = millis();
   
-  LOG_I(LOG_CHART, "Jour de reference: %d", lastCheckDay);
-  LOG_I(LOG_CHART, "Archivage automatique active (verification a minuit)");
+  LOG_I(LOG_CHART, "Archivage automatique active (sur changement de jour)");
   
   // Vérifier immédiatement l'espace disque
   size_t totalBytes = LittleFS.totalBytes();
@@ -13,6 +13,11 @@
  * 
  * Cela permet d'avoir un graphique précis montrant exactement quand les 
  * équipements changent d'état, sans attendre le prochain intervalle régulier.
+ * 
+ * Les événements sont regroupés : tous ceux qui arrivent dans une fenêtre de
+ * CHART_EVENT_COALESCE_MS produisent un seul point (état final de la rafale),
+ * et un point identique au précédent n'est pas ajouté. Le buffer de 1440
+ * points n'est ainsi plus rempli par des doublons qui chassent l'historique.
  */
 
 #ifndef CHART_EVENT_POINTS_H
@@ -20,6 +25,31 @@
 
 #include "chart_storage.h"
 #include "globals.h"
+#include "relay_service.h"
+
+// ============================================================================
+// CONSTANTES
+// ============================================================================
+
+#define CHART_EVENT_COALESCE_MS 2000       // Fenêtre de regroupement des événements
+#define CHART_DEDUP_TEMP_DELTA 0.1         // Écart de température considéré identique (°C)
+#define CHART_DEDUP_PRESSURE_DELTA 0.05    // Écart de pression considéré identique (BAR)
+
+// ============================================================================
+// VARIABLES GLOBALES
+// ============================================================================
+
+// Point en attente : capturé par captureCurrentStateToChart() (toute tâche),
+// validé par processChartEvents() (tâche maintenance) une fois la fenêtre écoulée.
+ChartDataPoint pendingEventPoint;
+bool eventPointPending = false;
+unsigned long pendingEventSince = 0;
+int pendingEventMerged = 0;
+portMUX_TYPE chartEventMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Statistiques
+unsigned long chartEventsCoalesced = 0;
+unsigned long chartEventsDeduplicated = 0;
 
 // ============================================================================
 // FONCTION HELPER - AJOUT DE POINT FORCÉ
@@ -27,7 +57,7 @@
 
 /**
  * Ajoute un point de données au graphique IMMÉDIATEMENT, sans vérifier l'intervalle.
- * À utiliser lors des événements (changements d'état) pour avoir un graphique précis.
+ * Utilisé par processChartEvents() une fois la fenêtre de regroupement écoulée.
  * 
  * @param waterTemp Température de l'eau
  * @param pressure Pression de l'eau
@@ -40,14 +70,12 @@ void addChartPointOnEvent(float waterTemp, float pressure, bool* relayStates,
   
   LOG_D(LOG_CHART, "Ajout point sur EVENEMENT...");
   
+  lockChartBuffer();
+  
   // Buffer circulaire : si plein, décaler tous les points
   if (chartBufferCount >= MAX_CHART_POINTS) {
     LOG_V(LOG_CHART, "Buffer plein - Decalage des donnees (FIFO)");
-    
-    for (int i = 0; i < MAX_CHART_POINTS - 1; i++) {
-      chartBuffer[i] = chartBuffer[i + 1];
-    }
-    chartBufferCount = MAX_CHART_POINTS - 1;
+    dropOldestChartPoint();
   }
   
   // Ajouter le nouveau point
@@ -67,15 +95,37 @@ void addChartPointOnEvent(float waterTemp, float pressure, bool* relayStates,
   point->activeTimers = activeTimers;
   
   chartBufferCount++;
+  unlockChartBuffer();
   // NE PAS mettre à jour lastChartSave pour permettre le prochain point régulier
   
   LOG_I(LOG_CHART, "Point EVENEMENT ajoute: T=%.1f C, P=%.2f BAR", waterTemp, pressure);
   LOG_V(LOG_CHART, "Buffer: %d/%d points", chartBufferCount, MAX_CHART_POINTS);
   
-  // Sauvegarder si buffer presque plein
-  if (chartBufferCount % 10 == 0 || chartBufferCount > 100) {
-    saveCurrentDayFile();
-  }
+  markChartDirty();
+}
+
+// ============================================================================
+// DÉDUPLICATION
+// ============================================================================
+
+/**
+ * Indique si un point est identique au dernier point du buffer
+ * (mêmes états d'équipements, mesures dans la zone morte).
+ */
+bool isSameAsLastChartPoint(const ChartDataPoint& p) {
+  if (chartBufferCount == 0) return false;
+  
+  const ChartDataPoint& last = chartBuffer[chartBufferCount - 1];
+  
+  return last.relayPump == p.relayPump &&
+         last.relayElectro == p.relayElectro &&
+         last.relayLight == p.relayLight &&
+         last.relayValve == p.relayValve &&
+         last.relayPAC == p.relayPAC &&
+         last.coverOpen == p.coverOpen &&
+         last.activeTimers == p.activeTimers &&
+         fabs(last.waterTemp - p.waterTemp) < CHART_DEDUP_TEMP_DELTA &&
+         fabs(last.pressure - p.pressure) < CHART_DEDUP_PRESSURE_DELTA;
 }
 
 // ============================================================================
@@ -83,15 +133,20 @@ void addChartPointOnEvent(float waterTemp, float pressure, bool* relayStates,
 // ============================================================================
 
 /**
- * Capture l'état actuel de tous les équipements et ajoute un point au graphique.
- * Simplifie l'appel depuis différents endroits du code.
+ * Capture l'état actuel de tous les équipements et le place en attente.
+ * Peut être appelée depuis les deux cores, y compris avec dataMutex déjà pris
+ * (lecture des capteurs) : aucune attente de mutex ni écriture flash ici.
+ * Un nouvel appel pendant la fenêtre remplace le point en attente.
  */
 void captureCurrentStateToChart() {
+  ChartDataPoint snapshot;
+  
   // Lire les états des relais
-  bool relayStates[5];
-  for (int i = 0; i < 5; i++) {
-    relayStates[i] = (digitalRead(relayPins[i]) == HIGH);
-  }
+  snapshot.relayPump = isRelayOn(0);
+  snapshot.relayElectro = isRelayOn(1);
+  snapshot.relayLight = isRelayOn(2);
+  snapshot.relayValve = isRelayOn(3);
+  snapshot.relayPAC = isRelayOn(4);
   
   // Compter les timers actifs
   uint8_t activeTimersCount = 0;
@@ -100,14 +155,64 @@ void captureCurrentStateToChart() {
       activeTimersCount++;
     }
   }
+  snapshot.activeTimers = activeTimersCount;
   
-  // Ajouter le point avec les données actuelles
-  if (xSemaphoreTake(dataMutex, pdMS_TO_TICKS(100))) {
-    addChartPointOnEvent(waterTemp, waterPressure, relayStates, 
-                        coverOpen, activeTimersCount);
-    xSemaphoreGive(dataMutex);
+  // Lectures atomiques (float/bool 32 bits) - pas de mutex nécessaire
+  snapshot.waterTemp = waterTemp;
+  snapshot.pressure = waterPressure;
+  snapshot.coverOpen = coverOpen;
+  snapshot.timestamp = 0;  // Horodaté à la validation
+  
+  portENTER_CRITICAL(&chartEventMux);
+  if (eventPointPending) {
+    pendingEventMerged++;
+    chartEventsCoalesced++;
   } else {
-    LOG_W(LOG_CHART, "Mutex timeout - point evenement ignore");
+    eventPointPending = true;
+    pendingEventSince = millis();
+    pendingEventMerged = 0;
+  }
+  pendingEventPoint = snapshot;
+  portEXIT_CRITICAL(&chartEventMux);
+  
+  LOG_V(LOG_CHART, "Evenement graphique en attente (fenetre %d ms)", CHART_EVENT_COALESCE_MS);
+}
+
+// ============================================================================
+// TRAITEMENT DES ÉVÉNEMENTS EN ATTENTE (TÂCHE MAINTENANCE)
+// ============================================================================
+
+/**
+ * Valide le point en attente une fois la fenêtre de regroupement écoulée.
+ * Appelée par la tâche maintenance, seule à modifier le buffer du graphique
+ * (coût négligeable quand rien n'est en attente).
+ */
+void processChartEvents() {
+  if (eventPointPending && millis() - pendingEventSince >= CHART_EVENT_COALESCE_MS) {
+    ChartDataPoint point;
+    int merged;
+    
+    portENTER_CRITICAL(&chartEventMux);
+    point = pendingEventPoint;
+    merged = pendingEventMerged;
+    eventPointPending = false;
+    portEXIT_CRITICAL(&chartEventMux);
+    
+    if (merged > 0) {
+      LOG_D(LOG_CHART, "%d evenements regroupes en un seul point", merged + 1);
+    }
+    
+    if (isSameAsLastChartPoint(point)) {
+      chartEventsDeduplicated++;
+      LOG_V(LOG_CHART, "Point evenement identique au precedent - ignore");
+    } else {
+      bool relayStates[5] = {
+        point.relayPump, point.relayElectro, point.relayLight,
+        point.relayValve, point.relayPAC
+      };
+      addChartPointOnEvent(point.waterTemp, point.pressure, relayStates,
+                           point.coverOpen, point.activeTimers);
+    }
   }
 }
 
@@ -1,7 +1,12 @@
 /* 
  * POOL CONNECT - CHART STORAGE
  * Système de stockage hiérarchique pour les données de graphique
- * chart_storage.h   V1.0
+ * chart_storage.h   V1.1
+ *
+ * chartBuffer est modifié par la tâche maintenance (points, archivage) et
+ * lu par la tâche web pendant un transfert : accès sous chartMutex. Les
+ * lectures se font point par point à partir d'un numéro de séquence,
+ * stable quand le buffer se décale (plein) ou est vidé (archivage).
  */
 
 #ifndef CHART_STORAGE_H
@@ -20,6 +25,8 @@
 #define MAX_CHART_POINTS 1440        // Maximum de points par jour (1 minute = 1440 points)
 #define CHART_DIR "/chart"           // Répertoire racine
 #define CHART_CURRENT "/chart/current.json"  // Fichier du jour en cours
+#define CHART_PERSIST_INTERVAL_MS 600000     // Écriture de current.json au plus toutes les 10 minutes
+#define CHART_PERSIST_MAX_PENDING 20         // ... ou dès que 20 points non sauvegardés s'accumulent
 
 // ============================================================================
 // STRUCTURES
@@ -58,11 +65,67 @@ int chartIntervalMs = 300000;  // 5 minutes par défaut
 unsigned long lastChartSave = 0;
 ChartDayFile currentDayFile;
 
+// Persistance groupée : nombre de points ajoutés depuis la dernière écriture
+int chartDirtyPoints = 0;
+unsigned long lastChartPersist = 0;
+
+// Accès concurrents (tâche web)
+SemaphoreHandle_t chartMutex = NULL;
+uint32_t chartFirstSeq = 0;    // Numéro de séquence de chartBuffer[0]
+
 // ============================================================================
 // DÉCLARATIONS FORWARD
 // ============================================================================
 
+// ============================================================================
+// ACCÈS CONCURRENTS
+// ============================================================================
+
+void lockChartBuffer() {
+  xSemaphoreTake(chartMutex, portMAX_DELAY);
+}
+
+void unlockChartBuffer() {
+  xSemaphoreGive(chartMutex);
+}
+
+/**
+ * Buffer plein : le plus ancien point est retiré (appelant sous verrou).
+ */
+void dropOldestChartPoint() {
+  for (int i = 0; i < MAX_CHART_POINTS - 1; i++) {
+    chartBuffer[i] = chartBuffer[i + 1];
+  }
+  chartBufferCount = MAX_CHART_POINTS - 1;
+  chartFirstSeq++;
+}
+
+/**
+ * Points présents : numéros de séquence [first, end).
+ */
+void getChartPointRange(uint32_t* first, uint32_t* end) {
+  lockChartBuffer();
+  *first = chartFirstSeq;
+  *end = chartFirstSeq + chartBufferCount;
+  unlockChartBuffer();
+}
+
+/**
+ * Copie d'un point par son numéro de séquence.
+ *
+ * @return false si le point n'est plus dans le buffer (décalé ou archivé)
+ */
+bool copyChartPoint(uint32_t seq, ChartDataPoint* point) {
+  lockChartBuffer();
+  uint32_t index = seq - chartFirstSeq;
+  bool found = seq >= chartFirstSeq && index < (uint32_t)chartBufferCount;
+  if (found) *point = chartBuffer[index];
+  unlockChartBuffer();
+  return found;
+}
+
 void saveCurrentDayFile();
+void markChartDirty();
 
 // ============================================================================
 // INITIALISATION
@@ -71,6 +134,8 @@ void saveCurrentDayFile();
 void initChartStorage() {
   LOG_I(LOG_CHART, "Initialisation du systeme de stockage graphique...");
   
+  if (chartMutex == NULL) chartMutex = xSemaphoreCreateMutex();
+  
   // Créer la structure de répertoires
   if (!LittleFS.exists(CHART_DIR)) {
     if (LittleFS.mkdir(CHART_DIR)) {
@@ -148,6 +213,8 @@ void initChartStorage() {
     chartBufferCount = 0;
   }
   
+  lastChartPersist = millis();
+  
   LOG_I(LOG_CHART, "Initialisation terminee - Buffer: %d/%d points", 
         chartBufferCount, MAX_CHART_POINTS);
   LOG_MEMORY();
@@ -259,14 +326,12 @@ void addChartPoint(float waterTemp, float pressure, bool* relayStates,
   
   LOG_D(LOG_CHART, "Ajout d'un nouveau point de donnees...");
   
+  lockChartBuffer();
+  
   // Buffer circulaire : si plein, décaler tous les points
   if (chartBufferCount >= MAX_CHART_POINTS) {
     LOG_V(LOG_CHART, "Buffer plein - Decalage des donnees (FIFO)");
-    
-    for (int i = 0; i < MAX_CHART_POINTS - 1; i++) {
-      chartBuffer[i] = chartBuffer[i + 1];
-    }
-    chartBufferCount = MAX_CHART_POINTS - 1;
+    dropOldestChartPoint();
   }
   
   // Ajouter le nouveau point
@@ -289,16 +354,49 @@ void addChartPoint(float waterTemp, float pressure, bool* relayStates,
 
   
   chartBufferCount++;
+  unlockChartBuffer();
   lastChartSave = now;
   
   LOG_V(LOG_CHART, "Point ajoute: T=%.1f C, P=%.2f BAR, Timers=%d", 
         waterTemp, pressure, activeTimers);
   LOG_I(LOG_CHART, "Buffer: %d/%d points", chartBufferCount, MAX_CHART_POINTS);
   
-  // Sauvegarder toutes les 10 minutes ou si > 100 points
-  if (chartBufferCount % 2 == 0 || chartBufferCount > 100) {
-    saveCurrentDayFile();
+  // La sauvegarde est groupée (voir flushChartPersistence)
+  markChartDirty();
+}
+
+// ============================================================================
+// PERSISTANCE GROUPÉE
+// ============================================================================
+
+/**
+ * Signale qu'un point a été ajouté au buffer et devra être écrit sur la flash.
+ */
+void markChartDirty() {
+  chartDirtyPoints++;
+}
+
+/**
+ * Écrit current.json si des points sont en attente et que l'intervalle de
+ * persistance est écoulé (ou que trop de points se sont accumulés).
+ * Réécrire le fichier complet coûte plusieurs dizaines de KB par appel :
+ * on l'écrit donc par lots plutôt qu'à chaque point.
+ * 
+ * @param force Écrire immédiatement s'il reste des points (avant redémarrage)
+ */
+void flushChartPersistence(bool force = false) {
+  if (chartDirtyPoints == 0) return;
+  
+  unsigned long now = millis();
+  if (!force && chartDirtyPoints < CHART_PERSIST_MAX_PENDING &&
+      now - lastChartPersist < CHART_PERSIST_INTERVAL_MS) {
+    return;
   }
+  
+  LOG_D(LOG_CHART, "Persistance groupee: %d points en attente", chartDirtyPoints);
+  saveCurrentDayFile();
+  chartDirtyPoints = 0;
+  lastChartPersist = now;
 }
 
 // ============================================================================
@@ -321,6 +419,8 @@ void saveCurrentDayFile() {
                 String(safeMonth(currentDayFile.month)) + "-" + 
                 String(safeDay(currentDayFile.day));
   doc["interval"] = safeInterval(currentDayFile.intervalMs);
+  
+  lockChartBuffer();
   doc["count"] = safeCount(chartBufferCount);
   
   JsonArray points = doc.createNestedArray("points");
@@ -341,6 +441,7 @@ void saveCurrentDayFile() {
     p["co"] = safeBool(point->coverOpen);
     p["at"] = safeActiveTimers(point->activeTimers);
   }
+  unlockChartBuffer();
   
   size_t bytesWritten = serializeJson(doc, f);
   f.close();
@@ -407,6 +508,8 @@ bool archiveCurrentDay() {
                 String(safeMonth(currentDayFile.month)) + "-" + 
                 String(safeDay(currentDayFile.day));
   doc["interval"] = safeInterval(currentDayFile.intervalMs);
+  
+  lockChartBuffer();
   doc["count"] = safeCount(chartBufferCount);
   
   JsonArray points = doc.createNestedArray("points");
@@ -440,8 +543,12 @@ bool archiveCurrentDay() {
     LOG_D(LOG_CHART, "Fichier %s supprime", CHART_CURRENT);
   }
   
-  // Réinitialiser le buffer pour le nouveau jour
+  // Réinitialiser le buffer pour le nouveau jour (points ajoutés pendant
+  // l'écriture impossibles : verrou gardé depuis la copie)
+  chartFirstSeq += chartBufferCount;
   chartBufferCount = 0;
+  chartDirtyPoints = 0;
+  unlockChartBuffer();
   
   time_t now;
   time(&now);
@@ -462,73 +569,54 @@ bool archiveCurrentDay() {
 // RÉCUPÉRATION DES DONNÉES D'UN JOUR
 // ============================================================================
 
-String getChartDataForDate(int year, int month, int day) {
-  LOG_D(LOG_CHART, "Recuperation des donnees pour: %04d-%02d-%02d", year, month, day);
-  
-  // Vérifier si c'est le jour en cours
-  if (year == currentDayFile.year && month == currentDayFile.month && 
-      day == currentDayFile.day) {
-    LOG_D(LOG_CHART, "Jour en cours - Lecture du buffer RAM");
-    
-    DynamicJsonDocument doc(400000);  // 400 KB pour supporter intervalle 1 min
-    
-    // ✅ VALIDATION DES MÉTADONNÉES
-    doc["date"] = String(safeYear(year)) + "-" + String(safeMonth(month)) + "-" + String(safeDay(day));
-    doc["interval"] = safeInterval(chartIntervalMs);
-    doc["count"] = safeCount(chartBufferCount);
-    
-    JsonArray points = doc.createNestedArray("points");
-    
-    for (int i = 0; i < chartBufferCount; i++) {
-      JsonObject p = points.createNestedObject();
-      ChartDataPoint* point = &chartBuffer[i];
-      
-      // ✅ TOUTES LES DONNÉES VALIDÉES AVANT ÉCRITURE JSON
-      p["t"] = safeTimestamp(point->timestamp);
-      p["wt"] = safeFloat(point->waterTemp);
-      p["pr"] = safeFloat(point->pressure);
-      p["rp"] = safeBool(point->relayPump);
-      p["re"] = safeBool(point->relayElectro);
-      p["rl"] = safeBool(point->relayLight);
-      p["rv"] = safeBool(point->relayValve);
-      p["rh"] = safeBool(point->relayPAC);
-      p["co"] = safeBool(point->coverOpen);
-      p["at"] = safeActiveTimers(point->activeTimers);
-    }
-    
-    String output;
-    serializeJson(doc, output);
-    
-    LOG_I(LOG_CHART, "Donnees retournees: %d points (%d bytes)", 
-          chartBufferCount, output.length());
-    
-    return output;
-  }
-  
-  // Sinon charger depuis le fichier archive
-  char filePath[48];
-  snprintf(filePath, sizeof(filePath), "/chart/%04d/%02d/%02d.json",
-           year, month, day);
-  
-  LOG_D(LOG_CHART, "Lecture du fichier: %s", filePath);
-  
-  if (!LittleFS.exists(filePath)) {
-    LOG_W(LOG_CHART, "Fichier non trouve: %s", filePath);
-    return "{\"error\":\"Date not found\"}";
-  }
-  
-  File f = LittleFS.open(filePath, "r");
-  if (!f) {
-    LOG_E(LOG_CHART, "Erreur ouverture du fichier: %s", filePath);
-    return "{\"error\":\"Cannot open file\"}";
+/**
+ * Le jour demandé est-il le jour en cours (points dans le buffer RAM) ?
+ */
+bool isCurrentChartDay(int year, int month, int day) {
+  return year == currentDayFile.year && month == currentDayFile.month &&
+         day == currentDayFile.day;
+}
+
+void getChartArchivePath(int year, int month, int day, char* path, size_t size) {
+  snprintf(path, size, "/chart/%04d/%02d/%02d.json", year, month, day);
+}
+
+/**
+ * Positionne le fichier d'archive au début du tableau "points".
+ */
+bool seekChartArchivePoints(File& f) {
+  return f.find("\"points\"") && f.find("[");
+}
+
+/**
+ * Lit le point suivant d'une archive sans charger le fichier entier
+ * (un objet JSON à la fois, quelques centaines d'octets).
+ * 
+ * @return false à la fin du tableau ou sur erreur
+ */
+bool readNextArchivedChartPoint(File& f, ChartDataPoint* point) {
+  // Séparateurs entre deux objets
+  int c = f.peek();
+  while (c == ',' || c == ' ' || c == '\n' || c == '\r' || c == '\t') {
+    f.read();
+    c = f.peek();
   }
-  
-  String content = f.readString();
-  f.close();
-  
-  LOG_I(LOG_CHART, "Fichier lu avec succes: %d bytes", content.length());
-  
-  return content;
+  if (c != '{') return false;
+  
+  StaticJsonDocument<384> doc;
+  if (deserializeJson(doc, f)) return false;
+  
+  point->timestamp = doc["t"] | 0UL;
+  point->waterTemp = doc["wt"] | 0.0f;
+  point->pressure = doc["pr"] | 0.0f;
+  point->relayPump = doc["rp"] | false;
+  point->relayElectro = doc["re"] | false;
+  point->relayLight = doc["rl"] | false;
+  point->relayValve = doc["rv"] | false;
+  point->relayPAC = doc["rh"] | false;
+  point->coverOpen = doc["co"] | false;
+  point->activeTimers = doc["at"] | 0;
+  return true;
 }
 
 // ============================================================================
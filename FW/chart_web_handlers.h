@@ -1,14 +1,206 @@
 /* 
  * POOL CONNECT - CHART WEB HANDLERS
  * API REST pour le système de graphique historique
- * chart_web_handlers.h   V1.0
+ * chart_web_handlers.h   V1.3
  * 
  * À AJOUTER dans web_handlers.h avant le #endif final
+ * 
+ * Les données d'un jour et l'export CSV sont envoyés par morceaux :
+ * plus de document JSON de 400 KB construit en mémoire.
+ *
+ * Agrégats énergie ("energy") ajoutés à la réponse : compteurs en cours
+ * pour le jour courant, historique de energy_meter.h pour une archive.
+ *
+ * Données d'un jour et export CSV envoyés en arrière-plan (WebTransfer) :
+ * les autres requêtes sont servies pendant le téléchargement. Les points
+ * du jour en cours sont copiés un par un sous chartMutex.
  */
 
 #ifndef CHART_WEB_HANDLERS_H
 #define CHART_WEB_HANDLERS_H
 
+#include "web_stream.h"
+#include "energy_meter.h"
+
+// ============================================================================
+// ÉCRITURE DES POINTS
+// ============================================================================
+
+/**
+ * Point au format JSON du graphique (mêmes clés que current.json).
+ */
+void writeChartPointJson(ChunkedResponse& out, const ChartDataPoint& p, bool first) {
+  out.printf("%s{\"t\":%lu,\"wt\":%.2f,\"pr\":%.2f,\"rp\":%s,\"re\":%s,\"rl\":%s,"
+             "\"rv\":%s,\"rh\":%s,\"co\":%s,\"at\":%d}",
+             first ? "" : ",",
+             (unsigned long)safeTimestamp(p.timestamp),
+             safeFloat(p.waterTemp), safeFloat(p.pressure),
+             p.relayPump ? "true" : "false",
+             p.relayElectro ? "true" : "false",
+             p.relayLight ? "true" : "false",
+             p.relayValve ? "true" : "false",
+             p.relayPAC ? "true" : "false",
+             p.coverOpen ? "true" : "false",
+             safeActiveTimers(p.activeTimers));
+}
+
+void writeChartCsvRow(ChunkedResponse& out, const ChartDataPoint& p) {
+  time_t t = p.timestamp;
+  struct tm timeinfo;
+  localtime_r(&t, &timeinfo);
+  
+  char dateTime[32];
+  strftime(dateTime, sizeof(dateTime), "%Y-%m-%d,%H:%M:%S", &timeinfo);
+  
+  out.printf("%lu,%s,%.1f,%.2f,%d,%d,%d,%d,%d,%d,%d\n",
+             p.timestamp, dateTime, p.waterTemp, p.pressure,
+             p.relayPump ? 1 : 0, p.relayElectro ? 1 : 0, p.relayLight ? 1 : 0,
+             p.relayValve ? 1 : 0, p.relayPAC ? 1 : 0, p.coverOpen ? 1 : 0,
+             p.activeTimers);
+}
+
+/**
+ * ,"energy":{"sec":[...],"kwh":[...],"cost":...} : temps de marche, énergie
+ * et coût estimés de chaque relais sur le jour.
+ */
+void writeChartEnergyJson(ChunkedResponse& out, const uint32_t* sec, const uint32_t* offPeakSec) {
+  float cost = 0;
+  out.print(",\"energy\":{\"sec\":[");
+  for (int i = 0; i < NUM_RELAYS; i++) {
+    out.printf("%s%lu", i == 0 ? "" : ",", (unsigned long)sec[i]);
+    cost += runtimeToCost(i, sec[i], offPeakSec[i]);
+  }
+  out.print("],\"kwh\":[");
+  for (int i = 0; i < NUM_RELAYS; i++) {
+    out.printf("%s%.3f", i == 0 ? "" : ",", runtimeToKwh(i, sec[i]));
+  }
+  out.printf("],\"cost\":%.2f}", cost);
+}
+
+// ============================================================================
+// PRODUCTEURS (TRANSFERTS EN ARRIÈRE-PLAN)
+// ============================================================================
+
+// Date d'un transfert : tag = AAAAMMJJ
+#define CHART_TAG(y, m, d) ((uint32_t)(y) * 10000 + (m) * 100 + (d))
+#define CHART_TAG_YEAR(tag) ((int)((tag) / 10000))
+#define CHART_TAG_MONTH(tag) ((int)((tag) / 100 % 100))
+#define CHART_TAG_DAY(tag) ((int)((tag) % 100))
+
+/**
+ * Point suivant du jour en cours (points retirés du buffer entre-temps
+ * sautés).
+ *
+ * @return false quand tous les points ont été parcourus
+ */
+bool nextChartBufferPoint(WebTransfer& t, ChartDataPoint* point) {
+  while (t.cursor < t.end) {
+    if (copyChartPoint(t.cursor++, point)) return true;
+  }
+  return false;
+}
+
+/**
+ * Jour en cours : en-tête, points du buffer RAM, bilan énergie.
+ */
+bool fillChartDayJson(WebTransfer& t) {
+  ChartDataPoint point;
+
+  switch (t.stage) {
+    case 0:
+      t.printf("{\"date\":\"%d-%d-%d\",\"interval\":%lu,\"count\":%d,\"points\":[",
+               safeYear(CHART_TAG_YEAR(t.tag)), safeMonth(CHART_TAG_MONTH(t.tag)),
+               safeDay(CHART_TAG_DAY(t.tag)), safeInterval(chartIntervalMs),
+               safeCount(t.end - t.cursor));
+      t.stage = 1;
+      return true;
+
+    case 1:
+      if (nextChartBufferPoint(t, &point)) {
+        writeChartPointJson(t, point, t.items == 0);
+        t.items++;
+        return true;
+      }
+      t.stage = 2;
+      return true;
+
+    default:
+    {
+      t.print("]");
+
+      uint32_t sec[NUM_RELAYS], offPeakSec[NUM_RELAYS];
+      for (int i = 0; i < NUM_RELAYS; i++) {
+        RelayRuntimeCounters c;
+        getRelayRuntime(i, &c);
+        sec[i] = c.daySec;
+        offPeakSec[i] = c.dayOffPeakSec;
+      }
+      writeChartEnergyJson(t, sec, offPeakSec);
+      t.print("}");
+
+      LOG_I(LOG_WEB, "Donnees envoyees: %d points, %u bytes", t.items, (unsigned)t.bytesSent());
+      return false;
+    }
+  }
+}
+
+/**
+ * Archive : fichier recopié (sans son "}" final si le bilan énergie du jour
+ * est ajouté, tag != 0).
+ */
+bool fillChartArchiveJson(WebTransfer& t) {
+  if (t.cursor < t.end) {
+    uint8_t buf[512];
+    size_t remaining = t.end - t.cursor;
+    size_t n = t.file.read(buf, remaining < sizeof(buf) ? remaining : sizeof(buf));
+    if (n == 0) return false;
+    t.write(buf, n);
+    t.cursor += n;
+    return true;
+  }
+
+  if (t.tag != 0) {
+    EnergyDayRecord record;
+    if (getEnergyDayRecord(CHART_TAG_YEAR(t.tag), CHART_TAG_MONTH(t.tag), CHART_TAG_DAY(t.tag), &record)) {
+      writeChartEnergyJson(t, record.sec, record.offPeakSec);
+    }
+    t.print("}");
+  }
+  return false;
+}
+
+/**
+ * Export CSV : jour en cours (stage 1) ou archive (stage 2).
+ */
+bool fillChartCsv(WebTransfer& t) {
+  ChartDataPoint point;
+  bool more;
+
+  switch (t.stage) {
+    case 0:
+      t.print("Timestamp,Date,Time,Water Temp (C),Pressure (BAR),Pump,Electro,Light,Valve,PAC,Cover Open,Active Timers\n");
+      t.stage = t.file ? 2 : 1;
+      return true;
+
+    case 1:
+      more = nextChartBufferPoint(t, &point);
+      break;
+
+    default:
+      more = readNextArchivedChartPoint(t.file, &point);
+      break;
+  }
+
+  if (more) {
+    writeChartCsvRow(t, point);
+    t.items++;
+    return true;
+  }
+
+  LOG_I(LOG_WEB, "Export CSV termine: %d lignes, %u bytes", t.items, (unsigned)t.bytesSent());
+  return false;
+}
+
 // ============================================================================
 // API CHART - DONNÉES D'UN JOUR SPÉCIFIQUE
 // ============================================================================
@@ -39,15 +231,41 @@ void handleApiChartData() {
   
   LOG_V(LOG_WEB, "Date parsee: %04d-%02d-%02d", year, month, day);
   
-  String jsonData = getChartDataForDate(year, month, day);
+  // Jour en cours : points du buffer RAM envoyés au fil de l'eau
+  if (isCurrentChartDay(year, month, day)) {
+    WebTransfer* t = startWebTransfer("application/json", NULL, fillChartDayJson);
+    if (!t) return;
+    t->tag = CHART_TAG(year, month, day);
+    getChartPointRange(&t->cursor, &t->end);
+    return;
+  }
+  
+  // Archive : fichier envoyé tel quel
+  char filePath[48];
+  getChartArchivePath(year, month, day, filePath, sizeof(filePath));
   
-  if (jsonData.indexOf("error") >= 0) {
+  File f = LittleFS.open(filePath, "r");
+  if (!f) {
     LOG_W(LOG_WEB, "Donnees non trouvees pour %s", dateStr.c_str());
-    server.send(404, "application/json", jsonData);
-  } else {
-    LOG_I(LOG_WEB, "Donnees envoyees: %d bytes", jsonData.length());
-    server.send(200, "application/json", jsonData);
+    server.send(404, "application/json", "{\"error\":\"Date not found\"}");
+    return;
+  }
+  
+  LOG_I(LOG_WEB, "Archive envoyee: %s (%d bytes)", filePath, f.size());
+  
+  WebTransfer* t = startWebTransfer("application/json", NULL, fillChartArchiveJson);
+  if (!t) {
+    f.close();
+    return;
   }
+  
+  // Bilan énergie du jour : inséré avant la dernière accolade de l'archive
+  EnergyDayRecord record;
+  size_t size = f.size();
+  bool withEnergy = size >= 2 && getEnergyDayRecord(year, month, day, &record);
+  t->file = f;
+  t->end = withEnergy ? size - 1 : size;
+  t->tag = withEnergy ? CHART_TAG(year, month, day) : 0;
 }
 
 // ============================================================================
@@ -166,62 +384,42 @@ void handleApiChartExportCSV() {
   int month = dateStr.substring(5, 7).toInt();
   int day = dateStr.substring(8, 10).toInt();
   
-  // Récupérer les données JSON
-  String jsonData = getChartDataForDate(year, month, day);
+  char filename[32];
+  snprintf(filename, sizeof(filename), "poolconnect_%04d-%02d-%02d.csv", year, month, day);
   
-  if (jsonData.indexOf("error") >= 0) {
-    LOG_W(LOG_WEB, "Donnees non trouvees pour %s", dateStr.c_str());
-    server.send(404, "text/plain", "Date not found");
-    return;
+  bool currentDay = isCurrentChartDay(year, month, day);
+  File f;
+  
+  if (!currentDay) {
+    char filePath[48];
+    getChartArchivePath(year, month, day, filePath, sizeof(filePath));
+    
+    f = LittleFS.open(filePath, "r");
+    if (!f || !seekChartArchivePoints(f)) {
+      if (f) f.close();
+      LOG_W(LOG_WEB, "Donnees non trouvees pour %s", dateStr.c_str());
+      server.send(404, "text/plain", "Date not found");
+      return;
+    }
   }
   
-  // Parser le JSON pour créer le CSV
-  DynamicJsonDocument doc(100000);
-  DeserializationError err = deserializeJson(doc, jsonData);
+  // Envoi ligne par ligne avec header de téléchargement
+  char disposition[80];
+  snprintf(disposition, sizeof(disposition), "Content-Disposition: attachment; filename=%s\r\n", filename);
   
-  if (err) {
-    LOG_E(LOG_WEB, "Erreur parsing JSON: %s", err.c_str());
-    server.send(500, "text/plain", "JSON parse error");
+  WebTransfer* t = startWebTransfer("text/csv", disposition, fillChartCsv);
+  if (!t) {
+    if (f) f.close();
     return;
   }
   
-  // Construire le CSV
-  String csv = "Timestamp,Date,Time,Water Temp (C),Pressure (BAR),Pump,Electro,Light,Valve,PAC,Cover Open,Active Timers\n";
-  
-  JsonArray points = doc["points"];
-  
-  for (JsonObject p : points) {
-    unsigned long timestamp = p["t"];
-    
-    // Convertir timestamp en date/heure
-    time_t t = timestamp;
-    struct tm* timeinfo = localtime(&t);
-    
-    char dateTime[32];
-    strftime(dateTime, sizeof(dateTime), "%Y-%m-%d,%H:%M:%S", timeinfo);
-    
-    csv += String(timestamp) + "," + String(dateTime) + ",";
-    csv += String(p["wt"].as<float>(), 1) + ",";
-    csv += String(p["pr"].as<float>(), 2) + ",";
-    csv += String(p["rp"].as<bool>() ? 1 : 0) + ",";
-    csv += String(p["re"].as<bool>() ? 1 : 0) + ",";
-    csv += String(p["rl"].as<bool>() ? 1 : 0) + ",";
-    csv += String(p["rv"].as<bool>() ? 1 : 0) + ",";
-    csv += String(p["rh"].as<bool>() ? 1 : 0) + ",";
-    csv += String(p["co"].as<bool>() ? 1 : 0) + ",";
-    csv += String(p["at"].as<int>()) + "\n";
+  if (currentDay) {
+    getChartPointRange(&t->cursor, &t->end);
+  } else {
+    t->file = f;
   }
   
-  LOG_I(LOG_WEB, "CSV genere: %d lignes, %d bytes", points.size(), csv.length());
-  
-  // Envoyer avec header de téléchargement
-  char filename[32];
-  snprintf(filename, sizeof(filename), "poolconnect_%04d-%02d-%02d.csv", year, month, day);
-  
-  server.sendHeader("Content-Disposition", "attachment; filename=" + String(filename));
-  server.send(200, "text/csv", csv);
-  
-  LOG_I(LOG_WEB, "Export CSV termine: %s", filename);
+  LOG_D(LOG_WEB, "Export CSV demarre: %s", filename);
 }
 
 #endif // CHART_WEB_HANDLERS_H
@@ -1,7 +1,7 @@
 /* 
  * POOL CONNECT - CONFIGURATION
  * Pinout, constantes et définitions globales
- * config.h   V0.4
+ * config.h   V0.6
  */
 
 #ifndef CONFIG_H
@@ -43,6 +43,9 @@
 
 #define MAX_USERS 10
 #define MAX_TIMERS 20
+#define MAX_TIMER_CONDITIONS 10
+#define MAX_TIMER_ACTIONS 50
+#define MAX_TIMER_STARTS 8             // Heures de départ d'une liste (RECUR_LIST)
 #define MAX_HISTORY 50
 
 // NTP - Déclarations extern (définies dans globals_impl.cpp)
@@ -63,9 +66,16 @@ extern const unsigned long WEATHER_UPDATE_INTERVAL;
 // Activer/désactiver le système de logging
 #define ENABLE_LOGGING true
 
-// Niveau de log global (LOG_NONE=0, LOG_ERROR=1, LOG_WARNING=2, LOG_INFO=3, LOG_DEBUG=4, LOG_VERBOSE=5)
+// Niveau de log par défaut de chaque catégorie (LOG_NONE=0, LOG_ERROR=1, LOG_WARNING=2, LOG_INFO=3, LOG_DEBUG=4, LOG_VERBOSE=5)
+// Modifiable à l'exécution : /api/logs/levels ou MQTT <topic>/log/<categorie>/set
 #define LOG_LEVEL 4
 
+// Niveau maximal compilé (les logs au-dessus ne peuvent pas être activés)
+#define LOG_LEVEL_MAX 5
+
+// Journal en flash (/logs) : niveau par défaut des messages conservés (0 = désactivé)
+#define LOG_FLASH_LEVEL 2
+
 // Activer/désactiver les catégories spécifiques de logs
 #define LOG_WEB_REQUESTS       true  // Logs des requêtes HTTP
 #define LOG_WEB_DATA_EXCHANGE  true  // Logs des données échangées web <-> hardware
@@ -80,4 +90,12 @@ extern const unsigned long WEATHER_UPDATE_INTERVAL;
 // Vitesse du port série pour les logs
 #define SERIAL_BAUD_RATE 115200
 
+// ============================================
+// MÉTRIQUES SYSTÈME
+// ============================================
+
+// Publier un résumé (tas, pile, boucle contrôle) sur <topic>/system/...
+#define SYS_METRICS_MQTT false
+#define SYS_METRICS_MQTT_INTERVAL_MS 60000
+
 #endif // CONFIG_H
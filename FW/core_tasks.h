@@ -1,7 +1,9 @@
 /* 
- * POOL CONNECT - CORE 1 TASK
- * Gestion du Core 1 (capteurs, timers, MQTT, météo)
- * core_tasks.h   V0.2
+ * POOL CONNECT - TASKS
+ * Tâches FreeRTOS : contrôle (capteurs, timers, thermostat PAC), réseau (MQTT, météo),
+ * maintenance (persistance graphique, compteurs énergie, archivage, backup)
+ * et serveur web
+ * core_tasks.h   V1.1
  */
 
 #ifndef CORE_TASKS_H
@@ -9,6 +11,7 @@
 
 #include <Arduino.h>
 #include "globals.h"
+#include "time_service.h"
 #include "config.h"
 #include "logging.h"
 #include "sensors.h"
@@ -16,34 +19,81 @@
 #include "weather.h"
 #include "timer_processor.h"
 #include "led_buzzer.h"
+#include "task_bus.h"
+#include "relay_service.h"
+#include "mqtt_buffer.h"
+#include "mqtt_commands.h"
+#include "chart_event_points.h"
+#include "chart_archiver.h"
+#include "backup_restore.h"
+#include "web_events.h"
+#include "web_state.h"
+#include "system_metrics.h"
+#include "energy_meter.h"
+#include "heat_pump_control.h"
 
 // ============================================================================
-// CORE 1 TASK - Traitement des capteurs, timers et MQTT
+// CONFIGURATION DES TÂCHES
 // ============================================================================
 
-void core1Task(void *parameter) {
+// Contrôle : priorité la plus haute, ne fait jamais d'I/O réseau ni flash
+#define CONTROL_TASK_STACK 8192
+#define CONTROL_TASK_PRIORITY 3
+#define CONTROL_TASK_CORE 1
+#define CONTROL_TASK_PERIOD_MS 20
+
+// Réseau : MQTT et météo, peut bloquer sans affecter le contrôle
+#define NETWORK_TASK_STACK 8192
+#define NETWORK_TASK_PRIORITY 2
+#define NETWORK_TASK_CORE 1
+#define NETWORK_TASK_PERIOD_MS 10
+
+// Maintenance : écritures LittleFS (graphique, archives, backup)
+#define HOUSEKEEPING_TASK_STACK 8192
+#define HOUSEKEEPING_TASK_PRIORITY 1
+#define HOUSEKEEPING_TASK_CORE 0
+#define HOUSEKEEPING_TASK_PERIOD_MS 1000
+
+// Web : requêtes HTTP, réponses longues envoyées par morceaux
+#define WEB_TASK_STACK 12288
+#define WEB_TASK_PRIORITY 2
+#define WEB_TASK_CORE 0
+#define WEB_TASK_PERIOD_MS 2
+
+
+// ============================================================================
+// TÂCHE CONTRÔLE - Capteurs, timers, alarmes, LED
+// ============================================================================
+
+void controlTask(void *parameter) {
   LOG_SEPARATOR();
-  LOG_I(LOG_SYSTEM, "Core 1 Task demarre avec succes");
-  LOG_I(LOG_SYSTEM, "Responsabilites: Capteurs, Timers, MQTT, Meteo, LED");
-  LOG_V(LOG_SYSTEM, "Intervalle capteurs: 10s");
-  LOG_V(LOG_SYSTEM, "Intervalle MQTT publish: 10s");
-  LOG_V(LOG_SYSTEM, "Intervalle meteo: %lu ms", WEATHER_UPDATE_INTERVAL);
+  LOG_I(LOG_SYSTEM, "Tache Controle demarree (Core %d)", xPortGetCoreID());
+  LOG_I(LOG_SYSTEM, "Responsabilites: Capteurs, Timers, Thermostat PAC, Alarmes, LED");
+  LOG_V(LOG_SYSTEM, "Intervalle capteurs: 10s, periode: %d ms", CONTROL_TASK_PERIOD_MS);
   LOG_SEPARATOR();
   
   unsigned long loopCount = 0;
   unsigned long lastLogTime = 0;
+  TickType_t lastWake = xTaskGetTickCount();
   
   while(true) {
     loopCount++;
+    LoopTimer loopTimer;                   // Durée par section (system_metrics.h)
     
-    // Log périodique de l'activité du Core 1 (toutes les 60 secondes)
+    // Log périodique de l'activité (toutes les 60 secondes)
     if (millis() - lastLogTime > 60000) {
-      LOG_I(LOG_SYSTEM, "Core 1 actif - Iterations: %lu", loopCount);
+      LOG_I(LOG_SYSTEM, "Tache Controle active - Iterations: %lu", loopCount);
       LOG_MEMORY();
       lastLogTime = millis();
       loopCount = 0;
     }
     
+    // ========================================================================
+    // HEURE - Cache mis à jour une fois par seconde
+    // ========================================================================
+    updateTimeService();
+    loopTimer.lap(LOOP_SECTION_TIME);
+    
     // ========================================================================
     // LECTURE CAPTEURS - Toutes les 10 secondes
     // ========================================================================
@@ -55,14 +105,14 @@ void core1Task(void *parameter) {
       // AJOUT POINT AU GRAPHIQUE
       // ============================================================================
       
+      ChartDataPoint point;
+      
       // Collecter les états des relais
-      bool relayStates[5] = {
-        digitalRead(RELAY_POMPE),
-        digitalRead(RELAY_ELECTROLYSEUR),
-        digitalRead(RELAY_LAMPE),
-        digitalRead(RELAY_ELECTROVALVE),
-        digitalRead(RELAY_PAC)
-      };
+      point.relayPump = isRelayOn(0);
+      point.relayElectro = isRelayOn(1);
+      point.relayLight = isRelayOn(2);
+      point.relayValve = isRelayOn(3);
+      point.relayPAC = isRelayOn(4);
       
       // Compter les timers actifs
       uint8_t activeTimersCount = 0;
@@ -71,19 +121,28 @@ void core1Task(void *parameter) {
           activeTimersCount++;
         }
       }
+      point.activeTimers = activeTimersCount;
+      point.waterTemp = waterTemp;
+      point.pressure = waterPressure;
+      point.coverOpen = coverOpen;
+      point.timestamp = 0;
       
-      // Ajouter le point de données
-      addChartPoint(waterTemp, waterPressure, relayStates, 
-                    coverOpen, activeTimersCount);
+      // Le buffer est géré par la tâche maintenance
+      queueChartPoint(point);
       lastSensorRead = millis();
+      
+      // Prévenir la tâche réseau, le flux direct et l'instantané de l'interface
+      markSensorsChanged();
+      postSystemEvent(EVT_SENSORS_UPDATED | EVT_LIVE_CHANGED);
       LOG_V(LOG_SENSOR, "Prochaine lecture dans 10s");
     }
+    loopTimer.lap(LOOP_SECTION_SENSORS);
     
     // ========================================================================
     // TRAITEMENT TIMERS
     // ========================================================================
     struct tm timeinfo;
-    if (getLocalTime(&timeinfo)) {
+    if (getCachedTime(&timeinfo)) {
       static int lastMinute = -1;
       int currentMinute = timeinfo.tm_min;
       
@@ -102,40 +161,13 @@ void core1Task(void *parameter) {
         lastNtpWarning = millis();
       }
     }
+    loopTimer.lap(LOOP_SECTION_TIMERS);
     
     // ========================================================================
-    // MQTT - Reconnexion et publication
+    // THERMOSTAT PAC - Cadencé sur les mesures (10s)
     // ========================================================================
-    mqttReconnect();
-    
-    if (mqttClient.connected()) {
-      mqttClient.loop();
-      
-      static unsigned long lastMqttPublish = 0;
-      if (millis() - lastMqttPublish > 10000) {
-        LOG_V(LOG_MQTT, "Publication periodique des etats des capteurs");
-        publishSensorStates();
-        lastMqttPublish = millis();
-        LOG_V(LOG_MQTT, "Prochaine publication dans 10s");
-      }
-    } else {
-      static unsigned long lastMqttDisconnectLog = 0;
-      if (millis() - lastMqttDisconnectLog > 60000) { // Log toutes les 60s si déconnecté
-        LOG_W(LOG_MQTT, "Client MQTT deconnecte - Les donnees ne sont pas publiees");
-        lastMqttDisconnectLog = millis();
-      }
-    }
-    
-    // ========================================================================
-    // MÉTÉO - Mise à jour périodique
-    // ========================================================================
-    static unsigned long lastWeather = 0;
-    if (millis() - lastWeather > WEATHER_UPDATE_INTERVAL) {
-      LOG_D(LOG_WEATHER, "Declenchement de la mise a jour meteo");
-      updateWeatherData();
-      lastWeather = millis();
-      LOG_V(LOG_WEATHER, "Prochaine mise a jour dans %lu ms", WEATHER_UPDATE_INTERVAL);
-    }
+    processHeatPumpControl();
+    loopTimer.lap(LOOP_SECTION_HEATING);
     
     // ========================================================================
     // LED - Activité si pas d'alarme
@@ -168,9 +200,189 @@ void core1Task(void *parameter) {
     if (!waterLeak && !currentPressureAlarm) {
       ledActivity();
     }
+    loopTimer.lap(LOOP_SECTION_ALARMS);
+    loopTimer.finish(CONTROL_TASK_PERIOD_MS * 1000UL);
+    
+    // Période fixe : la gigue ne dépend plus du réseau
+    vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(CONTROL_TASK_PERIOD_MS));
+  }
+}
+
+// ============================================================================
+// TÂCHE RÉSEAU - MQTT et météo
+// ============================================================================
+
+/**
+ * Publie les messages en attente dans la file MQTT (stockés pour
+ * republication si le client est déconnecté).
+ */
+void drainMqttOutQueue() {
+  MqttOutMessage msg;
+  
+  while (xQueueReceive(mqttOutQueue, &msg, 0) == pdTRUE) {
+    if (!mqttClient.connected()) {
+      bufferMqttOutMessage(msg);
+      continue;
+    }
     
-    delay(10);
+    char topic[MQTT_TOPIC_MAX];
+    formatMqttTopic(topic, sizeof(topic), msg.topic);
+    mqttClient.publish(topic, msg.payload, msg.retain);
+    LOG_MQTT_PUB(topic, msg.payload);
+  }
+}
+
+void networkTask(void *parameter) {
+  LOG_SEPARATOR();
+  LOG_I(LOG_SYSTEM, "Tache Reseau demarree (Core %d)", xPortGetCoreID());
+  LOG_I(LOG_SYSTEM, "Responsabilites: MQTT, Meteo");
+  LOG_V(LOG_SYSTEM, "Intervalle MQTT publish: 10s");
+  LOG_V(LOG_SYSTEM, "Intervalle meteo: %lu ms", WEATHER_UPDATE_INTERVAL);
+  LOG_SEPARATOR();
+  
+  while(true) {
+    // Attente des demandes des autres tâches (ou de la période)
+    EventBits_t events = xEventGroupWaitBits(systemEvents,
+        EVT_SENSORS_UPDATED | EVT_WEATHER_REFRESH | EVT_MQTT_RECONFIGURE | EVT_MQTT_REDISCOVER,
+        pdTRUE, pdFALSE, pdMS_TO_TICKS(NETWORK_TASK_PERIOD_MS));
+    
+    // ========================================================================
+    // MQTT - Reconfiguration demandée par l'interface web
+    // ========================================================================
+    if (events & EVT_MQTT_RECONFIGURE) {
+      LOG_I(LOG_MQTT, "Reconfiguration MQTT: %s:%d", mqttServer.c_str(), mqttPort);
+      if (mqttClient.connected()) {
+        mqttClient.disconnect();
+      }
+      clearHaDiscoveryCache();  // Topic de base peut-être modifié
+      mqttClient.setServer(mqttServer.c_str(), mqttPort);
+      mqttClient.setCallback(mqttCallback);
+      lastMqttAttempt = 0;
+    }
+    
+    // ========================================================================
+    // MQTT - Reconnexion et publication
+    // ========================================================================
+    mqttReconnect();
+    
+    if (mqttClient.connected()) {
+      mqttClient.loop();
+      drainMqttOutQueue();
+      
+      if (events & EVT_MQTT_REDISCOVER) {
+        LOG_I(LOG_MQTT, "Republication Home Assistant Discovery");
+        startHaDiscovery();
+      }
+      processHaDiscovery();
+      
+      // Nouvelle lecture des capteurs (10s) : seules les valeurs modifiées partent
+      if (events & EVT_SENSORS_UPDATED) {
+        LOG_V(LOG_MQTT, "Publication des changements des capteurs");
+        publishSensorStates();
+      }
+      
+      // État des timers : nouvelles mesures, commande reçue ou nouvelle connexion
+      if ((events & EVT_SENSORS_UPDATED) || mqttTimerStatesDirty ||
+          mqttTimerConnectSeen != mqttConnectCount) {
+        publishTimerStates();
+      }
+      
+      // Compteurs énergie : nouvelles mesures ou nouvelle connexion
+      if ((events & EVT_SENSORS_UPDATED) || mqttEnergyConnectSeen != mqttConnectCount) {
+        publishEnergyStates();
+      }
+      
+      // Messages stockés pendant la coupure : après le direct, découverte terminée
+      if (!isHaDiscoveryRunning()) processMqttReplay();
+    } else {
+      drainMqttOutQueue();  // Stockés pour republication horodatée
+      
+      if (events & EVT_SENSORS_UPDATED) {
+        bufferTelemetrySnapshot();
+      }
+      
+      static unsigned long lastMqttDisconnectLog = 0;
+      if (millis() - lastMqttDisconnectLog > 60000) { // Log toutes les 60s si déconnecté
+        LOG_W(LOG_MQTT, "Client MQTT deconnecte - Donnees stockees (%d en attente)", mqttBufferCount);
+        lastMqttDisconnectLog = millis();
+      }
+    }
+    
+    // ========================================================================
+    // MÉTÉO - Mise à jour périodique ou sur demande (report sur erreur)
+    // ========================================================================
+    processWeatherFetcher(events & EVT_WEATHER_REFRESH);
+  }
+}
+
+// ============================================================================
+// TÂCHE MAINTENANCE - Persistance, énergie, archivage, backup
+// ============================================================================
+
+void housekeepingTask(void *parameter) {
+  // Attendre la fin du setup (stockage graphique initialisé)
+  xEventGroupWaitBits(systemEvents, EVT_SYSTEM_READY, pdFALSE, pdTRUE, portMAX_DELAY);
+  
+  LOG_I(LOG_SYSTEM, "Tache Maintenance demarree (Core %d)", xPortGetCoreID());
+  
+  while(true) {
+    // Points périodiques transmis par la tâche contrôle
+    ChartDataPoint point;
+    if (xQueueReceive(chartPointQueue, &point, pdMS_TO_TICKS(HOUSEKEEPING_TASK_PERIOD_MS)) == pdTRUE) {
+      bool relayStates[5] = {
+        point.relayPump, point.relayElectro, point.relayLight,
+        point.relayValve, point.relayPAC
+      };
+      addChartPoint(point.waterTemp, point.pressure, relayStates,
+                    point.coverOpen, point.activeTimers);
+    }
+    
+    // Événements regroupés, puis écriture groupée de current.json
+    processChartEvents();
+    
+    // Redémarrage demandé : tout écrire, puis plus aucune écriture flash
+    if (xEventGroupGetBits(systemEvents) & EVT_PERSIST_FLUSH) {
+      xEventGroupClearBits(systemEvents, EVT_PERSIST_FLUSH);
+      flushChartPersistence(true);
+      flushEnergyCounters();
+      persistenceFrozen = true;
+      LOG_I(LOG_SYSTEM, "Sauvegarde avant redemarrage terminee");
+      xEventGroupSetBits(systemEvents, EVT_PERSIST_DONE);
+    }
+    
+    if (!persistenceFrozen) {
+      flushChartPersistence();
+      
+      // Compteurs de marche : changement d'heure ou de jour, écriture groupée
+      processEnergyMeter();
+      checkAutoBackup();
+    }
+    
+    checkMemoryPeriodic();
+    processSystemMetrics();
+  }
+}
+
+// ============================================================================
+// TÂCHE WEB - Serveur HTTP
+// ============================================================================
+
+/**
+ * Sert les requêtes HTTP hors de loop() (plus de delay(10) entre deux
+ * clients). Sur le core 0, les réponses longues ne retardent ni le
+ * contrôle ni le MQTT. Les téléchargements (graphique, CSV) avancent d'un
+ * segment par tour : les autres requêtes passent entre deux segments.
+ */
+void webTask(void *parameter) {
+  LOG_I(LOG_SYSTEM, "Tache Web demarree (Core %d)", xPortGetCoreID());
+  
+  while(true) {
+    server.handleClient();
+    processWebTransfers();
+    processLiveEvents();
+    refreshStateCache();
+    vTaskDelay(pdMS_TO_TICKS(WEB_TASK_PERIOD_MS));
   }
 }
 
-#endif // CORE_TASKS_H
\ No newline at end of file
+#endif // CORE_TASKS_H
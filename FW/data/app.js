@@ -53,11 +53,12 @@ document.addEventListener('DOMContentLoaded', () => {
     };
     
     try {
-      await fetch('/api/saveMQTT', {
+      const response = await fetch('/api/saveMQTT', {
         method: 'POST',
         headers: {'Content-Type': 'application/json'},
         body: JSON.stringify(config)
       });
+      if (!response.ok) throw new Error(await response.text());
       alert('✅ Configuration MQTT sauvegardée !');
       PoolSettings.loadSettings();
     } catch (error) {
@@ -88,6 +89,8 @@ document.addEventListener('DOMContentLoaded', () => {
     }
   });
   
+  document.getElementById('energyForm').addEventListener('submit', PoolSettings.saveEnergyConfig);
+  
   document.getElementById('systemForm').addEventListener('submit', async (e) => {
     e.preventDefault();
     
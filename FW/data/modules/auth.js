@@ -68,6 +68,7 @@ function logout() {
     if (updateInterval) {
       clearInterval(updateInterval);
     }   
+    PoolLive.stopLiveUpdates();
     
     showLogin();
   }
@@ -134,8 +135,12 @@ function showApp() {
 
   PoolChart.startChartInterval();
   
+  // Mesures et relais poussés par le firmware, le polling ne sert qu'en secours
+  PoolLive.startLiveUpdates();
+  
   if (updateInterval) clearInterval(updateInterval);
   updateInterval = setInterval(() => {
+    if (PoolLive.isConnected()) return;
 	PoolDashboard.updateSidebar(); // Actualiser sidebar toutes les 2 secondes
     const activeTab = document.querySelector('.tab-content.active').id;
     if (activeTab === 'tab-dashboard') PoolDashboard.updateDashboard();
@@ -94,6 +94,11 @@ function convertESP32DataToChart(esp32Data) {
     activeTimers: []
   };
   
+  // Agrégats énergie du jour (absents pour les anciennes archives)
+  if (esp32Data.energy) {
+    converted.energy = esp32Data.energy;
+  }
+  
   if (!esp32Data.points || esp32Data.points.length === 0) {
     return converted;
   }
@@ -695,8 +700,26 @@ function calculateChartStats() {
   const coverOpenTime = chartData.coverOpen.filter(c => c === 1).length;
   const coverOpenPercent = (coverOpenTime / chartData.coverOpen.length * 100).toFixed(1);
   
+  // Temps de marche : compteurs de l'ESP32 si disponibles, sinon estimés sur les points
+  const energy = chartData.energy;
   const heatPumpTime = chartData.heatPump.filter(h => h === 1).length;
-  const heatPumpHours = (heatPumpTime * chartUpdateInterval / 3600000).toFixed(1);
+  const heatPumpHours = energy
+    ? (energy.sec[4] / 3600).toFixed(1)
+    : (heatPumpTime * chartUpdateInterval / 3600000).toFixed(1);
+  
+  let energyText = '';
+  if (energy) {
+    const pumpHours = (energy.sec[0] / 3600).toFixed(1);
+    const electroHours = (energy.sec[1] / 3600).toFixed(1);
+    const totalKwh = energy.kwh.reduce((a, b) => a + b, 0);
+    energyText = `
+
+⚡ ÉNERGIE (estimée)
+  • Pompe: ${pumpHours}h (${energy.kwh[0].toFixed(2)} kWh)
+  • Électrolyseur: ${electroHours}h (${energy.kwh[1].toFixed(2)} kWh)
+  • PAC: ${heatPumpHours}h (${energy.kwh[4].toFixed(2)} kWh)
+  • Total: ${totalKwh.toFixed(2)} kWh - ${energy.cost.toFixed(2)} €`;
+  }
   
   // Afficher
   alert(`📊 STATISTIQUES SUR 24H
@@ -713,7 +736,7 @@ function calculateChartStats() {
 ⚙️ ÉQUIPEMENTS
   • Volet ouvert: ${coverOpenPercent}% du temps
   • PAC active: ${heatPumpHours}h
-  • Points de données: ${chartData.labels.length}`);
+  • Points de données: ${chartData.labels.length}${energyText}`);
 }
 
 // 7. PRÉDICTION SIMPLE (TENDANCE LINÉAIRE)
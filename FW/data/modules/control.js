@@ -10,21 +10,35 @@
  */
 async function updateControl() {
   try {
-    const relays = await fetch('/api/relays').then(r => r.json());
-    relays.forEach((state, i) => {
-      const checkbox = document.getElementById('ctrl-relay' + i);
-      if (checkbox) checkbox.checked = state;
-    });
-    
-    const sensors = await fetch('/api/sensors').then(r => r.json());
-    document.getElementById('ctrl-volet').textContent = sensors.coverOpen ? (t('open') || 'Ouvert') : (t('closed') || 'Fermé');
-    document.getElementById('ctrl-fuite').textContent = sensors.waterLeak ? '⚠️ ' + (t('leak_detected') || 'FUITE') : '✓ ' + (t('ok') || 'OK');
+    const state = await fetch('/api/state?fields=relays,sensors').then(r => r.json());
+    renderControlRelays(state.relays);
+    renderControlSensors(state.sensors);
     
   } catch (error) {
     console.error('Control update error:', error);
   }
 }
 
+/**
+ * Coche les interrupteurs selon l'état des relais
+ * @param {Array} relays - États des relais
+ */
+function renderControlRelays(relays) {
+  relays.forEach((state, i) => {
+    const checkbox = document.getElementById('ctrl-relay' + i);
+    if (checkbox) checkbox.checked = state;
+  });
+}
+
+/**
+ * Affiche l'état du volet et de la détection de fuite
+ * @param {Object} sensors - Format de /api/sensors
+ */
+function renderControlSensors(sensors) {
+  document.getElementById('ctrl-volet').textContent = sensors.coverOpen ? (t('open') || 'Ouvert') : (t('closed') || 'Fermé');
+  document.getElementById('ctrl-fuite').textContent = sensors.waterLeak ? '⚠️ ' + (t('leak_detected') || 'FUITE') : '✓ ' + (t('ok') || 'OK');
+}
+
 /**
  * Active/désactive un relais (équipement)
  * @param {number} relay - Numéro du relais (0-4)
@@ -34,11 +48,12 @@ async function toggleRelay(relay, state) {
   try {
     const response = await fetch(`/api/relay?ch=${relay}&state=${state ? 1 : 0}`);
     if (!response.ok) {
+      // Refus des règles de sécurité (409) : message et état réel
       const error = await response.text();
-      if (error.includes('pompe')) {
+      if (response.status === 409) {
         alert('⚠️ ' + error);
         const checkbox = document.getElementById('ctrl-relay' + relay);
-        if (checkbox) checkbox.checked = false;
+        if (checkbox) checkbox.checked = !state;
       }
     } else {
       PoolChart.addChartDataPoint();
@@ -67,6 +82,8 @@ async function toggleBuzzer(enabled) {
 window.PoolControl = {
   // Fonctions principales
   updateControl,
+  renderControlRelays,
+  renderControlSensors,
   toggleRelay,
   toggleBuzzer,
 };
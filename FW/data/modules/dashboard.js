@@ -16,71 +16,104 @@ let lastActiveTimerCount = 0;
  */
 async function updateDashboard() {
   try {
-    const temp = await fetch('/api/temp').then(r => r.text());
-    document.getElementById('dash-water-temp').textContent = temp === 'ERREUR' ? 'ERR' : formatTemperature(parseFloat(temp));
+    // Un seul instantané (304 si rien n'a changé depuis le dernier appel)
+    const state = await fetch('/api/state?fields=sensors,relays,timers').then(r => r.json());
+    renderWaterTemp(state.sensors.waterTemp);
+    renderSensors(state.sensors);
+    renderRelays(state.relays);
+    renderActiveTimers(state.timers);
     
-    const sensors = await fetch('/api/sensors').then(r => r.json());
-    document.getElementById('dash-pressure').textContent = formatPressure(sensors.waterPressure);
-    document.getElementById('dash-ext-temp').textContent = (sensors.extTemp !== null && sensors.extTemp !== undefined) ? formatTemperature(sensors.extTemp) : '--' + getTemperatureUnitLabel();
+    loadHistoryDashboard();
     
-    const leakCard = document.getElementById('leak-card');
-    const leakValue = document.getElementById('dash-leak');
-    if (sensors.waterLeak) {
-      leakValue.textContent = '⚠️ FUITE';
-      leakCard.style.background = 'linear-gradient(135deg, #e74c3c, #c0392b)';
-      leakCard.style.color = 'white';
-    } else {
-      leakValue.textContent = '✓ OK';
-      leakCard.style.background = '';
-      leakCard.style.color = '';
+  } catch (error) {
+    console.error('Dashboard update error:', error);
+  }
+}
+
+/**
+ * Affiche la température de l'eau (null = capteur en erreur)
+ * @param {number|null} temp - Température en °C
+ */
+function renderWaterTemp(temp) {
+  document.getElementById('dash-water-temp').textContent = (temp === null || isNaN(temp)) ? 'ERR' : formatTemperature(temp);
+}
+
+/**
+ * Affiche pression, température extérieure et détection de fuite
+ * @param {Object} sensors - Format de /api/sensors
+ */
+function renderSensors(sensors) {
+  document.getElementById('dash-pressure').textContent = formatPressure(sensors.waterPressure);
+  document.getElementById('dash-ext-temp').textContent = (sensors.extTemp !== null && sensors.extTemp !== undefined) ? formatTemperature(sensors.extTemp) : '--' + getTemperatureUnitLabel();
+  
+  const leakCard = document.getElementById('leak-card');
+  const leakValue = document.getElementById('dash-leak');
+  if (sensors.waterLeak) {
+    leakValue.textContent = '⚠️ FUITE';
+    leakCard.style.background = 'linear-gradient(135deg, #e74c3c, #c0392b)';
+    leakCard.style.color = 'white';
+  } else {
+    leakValue.textContent = '✓ OK';
+    leakCard.style.background = '';
+    leakCard.style.color = '';
+  }
+}
+
+/**
+ * Affiche les états des équipements
+ * @param {Array} relays - États des relais
+ */
+function renderRelays(relays) {
+  // Mettre à jour les états avec traductions
+  updateEquipmentStateTranslations(relays);
+  
+  // Mettre à jour les classes CSS
+  const equipmentNames = ['pompe', 'electro', 'lampe', 'valve', 'pac'];
+  relays.forEach((state, i) => {
+    const el = document.getElementById('eq-' + equipmentNames[i]);
+    if (el) {
+      el.className = 'equipment-state' + (state ? ' active' : '');
     }
-    
-    const relays = await fetch('/api/relays').then(r => r.json());
-    
-    // Mettre à jour les états avec traductions
-    updateEquipmentStateTranslations(relays);
-    
-    // Mettre à jour les classes CSS
-    const equipmentNames = ['pompe', 'electro', 'lampe', 'valve', 'pac'];
-    relays.forEach((state, i) => {
-      const el = document.getElementById('eq-' + equipmentNames[i]);
-      if (el) {
-        el.className = 'equipment-state' + (state ? ' active' : '');
-      }
-    });
-    
-    // FIX: Utiliser /api/timers/flex au lieu de /api/timers
-    const timersData = await fetch('/api/timers/flex').then(r => r.json()).catch(() => []);
-    const activeTimers = timersData.filter(t => t.context && t.context.state === 2); // TIMER_RUNNING = 2
-    document.getElementById('active-timers-count').textContent = activeTimers.length;
-    
-    if (activeTimers.length !== lastActiveTimerCount) {
-      lastActiveTimerCount = activeTimers.length;
+  });
+}
+
+/**
+ * Met à jour la liste des timers actifs
+ */
+async function updateActiveTimers() {
+  const state = await fetch('/api/state?fields=timers').then(r => r.json()).catch(() => ({ timers: [] }));
+  renderActiveTimers(state.timers);
+}
+
+/**
+ * Affiche la liste des timers actifs
+ * @param {Array} timers - Résumé des timers (bloc "timers" de /api/state)
+ */
+function renderActiveTimers(timers) {
+  const activeTimers = (timers || []).filter(t => t.state === 2); // TIMER_RUNNING = 2
+  document.getElementById('active-timers-count').textContent = activeTimers.length;
+  
+  if (activeTimers.length !== lastActiveTimerCount) {
+    lastActiveTimerCount = activeTimers.length;
 		if (typeof PoolChart.addChartDataPoint === 'function') {
 		  PoolChart.addChartDataPoint();
 		}
-    }
-    
-    if (activeTimers.length > 0) {
-      let html = '';
-      activeTimers.forEach(timer => {
-        html += `<div class="timer-item active">
-          <div class="timer-info">
-            <div class="timer-name">${timer.name}</div>
-            <div class="timer-details">${t('timer_action') || 'Action'} ${timer.context.currentAction + 1}/${timer.actionCount}</div>
-          </div>
-        </div>`;
-      });
-      document.getElementById('active-timers-list').innerHTML = html;
-    } else {
-      document.getElementById('active-timers-list').innerHTML = 
-        `<p style="text-align: center; color: #999; padding: 20px;">${t('no_active_timer')}</p>`;
-    }
-    
-    loadHistoryDashboard();
-    
-  } catch (error) {
-    console.error('Dashboard update error:', error);
+  }
+  
+  if (activeTimers.length > 0) {
+    let html = '';
+    activeTimers.forEach(timer => {
+      html += `<div class="timer-item active">
+        <div class="timer-info">
+          <div class="timer-name">${timer.name}</div>
+          <div class="timer-details">${t('timer_action') || 'Action'} ${timer.currentAction + 1}/${timer.actionCount}</div>
+        </div>
+      </div>`;
+    });
+    document.getElementById('active-timers-list').innerHTML = html;
+  } else {
+    document.getElementById('active-timers-list').innerHTML = 
+      `<p style="text-align: center; color: #999; padding: 20px;">${t('no_active_timer')}</p>`;
   }
 }
 
@@ -168,25 +201,27 @@ async function updateSidebar() {
     document.getElementById('datetime').textContent = '🕒 ' + time;
     
     // Mettre à jour la température de l'eau
-    const temp = await fetch('/api/temp').then(r => r.text());
-    if (temp !== 'ERREUR') {
-      document.getElementById('temperature').textContent = formatTemperature(temp);
-      
-      // Calculer temps de filtration recommandé (Temp / 2)
-      const tempValue = parseFloat(temp);
-      if (!isNaN(tempValue)) {
-        const heuresRecommandees = Math.round(tempValue / 2);
-        document.getElementById('tempsFiltrationRecommande').textContent = heuresRecommandees + 'h';
-      }
-    } else {
-      document.getElementById('temperature').textContent = 'ERR';
-    }
+    const state = await fetch('/api/state?fields=sensors').then(r => r.json());
+    renderSidebarTemp(state.sensors.waterTemp);
     
   } catch (error) {
     console.error('Sidebar update error:', error);
   }
 }
 
+/**
+ * Affiche la température de l'eau et le temps de filtration recommandé (Temp / 2)
+ * @param {number|null} temp - Température en °C (null = capteur en erreur)
+ */
+function renderSidebarTemp(temp) {
+  if (temp === null || isNaN(temp)) {
+    document.getElementById('temperature').textContent = 'ERR';
+    return;
+  }
+  document.getElementById('temperature').textContent = formatTemperature(temp);
+  document.getElementById('tempsFiltrationRecommande').textContent = Math.round(temp / 2) + 'h';
+}
+
 /**
  * Met à jour uniquement le statut de la pompe (temps restant)
  * Appelé plus fréquemment que updateSidebar (toutes les 1-2 secondes)
@@ -271,7 +306,13 @@ function showTab(tabName) {
 window.PoolDashboard = {
   // Fonctions principales
   updateDashboard,
+  updateActiveTimers,
+  renderActiveTimers,
   loadHistoryDashboard,
+  renderWaterTemp,
+  renderSensors,
+  renderRelays,
+  renderSidebarTemp,
   updateEquipmentStateTranslations,
   updateDynamicTranslations,
   updateSidebar,
@@ -284,7 +325,11 @@ window.PoolDashboard = {
 };
 
 // Mettre à jour le statut de la pompe toutes les 2 secondes (uniquement le temps restant)
+// En flux direct, les changements de relais déclenchent déjà la mise à jour : 30 secondes suffisent
+let pumpStatusTicks = 0;
 setInterval(() => {
+  pumpStatusTicks++;
+  if (typeof PoolLive !== 'undefined' && PoolLive.isConnected() && pumpStatusTicks % 15 !== 0) return;
   if (typeof PoolDashboard.updatePumpStatus === 'function') {
     PoolDashboard.updatePumpStatus();
   }
@@ -0,0 +1,117 @@
+// ============================================================================
+// LIVE.JS - Mises à jour en direct (Server-Sent Events)
+// ============================================================================
+
+// Le firmware pousse sur /api/events :
+// - "state" : état complet à la connexion
+// - "delta" : uniquement les champs modifiés (relais, capteurs, heure...)
+// Tant que le flux est ouvert, le polling de la sidebar et des onglets
+// Dashboard/Contrôle est suspendu. En cas d'erreur, le navigateur se
+// reconnecte seul et le polling reprend en attendant.
+
+let liveSource = null;
+let liveConnected = false;
+let liveState = {};
+let liveRetryTimer = null;
+
+const LIVE_RETRY_DELAY = 30000;   // Nouvel essai si le serveur a refusé le flux
+
+/**
+ * Ouvre le flux d'événements (sans effet s'il est déjà ouvert)
+ */
+function startLiveUpdates() {
+  if (liveSource || typeof EventSource === 'undefined') return;
+
+  liveSource = new EventSource('/api/events');
+
+  liveSource.addEventListener('state', (e) => {
+    liveState = {};
+    liveConnected = true;
+    applyLiveData(JSON.parse(e.data));
+  });
+
+  liveSource.addEventListener('delta', (e) => {
+    applyLiveData(JSON.parse(e.data));
+  });
+
+  liveSource.onerror = () => {
+    liveConnected = false;
+
+    // Flux refusé (trop de clients) : le navigateur abandonne, on réessaiera plus tard
+    if (liveSource && liveSource.readyState === EventSource.CLOSED) {
+      liveSource = null;
+      if (!liveRetryTimer) {
+        liveRetryTimer = setTimeout(() => {
+          liveRetryTimer = null;
+          startLiveUpdates();
+        }, LIVE_RETRY_DELAY);
+      }
+    }
+  };
+}
+
+/**
+ * Ferme le flux (déconnexion utilisateur)
+ */
+function stopLiveUpdates() {
+  if (liveRetryTimer) {
+    clearTimeout(liveRetryTimer);
+    liveRetryTimer = null;
+  }
+  if (liveSource) {
+    liveSource.close();
+    liveSource = null;
+  }
+  liveConnected = false;
+}
+
+/**
+ * Applique un événement à l'interface (seuls les champs présents changent)
+ * @param {Object} data - Champs reçus
+ */
+function applyLiveData(data) {
+  const previous = liveState;
+  liveState = Object.assign({}, liveState, data);
+
+  if ('time' in data) {
+    document.getElementById('datetime').textContent = '🕒 ' + data.time;
+  }
+
+  if ('waterTemp' in data) {
+    PoolDashboard.renderWaterTemp(data.waterTemp);
+    PoolDashboard.renderSidebarTemp(data.waterTemp);
+  }
+
+  if ('waterPressure' in data || 'extTemp' in data || 'waterLeak' in data || 'coverOpen' in data) {
+    PoolDashboard.renderSensors(liveState);
+    PoolControl.renderControlSensors(liveState);
+  }
+
+  if ('relays' in data) {
+    PoolDashboard.renderRelays(data.relays);
+    PoolControl.renderControlRelays(data.relays);
+    PoolDashboard.updatePumpStatus();
+  }
+
+  // Un timer démarre ou se termine : recharger la liste et l'historique
+  if ('activeTimers' in data) {
+    document.getElementById('active-timers-count').textContent = data.activeTimers;
+    if (previous.activeTimers !== undefined && previous.activeTimers !== data.activeTimers) {
+      PoolDashboard.updateActiveTimers();
+      PoolDashboard.loadHistoryDashboard();
+    }
+  }
+}
+
+// ============================================================================
+// EXPORT DES FONCTIONS
+// ============================================================================
+
+window.PoolLive = {
+  startLiveUpdates,
+  stopLiveUpdates,
+  isConnected: () => liveConnected,
+
+  // Variables
+  get liveState() { return liveState; }
+};
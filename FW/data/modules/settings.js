@@ -1,11 +1,12 @@
 // ============================================================================
-// SETTINGS.JS - Gestion des paramètres système (MQTT, Weather, System)
+// SETTINGS.JS - Gestion des paramètres système (MQTT, Weather, Energy, System)
 // ============================================================================
 
 /**
  * Charge tous les paramètres du système
  * - Configuration MQTT
  * - Configuration météo
+ * - Énergie (puissances, tarifs, compteurs)
  * - Configuration système
  * - Informations système
  */
@@ -16,6 +17,10 @@ async function loadSettings() {
     document.getElementById('mqtt-port').value = mqttConfig.port || 1883;
     document.getElementById('mqtt-user').value = mqttConfig.user || '';
     document.getElementById('mqtt-topic').value = mqttConfig.topic || 'pool/control';
+    document.getElementById('mqtt-temp-deadband').value = mqttConfig.tempDeadband !== undefined ? mqttConfig.tempDeadband : 0.1;
+    document.getElementById('mqtt-pressure-deadband').value = mqttConfig.pressureDeadband !== undefined ? mqttConfig.pressureDeadband : 0.02;
+    document.getElementById('mqtt-heartbeat').value = mqttConfig.heartbeat || 300;
+    document.getElementById('mqtt-state-json').checked = mqttConfig.stateJson === true;
     
     const mqttStatus = await fetch('/api/mqtt/status').then(r => r.json());
     const badge = document.getElementById('mqtt-status-badge');
@@ -43,6 +48,8 @@ async function loadSettings() {
     console.error('Weather config error:', error);
   }
   
+  loadEnergySettings();
+  
   try {
     const sysConfig = await fetch('/api/system/config').then(r => r.json());
     document.getElementById('pressure-threshold').value = sysConfig.pressureThreshold || 2.0;
@@ -139,15 +146,20 @@ async function saveMQTTConfig(e) {
     port: parseInt(document.getElementById('mqtt-port').value),
     user: document.getElementById('mqtt-user').value,
     password: document.getElementById('mqtt-password').value,
-    topic: document.getElementById('mqtt-topic').value
+    topic: document.getElementById('mqtt-topic').value,
+    tempDeadband: parseFloat(document.getElementById('mqtt-temp-deadband').value),
+    pressureDeadband: parseFloat(document.getElementById('mqtt-pressure-deadband').value),
+    heartbeat: parseInt(document.getElementById('mqtt-heartbeat').value),
+    stateJson: document.getElementById('mqtt-state-json').checked
   };
   
   try {
-    await fetch('/api/saveMQTT', {
+    const response = await fetch('/api/saveMQTT', {
       method: 'POST',
       headers: {'Content-Type': 'application/json'},
       body: JSON.stringify(config)
     });
+    if (!response.ok) throw new Error(await response.text());
     
     alert('✅ ' + (t('mqtt_saved') || 'Configuration MQTT sauvegardée !'));
     loadSettings();
@@ -184,6 +196,95 @@ async function saveWeatherConfig(e) {
   }
 }
 
+/**
+ * Charge la configuration énergie et affiche les compteurs par relais
+ */
+async function loadEnergySettings() {
+  try {
+    const energy = await fetch('/api/energy').then(r => r.json());
+    const config = energy.config;
+    
+    config.powerW.forEach((power, i) => {
+      const input = document.getElementById(`energy-power-${i}`);
+      if (input) input.value = power;
+    });
+    
+    ['hc1', 'hc2'].forEach((id, r) => {
+      const range = config.offPeak[r];
+      document.getElementById(`energy-${id}-start`).value = range ? range[0] : '';
+      document.getElementById(`energy-${id}-end`).value = range ? range[1] : '';
+    });
+    
+    document.getElementById('energy-price-peak').value = config.pricePeak;
+    document.getElementById('energy-price-offpeak').value = config.priceOffPeak;
+    
+    const badge = document.getElementById('energy-tariff-badge');
+    badge.textContent = energy.offPeakNow ? (t('energy_offpeak_now') || 'Heures creuses')
+                                          : (t('energy_peak_now') || 'Heures pleines');
+    badge.className = energy.offPeakNow ? 'badge success' : 'badge warning';
+    
+    const hours = sec => (sec / 3600).toFixed(1) + ' h';
+    let html = `<table style="width: 100%; font-size: 0.9em; border-collapse: collapse;">
+      <tr style="border-bottom: 1px solid #ddd;"><th></th>
+        <th>${t('energy_today') || "Aujourd'hui"}</th>
+        <th>${t('energy_month') || 'Ce mois'}</th>
+        <th>${t('energy_total') || 'Total'}</th></tr>`;
+    for (const relay of energy.relays) {
+      html += `<tr style="border-bottom: 1px solid #ddd;">
+        <td style="padding: 6px;">${relay.name}</td>
+        <td style="padding: 6px;">${hours(relay.daySec)} - ${relay.dayKwh.toFixed(2)} kWh - ${relay.dayCost.toFixed(2)} €</td>
+        <td style="padding: 6px;">${hours(relay.monthSec)} - ${relay.monthKwh.toFixed(1)} kWh - ${relay.monthCost.toFixed(2)} €</td>
+        <td style="padding: 6px;">${hours(relay.totalSec)} - ${relay.totalKwh.toFixed(0)} kWh</td></tr>`;
+    }
+    html += '</table>';
+    document.getElementById('energy-counters').innerHTML = html;
+  } catch (error) {
+    console.error('Energy config error:', error);
+  }
+}
+
+/**
+ * Sauvegarde la configuration énergie
+ * @param {Event} e - Événement du formulaire
+ */
+async function saveEnergyConfig(e) {
+  if (e) e.preventDefault();
+  
+  const powerW = [];
+  for (let i = 0; i < 5; i++) {
+    powerW.push(parseFloat(document.getElementById(`energy-power-${i}`).value) || 0);
+  }
+  
+  const offPeak = [];
+  ['hc1', 'hc2'].forEach(id => {
+    const start = document.getElementById(`energy-${id}-start`).value;
+    const end = document.getElementById(`energy-${id}-end`).value;
+    if (start !== '' && end !== '') offPeak.push([parseInt(start), parseInt(end)]);
+  });
+  
+  const config = {
+    powerW,
+    offPeak,
+    pricePeak: parseFloat(document.getElementById('energy-price-peak').value) || 0,
+    priceOffPeak: parseFloat(document.getElementById('energy-price-offpeak').value) || 0
+  };
+  
+  try {
+    const response = await fetch('/api/energy/config', {
+      method: 'POST',
+      headers: {'Content-Type': 'application/json'},
+      body: JSON.stringify(config)
+    });
+    if (!response.ok) throw new Error(`HTTP ${response.status}`);
+    
+    alert('✅ ' + (t('energy_saved') || 'Configuration énergie sauvegardée !'));
+    loadEnergySettings();
+  } catch (error) {
+    console.error('[SETTINGS] Erreur sauvegarde énergie:', error);
+    alert('❌ ' + (t('energy_save_error') || 'Erreur sauvegarde énergie'));
+  }
+}
+
 /**
  * Sauvegarde la configuration système
  * @param {Event} e - Événement du formulaire
@@ -218,6 +319,7 @@ window.PoolSettings = {
   // Chargement
   loadSettings,
   loadSystemInfo,
+  loadEnergySettings,
   
   // Actions
   testMQTT,
@@ -227,5 +329,6 @@ window.PoolSettings = {
   // Sauvegarde
   saveMQTTConfig,
   saveWeatherConfig,
+  saveEnergyConfig,
   saveSystemConfig,
 };
@@ -56,7 +56,7 @@ function displayFlexibleTimers(timers) {
                      '⏹️ ' + (t('timer_inactive') || 'Inactif');
     
     const days = getDaysText(timer.days);
-    const startTime = getStartTimeText(timer.startTime);
+    const startTime = getStartTimeText(timer.startTime, timer.recurrence);
     
     html += `
       <div class="timer-flex-item ${stateClass}">
@@ -136,15 +136,53 @@ function getDaysText(days) {
   return activeDays.length === 7 ? (t('every_day') || 'Tous les jours') : activeDays.join(', ');
 }
 
-function getStartTimeText(startTime) {
+function getStartTimeText(startTime, recurrence) {
+  // Liste d'heures : startTime n'est pas utilisé
+  if (recurrence && recurrence.type === 2) return getRecurrenceText(recurrence);
+  
+  let text = '';
   switch(startTime.type) {
     case 0:
-      return `${startTime.hour.toString().padStart(2, '0')}:${startTime.minute.toString().padStart(2, '0')}`;
+      text = `${startTime.hour.toString().padStart(2, '0')}:${startTime.minute.toString().padStart(2, '0')}`;
+      break;
     case 1:
-      return `Lever du soleil ${startTime.sunriseOffset >= 0 ? '+' : ''}${startTime.sunriseOffset}min`;
+      text = `Lever du soleil ${startTime.sunriseOffset >= 0 ? '+' : ''}${startTime.sunriseOffset}min`;
+      break;
     case 2:
-      return `Coucher du soleil ${startTime.sunriseOffset >= 0 ? '+' : ''}${startTime.sunriseOffset}min`;
+      text = `Coucher du soleil ${startTime.sunriseOffset >= 0 ? '+' : ''}${startTime.sunriseOffset}min`;
+      break;
+  }
+  return text + getRecurrenceText(recurrence);
+}
+
+function formatMinutesOfDay(minutes) {
+  return `${Math.floor(minutes / 60).toString().padStart(2, '0')}:${(minutes % 60).toString().padStart(2, '0')}`;
+}
+
+// Suffixe du démarrage : répétition et parité (vide pour "une fois")
+function getRecurrenceText(recurrence) {
+  if (!recurrence) return '';
+  let text = '';
+  if (recurrence.type === 1) {
+    text = `, ${t('recur_every') || 'Toutes les'} ${recurrence.every} min → ${formatMinutesOfDay(recurrence.until)}`;
+  } else if (recurrence.type === 2) {
+    text = (recurrence.starts || []).map(formatMinutesOfDay).join(', ');
   }
+  if (recurrence.parity === 1) text += ` (${t('parity_odd') || 'Impairs'})`;
+  if (recurrence.parity === 2) text += ` (${t('parity_even') || 'Pairs'})`;
+  return text;
+}
+
+// "06:00, 12:00" -> [360, 720] ; null si invalide
+function parseStartList(text) {
+  const starts = [];
+  for (const part of text.split(/[,;\s]+/).filter(p => p)) {
+    const match = part.match(/^(\d{1,2})[:h](\d{2})$/);
+    if (!match || parseInt(match[1]) > 23 || parseInt(match[2]) > 59) return null;
+    starts.push(parseInt(match[1]) * 60 + parseInt(match[2]));
+  }
+  if (starts.length === 0 || starts.length > 8) return null;
+  return starts.sort((a, b) => a - b);
 }
 
 // ============================================================================
@@ -208,6 +246,15 @@ async function loadTimerForEdit(timerId) {
     document.getElementById('edit-sun-offset').value = timer.startTime.sunriseOffset || 0;
     updateStartTimeInputs();
     
+    const recurrence = timer.recurrence || { type: 0, every: 120, until: 1200, starts: [], parity: 0 };
+    document.getElementById('edit-recur-type').value = recurrence.type;
+    document.getElementById('edit-recur-every').value = recurrence.every;
+    document.getElementById('edit-recur-until-hour').value = Math.floor(recurrence.until / 60);
+    document.getElementById('edit-recur-until-minute').value = recurrence.until % 60;
+    document.getElementById('edit-recur-starts').value = (recurrence.starts || []).map(formatMinutesOfDay).join(', ');
+    document.getElementById('edit-day-parity').value = recurrence.parity;
+    updateRecurrenceInputs();
+    
     // Charger conditions
     document.querySelectorAll('#editor-conditions input[type="checkbox"]').forEach(cb => {
       cb.checked = false;
@@ -290,6 +337,12 @@ function resetTimerEditor() {
   document.getElementById('edit-start-hour').value = '9';
   document.getElementById('edit-start-minute').value = '0';
   document.getElementById('edit-sun-offset').value = '0';
+  document.getElementById('edit-recur-type').value = '0';
+  document.getElementById('edit-recur-every').value = '120';
+  document.getElementById('edit-recur-until-hour').value = '20';
+  document.getElementById('edit-recur-until-minute').value = '0';
+  document.getElementById('edit-recur-starts').value = '';
+  document.getElementById('edit-day-parity').value = '0';
   
   document.querySelectorAll('.day-btn').forEach((btn, i) => {
     if (i >= 1 && i <= 5) {
@@ -307,6 +360,7 @@ function resetTimerEditor() {
   updateActionsList();
   
   updateStartTimeInputs();
+  updateRecurrenceInputs();
 }
 
 function updateStartTimeInputs() {
@@ -323,6 +377,25 @@ function updateStartTimeInputs() {
   }
 }
 
+function updateRecurrenceInputs() {
+  const type = parseInt(document.getElementById('edit-recur-type').value);
+  document.getElementById('recur-interval-inputs').style.display = type === 1 ? 'flex' : 'none';
+  document.getElementById('recur-list-inputs').style.display = type === 2 ? 'flex' : 'none';
+}
+
+// Récurrence saisie dans l'éditeur (starts null si la liste est invalide)
+function readRecurrenceInputs() {
+  const type = parseInt(document.getElementById('edit-recur-type').value);
+  return {
+    type: type,
+    every: parseInt(document.getElementById('edit-recur-every').value) || 120,
+    until: (parseInt(document.getElementById('edit-recur-until-hour').value) || 0) * 60 +
+           (parseInt(document.getElementById('edit-recur-until-minute').value) || 0),
+    starts: type === 2 ? parseStartList(document.getElementById('edit-recur-starts').value) : [],
+    parity: parseInt(document.getElementById('edit-day-parity').value)
+  };
+}
+
 function toggleDay(btn) {
   btn.classList.toggle('active');
 }
@@ -397,6 +470,23 @@ function addActionType(type) {
       };
       break;
       
+    case 'planned':
+      action = {
+        type: 9,  // ACTION_PLANNED_FILTRATION = 9
+        relay: 0,           // Relais asservi à la pompe (0 = aucun)
+        conditionValue: 8,  // Durée continue max (heures)
+        buzzerCount: 1,
+        ledColor: 0,
+        ledMode: 0,
+        ledDuration: 0,
+        customEquation: {
+          useCustom: false,
+          expression: 'waterTemp / 2'
+        },
+        description: 'Filtration planifiée sur 24h'
+      };
+      break;
+      
     case 'buzzer':
       action = {
         type: 7,  // ACTION_BUZZER = 7
@@ -461,7 +551,8 @@ function getActionTypeName(action) {
     4: t('action_measure_title') || 'Mesurer Température',
     5: t('action_auto_title') || 'Durée Automatique',
     7: t('action_buzzer_title') || 'Buzzer',
-    8: t('action_led_title') || 'LED'
+    8: t('action_led_title') || 'LED',
+    9: t('action_planned_title') || 'Filtration planifiée'
   };
   return names[action.type] || (t('actions') || 'Action');
 }
@@ -477,6 +568,19 @@ function getActionDescription(action) {
     }
   }
   
+  // Filtration planifiée (type 9)
+  if (action.type === 9) {
+    if (action.customEquation && action.customEquation.useCustom) {
+      desc = `📅 ${action.customEquation.expression}`;
+    } else {
+      desc = '📅 ' + (t('temp_div_2_default') || 'Temp / 2 (défaut, 3h-24h)');
+    }
+    desc += ` - max ${action.conditionValue || 8}h`;
+    if (action.relay > 0) {
+      desc += ` + ${RELAY_NAMES[action.relay]}`;
+    }
+  }
+  
   // Détails spécifiques buzzer (type 7)
   if (action.type === 7) {
     if (action.buzzerCount === 0) {
@@ -530,6 +634,8 @@ function editActionForm(index) {
   document.getElementById('action-wait-form').style.display = 'none';
   document.getElementById('action-buzzer-form').style.display = 'none';
   document.getElementById('action-led-form').style.display = 'none';
+  document.getElementById('action-auto-form').style.display = 'none';
+  document.getElementById('action-planned-form').style.display = 'none';
   
   // Remplir le formulaire selon le type
   if (action.type === 0) {
@@ -556,6 +662,20 @@ function editActionForm(index) {
 	  
 	  updateAutoEquationForm();  
 
+  } else if (action.type === 9) {
+    // FILTRATION PLANIFIÉE (type 9) : durée comme l'action auto + contraintes
+    document.getElementById('action-auto-form').style.display = 'block';
+    document.getElementById('action-planned-form').style.display = 'block';
+    
+    document.getElementById('edit-action-auto-use-custom').checked = 
+      action.customEquation?.useCustom || false;
+    document.getElementById('edit-action-auto-equation').value = 
+      action.customEquation?.expression || 'waterTemp / 2';
+    document.getElementById('edit-action-planned-relay').value = action.relay || 0;
+    document.getElementById('edit-action-planned-max').value = action.conditionValue || 8;
+    
+    updateAutoEquationForm();
+
   } else if (action.type === 7) {
     // BUZZER (type 7)
     if (action.buzzerCount === 0) {
@@ -625,6 +745,16 @@ function saveActionEdit() {
 		action.description = 'Durée auto = Température / 2 (3h-24h)';
 	  }
     
+  } else if (action.type === 9) {
+    // FILTRATION PLANIFIÉE (type 9)
+    action.customEquation = {
+      useCustom: document.getElementById('edit-action-auto-use-custom').checked,
+      expression: document.getElementById('edit-action-auto-equation').value
+    };
+    action.relay = parseInt(document.getElementById('edit-action-planned-relay').value);
+    action.conditionValue = parseInt(document.getElementById('edit-action-planned-max').value) || 8;
+    action.description = `Filtration planifiée (max ${action.conditionValue}h continues)`;
+    
   } else if (action.type === 7) {
     // BUZZER (type 7)
     const buzzerType = document.getElementById('edit-action-buzzer-type').value;
@@ -725,6 +855,9 @@ function generateTimerPreview() {
   } else {
     startText = `${t('sunset') || 'Coucher du soleil'} +${document.getElementById('edit-sun-offset').value}min`;
   }
+  const recurrence = readRecurrenceInputs();
+  if (recurrence.type === 2) startText = '';
+  if (recurrence.starts) startText += getRecurrenceText(recurrence);
   
   const dayNames = [
     t('day_sunday') || 'Dim',
@@ -800,6 +933,7 @@ async function saveTimer() {
       minute: parseInt(document.getElementById('edit-start-minute').value),
       sunriseOffset: parseInt(document.getElementById('edit-sun-offset').value)
     },
+    recurrence: readRecurrenceInputs(),
     conditions: [],
     actions: timerActions
   };
@@ -836,6 +970,11 @@ async function saveTimer() {
     return;
   }
   
+  if (!timer.recurrence.starts) {
+    alert('⚠️ ' + (t('recur_list_invalid') || "Liste d'heures invalide (format HH:MM, 8 au maximum)"));
+    return;
+  }
+  
   try {
     // FIX: Utiliser l'ID existant pour la mise à jour
     const url = currentEditingTimer ? `/api/timers/flex/${timer.id}` : '/api/timers/flex';
@@ -991,6 +1130,25 @@ function createActionEditorModal() {
           </div>
         </div>
 		
+		<!-- FILTRATION PLANIFIÉE -->
+		<div id="action-planned-form" style="display: none;">
+		  <div class="form-group">
+			<label>Relais asservi à la pompe</label>
+			<select id="edit-action-planned-relay" style="width: 100%;">
+			  <option value="0">Aucun</option>
+			  <option value="1">Électrolyseur</option>
+			  <option value="4">PAC</option>
+			</select>
+			<small>Démarre après la pompe et s'arrête avant elle</small>
+		  </div>
+		  
+		  <div class="form-group">
+			<label>Durée continue maximale (heures)</label>
+			<input type="number" id="edit-action-planned-max" value="8" min="1" max="24" style="width: 100%;">
+			<small>Les heures les plus chaudes et les heures creuses (22h-6h) sont privilégiées</small>
+		  </div>
+		</div>
+		
 		<!-- DURÉE AUTOMATIQUE -->
 		<div id="action-auto-form" style="display: none;">
 		  <div class="form-group">
@@ -1033,10 +1191,18 @@ function createActionEditorModal() {
 					<td style="padding: 8px; font-family: monospace; font-weight: 600;"><code>weatherMin</code></td>
 					<td style="padding: 8px;">Température MIN prévue aujourd'hui (°C)</td>
 				  </tr>
-				  <tr>
+				  <tr style="border-bottom: 1px solid #ddd;">
 					<td style="padding: 8px; font-family: monospace; font-weight: 600;"><code>sunshine</code></td>
 					<td style="padding: 8px;">Pourcentage d'ensoleillement (0-100)</td>
 				  </tr>
+				  <tr style="border-bottom: 1px solid #ddd;">
+					<td style="padding: 8px; font-family: monospace; font-weight: 600;"><code>offPeak</code></td>
+					<td style="padding: 8px;">1 en heures creuses, 0 sinon (calendrier tarifaire)</td>
+				  </tr>
+				  <tr>
+					<td style="padding: 8px; font-family: monospace; font-weight: 600;"><code>tariffPrice</code></td>
+					<td style="padding: 8px;">Prix du kWh en cours (€)</td>
+				  </tr>
 				</table>
 				
 				<div style="margin-top: 20px; border-top: 2px solid #ddd; padding-top: 15px;">
@@ -1066,6 +1232,10 @@ function createActionEditorModal() {
 					  <code style="background: #fff; padding: 4px 8px; border-radius: 4px; font-weight: 600;">waterTemp / 2 + (sunshine - 50) / 25</code>
 					  <span style="color: #666;"> - Ajustement fin avec soleil</span>
 					</li>
+					<li>
+					  <code style="background: #fff; padding: 4px 8px; border-radius: 4px; font-weight: 600;">waterTemp / 2 + offPeak * 2</code>
+					  <span style="color: #666;"> - 2h de plus si calculé en heures creuses</span>
+					</li>
 				  </ul>
 				</div>
 				
@@ -1124,6 +1294,8 @@ window.PoolTimers = {
 	showEditorTab,
 	resetTimerEditor,
 	updateStartTimeInputs,
+	updateRecurrenceInputs,
+	getRecurrenceText,
 	toggleDay,
 
 	//GESTION DES ACTIONS
@@ -141,6 +141,12 @@ const translations = {
     upload_backup: "Restaurer backup",
     disconnected: "Déconnecté",
     mqtt_topic: "Topic",
+    mqtt_temp_deadband: "Écart température (°C)",
+    mqtt_pressure_deadband: "Écart pression (bar)",
+    mqtt_heartbeat: "Republication complète (s)",
+    mqtt_publish_desc: "Les mesures ne sont publiées que si elles changent de plus de l'écart",
+    mqtt_state_json: "Topic état JSON",
+    mqtt_state_json_desc: "Publier tout l'état sur <topic>/state",
     test_connection: "Tester connexion",
     republish_ha: "Republier HA",
     weather_config: "Configuration Météo",
@@ -148,6 +154,21 @@ const translations = {
     latitude: "Latitude",
     longitude: "Longitude",
     weather_save: "Sauvegarder Météo",
+    energy_config: "Énergie et Tarifs",
+    energy_power: "Puissance nominale (W)",
+    energy_offpeak: "Heures creuses (heures entières, vide = inutilisée)",
+    energy_range_1: "Plage 1",
+    energy_range_2: "Plage 2",
+    energy_price_peak: "Prix heures pleines (€/kWh)",
+    energy_price_offpeak: "Prix heures creuses (€/kWh)",
+    energy_save: "Sauvegarder Énergie",
+    energy_saved: "Configuration énergie sauvegardée !",
+    energy_save_error: "Erreur sauvegarde énergie",
+    energy_offpeak_now: "Heures creuses",
+    energy_peak_now: "Heures pleines",
+    energy_today: "Aujourd'hui",
+    energy_month: "Ce mois",
+    energy_total: "Total",
     chart_config: "Configuration Graphique",
     current_interval: "Intervalle actuel",
     tips: "Conseils",
@@ -410,6 +431,17 @@ const translations = {
     sunrise: "Lever du soleil",
     sunset: "Coucher du soleil",
     offset: "Décalage",
+    recurrence: "Répétition dans la journée",
+    recur_once: "Une fois",
+    recur_interval: "Toutes les N minutes",
+    recur_list: "Liste d'heures",
+    recur_every: "Toutes les",
+    recur_until: "dernier départ",
+    recur_list_invalid: "Liste d'heures invalide (format HH:MM, 8 au maximum)",
+    day_parity: "Jours du mois",
+    parity_all: "Tous",
+    parity_odd: "Impairs",
+    parity_even: "Pairs",
     
     // === TIMER EDITOR - CONDITIONS ===
     timer_conditions_warning: "Le timer ne démarrera que si toutes les conditions cochées sont remplies",
@@ -480,6 +512,8 @@ const translations = {
     action_measure_desc: "Après 15min de pompe",
     action_auto_title: "Durée Auto",
     action_auto_desc: "Température / 2 heures",
+    action_planned_title: "Filtration planifiée",
+    action_planned_desc: "Heures chaudes / creuses (24h)",
     action_buzzer_title: "Buzzer",
     action_buzzer_desc: "Signal sonore (bips ou alarme)",
     action_led_title: "LED",
@@ -677,6 +711,12 @@ const translations = {
     upload_backup: "Restore backup",
     disconnected: "Disconnected",
     mqtt_topic: "Topic",
+    mqtt_temp_deadband: "Temperature deadband (°C)",
+    mqtt_pressure_deadband: "Pressure deadband (bar)",
+    mqtt_heartbeat: "Full republish (s)",
+    mqtt_publish_desc: "Values are only published when they change by more than the deadband",
+    mqtt_state_json: "JSON state topic",
+    mqtt_state_json_desc: "Publish the whole state on <topic>/state",
     test_connection: "Test connection",
     republish_ha: "Republish HA",
     weather_config: "Weather Configuration",
@@ -684,6 +724,21 @@ const translations = {
     latitude: "Latitude",
     longitude: "Longitude",
     weather_save: "Save Weather",
+    energy_config: "Energy and Tariffs",
+    energy_power: "Rated power (W)",
+    energy_offpeak: "Off-peak hours (whole hours, empty = unused)",
+    energy_range_1: "Range 1",
+    energy_range_2: "Range 2",
+    energy_price_peak: "Peak price (€/kWh)",
+    energy_price_offpeak: "Off-peak price (€/kWh)",
+    energy_save: "Save Energy",
+    energy_saved: "Energy configuration saved!",
+    energy_save_error: "Energy save error",
+    energy_offpeak_now: "Off-peak",
+    energy_peak_now: "Peak",
+    energy_today: "Today",
+    energy_month: "This month",
+    energy_total: "Total",
     chart_config: "Chart Configuration",
     current_interval: "Current interval",
     tips: "Tips",
@@ -946,6 +1001,17 @@ const translations = {
     sunrise: "Sunrise",
     sunset: "Sunset",
     offset: "Offset",
+    recurrence: "Repeat during the day",
+    recur_once: "Once",
+    recur_interval: "Every N minutes",
+    recur_list: "List of times",
+    recur_every: "Every",
+    recur_until: "last start",
+    recur_list_invalid: "Invalid list of times (HH:MM format, 8 at most)",
+    day_parity: "Days of the month",
+    parity_all: "All",
+    parity_odd: "Odd",
+    parity_even: "Even",
     
     // === TIMER EDITOR - CONDITIONS ===
     timer_conditions_warning: "Timer will only start if all checked conditions are met",
@@ -1016,6 +1082,8 @@ const translations = {
     action_measure_desc: "After 15min pump",
     action_auto_title: "Auto Duration",
     action_auto_desc: "Temperature / 2 hours",
+    action_planned_title: "Planned Filtration",
+    action_planned_desc: "Warm / off-peak hours (24h)",
     action_buzzer_title: "Buzzer",
     action_buzzer_desc: "Sound signal (beeps or alarm)",
     action_led_title: "LED",
@@ -0,0 +1,543 @@
+/*
+ * POOL CONNECT - ENERGY METER
+ * Temps de marche des relais, énergie estimée et calendrier tarifaire
+ * energy_meter.h   V0.2
+ *
+ * Compteurs par relais (jour, mois, total) alimentés par les transitions
+ * du service relais (recordRelayTransition), sans scrutation des sorties.
+ * Un relais allumé est crédité à son extinction et à chaque changement
+ * d'heure : le temps est réparti entre heures pleines et heures creuses.
+ * kWh = temps de marche x puissance nominale configurée.
+ *
+ * Calendrier tarifaire : deux plages d'heures creuses au plus (heures
+ * entières), compilées en masque de 24 bits. Utilisé par le planificateur
+ * de filtration (heures creuses favorisées) et les équations (offPeak,
+ * tariffPrice).
+ *
+ * Écriture en flash limitée : compteurs sauvegardés au plus toutes les
+ * ENERGY_FLUSH_INTERVAL_MS (s'ils ont changé), au changement de jour et
+ * avant un redémarrage demandé. Une coupure secteur perd au plus cet
+ * intervalle. Historique des ENERGY_HISTORY_DAYS derniers jours dans le
+ * même fichier (agrégats du graphique).
+ *
+ * Crédits (toutes tâches) sous energyMux ; jour, heure et écriture en
+ * flash par la tâche maintenance (processEnergyMeter).
+ */
+
+#ifndef ENERGY_METER_H
+#define ENERGY_METER_H
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <ArduinoJson.h>
+#include "globals.h"
+#include "config.h"
+#include "logging.h"
+#include "time_service.h"
+
+// ============================================================================
+// CONSTANTES
+// ============================================================================
+
+#define ENERGY_CONFIG_FILE "/energy.json"
+#define ENERGY_COUNTERS_FILE "/energy_counters.json"
+#define ENERGY_COUNTERS_TMP "/energy_counters.tmp"
+#define ENERGY_FLUSH_INTERVAL_MS 1800000UL   // Au plus une écriture par 30 min
+#define ENERGY_HISTORY_DAYS 62
+#define ENERGY_TARIFF_RANGES 2
+#define ENERGY_COUNTERS_DOC_SIZE 16384
+
+// ============================================================================
+// STRUCTURES
+// ============================================================================
+
+struct TariffCalendar {
+  int8_t offPeakStart[ENERGY_TARIFF_RANGES];   // Heure 0-23, -1 = plage inutilisée
+  int8_t offPeakEnd[ENERGY_TARIFF_RANGES];     // Exclue, plage sur minuit possible
+  float pricePeak;                             // €/kWh
+  float priceOffPeak;
+};
+
+struct EnergyConfig {
+  float powerW[NUM_RELAYS];                    // Puissance nominale
+  TariffCalendar tariff;
+};
+
+struct RelayRuntimeCounters {
+  uint32_t daySec;
+  uint32_t dayOffPeakSec;
+  uint32_t monthSec;
+  uint32_t monthOffPeakSec;
+  uint32_t lifetimeSec;
+};
+
+// Bilan d'un jour terminé
+struct EnergyDayRecord {
+  uint16_t year;
+  uint8_t month;
+  uint8_t day;
+  uint32_t sec[NUM_RELAYS];
+  uint32_t offPeakSec[NUM_RELAYS];
+};
+
+// ============================================================================
+// VARIABLES GLOBALES
+// ============================================================================
+
+EnergyConfig energyConfig = {
+  { 750, 150, 50, 10, 1200 },
+  { { 22, -1 }, { 6, -1 }, 0.2516f, 0.1828f }
+};
+volatile uint32_t tariffOffPeakMask = 0;       // Bit h = heure creuse
+
+RelayRuntimeCounters energyCounters[NUM_RELAYS];
+unsigned long energyRunningSince[NUM_RELAYS];  // millis() du dernier crédit, 0 = éteint
+EnergyDayRecord energyHistory[ENERGY_HISTORY_DAYS];
+int energyHistoryCount = 0;
+int energyHistoryNext = 0;                     // Prochain emplacement (circulaire)
+portMUX_TYPE energyMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Jour et mois des compteurs (0 = heure jamais réglée)
+uint16_t energyYear = 0;
+uint8_t energyMonth = 0;
+uint8_t energyDay = 0;
+bool energyOffPeak = false;                    // Tarif de l'heure en cours
+int energyHour = -1;
+volatile bool energyDirty = false;
+unsigned long lastEnergyFlush = 0;
+
+// ============================================================================
+// CALENDRIER TARIFAIRE
+// ============================================================================
+
+/**
+ * Masque des heures creuses (bit h = heure h).
+ */
+uint32_t buildTariffMask(const TariffCalendar& tariff) {
+  uint32_t mask = 0;
+  for (int r = 0; r < ENERGY_TARIFF_RANGES; r++) {
+    int start = tariff.offPeakStart[r];
+    int end = tariff.offPeakEnd[r];
+    if (start < 0 || start > 23 || end < 0 || end > 23 || start == end) continue;
+    for (int h = start; h != end; h = (h + 1) % 24) mask |= (1UL << h);
+  }
+  return mask;
+}
+
+bool isOffPeakHourOfDay(int hour) {
+  return hour >= 0 && hour < 24 && (tariffOffPeakMask & (1UL << hour));
+}
+
+bool isOffPeakNow() {
+  struct tm timeinfo;
+  return getCachedTime(&timeinfo) && isOffPeakHourOfDay(timeinfo.tm_hour);
+}
+
+float getTariffPrice(bool offPeak) {
+  return offPeak ? energyConfig.tariff.priceOffPeak : energyConfig.tariff.pricePeak;
+}
+
+float getCurrentTariffPrice() {
+  return getTariffPrice(isOffPeakNow());
+}
+
+// ============================================================================
+// CALCULS
+// ============================================================================
+
+float runtimeToKwh(int relay, uint32_t sec) {
+  return sec * energyConfig.powerW[relay] / 3600000.0f;
+}
+
+/**
+ * Coût estimé d'un temps de marche réparti entre heures pleines et creuses.
+ */
+float runtimeToCost(int relay, uint32_t sec, uint32_t offPeakSec) {
+  uint32_t peakSec = sec > offPeakSec ? sec - offPeakSec : 0;
+  return runtimeToKwh(relay, peakSec) * energyConfig.tariff.pricePeak +
+         runtimeToKwh(relay, offPeakSec) * energyConfig.tariff.priceOffPeak;
+}
+
+// ============================================================================
+// CRÉDITS
+// ============================================================================
+
+/**
+ * Crédite le temps écoulé d'un relais allumé (sous energyMux).
+ * Le reste inférieur à la seconde est conservé.
+ */
+void creditRelayRuntimeLocked(int relay, unsigned long now) {
+  if (energyRunningSince[relay] == 0) return;
+
+  uint32_t sec = (now - energyRunningSince[relay]) / 1000;
+  if (sec == 0) return;
+
+  RelayRuntimeCounters& c = energyCounters[relay];
+  c.daySec += sec;
+  c.monthSec += sec;
+  c.lifetimeSec += sec;
+  if (energyOffPeak) {
+    c.dayOffPeakSec += sec;
+    c.monthOffPeakSec += sec;
+  }
+  energyRunningSince[relay] += sec * 1000;
+  if (energyRunningSince[relay] == 0) energyRunningSince[relay] = 1;
+  energyDirty = true;
+}
+
+/**
+ * Appelé par le service relais à chaque transition (mutex relais pris).
+ */
+void recordRelayTransition(int relay, bool on) {
+  if (relay < 0 || relay >= NUM_RELAYS) return;
+
+  unsigned long now = millis();
+  portENTER_CRITICAL(&energyMux);
+  if (on) {
+    energyRunningSince[relay] = now != 0 ? now : 1;
+  } else {
+    creditRelayRuntimeLocked(relay, now);
+    energyRunningSince[relay] = 0;
+  }
+  portEXIT_CRITICAL(&energyMux);
+}
+
+/**
+ * Crédite tous les relais allumés jusqu'à maintenant.
+ */
+void settleRelayRuntime() {
+  unsigned long now = millis();
+  portENTER_CRITICAL(&energyMux);
+  for (int i = 0; i < NUM_RELAYS; i++) creditRelayRuntimeLocked(i, now);
+  portEXIT_CRITICAL(&energyMux);
+}
+
+/**
+ * Copie cohérente des compteurs (relais allumés crédités jusqu'à maintenant).
+ */
+void getRelayRuntime(int relay, RelayRuntimeCounters* out) {
+  unsigned long now = millis();
+  portENTER_CRITICAL(&energyMux);
+  creditRelayRuntimeLocked(relay, now);
+  *out = energyCounters[relay];
+  portEXIT_CRITICAL(&energyMux);
+}
+
+/**
+ * Bilan d'un jour passé.
+ *
+ * @return false si le jour n'est pas dans l'historique
+ */
+bool getEnergyDayRecord(int year, int month, int day, EnergyDayRecord* out) {
+  bool found = false;
+  portENTER_CRITICAL(&energyMux);
+  for (int i = 0; i < energyHistoryCount; i++) {
+    const EnergyDayRecord& r = energyHistory[i];
+    if (r.year == year && r.month == month && r.day == day) {
+      *out = r;
+      found = true;
+      break;
+    }
+  }
+  portEXIT_CRITICAL(&energyMux);
+  return found;
+}
+
+// ============================================================================
+// CONFIGURATION
+// ============================================================================
+
+void writeEnergyConfigJson(JsonObject obj) {
+  JsonArray power = obj.createNestedArray("powerW");
+  for (int i = 0; i < NUM_RELAYS; i++) power.add(energyConfig.powerW[i]);
+
+  JsonArray ranges = obj.createNestedArray("offPeak");
+  for (int r = 0; r < ENERGY_TARIFF_RANGES; r++) {
+    if (energyConfig.tariff.offPeakStart[r] < 0) continue;
+    JsonArray range = ranges.createNestedArray();
+    range.add(energyConfig.tariff.offPeakStart[r]);
+    range.add(energyConfig.tariff.offPeakEnd[r]);
+  }
+  obj["pricePeak"] = energyConfig.tariff.pricePeak;
+  obj["priceOffPeak"] = energyConfig.tariff.priceOffPeak;
+}
+
+/**
+ * Applique une configuration (valeurs actuelles si absentes).
+ */
+void readEnergyConfigJson(JsonObject obj) {
+  if (obj.containsKey("powerW")) {
+    JsonArray power = obj["powerW"];
+    for (int i = 0; i < NUM_RELAYS && i < (int)power.size(); i++) {
+      energyConfig.powerW[i] = constrain(power[i] | 0.0f, 0.0f, 10000.0f);
+    }
+  }
+
+  if (obj.containsKey("offPeak")) {
+    JsonArray ranges = obj["offPeak"];
+    for (int r = 0; r < ENERGY_TARIFF_RANGES; r++) {
+      int start = -1, end = -1;
+      if (r < (int)ranges.size()) {
+        start = ranges[r][0] | -1;
+        end = ranges[r][1] | -1;
+      }
+      bool valid = start >= 0 && start <= 23 && end >= 0 && end <= 23 && start != end;
+      energyConfig.tariff.offPeakStart[r] = valid ? start : -1;
+      energyConfig.tariff.offPeakEnd[r] = valid ? end : -1;
+    }
+  }
+
+  energyConfig.tariff.pricePeak = constrain(obj["pricePeak"] | energyConfig.tariff.pricePeak, 0.0f, 10.0f);
+  energyConfig.tariff.priceOffPeak = constrain(obj["priceOffPeak"] | energyConfig.tariff.priceOffPeak, 0.0f, 10.0f);
+
+  tariffOffPeakMask = buildTariffMask(energyConfig.tariff);
+}
+
+void saveEnergyConfig() {
+  File f = LittleFS.open(ENERGY_CONFIG_FILE, FILE_WRITE);
+  if (!f) {
+    LOG_E(LOG_STORAGE, "Erreur ouverture %s en ecriture", ENERGY_CONFIG_FILE);
+    LOG_STORAGE_OP("WRITE", ENERGY_CONFIG_FILE, false);
+    return;
+  }
+
+  StaticJsonDocument<512> doc;
+  writeEnergyConfigJson(doc.to<JsonObject>());
+  size_t bytesWritten = serializeJson(doc, f);
+  f.close();
+
+  LOG_I(LOG_STORAGE, "Configuration energie sauvegardee (%d bytes)", bytesWritten);
+  LOG_STORAGE_OP("WRITE", ENERGY_CONFIG_FILE, true);
+}
+
+void loadEnergyConfig() {
+  tariffOffPeakMask = buildTariffMask(energyConfig.tariff);
+
+  if (!LittleFS.exists(ENERGY_CONFIG_FILE)) {
+    LOG_D(LOG_STORAGE, "Fichier %s non trouve - Configuration energie par defaut", ENERGY_CONFIG_FILE);
+    return;
+  }
+
+  File f = LittleFS.open(ENERGY_CONFIG_FILE, FILE_READ);
+  if (!f) {
+    LOG_E(LOG_STORAGE, "Erreur ouverture %s en lecture", ENERGY_CONFIG_FILE);
+    LOG_STORAGE_OP("READ", ENERGY_CONFIG_FILE, false);
+    return;
+  }
+
+  StaticJsonDocument<512> doc;
+  DeserializationError err = deserializeJson(doc, f);
+  f.close();
+
+  if (err) {
+    LOG_E(LOG_STORAGE, "Erreur parsing %s: %s", ENERGY_CONFIG_FILE, err.c_str());
+    LOG_STORAGE_OP("READ", ENERGY_CONFIG_FILE, false);
+    return;
+  }
+
+  readEnergyConfigJson(doc.as<JsonObject>());
+  LOG_I(LOG_STORAGE, "Configuration energie chargee - Heures creuses: 0x%06lX",
+        (unsigned long)tariffOffPeakMask);
+  LOG_STORAGE_OP("READ", ENERGY_CONFIG_FILE, true);
+}
+
+// ============================================================================
+// PERSISTANCE DES COMPTEURS
+// ============================================================================
+
+void saveEnergyCounters() {
+  settleRelayRuntime();
+
+  DynamicJsonDocument doc(ENERGY_COUNTERS_DOC_SIZE);
+
+  portENTER_CRITICAL(&energyMux);
+  RelayRuntimeCounters counters[NUM_RELAYS];
+  for (int i = 0; i < NUM_RELAYS; i++) counters[i] = energyCounters[i];
+  energyDirty = false;
+  portEXIT_CRITICAL(&energyMux);
+
+  doc["year"] = energyYear;
+  doc["month"] = energyMonth;
+  doc["day"] = energyDay;
+
+  JsonArray relays = doc.createNestedArray("relays");
+  for (int i = 0; i < NUM_RELAYS; i++) {
+    JsonArray c = relays.createNestedArray();
+    c.add(counters[i].daySec);
+    c.add(counters[i].dayOffPeakSec);
+    c.add(counters[i].monthSec);
+    c.add(counters[i].monthOffPeakSec);
+    c.add(counters[i].lifetimeSec);
+  }
+
+  // Historique du plus ancien au plus récent (modifié par cette tâche seulement)
+  JsonArray days = doc.createNestedArray("history");
+  int first = (energyHistoryNext - energyHistoryCount + ENERGY_HISTORY_DAYS) % ENERGY_HISTORY_DAYS;
+  for (int k = 0; k < energyHistoryCount; k++) {
+    const EnergyDayRecord& r = energyHistory[(first + k) % ENERGY_HISTORY_DAYS];
+    JsonArray d = days.createNestedArray();
+    d.add(r.year * 10000 + r.month * 100 + r.day);
+    for (int i = 0; i < NUM_RELAYS; i++) d.add(r.sec[i]);
+    for (int i = 0; i < NUM_RELAYS; i++) d.add(r.offPeakSec[i]);
+  }
+
+  // Fichier temporaire puis renommage : une coupure pendant l'écriture
+  // laisse les compteurs précédents intacts
+  File f = LittleFS.open(ENERGY_COUNTERS_TMP, FILE_WRITE);
+  if (!f) {
+    LOG_E(LOG_STORAGE, "Erreur ouverture %s en ecriture", ENERGY_COUNTERS_TMP);
+    LOG_STORAGE_OP("WRITE", ENERGY_COUNTERS_FILE, false);
+    energyDirty = true;
+    return;
+  }
+  size_t bytesWritten = serializeJson(doc, f);
+  f.close();
+
+  if (bytesWritten == 0 || !LittleFS.rename(ENERGY_COUNTERS_TMP, ENERGY_COUNTERS_FILE)) {
+    LOG_E(LOG_STORAGE, "Erreur renommage %s", ENERGY_COUNTERS_TMP);
+    LOG_STORAGE_OP("WRITE", ENERGY_COUNTERS_FILE, false);
+    LittleFS.remove(ENERGY_COUNTERS_TMP);
+    energyDirty = true;
+    return;
+  }
+
+  lastEnergyFlush = millis();
+  LOG_D(LOG_STORAGE, "Compteurs energie sauvegardes (%d bytes)", bytesWritten);
+}
+
+void loadEnergyCounters() {
+  if (!LittleFS.exists(ENERGY_COUNTERS_FILE)) {
+    LOG_D(LOG_STORAGE, "Pas de compteurs energie - Demarrage a zero");
+    return;
+  }
+
+  File f = LittleFS.open(ENERGY_COUNTERS_FILE, FILE_READ);
+  if (!f) {
+    LOG_E(LOG_STORAGE, "Erreur ouverture %s en lecture", ENERGY_COUNTERS_FILE);
+    LOG_STORAGE_OP("READ", ENERGY_COUNTERS_FILE, false);
+    return;
+  }
+
+  DynamicJsonDocument doc(ENERGY_COUNTERS_DOC_SIZE);
+  DeserializationError err = deserializeJson(doc, f);
+  f.close();
+
+  if (err) {
+    LOG_E(LOG_STORAGE, "Erreur parsing %s: %s", ENERGY_COUNTERS_FILE, err.c_str());
+    LOG_STORAGE_OP("READ", ENERGY_COUNTERS_FILE, false);
+    return;
+  }
+
+  energyYear = doc["year"] | 0;
+  energyMonth = doc["month"] | 0;
+  energyDay = doc["day"] | 0;
+
+  JsonArray relays = doc["relays"];
+  for (int i = 0; i < NUM_RELAYS && i < (int)relays.size(); i++) {
+    JsonArray c = relays[i];
+    energyCounters[i].daySec = c[0] | 0;
+    energyCounters[i].dayOffPeakSec = c[1] | 0;
+    energyCounters[i].monthSec = c[2] | 0;
+    energyCounters[i].monthOffPeakSec = c[3] | 0;
+    energyCounters[i].lifetimeSec = c[4] | 0;
+  }
+
+  energyHistoryCount = 0;
+  energyHistoryNext = 0;
+  for (JsonArray d : doc["history"].as<JsonArray>()) {
+    EnergyDayRecord& r = energyHistory[energyHistoryNext];
+    uint32_t date = d[0] | 0;
+    r.year = date / 10000;
+    r.month = (date / 100) % 100;
+    r.day = date % 100;
+    for (int i = 0; i < NUM_RELAYS; i++) {
+      r.sec[i] = d[1 + i] | 0;
+      r.offPeakSec[i] = d[1 + NUM_RELAYS + i] | 0;
+    }
+    energyHistoryNext = (energyHistoryNext + 1) % ENERGY_HISTORY_DAYS;
+    if (energyHistoryCount < ENERGY_HISTORY_DAYS) energyHistoryCount++;
+  }
+
+  LOG_I(LOG_STORAGE, "Compteurs energie charges (%04d-%02d-%02d, %d jours d'historique)",
+        energyYear, energyMonth, energyDay, energyHistoryCount);
+  LOG_STORAGE_OP("READ", ENERGY_COUNTERS_FILE, true);
+}
+
+// ============================================================================
+// JOUR ET HEURE
+// ============================================================================
+
+/**
+ * Clôt le jour des compteurs (historique) et passe à la date donnée.
+ */
+void closeEnergyDay(const struct tm& timeinfo) {
+  uint16_t year = timeinfo.tm_year + 1900;
+  uint8_t month = timeinfo.tm_mon + 1;
+
+  portENTER_CRITICAL(&energyMux);
+  if (energyYear != 0) {
+    EnergyDayRecord& r = energyHistory[energyHistoryNext];
+    r.year = energyYear;
+    r.month = energyMonth;
+    r.day = energyDay;
+    for (int i = 0; i < NUM_RELAYS; i++) {
+      r.sec[i] = energyCounters[i].daySec;
+      r.offPeakSec[i] = energyCounters[i].dayOffPeakSec;
+    }
+    energyHistoryNext = (energyHistoryNext + 1) % ENERGY_HISTORY_DAYS;
+    if (energyHistoryCount < ENERGY_HISTORY_DAYS) energyHistoryCount++;
+  }
+
+  bool newMonth = (year != energyYear || month != energyMonth);
+  for (int i = 0; i < NUM_RELAYS; i++) {
+    energyCounters[i].daySec = 0;
+    energyCounters[i].dayOffPeakSec = 0;
+    if (newMonth) {
+      energyCounters[i].monthSec = 0;
+      energyCounters[i].monthOffPeakSec = 0;
+    }
+  }
+  energyYear = year;
+  energyMonth = month;
+  energyDay = timeinfo.tm_mday;
+  energyDirty = true;
+  portEXIT_CRITICAL(&energyMux);
+
+  LOG_I(LOG_SYSTEM, "Compteurs energie: nouveau jour %04d-%02d-%02d%s",
+        year, month, timeinfo.tm_mday, newMonth ? " (nouveau mois)" : "");
+}
+
+/**
+ * Appelé à chaque tour de la tâche maintenance : crédit au changement
+ * d'heure (tarif), changement de jour, écriture groupée.
+ */
+void processEnergyMeter() {
+  struct tm timeinfo;
+  if (getCachedTime(&timeinfo) && timeinfo.tm_hour != energyHour) {
+    // Temps de l'heure écoulée au tarif de cette heure
+    settleRelayRuntime();
+    energyHour = timeinfo.tm_hour;
+    energyOffPeak = isOffPeakHourOfDay(energyHour);
+
+    bool sameDay = energyYear == timeinfo.tm_year + 1900 && energyMonth == timeinfo.tm_mon + 1 &&
+                   energyDay == timeinfo.tm_mday;
+    if (!sameDay) {
+      closeEnergyDay(timeinfo);
+      saveEnergyCounters();
+    }
+  }
+
+  if (energyDirty && millis() - lastEnergyFlush >= ENERGY_FLUSH_INTERVAL_MS) {
+    saveEnergyCounters();
+  }
+}
+
+/**
+ * Sauvegarde immédiate (redémarrage demandé).
+ */
+void flushEnergyCounters() {
+  settleRelayRuntime();
+  if (energyDirty) saveEnergyCounters();
+}
+
+#endif // ENERGY_METER_H
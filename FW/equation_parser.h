@@ -1,7 +1,7 @@
 /* 
  * EQUATION PARSER 
  * évaluateur d'équations mathématiques personnalisées
- * equation_parser.h   V0.2
+ * equation_parser.h   V0.3
  */
 
 #ifndef EQUATION_PARSER_H
@@ -19,6 +19,8 @@ private:
   float weatherMax;
   float weatherMin;
   float sunshine;
+  float offPeak = 0;          // 1 en heures creuses (energy_meter.h)
+  float tariffPrice = 0;      // Prix du kWh en cours
   
   // Remplacer les variables par leurs valeurs
   String replaceVariables(String expr) {
@@ -30,6 +32,8 @@ private:
     expr.replace("weatherMax", String(weatherMax, 2));
     expr.replace("weatherMin", String(weatherMin, 2));
     expr.replace("sunshine", String(sunshine, 2));
+    expr.replace("offPeak", String(offPeak, 0));
+    expr.replace("tariffPrice", String(tariffPrice, 4));
     
     if (original != expr) {
       LOG_D(LOG_TIMER, "Variables remplacees:");
@@ -38,6 +42,7 @@ private:
       LOG_V(LOG_TIMER, "  weatherMax = %.2f", weatherMax);
       LOG_V(LOG_TIMER, "  weatherMin = %.2f", weatherMin);
       LOG_V(LOG_TIMER, "  sunshine = %.2f", sunshine);
+      LOG_V(LOG_TIMER, "  offPeak = %.0f, tariffPrice = %.4f", offPeak, tariffPrice);
       LOG_V(LOG_TIMER, "Expression apres substitution: %s", expr.c_str());
     }
     
@@ -241,6 +246,13 @@ public:
     LOG_V(LOG_TIMER, "  weatherMax=%.2f, weatherMin=%.2f, sunshine=%.2f", wMax, wMin, sun);
   }
   
+  void setTariff(bool isOffPeak, float price) {
+    offPeak = isOffPeak ? 1 : 0;
+    tariffPrice = price;
+    
+    LOG_V(LOG_TIMER, "  offPeak=%.0f, tariffPrice=%.4f", offPeak, tariffPrice);
+  }
+  
   float calculate(String expr, bool& error) {
     error = false;
     
@@ -0,0 +1,279 @@
+/*
+ * POOL CONNECT - FILTRATION PLANNER
+ * Planification des heures de filtration sur les prévisions météo
+ * filtration_planner.h   V0.3
+ *
+ * Place les heures de filtration nécessaires (temps de renouvellement) sur
+ * les heures les plus chaudes et/ou les moins chères de l'horizon (24h pour
+ * les timers, PLANNER_MAX_HOURS au plus), en respectant une durée maximale
+ * de fonctionnement continu. Les blocs plus courts que minRunHours sont
+ * déplacés en bordure des autres blocs (moins de démarrages de pompe).
+ *
+ * Le plan porte sur la pompe : l'électrolyseur et la PAC ne fonctionnent
+ * que pendant les heures pompe (contrainte respectée par construction).
+ *
+ * Module pur (aucune dépendance Arduino, pas d'allocation) : calcul en
+ * quelques centaines de microsecondes et testable sur PC.
+ */
+
+#ifndef FILTRATION_PLANNER_H
+#define FILTRATION_PLANNER_H
+
+#include <stdint.h>
+#include <time.h>
+#include <math.h>
+
+// ============================================================================
+// CONSTANTES
+// ============================================================================
+
+#define PLANNER_MAX_HOURS 48
+#define PLANNER_DEFAULT_MAX_CONTINUOUS 8     // Heures consécutives max par défaut
+#define PLANNER_DEFAULT_MIN_RUN 2            // Bloc minimal (démarrages de pompe)
+#define PLANNER_DEFAULT_OFFPEAK_START 22     // Heures creuses 22h-6h
+#define PLANNER_DEFAULT_OFFPEAK_END 6
+#define PLANNER_DEFAULT_OFFPEAK_BONUS 2.0    // Bonus heures creuses (équivalent °C)
+#define PLANNER_PEAK_TEMP_HOUR 15            // Heure la plus chaude (modèle diurne)
+
+// ============================================================================
+// STRUCTURES
+// ============================================================================
+
+struct PlannerParams {
+  float requiredHours;        // Heures de filtration à placer
+  int maxContinuousHours;     // Durée max d'un bloc (0 = illimité)
+  int minRunHours;            // Durée min d'un bloc (1 = pas de fusion)
+  int offPeakStartHour;       // Début heures creuses (0-23, -1 = pas de tarif)
+  int offPeakEndHour;         // Fin heures creuses (exclue)
+  uint32_t offPeakMask;       // Bit h = heure creuse (prioritaire, 0 = plage ci-dessus)
+  float offPeakBonus;         // Bonus de score en heures creuses
+
+  PlannerParams() : requiredHours(0), maxContinuousHours(PLANNER_DEFAULT_MAX_CONTINUOUS),
+                    minRunHours(PLANNER_DEFAULT_MIN_RUN),
+                    offPeakStartHour(PLANNER_DEFAULT_OFFPEAK_START),
+                    offPeakEndHour(PLANNER_DEFAULT_OFFPEAK_END),
+                    offPeakMask(0),
+                    offPeakBonus(PLANNER_DEFAULT_OFFPEAK_BONUS) {}
+};
+
+struct FiltrationPlan {
+  int hours;                  // Nombre d'heures couvertes par le plan
+  int plannedHours;           // Heures de filtration placées
+  bool constraintRelaxed;     // Durée continue max dépassée pour tout placer
+  bool run[PLANNER_MAX_HOURS];
+};
+
+// ============================================================================
+// TEMPÉRATURES HORAIRES
+// ============================================================================
+
+/**
+ * Interpole linéairement des prévisions par créneaux (3h) en valeurs horaires.
+ * Avant le premier / après le dernier créneau, la valeur extrême est reprise.
+ *
+ * @param slotTimes Epoch de chaque créneau (croissant)
+ * @param slotTemps Température de chaque créneau
+ * @param slotCount Nombre de créneaux
+ * @param startEpoch Début de la première heure
+ * @param hours Nombre d'heures à produire (<= PLANNER_MAX_HOURS)
+ * @param out Températures horaires
+ * @return false si aucun créneau
+ */
+bool buildHourlyTemps(const time_t* slotTimes, const float* slotTemps, int slotCount,
+                      time_t startEpoch, int hours, float* out) {
+  if (slotCount <= 0) return false;
+
+  int s = 0;
+  for (int h = 0; h < hours; h++) {
+    time_t t = startEpoch + (time_t)h * 3600 + 1800;  // Milieu de l'heure
+
+    while (s < slotCount - 1 && slotTimes[s + 1] <= t) s++;
+
+    if (t <= slotTimes[0]) {
+      out[h] = slotTemps[0];
+    } else if (s >= slotCount - 1) {
+      out[h] = slotTemps[slotCount - 1];
+    } else {
+      float span = (float)(slotTimes[s + 1] - slotTimes[s]);
+      float k = span > 0 ? (float)(t - slotTimes[s]) / span : 0;
+      out[h] = slotTemps[s] + (slotTemps[s + 1] - slotTemps[s]) * k;
+    }
+  }
+  return true;
+}
+
+/**
+ * Modèle diurne de repli (sans prévisions horaires) :
+ * sinusoïde entre tMin (3h du matin) et tMax (15h).
+ */
+void buildDiurnalTemps(float tMin, float tMax, int startHourOfDay, int hours, float* out) {
+  float mid = (tMax + tMin) / 2.0;
+  float amp = (tMax - tMin) / 2.0;
+
+  for (int h = 0; h < hours; h++) {
+    int hod = (startHourOfDay + h) % 24;
+    out[h] = mid + amp * cosf((hod - PLANNER_PEAK_TEMP_HOUR) * (float)M_PI / 12.0f);
+  }
+}
+
+// ============================================================================
+// PLANIFICATION
+// ============================================================================
+
+bool isOffPeakHour(int hourOfDay, int startHour, int endHour) {
+  if (startHour < 0) return false;
+  if (startHour <= endHour) return hourOfDay >= startHour && hourOfDay < endHour;
+  return hourOfDay >= startHour || hourOfDay < endHour;  // Plage sur minuit
+}
+
+float scorePlannerHour(float temp, int hourOfDay, const PlannerParams& p) {
+  float score = temp;
+  bool offPeak = p.offPeakMask != 0 ? (p.offPeakMask & (1UL << hourOfDay)) != 0
+                                     : isOffPeakHour(hourOfDay, p.offPeakStartHour, p.offPeakEndHour);
+  if (offPeak) {
+    score += p.offPeakBonus;
+  }
+  return score;
+}
+
+/**
+ * Longueur du bloc continu contenant l'heure idx.
+ */
+int plannerRunLength(const bool* run, int hours, int idx) {
+  int len = 1;
+  for (int i = idx - 1; i >= 0 && run[i]; i--) len++;
+  for (int i = idx + 1; i < hours && run[i]; i++) len++;
+  return len;
+}
+
+/**
+ * Heure libre de meilleur score qui, ajoutée, prolonge un bloc jusqu'à au
+ * moins minRunHours sans dépasser la durée continue maximale.
+ *
+ * @return -1 si aucune
+ */
+int findPlannerExtension(const bool* run, const float* score, int hours, const PlannerParams& p) {
+  int best = -1;
+  for (int i = 0; i < hours; i++) {
+    if (run[i]) continue;
+    int len = plannerRunLength(run, hours, i);
+    if (len < p.minRunHours) continue;
+    if (p.maxContinuousHours > 0 && len > p.maxContinuousHours) continue;
+    if (best < 0 || score[i] > score[best]) best = i;
+  }
+  return best;
+}
+
+/**
+ * Fusion des blocs courts : les heures d'un bloc de moins de minRunHours
+ * sont replacées en bordure d'autres blocs. Bloc laissé en place si ses
+ * heures ne peuvent pas toutes être replacées.
+ */
+void mergeShortPlannerRuns(FiltrationPlan* plan, const float* score, int hours, const PlannerParams& p) {
+  bool tried[PLANNER_MAX_HOURS];
+  for (int i = 0; i < hours; i++) tried[i] = false;
+
+  for (;;) {
+    // Bloc court le plus petit, pas encore essayé
+    int start = -1;
+    int len = 0;
+    for (int i = 0; i < hours; i++) {
+      if (!plan->run[i] || (i > 0 && plan->run[i - 1]) || tried[i]) continue;
+      int l = plannerRunLength(plan->run, hours, i);
+      if (l < p.minRunHours && (start < 0 || l < len)) {
+        start = i;
+        len = l;
+      }
+    }
+    if (start < 0) return;
+    tried[start] = true;
+
+    bool saved[PLANNER_MAX_HOURS];
+    for (int i = 0; i < hours; i++) saved[i] = plan->run[i];
+    for (int i = start; i < start + len; i++) plan->run[i] = false;
+
+    bool moved = true;
+    for (int k = 0; k < len && moved; k++) {
+      int idx = findPlannerExtension(plan->run, score, hours, p);
+      if (idx < 0) moved = false;
+      else plan->run[idx] = true;
+    }
+
+    if (!moved) {
+      for (int i = 0; i < hours; i++) plan->run[i] = saved[i];
+    }
+  }
+}
+
+/**
+ * Sélectionne les meilleures heures (score décroissant) sans dépasser la
+ * durée continue maximale. Si la contrainte empêche de placer toutes les
+ * heures requises, les heures restantes sont placées quand même
+ * (la qualité de l'eau prime) et constraintRelaxed est positionné.
+ * Blocs courts fusionnés ensuite (mergeShortPlannerRuns).
+ *
+ * @param hourlyTemps Températures prévues pour chaque heure
+ * @param hours Horizon (<= PLANNER_MAX_HOURS)
+ * @param startHourOfDay Heure civile de la première heure (0-23)
+ * @param p Paramètres
+ * @param plan Résultat
+ * @return Nombre d'heures placées
+ */
+int planFiltration(const float* hourlyTemps, int hours, int startHourOfDay,
+                   const PlannerParams& p, FiltrationPlan* plan) {
+  if (hours > PLANNER_MAX_HOURS) hours = PLANNER_MAX_HOURS;
+  if (hours < 0) hours = 0;
+
+  plan->hours = hours;
+  plan->plannedHours = 0;
+  plan->constraintRelaxed = false;
+  for (int i = 0; i < PLANNER_MAX_HOURS; i++) plan->run[i] = false;
+
+  int needed = (int)ceilf(p.requiredHours);
+  if (needed > hours) needed = hours;
+  if (needed <= 0) return 0;
+
+  // Tri des heures par score décroissant (tri par insertion, stable)
+  float score[PLANNER_MAX_HOURS];
+  uint8_t order[PLANNER_MAX_HOURS];
+
+  for (int i = 0; i < hours; i++) {
+    score[i] = scorePlannerHour(hourlyTemps[i], (startHourOfDay + i) % 24, p);
+    int j = i;
+    while (j > 0 && score[order[j - 1]] < score[i]) {
+      order[j] = order[j - 1];
+      j--;
+    }
+    order[j] = i;
+  }
+
+  // Passe 1 : respecter la durée continue maximale
+  for (int k = 0; k < hours && plan->plannedHours < needed; k++) {
+    int idx = order[k];
+    plan->run[idx] = true;
+
+    if (p.maxContinuousHours > 0 &&
+        plannerRunLength(plan->run, hours, idx) > p.maxContinuousHours) {
+      plan->run[idx] = false;
+      continue;
+    }
+    plan->plannedHours++;
+  }
+
+  // Passe 2 : compléter si la contrainte était trop forte
+  for (int k = 0; k < hours && plan->plannedHours < needed; k++) {
+    int idx = order[k];
+    if (plan->run[idx]) continue;
+
+    plan->run[idx] = true;
+    plan->plannedHours++;
+    plan->constraintRelaxed = true;
+  }
+
+  // Passe 3 : moins de démarrages
+  if (p.minRunHours > 1) mergeShortPlannerRuns(plan, score, hours, p);
+
+  return plan->plannedHours;
+}
+
+#endif // FILTRATION_PLANNER_H
@@ -17,6 +17,7 @@
 #include <INA226.h>
 #include "config.h"
 #include "types.h"
+#include "web_server.h"
 
 // ============================================================================
 // OBJETS GLOBAUX
@@ -27,13 +28,16 @@ extern OneWire oneWire;
 extern DallasTemperature sensors;
 extern INA226 ina226;
 
-extern WebServer server;
+extern PoolWebServer server;
 extern WiFiClient espClient;
 extern PubSubClient mqttClient;
 
 // Dual Core
 extern SemaphoreHandle_t dataMutex;
-extern TaskHandle_t core1TaskHandle;
+extern TaskHandle_t controlTaskHandle;
+extern TaskHandle_t networkTaskHandle;
+extern TaskHandle_t housekeepingTaskHandle;
+extern TaskHandle_t webTaskHandle;
 
 // ============================================================================
 // PINOUT
@@ -109,6 +113,7 @@ extern int mqttPort;
 extern String mqttUser;
 extern String mqttPassword;
 extern String mqttTopic;
+extern MqttPublishConfig mqttPublishConfig;
 extern unsigned long lastMqttAttempt;
 
 #endif // GLOBALS_H
@@ -6,6 +6,7 @@
 
 #include "globals.h"
 #include "timer_system.h"
+#include "logging.h"
 
 // ============================================================================
 // OBJETS GLOBAUX
@@ -16,13 +17,33 @@ OneWire oneWire(DS18B20_PIN);
 DallasTemperature sensors(&oneWire);
 INA226 ina226(0x40);
 
-WebServer server(80);
+PoolWebServer server(80);
 WiFiClient espClient;
 PubSubClient mqttClient(espClient);
 
 // Dual Core
 SemaphoreHandle_t dataMutex = NULL;
-TaskHandle_t core1TaskHandle = NULL;
+TaskHandle_t controlTaskHandle = NULL;
+TaskHandle_t networkTaskHandle = NULL;
+TaskHandle_t housekeepingTaskHandle = NULL;
+TaskHandle_t webTaskHandle = NULL;
+
+// File des logs (log_buffer.h)
+LogRecord logRing[LOG_RING_SIZE];
+std::atomic<uint32_t> logHead(0);
+uint32_t logTail = 0;
+std::atomic<uint32_t> logDropped(0);
+volatile bool logTaskRunning = false;
+TaskHandle_t logTaskHandle = NULL;
+LogSinkWriteFn logSinkWrite = NULL;
+LogSinkPollFn logSinkPoll = NULL;
+
+// Niveaux par catégorie (logging.h), initialisés avant les constructeurs globaux
+static_assert(LOG_CATEGORY_COUNT == 12, "Une valeur par categorie de log");
+uint8_t logCategoryLevels[LOG_CATEGORY_COUNT] = {
+  LOG_LEVEL, LOG_LEVEL, LOG_LEVEL, LOG_LEVEL, LOG_LEVEL, LOG_LEVEL,
+  LOG_LEVEL, LOG_LEVEL, LOG_LEVEL, LOG_LEVEL, LOG_LEVEL, LOG_LEVEL
+};
 
 // ============================================================================
 // PINOUT
@@ -113,4 +134,5 @@ int mqttPort = 1883;
 String mqttUser = "";
 String mqttPassword = "";
 String mqttTopic = "pool/control";
+MqttPublishConfig mqttPublishConfig = {0.1, 0.02, 300, false};
 unsigned long lastMqttAttempt = 0;
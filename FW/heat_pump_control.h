@@ -0,0 +1,291 @@
+/*
+ * POOL CONNECT - HEAT PUMP CONTROL
+ * Étape de régulation de la PAC dans la tâche contrôle
+ * heat_pump_control.h   V0.2
+ *
+ * Exécute heat_pump_thermostat.h toutes les HEATPUMP_CONTROL_PERIOD_MS sur
+ * la température de l'eau et la température extérieure (météo, ignorée si
+ * plus ancienne que HEATPUMP_EXT_TEMP_MAX_AGE_S).
+ *
+ * Mode actif : le thermostat pilote seul la PAC (source "thermostat") ;
+ * une commande web, MQTT ou timer est corrigée au pas suivant, dans le
+ * respect des durées minimales. Les règles de relay_service.h (pompe
+ * requise, arrêt minimum) restent appliquées. Repasser en mode OFF arrête
+ * la PAC si le thermostat l'avait allumée.
+ *
+ * Réglages : GET /api/heatpump, POST /api/heatpump/config (fichier
+ * /heatpump.json).
+ *
+ * Réglages écrits par la tâche web, état modifié par la tâche contrôle :
+ * copies sous heatPumpMux. Un changement de mode est signalé à la tâche
+ * contrôle, qui repart de zéro au pas suivant.
+ */
+
+#ifndef HEAT_PUMP_CONTROL_H
+#define HEAT_PUMP_CONTROL_H
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <ArduinoJson.h>
+#include "globals.h"
+#include "logging.h"
+#include "time_service.h"
+#include "relay_service.h"
+#include "weather.h"
+#include "heat_pump_thermostat.h"
+
+// ============================================================================
+// CONSTANTES
+// ============================================================================
+
+#define HEATPUMP_CONFIG_FILE "/heatpump.json"
+#define HEATPUMP_CONTROL_PERIOD_MS 10000UL   // Rythme des mesures
+#define HEATPUMP_EXT_TEMP_MAX_AGE_S 10800    // Météo de plus de 3h ignorée
+
+// ============================================================================
+// VARIABLES GLOBALES
+// ============================================================================
+
+ThermostatParams heatPumpParams = {
+  THERMOSTAT_OFF,
+  28.0f,          // Consigne
+  0.5f,           // Hystérésis
+  0.5f,           // kp : pleine chauffe à 2°C sous la consigne
+  0.15f,          // ki
+  0.0f,           // kd
+  0.0f,           // kff
+  3600,           // Fenêtre 1h : une marche par heure au plus
+  900,            // Marche minimale 15 min
+  300,            // Arrêt minimal 5 min
+  5.0f,           // Verrouillage sous 5°C extérieur
+  300.0f          // Filtre 5 min
+};
+ThermostatState heatPumpState;
+unsigned long lastHeatPumpStep = 0;
+bool heatPumpCommanded = false;            // PAC allumée par le thermostat
+ThermostatLock heatPumpLastLock = THERMOSTAT_LOCK_NONE;
+bool heatPumpResetPending = false;         // Mode changé par la tâche web
+portMUX_TYPE heatPumpMux = portMUX_INITIALIZER_UNLOCKED;
+
+// ============================================================================
+// ACCÈS PARTAGÉS
+// ============================================================================
+
+ThermostatParams getHeatPumpParams() {
+  portENTER_CRITICAL(&heatPumpMux);
+  ThermostatParams p = heatPumpParams;
+  portEXIT_CRITICAL(&heatPumpMux);
+  return p;
+}
+
+ThermostatState getHeatPumpState() {
+  portENTER_CRITICAL(&heatPumpMux);
+  ThermostatState s = heatPumpState;
+  portEXIT_CRITICAL(&heatPumpMux);
+  return s;
+}
+
+// ============================================================================
+// NOMS
+// ============================================================================
+
+const char* getThermostatModeName(ThermostatMode mode) {
+  switch (mode) {
+    case THERMOSTAT_OFF:        return "off";
+    case THERMOSTAT_HYSTERESIS: return "hysteresis";
+    case THERMOSTAT_PID:        return "pid";
+  }
+  return "off";
+}
+
+ThermostatMode parseThermostatMode(const char* name, ThermostatMode fallback) {
+  if (name == NULL) return fallback;
+  if (strcmp(name, "off") == 0) return THERMOSTAT_OFF;
+  if (strcmp(name, "hysteresis") == 0) return THERMOSTAT_HYSTERESIS;
+  if (strcmp(name, "pid") == 0) return THERMOSTAT_PID;
+  return fallback;
+}
+
+const char* getThermostatLockName(ThermostatLock lock) {
+  switch (lock) {
+    case THERMOSTAT_LOCK_NONE:     return "none";
+    case THERMOSTAT_LOCK_SENSOR:   return "sensor";
+    case THERMOSTAT_LOCK_PUMP:     return "pump";
+    case THERMOSTAT_LOCK_EXT_TEMP: return "ext_temp";
+  }
+  return "none";
+}
+
+// ============================================================================
+// CONFIGURATION
+// ============================================================================
+
+void writeHeatPumpJson(JsonObject obj) {
+  ThermostatParams p = getHeatPumpParams();
+  obj["mode"] = getThermostatModeName(p.mode);
+  obj["setpoint"] = p.setpoint;
+  obj["hysteresis"] = p.hysteresis;
+  obj["kp"] = p.kp;
+  obj["ki"] = p.ki;
+  obj["kd"] = p.kd;
+  obj["kff"] = p.kff;
+  obj["cyclePeriod"] = p.cyclePeriodSec;
+  obj["minOn"] = p.minOnSec;
+  obj["minOff"] = p.minOffSec;
+  obj["minExtTemp"] = p.minExtTemp;
+  obj["filterTau"] = p.filterTauSec;
+}
+
+/**
+ * Applique une configuration (valeurs actuelles si absentes, bornées).
+ * Changement de mode : régulation repartie de zéro (par la tâche contrôle).
+ */
+void readHeatPumpJson(JsonObject obj) {
+  ThermostatParams p = getHeatPumpParams();
+  ThermostatMode mode = parseThermostatMode(obj["mode"].as<const char*>(), p.mode);
+
+  p.setpoint = constrain(obj["setpoint"] | p.setpoint, 10.0f, 40.0f);
+  p.hysteresis = constrain(obj["hysteresis"] | p.hysteresis, 0.1f, 5.0f);
+  p.kp = constrain(obj["kp"] | p.kp, 0.0f, 10.0f);
+  p.ki = constrain(obj["ki"] | p.ki, 0.0f, 10.0f);
+  p.kd = constrain(obj["kd"] | p.kd, 0.0f, 10.0f);
+  p.kff = constrain(obj["kff"] | p.kff, 0.0f, 1.0f);
+  p.cyclePeriodSec = constrain(obj["cyclePeriod"] | (int)p.cyclePeriodSec, 600, 14400);
+  p.minOnSec = constrain(obj["minOn"] | (int)p.minOnSec, 0, 3600);
+  p.minOffSec = constrain(obj["minOff"] | (int)p.minOffSec, 0, 3600);
+  p.minExtTemp = constrain(obj["minExtTemp"] | p.minExtTemp, -30.0f, 30.0f);
+  p.filterTauSec = constrain(obj["filterTau"] | p.filterTauSec, 0.0f, 3600.0f);
+
+  portENTER_CRITICAL(&heatPumpMux);
+  if (mode != heatPumpParams.mode) heatPumpResetPending = true;
+  p.mode = mode;
+  heatPumpParams = p;
+  portEXIT_CRITICAL(&heatPumpMux);
+}
+
+void saveHeatPumpConfig() {
+  File f = LittleFS.open(HEATPUMP_CONFIG_FILE, FILE_WRITE);
+  if (!f) {
+    LOG_E(LOG_STORAGE, "Erreur ouverture %s en ecriture", HEATPUMP_CONFIG_FILE);
+    LOG_STORAGE_OP("WRITE", HEATPUMP_CONFIG_FILE, false);
+    return;
+  }
+
+  StaticJsonDocument<512> doc;
+  writeHeatPumpJson(doc.to<JsonObject>());
+  size_t bytesWritten = serializeJson(doc, f);
+  f.close();
+
+  LOG_I(LOG_STORAGE, "Configuration PAC sauvegardee (%d bytes)", bytesWritten);
+  LOG_STORAGE_OP("WRITE", HEATPUMP_CONFIG_FILE, true);
+}
+
+void loadHeatPumpConfig() {
+  resetThermostat(heatPumpState);
+
+  if (!LittleFS.exists(HEATPUMP_CONFIG_FILE)) {
+    LOG_D(LOG_STORAGE, "Fichier %s non trouve - Thermostat PAC desactive", HEATPUMP_CONFIG_FILE);
+    return;
+  }
+
+  File f = LittleFS.open(HEATPUMP_CONFIG_FILE, FILE_READ);
+  if (!f) {
+    LOG_E(LOG_STORAGE, "Erreur ouverture %s en lecture", HEATPUMP_CONFIG_FILE);
+    LOG_STORAGE_OP("READ", HEATPUMP_CONFIG_FILE, false);
+    return;
+  }
+
+  StaticJsonDocument<512> doc;
+  DeserializationError err = deserializeJson(doc, f);
+  f.close();
+
+  if (err) {
+    LOG_E(LOG_STORAGE, "Erreur parsing %s: %s", HEATPUMP_CONFIG_FILE, err.c_str());
+    LOG_STORAGE_OP("READ", HEATPUMP_CONFIG_FILE, false);
+    return;
+  }
+
+  readHeatPumpJson(doc.as<JsonObject>());
+  LOG_I(LOG_STORAGE, "Thermostat PAC: mode %s, consigne %.1fC",
+        getThermostatModeName(heatPumpParams.mode), heatPumpParams.setpoint);
+  LOG_STORAGE_OP("READ", HEATPUMP_CONFIG_FILE, true);
+}
+
+// ============================================================================
+// RÉGULATION
+// ============================================================================
+
+/**
+ * Étape de la tâche contrôle (appelée à chaque tour, cadencée ici).
+ */
+void processHeatPumpControl() {
+  unsigned long now = millis();
+  if (lastHeatPumpStep != 0 && now - lastHeatPumpStep < HEATPUMP_CONTROL_PERIOD_MS) return;
+  float dtSec = lastHeatPumpStep != 0 ? (now - lastHeatPumpStep) / 1000.0f : 0;
+  lastHeatPumpStep = now;
+
+  // Réglages du pas et état de travail (seule cette tâche modifie l'état)
+  portENTER_CRITICAL(&heatPumpMux);
+  ThermostatParams params = heatPumpParams;
+  bool reset = heatPumpResetPending;
+  heatPumpResetPending = false;
+  portEXIT_CRITICAL(&heatPumpMux);
+
+  ThermostatState state = heatPumpState;
+  if (reset) {
+    resetThermostat(state);
+    portENTER_CRITICAL(&heatPumpMux);
+    heatPumpState = state;
+    portEXIT_CRITICAL(&heatPumpMux);
+  }
+
+  if (params.mode == THERMOSTAT_OFF) {
+    // Mode désactivé : rendre la PAC dans l'état où le thermostat l'a prise
+    if (heatPumpCommanded) {
+      heatPumpCommanded = false;
+      if (isRelayOn(RELAY_HEAT_PUMP)) {
+        LOG_I(LOG_SYSTEM, "Thermostat PAC desactive - Arret de la PAC");
+        setRelay(RELAY_HEAT_PUMP, false, RELAY_SOURCE_THERMOSTAT);
+      }
+    }
+    return;
+  }
+
+  float water, ext;
+  if (!xSemaphoreTake(dataMutex, pdMS_TO_TICKS(100))) return;
+  water = waterTemp;
+  ext = tempExterieure;
+  xSemaphoreGive(dataMutex);
+
+  time_t epoch = getCachedEpoch();
+  if (weatherLastSuccess == 0 || epoch - weatherLastSuccess > HEATPUMP_EXT_TEMP_MAX_AGE_S) ext = NAN;
+
+  bool on = isRelayOn(RELAY_HEAT_PUMP);
+  RelayInfo info = getRelayInfo(RELAY_HEAT_PUMP);
+  bool want = stepThermostat(params, state, water, ext, isRelayOn(RELAY_PUMP),
+                             on, now - info.changedAt, now, dtSec);
+
+  portENTER_CRITICAL(&heatPumpMux);
+  heatPumpState = state;
+  portEXIT_CRITICAL(&heatPumpMux);
+
+  if (state.lock != heatPumpLastLock) {
+    if (state.lock != THERMOSTAT_LOCK_NONE) {
+      LOG_W(LOG_SYSTEM, "Thermostat PAC verrouille: %s", getThermostatLockName(state.lock));
+    } else {
+      LOG_I(LOG_SYSTEM, "Thermostat PAC deverrouille");
+    }
+    heatPumpLastLock = state.lock;
+  }
+
+  if (want == on) return;
+
+  RelayRuleResult refusal;
+  if (setRelay(RELAY_HEAT_PUMP, want, RELAY_SOURCE_THERMOSTAT, &refusal)) {
+    heatPumpCommanded = want;
+    LOG_I(LOG_SYSTEM, "Thermostat PAC %s: eau %.2fC (filtree), consigne %.1fC, rapport %.0f%%",
+          want ? "ON" : "OFF", state.filteredTemp, params.setpoint, state.duty * 100);
+  }
+}
+
+#endif // HEAT_PUMP_CONTROL_H
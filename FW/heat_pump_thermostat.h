@@ -0,0 +1,222 @@
+/*
+ * POOL CONNECT - HEAT PUMP THERMOSTAT
+ * Régulation de la PAC sur une consigne de température d'eau
+ * heat_pump_thermostat.h   V0.1
+ *
+ * Deux modes :
+ *   THERMOSTAT_HYSTERESIS  marche sous (consigne - hystérésis), arrêt à la
+ *                          consigne
+ *   THERMOSTAT_PID         rapport cyclique PI(D) appliqué sur une fenêtre
+ *                          fixe (cyclePeriodSec) : une seule marche par
+ *                          fenêtre, le compresseur ne bat pas
+ *
+ * Température de l'eau filtrée (premier ordre, filterTauSec). Anticipation
+ * optionnelle sur l'écart consigne - extérieur (pertes du bassin).
+ *
+ * Durées minimales de marche et d'arrêt respectées par la régulation
+ * elle-même (fenêtre trop courte : arrondie à 0 ou à la fenêtre entière).
+ * Verrouillages (PAC arrêtée sans attendre) : mesure invalide, pompe
+ * arrêtée, température extérieure sous minExtTemp. L'intégrale n'évolue
+ * que pompe en marche (mesure représentative du bassin).
+ *
+ * Module pur (aucune dépendance Arduino, pas d'allocation) : testable sur
+ * PC contre un modèle thermique du bassin, le temps et les mesures sont
+ * passés en paramètres.
+ */
+
+#ifndef HEAT_PUMP_THERMOSTAT_H
+#define HEAT_PUMP_THERMOSTAT_H
+
+#include <stdint.h>
+#include <math.h>
+
+// ============================================================================
+// CONSTANTES
+// ============================================================================
+
+#define THERMOSTAT_WATER_TEMP_MIN 1.0f       // Hors plage : capteur en défaut
+#define THERMOSTAT_WATER_TEMP_MAX 45.0f
+
+// ============================================================================
+// STRUCTURES
+// ============================================================================
+
+enum ThermostatMode {
+  THERMOSTAT_OFF,
+  THERMOSTAT_HYSTERESIS,
+  THERMOSTAT_PID
+};
+
+enum ThermostatLock {
+  THERMOSTAT_LOCK_NONE,
+  THERMOSTAT_LOCK_SENSOR,     // Température d'eau invalide
+  THERMOSTAT_LOCK_PUMP,       // Pas de débit
+  THERMOSTAT_LOCK_EXT_TEMP    // Trop froid dehors (rendement, dégivrage)
+};
+
+struct ThermostatParams {
+  ThermostatMode mode;
+  float setpoint;             // Consigne eau (°C)
+  float hysteresis;           // Écart sous la consigne avant remise en marche (°C)
+  float kp;                   // Rapport cyclique par °C d'écart
+  float ki;                   // Rapport cyclique par °C.h
+  float kd;                   // Rapport cyclique par °C/h (sur la mesure)
+  float kff;                  // Rapport cyclique par °C de (consigne - extérieur)
+  uint16_t cyclePeriodSec;    // Fenêtre du rapport cyclique
+  uint16_t minOnSec;
+  uint16_t minOffSec;
+  float minExtTemp;           // Verrouillage sous cette température extérieure
+  float filterTauSec;         // Constante de temps du filtre (0 = pas de filtre)
+};
+
+struct ThermostatState {
+  bool filterReady;
+  float filteredTemp;
+  float lastTemp;             // Dernière mesure filtrée (dérivée)
+  float integral;             // °C.h
+  float duty;                 // Dernière sortie du PID (0-1)
+  uint32_t cycleStartMs;
+  uint32_t cycleOnMs;         // Marche de la fenêtre en cours
+  bool cycleStarted;
+  bool heating;               // Demande de chauffe
+  ThermostatLock lock;
+};
+
+// ============================================================================
+// ÉTAT
+// ============================================================================
+
+inline void resetThermostat(ThermostatState& s) {
+  s.filterReady = false;
+  s.filteredTemp = 0;
+  s.lastTemp = 0;
+  s.integral = 0;
+  s.duty = 0;
+  s.cycleStartMs = 0;
+  s.cycleOnMs = 0;
+  s.cycleStarted = false;
+  s.heating = false;
+  s.lock = THERMOSTAT_LOCK_NONE;
+}
+
+inline bool isValidWaterTemp(float temp) {
+  return !isnan(temp) && temp >= THERMOSTAT_WATER_TEMP_MIN && temp <= THERMOSTAT_WATER_TEMP_MAX;
+}
+
+/**
+ * Filtre du premier ordre (initialisé sur la première mesure valide).
+ */
+inline float filterThermostatTemp(ThermostatState& s, float temp, float dtSec, float tauSec) {
+  if (!s.filterReady || tauSec <= 0) {
+    s.filteredTemp = temp;
+    s.filterReady = true;
+  } else {
+    float alpha = dtSec / (tauSec + dtSec);
+    s.filteredTemp += alpha * (temp - s.filteredTemp);
+  }
+  return s.filteredTemp;
+}
+
+// ============================================================================
+// RÉGULATION
+// ============================================================================
+
+/**
+ * Rapport cyclique PI(D) avec anticipation. Anti-emballement : l'intégrale
+ * n'avance pas quand la sortie est saturée dans le sens de l'erreur.
+ */
+inline float computeThermostatDuty(const ThermostatParams& p, ThermostatState& s,
+                                   float temp, float extTemp, float dtSec, bool integrate) {
+  float error = p.setpoint - temp;
+  float dtHours = dtSec / 3600.0f;
+
+  float derivative = 0;
+  if (dtHours > 0 && s.lastTemp != 0) derivative = -(temp - s.lastTemp) / dtHours;
+  s.lastTemp = temp;
+
+  float feedForward = isnan(extTemp) ? 0 : p.kff * (p.setpoint - extTemp);
+  float base = p.kp * error + p.kd * derivative + feedForward;
+
+  if (integrate && p.ki > 0) {
+    float next = s.integral + error * dtHours;
+    float out = base + p.ki * next;
+    bool saturated = (out > 1 && error > 0) || (out < 0 && error < 0);
+    if (!saturated) s.integral = next;
+  }
+
+  float duty = base + p.ki * s.integral;
+  if (duty < 0) duty = 0;
+  if (duty > 1) duty = 1;
+  s.duty = duty;
+  return duty;
+}
+
+/**
+ * Marche de la fenêtre : trop courte pour minOnSec -> 0, arrêt restant
+ * trop court pour minOffSec -> fenêtre entière.
+ */
+inline uint32_t computeCycleOnMs(const ThermostatParams& p, float duty) {
+  uint32_t periodMs = (uint32_t)p.cyclePeriodSec * 1000;
+  uint32_t onMs = (uint32_t)(duty * periodMs);
+  if (onMs < (uint32_t)p.minOnSec * 1000) return 0;
+  if (periodMs - onMs < (uint32_t)p.minOffSec * 1000) return periodMs;
+  return onMs;
+}
+
+/**
+ * Un pas de régulation.
+ *
+ * @param waterTemp Mesure brute (filtrée ici)
+ * @param extTemp Température extérieure (NAN si inconnue)
+ * @param heatingOn État réel de la PAC
+ * @param sinceChangeMs Temps depuis le dernier changement réel de la PAC
+ * @return état demandé pour la PAC
+ */
+inline bool stepThermostat(const ThermostatParams& p, ThermostatState& s,
+                           float waterTemp, float extTemp, bool pumpOn,
+                           bool heatingOn, uint32_t sinceChangeMs,
+                           uint32_t nowMs, float dtSec) {
+  if (p.mode == THERMOSTAT_OFF) {
+    s.heating = false;
+    s.lock = THERMOSTAT_LOCK_NONE;
+    s.cycleStarted = false;
+    return false;
+  }
+
+  // Verrouillages : arrêt immédiat, la sécurité passe avant la durée minimale
+  if (!isValidWaterTemp(waterTemp)) {
+    s.lock = THERMOSTAT_LOCK_SENSOR;
+  } else {
+    float temp = filterThermostatTemp(s, waterTemp, dtSec, p.filterTauSec);
+    if (!pumpOn) s.lock = THERMOSTAT_LOCK_PUMP;
+    else if (!isnan(extTemp) && extTemp < p.minExtTemp) s.lock = THERMOSTAT_LOCK_EXT_TEMP;
+    else s.lock = THERMOSTAT_LOCK_NONE;
+
+    if (p.mode == THERMOSTAT_HYSTERESIS) {
+      if (temp >= p.setpoint) s.heating = false;
+      else if (temp <= p.setpoint - p.hysteresis) s.heating = true;
+    } else {
+      computeThermostatDuty(p, s, temp, extTemp, dtSec, s.lock == THERMOSTAT_LOCK_NONE);
+
+      uint32_t periodMs = (uint32_t)p.cyclePeriodSec * 1000;
+      if (!s.cycleStarted || nowMs - s.cycleStartMs >= periodMs) {
+        s.cycleStartMs = nowMs;
+        s.cycleOnMs = computeCycleOnMs(p, s.duty);
+        s.cycleStarted = true;
+      }
+      s.heating = nowMs - s.cycleStartMs < s.cycleOnMs;
+    }
+  }
+
+  if (s.lock != THERMOSTAT_LOCK_NONE) {
+    s.cycleStarted = false;   // Nouvelle fenêtre à la levée du verrouillage
+    return false;
+  }
+
+  // Durées minimales : l'état réel est conservé tant qu'elles ne sont pas écoulées
+  if (s.heating && !heatingOn && sinceChangeMs < (uint32_t)p.minOffSec * 1000) return false;
+  if (!s.heating && heatingOn && sinceChangeMs < (uint32_t)p.minOnSec * 1000) return true;
+  return s.heating;
+}
+
+#endif // HEAT_PUMP_THERMOSTAT_H
@@ -0,0 +1,327 @@
+/*
+ * POOL CONNECT - LOG BUFFER
+ * File circulaire des logs, écrite sur le port série par une tâche dédiée
+ * log_buffer.h   V0.2
+ *
+ * Les macros LOG_* ne formatent plus rien : elles copient dans un
+ * emplacement de la file l'heure, le niveau, la catégorie, le pointeur du
+ * format (littéral) et les arguments bruts (les chaînes sont recopiées,
+ * leur source peut disparaître). Le formatage et l'écriture sur l'UART
+ * sont faits par logTask, de priorité basse sur le core 0.
+ *
+ * - File multi-producteurs sans verrou (numéro de séquence par
+ *   emplacement) : aucune tâche n'attend une autre pour loguer
+ * - File pleine : l'enregistrement est compté puis abandonné, jamais
+ *   d'attente ; le nombre perdu est affiché par logTask
+ * - Arguments trop longs pour l'emplacement : message formaté tout de
+ *   suite (tronqué à LOG_PAYLOAD_SIZE)
+ * - Chaque ligne écrite est aussi passée à logSinkWrite si défini
+ *   (journal en flash de log_manager.h), depuis logTask uniquement
+ * - Avant startLogTask(), appelé à la fin du setup : écriture directe
+ *   sur le port série, comme avant (les logs du démarrage dépasseraient
+ *   la file)
+ *
+ * Inclus par logging.h après les catégories. Présent dans les deux unités
+ * de compilation : variables définies dans globals_impl.cpp, fonctions
+ * inline.
+ */
+
+#ifndef LOG_BUFFER_H
+#define LOG_BUFFER_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <type_traits>
+
+// ============================================================================
+// CONSTANTES
+// ============================================================================
+
+#define LOG_RING_SIZE 64                 // Puissance de 2
+#define LOG_PAYLOAD_SIZE 112             // Arguments bruts ou texte formaté
+#define LOG_LINE_MAX 192
+#define LOG_TASK_STACK 4096
+#define LOG_TASK_PRIORITY 1              // Comme la tâche maintenance
+#define LOG_TASK_CORE 0
+#define LOG_TASK_PERIOD_MS 10
+
+// ============================================================================
+// STRUCTURES
+// ============================================================================
+
+#define LOG_UNTAGGED 0x80                // Catégorie non affichée (logs spécialisés)
+
+// Reconstruit les arguments depuis le payload et formate le message
+typedef int (*LogFormatFn)(char* out, size_t size, const char* format, const uint8_t* payload);
+
+struct LogRecord {
+  std::atomic<uint32_t> sequence;        // = position : libre, position + 1 : prêt
+  uint32_t timestamp;                    // millis()
+  uint8_t level;
+  const char* prefix;                    // "[ERROR]", "[WEB-REQ]"...
+  uint8_t category;                      // LOG_SYSTEM... (| LOG_UNTAGGED)
+  const char* format;
+  LogFormatFn formatter;                 // NULL : payload déjà formaté
+  uint8_t payload[LOG_PAYLOAD_SIZE];
+};
+
+// ============================================================================
+// VARIABLES GLOBALES (globals_impl.cpp)
+// ============================================================================
+
+extern LogRecord logRing[LOG_RING_SIZE];
+extern std::atomic<uint32_t> logHead;    // Prochaine position à réserver
+extern uint32_t logTail;                 // Prochaine position à lire (logTask)
+extern std::atomic<uint32_t> logDropped;
+extern volatile bool logTaskRunning;
+extern TaskHandle_t logTaskHandle;
+
+// Suite d'une ligne écrite (journal en flash), appelé par logTask
+typedef void (*LogSinkWriteFn)(const LogRecord& record, const char* line, size_t len);
+typedef void (*LogSinkPollFn)();
+extern LogSinkWriteFn logSinkWrite;
+extern LogSinkPollFn logSinkPoll;
+
+// ============================================================================
+// COPIE DES ARGUMENTS
+// ============================================================================
+
+/**
+ * Nombres, énumérations et pointeurs (%p) : copiés tels quels.
+ */
+template<typename T, typename Enable = void>
+struct LogArg {
+  static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value || std::is_pointer<T>::value,
+                "Type d'argument de log non supporte");
+  typedef T Stored;
+
+  static bool pack(uint8_t*& p, const uint8_t* end, T value) {
+    if (p + sizeof(T) > end) return false;
+    memcpy(p, &value, sizeof(T));
+    p += sizeof(T);
+    return true;
+  }
+
+  static const uint8_t* unpack(const uint8_t* p, Stored& value) {
+    memcpy(&value, p, sizeof(T));
+    return p + sizeof(T);
+  }
+};
+
+/**
+ * Chaînes (%s) : contenu recopié, relu en place dans le payload.
+ */
+template<typename T>
+struct LogArg<T, typename std::enable_if<std::is_same<T, const char*>::value || std::is_same<T, char*>::value>::type> {
+  typedef const char* Stored;
+
+  static bool pack(uint8_t*& p, const uint8_t* end, const char* value) {
+    if (value == NULL) value = "(null)";
+    size_t len = strlen(value) + 1;
+    if (p + len > end) return false;
+    memcpy(p, value, len);
+    p += len;
+    return true;
+  }
+
+  static const uint8_t* unpack(const uint8_t* p, Stored& value) {
+    value = (const char*)p;
+    return p + strlen(value) + 1;
+  }
+};
+
+inline bool logPackArgs(uint8_t*& p, const uint8_t* end) {
+  return true;
+}
+
+template<typename T, typename... Rest>
+inline bool logPackArgs(uint8_t*& p, const uint8_t* end, T value, Rest... rest) {
+  return LogArg<T>::pack(p, end, value) && logPackArgs(p, end, rest...);
+}
+
+template<typename... Ts>
+struct LogUnpacker;
+
+template<>
+struct LogUnpacker<> {
+  template<typename... Done>
+  static int format(char* out, size_t size, const char* format, const uint8_t* p, Done... done) {
+    return snprintf(out, size, format, done...);
+  }
+};
+
+template<typename T, typename... Ts>
+struct LogUnpacker<T, Ts...> {
+  template<typename... Done>
+  static int format(char* out, size_t size, const char* format, const uint8_t* p, Done... done) {
+    typename LogArg<T>::Stored value;
+    p = LogArg<T>::unpack(p, value);
+    return LogUnpacker<Ts...>::format(out, size, format, p, done..., value);
+  }
+};
+
+template<typename... Args>
+int logFormatPayload(char* out, size_t size, const char* format, const uint8_t* payload) {
+  return LogUnpacker<Args...>::format(out, size, format, payload);
+}
+
+// ============================================================================
+// ÉCRITURE SUR LE PORT SÉRIE
+// ============================================================================
+
+/**
+ * Formate un enregistrement en une ligne terminée par '\n'.
+ *
+ * @return longueur de la ligne
+ */
+inline size_t formatLogRecord(const LogRecord& record, char* line, size_t size) {
+  const char* tag = (record.category & LOG_UNTAGGED) ? "" : getLogCategoryTag(record.category);
+  int len = snprintf(line, size, "%s%s%s", record.prefix, tag, (*record.prefix || *tag) ? " " : "");
+  if (len < 0 || len >= (int)size - 1) len = 0;
+
+  int n;
+  if (record.formatter != NULL) {
+    n = record.formatter(line + len, size - len - 1, record.format, record.payload);
+  } else {
+    n = snprintf(line + len, size - len - 1, "%s", (const char*)record.payload);
+  }
+  if (n > 0) len += n;
+  if (len > (int)size - 2) len = size - 2;
+
+  line[len++] = '\n';
+  return len;
+}
+
+/**
+ * Écrit un enregistrement sur le port série (et le journal en flash).
+ */
+inline void writeLogRecord(const LogRecord& record, bool toSink) {
+  char line[LOG_LINE_MAX];
+  size_t len = formatLogRecord(record, line, sizeof(line));
+  Serial.write((const uint8_t*)line, len);
+  if (toSink && logSinkWrite != NULL) logSinkWrite(record, line, len);
+}
+
+// ============================================================================
+// PRODUCTEURS
+// ============================================================================
+
+/**
+ * Remplit un enregistrement (arguments bruts, sinon texte formaté).
+ */
+template<typename... Args>
+inline void fillLogRecord(LogRecord& record, uint8_t level, const char* prefix,
+                          uint8_t category, const char* format, Args... args) {
+  record.timestamp = millis();
+  record.level = level;
+  record.prefix = prefix;
+  record.category = category;
+  record.format = format;
+
+  uint8_t* p = record.payload;
+  if (logPackArgs(p, record.payload + LOG_PAYLOAD_SIZE, args...)) {
+    record.formatter = &logFormatPayload<typename LogArg<Args>::Stored...>;
+  } else {
+    snprintf((char*)record.payload, LOG_PAYLOAD_SIZE, format, args...);
+    record.formatter = NULL;
+  }
+}
+
+/**
+ * Ajoute un log à la file (appelé par les macros LOG_*).
+ */
+template<typename... Args>
+inline void logRecord(uint8_t level, const char* prefix, uint8_t category,
+                      const char* format, Args... args) {
+  if (!logTaskRunning) {
+    LogRecord record;
+    fillLogRecord(record, level, prefix, category, format, args...);
+    writeLogRecord(record, false);
+    return;
+  }
+
+  // Réservation d'un emplacement (file bornée multi-producteurs)
+  uint32_t pos = logHead.load(std::memory_order_relaxed);
+  LogRecord* record;
+  while (true) {
+    record = &logRing[pos & (LOG_RING_SIZE - 1)];
+    int32_t diff = (int32_t)(record->sequence.load(std::memory_order_acquire) - pos);
+    if (diff == 0) {
+      if (logHead.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+    } else if (diff < 0) {
+      logDropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    } else {
+      pos = logHead.load(std::memory_order_relaxed);
+    }
+  }
+
+  fillLogRecord(*record, level, prefix, category, format, args...);
+  record->sequence.store(pos + 1, std::memory_order_release);
+}
+
+// ============================================================================
+// TÂCHE D'ÉCRITURE
+// ============================================================================
+
+/**
+ * Écrit les enregistrements prêts, dans l'ordre de réservation.
+ *
+ * @return nombre d'enregistrements écrits
+ */
+inline int drainLogRing() {
+  int count = 0;
+
+  while (true) {
+    LogRecord& record = logRing[logTail & (LOG_RING_SIZE - 1)];
+    if (record.sequence.load(std::memory_order_acquire) != logTail + 1) break;
+
+    writeLogRecord(record, true);
+    record.sequence.store(logTail + LOG_RING_SIZE, std::memory_order_release);
+    logTail++;
+    count++;
+  }
+
+  return count;
+}
+
+inline void logTask(void* parameter) {
+  uint32_t reportedDropped = 0;
+
+  while (true) {
+    drainLogRing();
+
+    uint32_t dropped = logDropped.load(std::memory_order_relaxed);
+    if (dropped != reportedDropped) {
+      Serial.printf("[WARN][SYSTEM] File de logs pleine - %lu messages perdus (total %lu)\n",
+                    (unsigned long)(dropped - reportedDropped), (unsigned long)dropped);
+      reportedDropped = dropped;
+    }
+
+    if (logSinkPoll != NULL) logSinkPoll();
+
+    vTaskDelay(pdMS_TO_TICKS(LOG_TASK_PERIOD_MS));
+  }
+}
+
+/**
+ * Passe les logs en mode différé (fin du setup).
+ */
+inline void startLogTask() {
+  if (logTaskRunning) return;
+
+  for (uint32_t i = 0; i < LOG_RING_SIZE; i++) {
+    logRing[i].sequence.store(i, std::memory_order_relaxed);
+  }
+  logHead.store(0, std::memory_order_relaxed);
+  logTail = 0;
+
+  if (xTaskCreatePinnedToCore(logTask, "LogTask", LOG_TASK_STACK, NULL,
+                              LOG_TASK_PRIORITY, &logTaskHandle, LOG_TASK_CORE) != pdPASS) {
+    Serial.println("[ERROR][SYSTEM] Tache LogTask non creee - Logs synchrones");
+    return;
+  }
+  logTaskRunning = true;
+}
+
+#endif // LOG_BUFFER_H
@@ -0,0 +1,432 @@
+/*
+ * POOL CONNECT - LOG MANAGER
+ * Niveaux de log modifiables à l'exécution et journal circulaire en flash
+ * log_manager.h   V0.1
+ *
+ * Niveaux :
+ * - un niveau par catégorie (logCategoryLevels), plus celui du journal
+ * - GET/POST /api/logs/levels, MQTT <topic>/log/<categorie|all|flash>/set
+ *   (valeur 0-5 ou none/error/warning/info/debug/verbose)
+ * - sauvegardés dans /log_levels.json
+ *
+ * Journal en flash (/logs) :
+ * - les lignes de niveau <= logFlashLevel (warnings et erreurs par défaut)
+ *   sont numérotées et gardées en RAM par LogTask, puis ajoutées à
+ *   current.log toutes les 30 s (tout de suite pour une erreur)
+ * - current.log devient previous.log au-delà de 32 KB : 64 KB max
+ * - ligne : "<numéro> <heure unix, 0 si inconnue> <ligne du port série>"
+ * - GET /api/logs?since=<numéro> renvoie les lignes suivantes
+ * Le journal n'attend jamais : fichier occupé (lecture HTTP en cours),
+ * l'écriture est reportée ; tampon plein, la ligne est comptée et perdue.
+ */
+
+#ifndef LOG_MANAGER_H
+#define LOG_MANAGER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <LittleFS.h>
+#include <time.h>
+#include "globals.h"
+#include "config.h"
+#include "logging.h"
+#include "task_bus.h"
+#include "web_stream.h"
+
+// ============================================================================
+// CONSTANTES
+// ============================================================================
+
+#define LOG_CONFIG_FILE "/log_levels.json"
+#define LOG_FLASH_DIR "/logs"
+#define LOG_FLASH_CURRENT "/logs/current.log"
+#define LOG_FLASH_PREVIOUS "/logs/previous.log"
+#define LOG_FLASH_FILE_SIZE 32768
+#define LOG_FLASH_BUFFER_SIZE 2048
+#define LOG_FLASH_FLUSH_MS 30000
+#define LOG_FLASH_LINE_MAX (LOG_LINE_MAX + 32)
+
+// ============================================================================
+// VARIABLES GLOBALES
+// ============================================================================
+
+uint8_t logFlashLevel = LOG_FLASH_LEVEL;
+
+char logFlashBuffer[LOG_FLASH_BUFFER_SIZE];  // Lignes en attente (sous logFlashMux)
+size_t logFlashBufferLen = 0;
+bool logFlashUrgent = false;
+portMUX_TYPE logFlashMux = portMUX_INITIALIZER_UNLOCKED;
+
+SemaphoreHandle_t logFileMutex = NULL;     // Fichiers /logs
+uint32_t logFlashSeq = 0;                  // Dernier numéro attribué
+uint32_t logFlashLost = 0;
+unsigned long lastLogFlashFlush = 0;
+
+// ============================================================================
+// NIVEAUX
+// ============================================================================
+
+/**
+ * "3", "debug", "warn"... -> niveau, -1 si invalide.
+ */
+int parseLogLevel(const char* text) {
+  if (text == NULL || *text == '\0') return -1;
+
+  if (isdigit((unsigned char)text[0])) {
+    int level = atoi(text);
+    return (level >= LOG_NONE && level <= LOG_VERBOSE) ? level : -1;
+  }
+
+  static const char* const names[] = { "none", "error", "warning", "info", "debug", "verbose" };
+  for (int i = 0; i <= LOG_VERBOSE; i++) {
+    if (strcasecmp(text, names[i]) == 0) return i;
+  }
+  if (strcasecmp(text, "warn") == 0) return LOG_WARNING;
+  return -1;
+}
+
+int parseLogLevelValue(JsonVariantConst value) {
+  if (value.is<int>()) {
+    int level = value.as<int>();
+    return (level >= LOG_NONE && level <= LOG_VERBOSE) ? level : -1;
+  }
+  return parseLogLevel(value.as<const char*>());
+}
+
+int getLogCategoryByName(const char* name) {
+  for (int i = 0; i < LOG_CATEGORY_COUNT; i++) {
+    if (strcmp(name, LOG_CATEGORY_NAMES[i]) == 0) return i;
+  }
+  return -1;
+}
+
+/**
+ * Applique un niveau à une catégorie, à toutes ("all") ou au journal ("flash").
+ *
+ * @return false si le nom ou le niveau est invalide
+ */
+bool setLogLevel(const char* name, int level) {
+  if (level < LOG_NONE || level > LOG_VERBOSE) return false;
+  if (level > LOG_LEVEL_MAX) level = LOG_LEVEL_MAX;
+
+  if (strcmp(name, "flash") == 0) {
+    logFlashLevel = level;
+  } else if (strcmp(name, "all") == 0) {
+    for (int i = 0; i < LOG_CATEGORY_COUNT; i++) logCategoryLevels[i] = level;
+  } else {
+    int category = getLogCategoryByName(name);
+    if (category < 0) return false;
+    logCategoryLevels[category] = level;
+  }
+
+  LOG_I(LOG_SYSTEM, "Niveau de log %s: %d", name, level);
+  return true;
+}
+
+void saveLogConfig() {
+  File f = LittleFS.open(LOG_CONFIG_FILE, FILE_WRITE);
+  if (!f) {
+    LOG_E(LOG_STORAGE, "Erreur ouverture %s en ecriture", LOG_CONFIG_FILE);
+    LOG_STORAGE_OP("WRITE", LOG_CONFIG_FILE, false);
+    return;
+  }
+
+  StaticJsonDocument<512> doc;
+  JsonObject levels = doc.createNestedObject("levels");
+  for (int i = 0; i < LOG_CATEGORY_COUNT; i++) {
+    levels[LOG_CATEGORY_NAMES[i]] = logCategoryLevels[i];
+  }
+  doc["flash"] = logFlashLevel;
+
+  serializeJson(doc, f);
+  f.close();
+  LOG_STORAGE_OP("WRITE", LOG_CONFIG_FILE, true);
+}
+
+void loadLogConfig() {
+  if (!LittleFS.exists(LOG_CONFIG_FILE)) {
+    LOG_D(LOG_STORAGE, "Fichier %s non trouve - Niveaux de log par defaut", LOG_CONFIG_FILE);
+    return;
+  }
+
+  File f = LittleFS.open(LOG_CONFIG_FILE, FILE_READ);
+  if (!f) {
+    LOG_STORAGE_OP("READ", LOG_CONFIG_FILE, false);
+    return;
+  }
+
+  StaticJsonDocument<512> doc;
+  DeserializationError err = deserializeJson(doc, f);
+  f.close();
+
+  if (err) {
+    LOG_E(LOG_STORAGE, "Erreur parsing JSON: %s", err.c_str());
+    LOG_STORAGE_OP("READ", LOG_CONFIG_FILE, false);
+    return;
+  }
+
+  JsonObject levels = doc["levels"];
+  for (int i = 0; i < LOG_CATEGORY_COUNT; i++) {
+    int level = levels[LOG_CATEGORY_NAMES[i]] | (int)LOG_LEVEL;
+    logCategoryLevels[i] = constrain(level, (int)LOG_NONE, (int)LOG_LEVEL_MAX);
+  }
+  logFlashLevel = constrain(doc["flash"] | (int)LOG_FLASH_LEVEL, (int)LOG_NONE, (int)LOG_LEVEL_MAX);
+
+  LOG_I(LOG_STORAGE, "Niveaux de log charges (journal flash: %d)", logFlashLevel);
+  LOG_STORAGE_OP("READ", LOG_CONFIG_FILE, true);
+}
+
+// ============================================================================
+// JOURNAL EN FLASH
+// ============================================================================
+
+/**
+ * Numéro en tête d'une ligne du journal.
+ */
+uint32_t getLogLineSeq(const char* line) {
+  return strtoul(line, NULL, 10);
+}
+
+/**
+ * Dernier numéro écrit (relu au démarrage pour continuer la numérotation).
+ */
+uint32_t readLastLogSeq(const char* path) {
+  File f = LittleFS.open(path, FILE_READ);
+  if (!f) return 0;
+
+  char line[LOG_FLASH_LINE_MAX];
+  uint32_t last = 0;
+  while (f.available()) {
+    size_t n = f.readBytesUntil('\n', line, sizeof(line) - 1);
+    line[n] = '\0';
+    if (n > 0) last = getLogLineSeq(line);
+  }
+  f.close();
+  return last;
+}
+
+/**
+ * Écrit les lignes en attente à la fin de current.log.
+ *
+ * @param wait Attente max du fichier (0 depuis LogTask)
+ */
+bool flushLogFlash(TickType_t wait) {
+  if (logFileMutex == NULL || xSemaphoreTake(logFileMutex, wait) != pdTRUE) return false;
+
+  static char pending[LOG_FLASH_BUFFER_SIZE];
+  portENTER_CRITICAL(&logFlashMux);
+  size_t len = logFlashBufferLen;
+  memcpy(pending, logFlashBuffer, len);
+  logFlashBufferLen = 0;
+  logFlashUrgent = false;
+  portEXIT_CRITICAL(&logFlashMux);
+
+  if (len > 0) {
+    File f = LittleFS.open(LOG_FLASH_CURRENT, FILE_APPEND);
+    if (f && f.size() + len > LOG_FLASH_FILE_SIZE) {
+      f.close();
+      LittleFS.remove(LOG_FLASH_PREVIOUS);
+      LittleFS.rename(LOG_FLASH_CURRENT, LOG_FLASH_PREVIOUS);
+      f = LittleFS.open(LOG_FLASH_CURRENT, FILE_APPEND);
+    }
+    if (f) {
+      f.write((const uint8_t*)pending, len);
+      f.close();
+    }
+  }
+
+  lastLogFlashFlush = millis();
+  xSemaphoreGive(logFileMutex);
+  return true;
+}
+
+/**
+ * Reçoit chaque ligne écrite sur le port série (LogTask).
+ */
+void logFlashWrite(const LogRecord& record, const char* line, size_t len) {
+  if (record.level == LOG_NONE || record.level > logFlashLevel) return;
+
+  time_t now = time(NULL);
+  unsigned long epoch = now > 1600000000 ? now - (millis() - record.timestamp) / 1000 : 0;
+
+  char header[24];
+  int headerLen = snprintf(header, sizeof(header), "%lu %lu ", (unsigned long)(logFlashSeq + 1), epoch);
+
+  portENTER_CRITICAL(&logFlashMux);
+  bool fits = logFlashBufferLen + headerLen + len <= LOG_FLASH_BUFFER_SIZE;
+  if (fits) {
+    memcpy(logFlashBuffer + logFlashBufferLen, header, headerLen);
+    memcpy(logFlashBuffer + logFlashBufferLen + headerLen, line, len);
+    logFlashBufferLen += headerLen + len;
+    if (record.level == LOG_ERROR) logFlashUrgent = true;
+  }
+  portEXIT_CRITICAL(&logFlashMux);
+
+  if (fits) logFlashSeq++;
+  else logFlashLost++;
+}
+
+/**
+ * Écriture périodique (LogTask, toutes les 10 ms).
+ */
+void logFlashPoll() {
+  if (logFlashBufferLen == 0) return;
+
+  bool due = logFlashUrgent || logFlashBufferLen > LOG_FLASH_BUFFER_SIZE * 3 / 4 ||
+             millis() - lastLogFlashFlush >= LOG_FLASH_FLUSH_MS;
+  if (due) flushLogFlash(0);
+}
+
+/**
+ * Charge les niveaux et branche le journal sur LogTask.
+ */
+void initLogManager() {
+  loadLogConfig();
+
+  logFileMutex = xSemaphoreCreateMutex();
+  if (logFileMutex == NULL) {
+    LOG_E(LOG_SYSTEM, "Mutex du journal non cree - Journal flash desactive");
+    return;
+  }
+
+  if (!LittleFS.exists(LOG_FLASH_DIR)) LittleFS.mkdir(LOG_FLASH_DIR);
+
+  logFlashSeq = readLastLogSeq(LOG_FLASH_CURRENT);
+  if (logFlashSeq == 0) logFlashSeq = readLastLogSeq(LOG_FLASH_PREVIOUS);
+  lastLogFlashFlush = millis();
+
+  logSinkWrite = logFlashWrite;
+  logSinkPoll = logFlashPoll;
+
+  LOG_I(LOG_SYSTEM, "Journal flash actif (niveau %d, dernier numero %lu)",
+        logFlashLevel, (unsigned long)logFlashSeq);
+}
+
+// ============================================================================
+// MQTT
+// ============================================================================
+
+/**
+ * <topic>/log/<nom>/set : nom = catégorie, "all" ou "flash".
+ */
+void handleLogLevelCommand(const char* name, const char* payload) {
+  int level = parseLogLevel(payload);
+  if (level < 0 || !setLogLevel(name, level)) {
+    LOG_W(LOG_MQTT, "Commande de niveau de log invalide: %s = %s", name, payload);
+    return;
+  }
+  saveLogConfig();
+
+  char topic[MQTT_OUT_TOPIC_LEN];
+  char value[4];
+  snprintf(topic, sizeof(topic), "log/%s/state", name);
+  snprintf(value, sizeof(value), "%d", level > LOG_LEVEL_MAX ? LOG_LEVEL_MAX : level);
+  queueMqttPublish(topic, value, true);
+}
+
+// ============================================================================
+// HANDLERS HTTP
+// ============================================================================
+
+void sendLogLevels() {
+  StaticJsonDocument<768> doc;
+  doc["default"] = LOG_LEVEL;
+  doc["max"] = LOG_LEVEL_MAX;
+  doc["flash"] = logFlashLevel;
+  JsonObject levels = doc.createNestedObject("levels");
+  for (int i = 0; i < LOG_CATEGORY_COUNT; i++) {
+    levels[LOG_CATEGORY_NAMES[i]] = logCategoryLevels[i];
+  }
+  doc["dropped"] = logDropped.load();
+  doc["flashSeq"] = logFlashSeq;
+  doc["flashLost"] = logFlashLost;
+
+  String response;
+  serializeJson(doc, response);
+  server.send(200, "application/json", response);
+}
+
+/**
+ * GET /api/logs/levels
+ */
+void handleApiGetLogLevels() {
+  LOG_WEB_REQUEST("GET", "/api/logs/levels");
+  sendLogLevels();
+}
+
+/**
+ * POST /api/logs/levels   {"all": 3, "mqtt": "verbose", "flash": 2}
+ */
+void handleApiSetLogLevels() {
+  LOG_WEB_REQUEST("POST", "/api/logs/levels");
+
+  StaticJsonDocument<512> doc;
+  if (!server.hasArg("plain") || deserializeJson(doc, server.arg("plain"))) {
+    server.send(400, "text/plain", "Invalid JSON");
+    return;
+  }
+
+  // "all" d'abord : les catégories citées le précisent ensuite
+  JsonObject body = doc.as<JsonObject>();
+  if (body.containsKey("all") && !setLogLevel("all", parseLogLevelValue(body["all"]))) {
+    server.send(400, "text/plain", "Invalid level");
+    return;
+  }
+  for (JsonPair kv : body) {
+    if (strcmp(kv.key().c_str(), "all") == 0) continue;
+    if (!setLogLevel(kv.key().c_str(), parseLogLevelValue(kv.value()))) {
+      LOG_W(LOG_WEB, "Niveau de log invalide: %s", kv.key().c_str());
+      server.send(400, "text/plain", "Invalid category or level");
+      return;
+    }
+  }
+
+  saveLogConfig();
+  sendLogLevels();
+}
+
+/**
+ * Envoie les lignes d'un fichier du journal dont le numéro dépasse since.
+ */
+void streamLogFile(ChunkedResponse& response, const char* path, uint32_t since) {
+  File f = LittleFS.open(path, FILE_READ);
+  if (!f) return;
+
+  char line[LOG_FLASH_LINE_MAX];
+  while (f.available()) {
+    size_t n = f.readBytesUntil('\n', line, sizeof(line) - 1);
+    if (n == 0 || getLogLineSeq(line) <= since) continue;
+    line[n++] = '\n';
+    response.write((const uint8_t*)line, n);
+  }
+  f.close();
+}
+
+/**
+ * GET /api/logs?since=<numéro>   (texte, une ligne par message)
+ */
+void handleApiLogs() {
+  LOG_WEB_REQUEST("GET", "/api/logs");
+
+  uint32_t since = server.hasArg("since") ? strtoul(server.arg("since").c_str(), NULL, 10) : 0;
+
+  // Lignes en attente écrites d'abord, puis fichiers gardés pendant la lecture
+  if (!flushLogFlash(pdMS_TO_TICKS(2000))) {
+    server.send(503, "text/plain", "Log busy");
+    return;
+  }
+  if (xSemaphoreTake(logFileMutex, pdMS_TO_TICKS(2000)) != pdTRUE) {
+    server.send(503, "text/plain", "Log busy");
+    return;
+  }
+
+  ChunkedResponse response;
+  response.begin(200, "text/plain; charset=utf-8");
+  streamLogFile(response, LOG_FLASH_PREVIOUS, since);
+  streamLogFile(response, LOG_FLASH_CURRENT, since);
+  response.end();
+
+  xSemaphoreGive(logFileMutex);
+}
+
+#endif // LOG_MANAGER_H
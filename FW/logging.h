@@ -1,6 +1,17 @@
 /* 
  * POOL CONNECT - LOGGING
- * logging.h   V0.3
+ * logging.h   V0.5
+ *
+ * Les messages passent par la file de log_buffer.h : une macro LOG_*
+ * copie ses arguments sans les formater, la tâche LogTask les écrit
+ * sur le port série.
+ *
+ * Filtrage en deux temps :
+ * - LOG_LEVEL_MAX (config.h) : plafond à la compilation, les niveaux
+ *   au-dessus disparaissent du binaire
+ * - logCategoryLevels[] : niveau courant de chaque catégorie, lu avant
+ *   toute copie (une comparaison), modifiable à l'exécution
+ *   (log_manager.h : REST, MQTT, sauvegardé en flash)
  */
 
 #ifndef LOGGING_H
@@ -19,18 +30,49 @@ enum LogLevel {
 };
 
 // Catégories de log
-#define LOG_SYSTEM    "[SYSTEM]"
-#define LOG_NETWORK   "[NETWORK]"
-#define LOG_WEB       "[WEB]"
-#define LOG_SENSOR    "[SENSOR]"
-#define LOG_TIMER     "[TIMER]"
-#define LOG_MQTT      "[MQTT]"
-#define LOG_STORAGE   "[STORAGE]"
-#define LOG_WEATHER   "[WEATHER]"
-#define LOG_SCENARIO  "[SCENARIO]"
-#define LOG_BACKUP    "[BACKUP]"
-#define LOG_CHART     "[CHART]"
-#define LOG_OTA       "[OTA]"
+enum LogCategory {
+    LOG_SYSTEM = 0,
+    LOG_NETWORK,
+    LOG_WEB,
+    LOG_SENSOR,
+    LOG_TIMER,
+    LOG_MQTT,
+    LOG_STORAGE,
+    LOG_WEATHER,
+    LOG_SCENARIO,
+    LOG_BACKUP,
+    LOG_CHART,
+    LOG_OTA,
+    LOG_CATEGORY_COUNT
+};
+
+// Préfixe affiché
+const char* const LOG_CATEGORY_TAGS[LOG_CATEGORY_COUNT] = {
+    "[SYSTEM]", "[NETWORK]", "[WEB]", "[SENSOR]", "[TIMER]", "[MQTT]",
+    "[STORAGE]", "[WEATHER]", "[SCENARIO]", "[BACKUP]", "[CHART]", "[OTA]"
+};
+
+// Nom utilisé par l'API et les topics MQTT
+const char* const LOG_CATEGORY_NAMES[LOG_CATEGORY_COUNT] = {
+    "system", "network", "web", "sensor", "timer", "mqtt",
+    "storage", "weather", "scenario", "backup", "chart", "ota"
+};
+
+#define LOG_CATEGORY_MASK 0x7F
+
+// Niveau courant par catégorie (globals_impl.cpp)
+extern uint8_t logCategoryLevels[LOG_CATEGORY_COUNT];
+
+inline const char* getLogCategoryTag(uint8_t category) {
+    category &= LOG_CATEGORY_MASK;
+    return category < LOG_CATEGORY_COUNT ? LOG_CATEGORY_TAGS[category] : "";
+}
+
+#include "log_buffer.h"
+
+// Catégorie active à ce niveau ?
+#define LOG_ENABLED(category, level) \
+    (LOG_LEVEL_MAX >= (level) && logCategoryLevels[(category) & LOG_CATEGORY_MASK] >= (level))
 
 // Macros de logging conditionnelles
 #if ENABLE_LOGGING
@@ -38,102 +80,102 @@ enum LogLevel {
     #define LOG_INIT() Serial.begin(115200); delay(1000)
     
     #define LOG_E(category, format, ...) \
-        if(LOG_LEVEL >= LOG_ERROR) { \
-            Serial.printf("[ERROR]%s " format "\n", category, ##__VA_ARGS__); \
+        if(LOG_ENABLED(category, LOG_ERROR)) { \
+            logRecord(LOG_ERROR, "[ERROR]", category, format, ##__VA_ARGS__); \
         }
     
     #define LOG_W(category, format, ...) \
-        if(LOG_LEVEL >= LOG_WARNING) { \
-            Serial.printf("[WARN]%s " format "\n", category, ##__VA_ARGS__); \
+        if(LOG_ENABLED(category, LOG_WARNING)) { \
+            logRecord(LOG_WARNING, "[WARN]", category, format, ##__VA_ARGS__); \
         }
     
     #define LOG_I(category, format, ...) \
-        if(LOG_LEVEL >= LOG_INFO) { \
-            Serial.printf("[INFO]%s " format "\n", category, ##__VA_ARGS__); \
+        if(LOG_ENABLED(category, LOG_INFO)) { \
+            logRecord(LOG_INFO, "[INFO]", category, format, ##__VA_ARGS__); \
         }
     
     #define LOG_D(category, format, ...) \
-        if(LOG_LEVEL >= LOG_DEBUG) { \
-            Serial.printf("[DEBUG]%s " format "\n", category, ##__VA_ARGS__); \
+        if(LOG_ENABLED(category, LOG_DEBUG)) { \
+            logRecord(LOG_DEBUG, "[DEBUG]", category, format, ##__VA_ARGS__); \
         }
     
     #define LOG_V(category, format, ...) \
-        if(LOG_LEVEL >= LOG_VERBOSE) { \
-            Serial.printf("[VERBOSE]%s " format "\n", category, ##__VA_ARGS__); \
+        if(LOG_ENABLED(category, LOG_VERBOSE)) { \
+            logRecord(LOG_VERBOSE, "[VERBOSE]", category, format, ##__VA_ARGS__); \
         }
 
     // Logs spécifiques pour les échanges web <-> hardware
     #define LOG_WEB_REQUEST(method, endpoint) \
-        if(LOG_WEB_REQUESTS && LOG_LEVEL >= LOG_INFO) { \
-            Serial.printf("[WEB-REQ] %s %s\n", method, endpoint); \
+        if(LOG_WEB_REQUESTS && LOG_ENABLED(LOG_WEB, LOG_INFO)) { \
+            logRecord(LOG_INFO, "[WEB-REQ]", LOG_WEB | LOG_UNTAGGED, "%s %s", method, endpoint); \
         }
     
     #define LOG_WEB_RESPONSE(endpoint, status) \
-        if(LOG_WEB_REQUESTS && LOG_LEVEL >= LOG_INFO) { \
-            Serial.printf("[WEB-RES] %s - Status: %d\n", endpoint, status); \
+        if(LOG_WEB_REQUESTS && LOG_ENABLED(LOG_WEB, LOG_INFO)) { \
+            logRecord(LOG_INFO, "[WEB-RES]", LOG_WEB | LOG_UNTAGGED, "%s - Status: %d", endpoint, status); \
         }
     
     #define LOG_WEB_DATA(name, value) \
-        if(LOG_WEB_DATA_EXCHANGE && LOG_LEVEL >= LOG_DEBUG) { \
-            Serial.printf("[WEB-DATA] %s = %s\n", name, value); \
+        if(LOG_WEB_DATA_EXCHANGE && LOG_ENABLED(LOG_WEB, LOG_DEBUG)) { \
+            logRecord(LOG_DEBUG, "[WEB-DATA]", LOG_WEB | LOG_UNTAGGED, "%s = %s", name, value); \
         }
     
     #define LOG_WEB_JSON(json) \
-        if(LOG_WEB_DATA_EXCHANGE && LOG_LEVEL >= LOG_VERBOSE) { \
-            Serial.printf("[WEB-JSON] %s\n", json); \
+        if(LOG_WEB_DATA_EXCHANGE && LOG_ENABLED(LOG_WEB, LOG_VERBOSE)) { \
+            logRecord(LOG_VERBOSE, "[WEB-JSON]", LOG_WEB | LOG_UNTAGGED, "%s", json); \
         }
 
     // Logs pour les capteurs
     #define LOG_SENSOR_READ(sensor, value, unit) \
-        if(LOG_SENSOR_VALUES && LOG_LEVEL >= LOG_DEBUG) { \
-            Serial.printf("[SENSOR] %s = %.2f %s\n", sensor, value, unit); \
+        if(LOG_SENSOR_VALUES && LOG_ENABLED(LOG_SENSOR, LOG_DEBUG)) { \
+            logRecord(LOG_DEBUG, "[SENSOR]", LOG_SENSOR | LOG_UNTAGGED, "%s = %.2f %s", sensor, value, unit); \
         }
 
     // Logs pour les timers
     #define LOG_TIMER_EVENT(event, details) \
-        if(LOG_TIMER_EVENTS && LOG_LEVEL >= LOG_INFO) { \
-            Serial.printf("[TIMER] %s: %s\n", event, details); \
+        if(LOG_TIMER_EVENTS && LOG_ENABLED(LOG_TIMER, LOG_INFO)) { \
+            logRecord(LOG_INFO, "[TIMER]", LOG_TIMER | LOG_UNTAGGED, "%s: %s", event, details); \
         }
 
     // Logs pour MQTT
     #define LOG_MQTT_PUB(topic, payload) \
-        if(LOG_MQTT_MESSAGES && LOG_LEVEL >= LOG_DEBUG) { \
-            Serial.printf("[MQTT-PUB] Topic: %s | Payload: %s\n", topic, payload); \
+        if(LOG_MQTT_MESSAGES && LOG_ENABLED(LOG_MQTT, LOG_DEBUG)) { \
+            logRecord(LOG_DEBUG, "[MQTT-PUB]", LOG_MQTT | LOG_UNTAGGED, "Topic: %s | Payload: %s", topic, payload); \
         }
     
     #define LOG_MQTT_SUB(topic, payload) \
-        if(LOG_MQTT_MESSAGES && LOG_LEVEL >= LOG_DEBUG) { \
-            Serial.printf("[MQTT-SUB] Topic: %s | Payload: %s\n", topic, payload); \
+        if(LOG_MQTT_MESSAGES && LOG_ENABLED(LOG_MQTT, LOG_DEBUG)) { \
+            logRecord(LOG_DEBUG, "[MQTT-SUB]", LOG_MQTT | LOG_UNTAGGED, "Topic: %s | Payload: %s", topic, payload); \
         }
 
     // Logs pour le stockage
     #define LOG_STORAGE_OP(operation, key, success) \
-        if(LOG_STORAGE_OPS && LOG_LEVEL >= LOG_DEBUG) { \
-            Serial.printf("[STORAGE] %s '%s' - %s\n", operation, key, success ? "OK" : "FAILED"); \
+        if(LOG_STORAGE_OPS && LOG_ENABLED(LOG_STORAGE, LOG_DEBUG)) { \
+            logRecord(LOG_DEBUG, "[STORAGE]", LOG_STORAGE | LOG_UNTAGGED, "%s '%s' - %s", operation, key, success ? "OK" : "FAILED"); \
         }
 
     // Logs pour la mémoire
     #define LOG_MEMORY() \
-        if(LOG_MEMORY_INFO && LOG_LEVEL >= LOG_INFO) { \
-            Serial.printf("[MEMORY] Free Heap: %d bytes | Min Free: %d bytes\n", \
+        if(LOG_MEMORY_INFO && LOG_ENABLED(LOG_SYSTEM, LOG_INFO)) { \
+            logRecord(LOG_INFO, "[MEMORY]", LOG_SYSTEM | LOG_UNTAGGED, "Free Heap: %d bytes | Min Free: %d bytes", \
                 ESP.getFreeHeap(), ESP.getMinFreeHeap()); \
         }
 
     // Logs pour les opérations OTA
     #define LOG_OTA_OP(operation, details) \
-        if(LOG_OTA_OPERATIONS && LOG_LEVEL >= LOG_INFO) { \
-            Serial.printf("[OTA] %s: %s\n", operation, details); \
+        if(LOG_OTA_OPERATIONS && LOG_ENABLED(LOG_OTA, LOG_INFO)) { \
+            logRecord(LOG_INFO, "[OTA]", LOG_OTA | LOG_UNTAGGED, "%s: %s", operation, details); \
         }
     
     #define LOG_OTA_PROGRESS(percentage, current, total) \
-        if(LOG_OTA_OPERATIONS && LOG_LEVEL >= LOG_INFO) { \
-            Serial.printf("[OTA] Progress: %d%% (%d/%d bytes)\n", percentage, current, total); \
+        if(LOG_OTA_OPERATIONS && LOG_ENABLED(LOG_OTA, LOG_INFO)) { \
+            logRecord(LOG_INFO, "[OTA]", LOG_OTA | LOG_UNTAGGED, "Progress: %d%% (%d/%d bytes)", percentage, current, total); \
         }
 
     // Séparateur visuel
     #define LOG_SEPARATOR() \
-        if(LOG_LEVEL >= LOG_INFO) { \
-            Serial.println("================================================================================"); \
+        if(LOG_ENABLED(LOG_SYSTEM, LOG_INFO)) { \
+            logRecord(LOG_INFO, "", LOG_SYSTEM | LOG_UNTAGGED, "================================================================================"); \
         }
 
 #else
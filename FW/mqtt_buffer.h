@@ -0,0 +1,232 @@
+/*
+ * POOL CONNECT - MQTT BUFFER
+ * Stockage des mesures et événements pendant les coupures du broker
+ * mqtt_buffer.h   V0.2
+ *
+ * Client MQTT déconnecté :
+ * - les messages de la file mqttOutQueue (relais, métriques système...)
+ *   sont conservés au lieu d'être perdus
+ * - un relevé des capteurs est ajouté toutes les MQTT_BUFFER_TELEMETRY_MS
+ * Chaque enregistrement porte l'heure (epoch, 0 si NTP absent) et l'uptime.
+ *
+ * Après reconnexion (et la découverte HA), les enregistrements sont
+ * republiés dans l'ordre, un toutes les MQTT_REPLAY_INTERVAL_MS, après les
+ * publications en direct du même tour de la tâche réseau :
+ *
+ *   <topic>/replay/<sous-topic>  {"ts":1717171717,"uptime":5230,"v":"1"}
+ *   <topic>/replay/telemetry     {"ts":...,"uptime":...,"v":{"water_temp":27.50,...}}
+ *
+ * Messages non retenus : les topics d'état ne reçoivent jamais de valeurs
+ * anciennes. File circulaire en PSRAM (interne, plus petite, sinon) ;
+ * pleine, le plus ancien enregistrement est écrasé.
+ *
+ * Vérification avec un broker local : mosquitto_sub -v -t '<topic>/replay/#',
+ * arrêter mosquitto quelques minutes puis le relancer ; compteurs dans
+ * GET /api/mqtt/status ("buffer").
+ *
+ * Utilisé par la tâche réseau uniquement (pas de verrou).
+ */
+
+#ifndef MQTT_BUFFER_H
+#define MQTT_BUFFER_H
+
+#include <Arduino.h>
+#include <PubSubClient.h>
+#include "globals.h"
+#include "logging.h"
+#include "time_service.h"
+#include "task_bus.h"
+#include "mqtt_manager.h"
+
+// ============================================================================
+// CONSTANTES
+// ============================================================================
+
+#define MQTT_BUFFER_SLOTS_PSRAM 512
+#define MQTT_BUFFER_SLOTS_INTERNAL 48
+#define MQTT_BUFFER_PAYLOAD_LEN 128
+#define MQTT_BUFFER_TELEMETRY_MS 60000   // Un relevé par minute hors connexion
+#define MQTT_REPLAY_INTERVAL_MS 100      // 10 messages/s au plus
+
+// ============================================================================
+// STRUCTURES
+// ============================================================================
+
+struct MqttBufferedRecord {
+  uint32_t epoch;                          // 0 si l'heure n'était pas réglée
+  uint32_t uptime;                         // Secondes
+  bool json;                               // Payload déjà en JSON (relevé)
+  char topic[MQTT_OUT_TOPIC_LEN];          // Relatif à mqttTopic
+  char payload[MQTT_BUFFER_PAYLOAD_LEN];
+};
+
+struct MqttBufferStats {
+  uint32_t stored;
+  uint32_t replayed;
+  uint32_t overwritten;                    // Plus anciens écrasés (file pleine)
+};
+
+// ============================================================================
+// VARIABLES GLOBALES
+// ============================================================================
+
+MqttBufferedRecord* mqttBuffer = NULL;
+uint16_t mqttBufferCapacity = 0;
+uint16_t mqttBufferHead = 0;               // Plus ancien
+uint16_t mqttBufferCount = 0;
+MqttBufferStats mqttBufferStats = {};
+unsigned long lastMqttBufferTelemetry = 0;
+unsigned long lastMqttReplay = 0;
+bool mqttReplayRunning = false;
+
+// ============================================================================
+// INITIALISATION
+// ============================================================================
+
+bool initMqttBuffer() {
+  if (mqttBuffer != NULL) return true;
+
+  uint16_t slots = MQTT_BUFFER_SLOTS_PSRAM;
+  mqttBuffer = (MqttBufferedRecord*)heap_caps_malloc(slots * sizeof(MqttBufferedRecord),
+                                                     MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  if (mqttBuffer == NULL) {
+    slots = MQTT_BUFFER_SLOTS_INTERNAL;
+    mqttBuffer = (MqttBufferedRecord*)malloc(slots * sizeof(MqttBufferedRecord));
+  }
+  if (mqttBuffer == NULL) {
+    LOG_E(LOG_MQTT, "Memoire insuffisante - Pas de stockage MQTT hors connexion");
+    return false;
+  }
+
+  mqttBufferCapacity = slots;
+  LOG_I(LOG_MQTT, "Stockage hors connexion: %d messages (%u octets)",
+        slots, (unsigned)(slots * sizeof(MqttBufferedRecord)));
+  return true;
+}
+
+// ============================================================================
+// STOCKAGE
+// ============================================================================
+
+/**
+ * Ajoute un enregistrement (écrase le plus ancien si la file est pleine).
+ */
+void storeMqttRecord(const char* topic, const char* payload, bool json) {
+  if (mqttBuffer == NULL && !initMqttBuffer()) return;
+
+  if (mqttBufferCount == mqttBufferCapacity) {
+    mqttBufferHead = (mqttBufferHead + 1) % mqttBufferCapacity;
+    mqttBufferCount--;
+    mqttBufferStats.overwritten++;
+  }
+
+  MqttBufferedRecord& record = mqttBuffer[(mqttBufferHead + mqttBufferCount) % mqttBufferCapacity];
+  record.epoch = (uint32_t)getCachedEpoch();
+  record.uptime = millis() / 1000;
+  record.json = json;
+  strlcpy(record.topic, topic, sizeof(record.topic));
+  strlcpy(record.payload, payload, sizeof(record.payload));
+
+  mqttBufferCount++;
+  mqttBufferStats.stored++;
+}
+
+/**
+ * Message de la file sortante reçu pendant une coupure.
+ */
+void bufferMqttOutMessage(const MqttOutMessage& msg) {
+  storeMqttRecord(msg.topic, msg.payload, false);
+}
+
+void appendTelemetryFloat(char* buf, size_t size, size_t& len, const char* name, float value) {
+  if (len >= size) return;
+  int n = isnan(value) ? snprintf(buf + len, size - len, "%s\"%s\":null", len > 1 ? "," : "", name)
+                       : snprintf(buf + len, size - len, "%s\"%s\":%.2f", len > 1 ? "," : "", name, value);
+  if (n > 0) len += n;
+}
+
+/**
+ * Relevé des capteurs, appelé à chaque nouvelle mesure quand le client est
+ * déconnecté (un sur MQTT_BUFFER_TELEMETRY_MS gardé).
+ */
+void bufferTelemetrySnapshot() {
+  unsigned long now = millis();
+  if (lastMqttBufferTelemetry != 0 && now - lastMqttBufferTelemetry < MQTT_BUFFER_TELEMETRY_MS) return;
+
+  float temp, pressure, ext;
+  bool leak, cover;
+  if (!xSemaphoreTake(dataMutex, pdMS_TO_TICKS(100))) return;
+  temp = waterTemp;
+  pressure = waterPressure;
+  ext = tempExterieure;
+  leak = waterLeak;
+  cover = coverOpen;
+  xSemaphoreGive(dataMutex);
+
+  uint8_t relays = getRelayMask();
+
+  char payload[MQTT_BUFFER_PAYLOAD_LEN];
+  size_t len = 1;
+  payload[0] = '{';
+  appendTelemetryFloat(payload, sizeof(payload), len, "water_temp", temp);
+  appendTelemetryFloat(payload, sizeof(payload), len, "water_pressure", pressure);
+  appendTelemetryFloat(payload, sizeof(payload), len, "ext_temp", ext);
+  if (len < sizeof(payload)) {
+    snprintf(payload + len, sizeof(payload) - len, ",\"water_leak\":%s,\"cover\":%s,\"relays\":%d}",
+             leak ? "true" : "false", cover ? "true" : "false", relays);
+  }
+
+  storeMqttRecord("telemetry", payload, true);
+  lastMqttBufferTelemetry = now;
+}
+
+// ============================================================================
+// REPUBLICATION
+// ============================================================================
+
+/**
+ * Republie au plus un enregistrement (client connecté, rythme limité).
+ * Appelé après les publications en direct du tour de la tâche réseau.
+ */
+void processMqttReplay() {
+  if (mqttBufferCount == 0) return;
+
+  unsigned long now = millis();
+  if (now - lastMqttReplay < MQTT_REPLAY_INTERVAL_MS) return;
+  lastMqttReplay = now;
+
+  if (!mqttReplayRunning) {
+    LOG_I(LOG_MQTT, "Republication de %d messages stockes hors connexion", mqttBufferCount);
+    mqttReplayRunning = true;
+    lastMqttBufferTelemetry = 0;   // Prochaine coupure : relevé immédiat
+  }
+
+  const MqttBufferedRecord& record = mqttBuffer[mqttBufferHead];
+
+  char topic[MQTT_TOPIC_MAX];
+  snprintf(topic, sizeof(topic), "%s/replay/%s", mqttTopics.base, record.topic);
+
+  char payload[MQTT_BUFFER_PAYLOAD_LEN + 64];
+  snprintf(payload, sizeof(payload), record.json ? "{\"ts\":%lu,\"uptime\":%lu,\"v\":%s}"
+                                                 : "{\"ts\":%lu,\"uptime\":%lu,\"v\":\"%s\"}",
+           (unsigned long)record.epoch, (unsigned long)record.uptime, record.payload);
+
+  // Échec : conservé, nouvel essai au prochain intervalle
+  if (!mqttClient.publish(topic, payload, false)) {
+    LOG_W(LOG_MQTT, "Echec republication %s - Nouvel essai", topic);
+    return;
+  }
+  LOG_MQTT_PUB(topic, payload);
+
+  mqttBufferHead = (mqttBufferHead + 1) % mqttBufferCapacity;
+  mqttBufferCount--;
+  mqttBufferStats.replayed++;
+
+  if (mqttBufferCount == 0) {
+    mqttReplayRunning = false;
+    LOG_I(LOG_MQTT, "Republication terminee (total: %lu republies, %lu ecrases)",
+          (unsigned long)mqttBufferStats.replayed, (unsigned long)mqttBufferStats.overwritten);
+  }
+}
+
+#endif // MQTT_BUFFER_H
@@ -0,0 +1,409 @@
+/*
+ * POOL CONNECT - MQTT COMMANDS
+ * Commandes MQTT (relais, scènes, timers, scénarios), état des timers et
+ * compteurs énergie
+ * mqtt_commands.h   V0.5
+ *
+ * Commandes (payload texte ou JSON) :
+ *   <topic>/relay/<n>/set       "1" / "0"
+ *   <topic>/relay/set           {"relay":1,"state":1}
+ *   <topic>/scene/set           {"0":1,"1":1,"2":0}   relais absents inchangés
+ *   <topic>/timer/<id>/set      "1" / "0" (ON/OFF accepté) : activer/désactiver
+ *   <topic>/scenario/set        index du scénario (0-5)
+ *   <topic>/log/<cat>/set       niveau de log
+ *
+ * Une scène est appliquée en entier ou refusée en entier : état final
+ * contraire à une règle de sécurité (relay_service.h), ou relais qui
+ * changerait avant la fin de sa durée minimale de marche ou d'arrêt. Le
+ * service relais reste verrouillé pendant toute la scène (aucune autre
+ * commande entre la vérification et les commutations). Les relais sont
+ * éteints avant d'être allumés (électrolyseur coupé avant la pompe, pompe
+ * allumée avant l'électrolyseur).
+ *
+ * État des timers (retenu, publié sur changement et à chaque connexion) :
+ *   <topic>/timer/<id>/state      idle|waiting|running|paused|completed|error
+ *   <topic>/timer/<id>/enabled    1 / 0
+ *   <topic>/timer/<id>/action     "2/5" (action en cours / total)
+ *   <topic>/timer/<id>/remaining  minutes restantes de l'attente en cours
+ *
+ * Compteurs énergie (retenus, publiés sur changement et à chaque connexion) :
+ *   <topic>/energy/<n>/runtime_today  minutes de marche du jour
+ *   <topic>/energy/<n>/kwh_today      énergie estimée du jour (0.01 kWh)
+ *   <topic>/energy/<n>/kwh_total      énergie estimée totale
+ *   <topic>/energy/tariff             peak|offpeak
+ *
+ * Exécuté par la tâche réseau (callback de mqttClient.loop()).
+ */
+
+#ifndef MQTT_COMMANDS_H
+#define MQTT_COMMANDS_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "globals.h"
+#include "logging.h"
+#include "storage.h"
+#include "scenarios.h"
+#include "timer_processor.h"
+#include "task_bus.h"
+#include "relay_service.h"
+#include "mqtt_manager.h"
+
+// ============================================================================
+// STRUCTURES
+// ============================================================================
+
+// Dernier état publié d'un timer (même ordre que flexTimers)
+struct MqttTimerSnapshot {
+  int id;                    // 0 : emplacement libre
+  TimerState state;
+  bool enabled;
+  int8_t action;             // -1 si le timer ne tourne pas
+  int16_t remaining;         // Minutes
+};
+
+// ============================================================================
+// VARIABLES GLOBALES
+// ============================================================================
+
+MqttTimerSnapshot mqttTimerPublished[MAX_TIMERS];
+uint32_t mqttTimerConnectSeen = 0;
+volatile bool mqttTimerStatesDirty = false;
+
+// Derniers compteurs publiés (minutes, centièmes de kWh)
+struct MqttEnergySnapshot {
+  int32_t runtimeToday;
+  int32_t kwhToday;
+  int32_t kwhTotal;
+};
+
+MqttEnergySnapshot mqttEnergyPublished[NUM_RELAYS];
+int8_t mqttTariffPublished = -1;
+uint32_t mqttEnergyConnectSeen = 0;
+
+// ============================================================================
+// SCÈNES
+// ============================================================================
+
+/**
+ * <topic>/scene/set  {"<relais>":0|1, ...}
+ */
+void handleMqttSceneCommand(const char* arg, const char* payload) {
+  StaticJsonDocument<256> doc;
+  if (deserializeJson(doc, payload) || !doc.is<JsonObject>()) {
+    LOG_E(LOG_MQTT, "Scene: JSON invalide");
+    return;
+  }
+
+  // Relais demandés (bit i) et leur état
+  uint8_t requested = 0;
+  uint8_t requestedOn = 0;
+
+  for (JsonPair kv : doc.as<JsonObject>()) {
+    const char* key = kv.key().c_str();
+    if (key[0] < '0' || key[0] > '9' || key[1] != '\0' || key[0] - '0' >= NUM_RELAYS) {
+      LOG_E(LOG_MQTT, "Scene refusee: relais invalide '%s'", key);
+      return;
+    }
+    int relay = key[0] - '0';
+    requested |= (1 << relay);
+    if ((kv.value().as<int>() != 0) || kv.value().as<bool>()) requestedOn |= (1 << relay);
+  }
+
+  // Mutex récursif : setRelay() le reprend pour chaque relais
+  if (relayMutex == NULL || !xSemaphoreTakeRecursive(relayMutex, pdMS_TO_TICKS(RELAY_MUTEX_TIMEOUT_MS))) {
+    LOG_W(LOG_MQTT, "Scene refusee: service relais occupe");
+    return;
+  }
+
+  uint8_t current = getRelayMask();
+  uint8_t target = (current & ~requested) | requestedOn;
+
+  // Règles de sécurité sur l'état final, puis durées minimales des relais
+  // qui changent : rien n'est commuté si un seul relais serait refusé
+  int refusedRelay = -1;
+  RelayRuleResult check = evaluateRelayMask(relayRules, target);
+  if (check.verdict == RULE_OK) {
+    uint32_t sinceChange[NUM_RELAYS];
+    unsigned long now = millis();
+    for (int i = 0; i < NUM_RELAYS; i++) sinceChange[i] = now - getRelayInfo(i).changedAt;
+    check = evaluateRelayTransition(relayRules, current, target, sinceChange, &refusedRelay);
+  }
+
+  if (check.verdict != RULE_OK) {
+    xSemaphoreGiveRecursive(relayMutex);
+    char reason[64];
+    formatRelayRefusal(check, reason, sizeof(reason));
+    if (refusedRelay >= 0) {
+      LOG_W(LOG_MQTT, "PROTECTION: Scene refusee - %s: %s", getRelayName(refusedRelay), reason);
+    } else {
+      LOG_W(LOG_MQTT, "PROTECTION: Scene refusee - %s", reason);
+    }
+    return;
+  }
+
+  // Extinctions d'abord (dépendants avant la pompe), puis allumages (pompe d'abord)
+  int changed = 0;
+  for (int i = NUM_RELAYS - 1; i >= 0; i--) {
+    bool on = target & (1 << i);
+    if ((current & (1 << i)) && !on && setRelay(i, false, RELAY_SOURCE_MQTT)) changed++;
+  }
+  for (int i = 0; i < NUM_RELAYS; i++) {
+    bool on = target & (1 << i);
+    if (!(current & (1 << i)) && on && setRelay(i, true, RELAY_SOURCE_MQTT)) changed++;
+  }
+  xSemaphoreGiveRecursive(relayMutex);
+
+  LOG_I(LOG_MQTT, "Scene appliquee via MQTT: %d relais modifies", changed);
+}
+
+// ============================================================================
+// TIMERS ET SCÉNARIOS
+// ============================================================================
+
+/**
+ * <topic>/timer/<id>/set  "1" / "0"
+ */
+void handleMqttTimerCommand(const char* arg, const char* payload) {
+  int id = arg != NULL ? atoi(arg) : 0;
+  FlexibleTimer* timer = id != 0 ? findFlexTimer(id) : nullptr;
+  if (timer == nullptr) {
+    LOG_W(LOG_MQTT, "Timer MQTT inconnu: %s", arg != NULL ? arg : "(aucun)");
+    return;
+  }
+
+  bool enabled;
+  if (strcmp(payload, "1") == 0 || strcasecmp(payload, "ON") == 0 || strcasecmp(payload, "true") == 0) {
+    enabled = true;
+  } else if (strcmp(payload, "0") == 0 || strcasecmp(payload, "OFF") == 0 || strcasecmp(payload, "false") == 0) {
+    enabled = false;
+  } else {
+    LOG_E(LOG_MQTT, "Timer %d: commande invalide '%s'", id, payload);
+    return;
+  }
+
+  if (timer->enabled == enabled) {
+    mqttTimerStatesDirty = true;   // Republier l'état réel
+    return;
+  }
+
+  LOG_I(LOG_MQTT, "Timer '%s' (ID %d) %s via MQTT",
+        timer->name.c_str(), id, enabled ? "active" : "desactive");
+
+  // Comme /api/timers/flex/{id}/toggle : désactiver arrête ses relais
+  if (!enabled && timer->context.state == TIMER_RUNNING) {
+    stopFlexTimer(timer);
+  }
+
+  timer->enabled = enabled;
+  saveFlexTimer(*timer);
+  mqttTimerStatesDirty = true;
+}
+
+/**
+ * <topic>/scenario/set  index du scénario
+ */
+void handleMqttScenarioCommand(const char* arg, const char* payload) {
+  char* end;
+  long scenarioId = strtol(payload, &end, 10);
+  if (end == payload || *end != '\0' || scenarioId < 0 || scenarioId >= SCENARIO_COUNT) {
+    LOG_E(LOG_MQTT, "ID scenario invalide: %s (max=%d)", payload, SCENARIO_COUNT - 1);
+    return;
+  }
+
+  LOG_I(LOG_MQTT, "Application scenario %ld via MQTT", scenarioId);
+  if (addScenarioTimer(scenarioId) != nullptr) {
+    mqttTimerStatesDirty = true;
+  }
+}
+
+/**
+ * Enregistre toutes les commandes MQTT (avant la première connexion).
+ */
+void initMqttCommands() {
+  if (mqttCommandRouteCount > 0) return;
+
+  registerMqttCommand("relay", handleMqttRelayCommand);
+  registerMqttCommand("scene", handleMqttSceneCommand);
+  registerMqttCommand("timer", handleMqttTimerCommand);
+  registerMqttCommand("scenario", handleMqttScenarioCommand);
+  registerMqttCommand("log", handleMqttLogCommand);
+
+  LOG_D(LOG_MQTT, "%d groupes de commandes MQTT enregistres", mqttCommandRouteCount);
+}
+
+// ============================================================================
+// ÉTAT DES TIMERS
+// ============================================================================
+
+const char* getTimerStateName(TimerState state) {
+  switch (state) {
+    case TIMER_IDLE:          return "idle";
+    case TIMER_WAITING_START: return "waiting";
+    case TIMER_RUNNING:       return "running";
+    case TIMER_PAUSED:        return "paused";
+    case TIMER_COMPLETED:     return "completed";
+    case TIMER_ERROR:         return "error";
+  }
+  return "idle";
+}
+
+/**
+ * Minutes restantes de l'attente en cours (durée fixe ou calculée), 0 sinon.
+ */
+int getTimerRemainingMinutes(const FlexibleTimer& timer) {
+  if (timer.context.state != TIMER_RUNNING) return 0;
+
+  int index = timer.context.currentActionIndex;
+  if (index < 0 || index >= timer.actionCount) return 0;
+
+  const Action& action = timer.actions[index];
+  int duration;
+  if (action.type == ACTION_WAIT_DURATION) {
+    duration = action.delayMinutes;
+  } else if (action.type == ACTION_AUTO_DURATION) {
+    duration = (int)(timer.context.calculatedDurationHours * 60);
+  } else {
+    return 0;
+  }
+
+  int remaining = duration - (int)((millis() - timer.context.actionStartMillis) / 60000);
+  return remaining > 0 ? remaining : 0;
+}
+
+void publishTimerValue(int id, const char* field, const char* value) {
+  char suffix[32];
+  snprintf(suffix, sizeof(suffix), "timer/%d/%s", id, field);
+  publishMqttValue(suffix, value);
+}
+
+/**
+ * Publie l'état des timers qui a changé (tout après une connexion).
+ * Appelé par la tâche réseau à chaque nouvelle mesure et après une commande.
+ */
+void publishTimerStates() {
+  if (!mqttClient.connected()) return;
+
+  bool full = mqttTimerConnectSeen != mqttConnectCount;
+  mqttTimerConnectSeen = mqttConnectCount;
+  mqttTimerStatesDirty = false;
+
+  int count = flexTimerCount;
+  int published = 0;
+  char value[16];
+
+  // Timers supprimés : topics retenus effacés
+  for (int i = 0; i < MAX_TIMERS; i++) {
+    int oldId = mqttTimerPublished[i].id;
+    if (oldId == 0 || findFlexTimer(oldId) != nullptr) continue;
+
+    publishTimerValue(oldId, "state", "");
+    publishTimerValue(oldId, "enabled", "");
+    publishTimerValue(oldId, "action", "");
+    publishTimerValue(oldId, "remaining", "");
+    mqttTimerPublished[i].id = 0;
+  }
+
+  for (int i = 0; i < count; i++) {
+    const FlexibleTimer& timer = flexTimers[i];
+    MqttTimerSnapshot current;
+    current.id = timer.id;
+    current.state = timer.context.state;
+    current.enabled = timer.enabled;
+    current.action = timer.context.state == TIMER_RUNNING ? timer.context.currentActionIndex : -1;
+    current.remaining = getTimerRemainingMinutes(timer);
+
+    MqttTimerSnapshot& last = mqttTimerPublished[i];
+    bool all = full || last.id != current.id;
+
+    if (all || last.state != current.state) {
+      publishTimerValue(current.id, "state", getTimerStateName(current.state));
+      published++;
+    }
+    if (all || last.enabled != current.enabled) {
+      publishTimerValue(current.id, "enabled", current.enabled ? "1" : "0");
+      published++;
+    }
+    if (all || last.action != current.action) {
+      snprintf(value, sizeof(value), "%d/%d", current.action + 1, timer.actionCount);
+      publishTimerValue(current.id, "action", value);
+      published++;
+    }
+    if (all || last.remaining != current.remaining) {
+      snprintf(value, sizeof(value), "%d", current.remaining);
+      publishTimerValue(current.id, "remaining", value);
+      published++;
+    }
+
+    last = current;
+  }
+
+  for (int i = count; i < MAX_TIMERS; i++) mqttTimerPublished[i].id = 0;
+
+  if (published > 0) {
+    LOG_D(LOG_MQTT, "Etat des timers: %d valeurs publiees", published);
+  }
+}
+
+// ============================================================================
+// COMPTEURS ÉNERGIE
+// ============================================================================
+
+void publishEnergyValue(int relay, const char* field, int32_t value, bool hundredths) {
+  char suffix[32];
+  char payload[16];
+  snprintf(suffix, sizeof(suffix), "energy/%d/%s", relay, field);
+  if (hundredths) snprintf(payload, sizeof(payload), "%ld.%02ld", (long)(value / 100), (long)(value % 100));
+  else snprintf(payload, sizeof(payload), "%ld", (long)value);
+  publishMqttValue(suffix, payload);
+}
+
+/**
+ * Publie les compteurs qui ont changé (tout après une connexion).
+ * Appelé par la tâche réseau à chaque nouvelle mesure.
+ */
+void publishEnergyStates() {
+  if (!mqttClient.connected()) return;
+
+  bool full = mqttEnergyConnectSeen != mqttConnectCount;
+  mqttEnergyConnectSeen = mqttConnectCount;
+  int published = 0;
+
+  for (int i = 0; i < NUM_RELAYS; i++) {
+    RelayRuntimeCounters c;
+    getRelayRuntime(i, &c);
+
+    MqttEnergySnapshot current;
+    current.runtimeToday = c.daySec / 60;
+    current.kwhToday = (int32_t)(runtimeToKwh(i, c.daySec) * 100 + 0.5f);
+    current.kwhTotal = (int32_t)(runtimeToKwh(i, c.lifetimeSec) * 100 + 0.5f);
+
+    MqttEnergySnapshot& last = mqttEnergyPublished[i];
+    if (full || last.runtimeToday != current.runtimeToday) {
+      publishEnergyValue(i, "runtime_today", current.runtimeToday, false);
+      published++;
+    }
+    if (full || last.kwhToday != current.kwhToday) {
+      publishEnergyValue(i, "kwh_today", current.kwhToday, true);
+      published++;
+    }
+    if (full || last.kwhTotal != current.kwhTotal) {
+      publishEnergyValue(i, "kwh_total", current.kwhTotal, true);
+      published++;
+    }
+    last = current;
+  }
+
+  int8_t tariff = isOffPeakNow() ? 1 : 0;
+  if (full || tariff != mqttTariffPublished) {
+    publishMqttValue("energy/tariff", tariff ? "offpeak" : "peak");
+    mqttTariffPublished = tariff;
+    published++;
+  }
+
+  if (published > 0) {
+    LOG_D(LOG_MQTT, "Compteurs energie: %d valeurs publiees", published);
+  }
+}
+
+#endif // MQTT_COMMANDS_H
@@ -1,7 +1,13 @@
 /* 
  * POOL CONNECT - MQTT MANAGER
  * Gestion MQTT et Home Assistant
- * mqtt_manager.h   V0.2
+ * mqtt_manager.h   V0.9
+ *
+ * Les mesures sont publiées sur changement (bandes mortes de
+ * mqttPublishConfig), avec une republication complète périodique.
+ *
+ * Découverte Home Assistant : messages construits une seule fois (PSRAM si
+ * disponible) puis publiés un par un par la tâche réseau, sans delay().
  */
 
 #ifndef MQTT_MANAGER_H
@@ -12,13 +18,37 @@
 #include <ArduinoJson.h>
 #include <LittleFS.h>
 #include "globals.h"
+#include "time_service.h"
 #include "config.h"
 #include "logging.h"
+#include "log_manager.h"
+#include "task_bus.h"
+#include "relay_service.h"
+
+// ============================================================================
+// CONSTANTES
+// ============================================================================
+
+#define MQTT_BASE_TOPIC_LEN 48
+#define MQTT_TOPIC_MAX 96                // Topic complet
+#define MQTT_MAX_COMMAND_ROUTES 8
+#define MQTT_MAX_SUBSCRIPTIONS (MQTT_MAX_COMMAND_ROUTES * 2)
+#define MQTT_COMMAND_PAYLOAD_MAX 256
+#define HA_DISCOVERY_INTERVAL_MS 50      // Entre deux messages de découverte
+#define HA_STATE_DELAY_MS 500            // Découverte -> états (traitement par HA)
 
 // ============================================================================
 // MQTT CONFIG
 // ============================================================================
 
+/**
+ * Topic de base accepté : doit tenir dans mqttTopics.base (un topic tronqué
+ * ne correspondrait plus à mqttTopic, table recalculée à chaque tentative).
+ */
+bool isValidMqttBaseTopic(const String& topic) {
+  return topic.length() < MQTT_BASE_TOPIC_LEN;
+}
+
 void saveMQTTConfig() {
   LOG_D(LOG_MQTT, "Sauvegarde de la configuration MQTT...");
   
@@ -35,6 +65,10 @@ void saveMQTTConfig() {
   doc["user"] = mqttUser;
   doc["password"] = mqttPassword;
   doc["topic"] = mqttTopic;
+  doc["tempDeadband"] = mqttPublishConfig.tempDeadband;
+  doc["pressureDeadband"] = mqttPublishConfig.pressureDeadband;
+  doc["heartbeat"] = mqttPublishConfig.heartbeatSec;
+  doc["stateJson"] = mqttPublishConfig.stateJson;
   
   size_t bytesWritten = serializeJson(doc, f);
   f.close();
@@ -73,11 +107,23 @@ void loadMQTTConfig() {
   mqttPort = doc["port"] | 1883;
   mqttUser = doc["user"].as<String>();
   mqttPassword = doc["password"].as<String>();
-  mqttTopic = doc["topic"].as<String>();
+  String topic = doc["topic"].as<String>();
+  if (isValidMqttBaseTopic(topic)) {
+    mqttTopic = topic;
+  } else {
+    LOG_E(LOG_MQTT, "Topic de base trop long (%d caracteres) - %s conserve", topic.length(), mqttTopic.c_str());
+  }
+  mqttPublishConfig.tempDeadband = doc["tempDeadband"] | 0.1f;
+  mqttPublishConfig.pressureDeadband = doc["pressureDeadband"] | 0.02f;
+  mqttPublishConfig.heartbeatSec = constrain(doc["heartbeat"] | 300, 10, 3600);
+  mqttPublishConfig.stateJson = doc["stateJson"] | false;
   
   LOG_I(LOG_MQTT, "Configuration MQTT chargee avec succes");
   LOG_I(LOG_MQTT, "Serveur: %s:%d", mqttServer.c_str(), mqttPort);
   LOG_I(LOG_MQTT, "Topic de base: %s", mqttTopic.c_str());
+  LOG_D(LOG_MQTT, "Bandes mortes: %.2f C, %.3f bar - Republication: %d s - JSON: %s",
+        mqttPublishConfig.tempDeadband, mqttPublishConfig.pressureDeadband,
+        mqttPublishConfig.heartbeatSec, mqttPublishConfig.stateJson ? "oui" : "non");
   LOG_V(LOG_MQTT, "Username: %s", mqttUser.length() > 0 ? mqttUser.c_str() : "Non configure");
   LOG_STORAGE_OP("READ", "/mqtt.json", true);
 }
@@ -89,282 +135,551 @@ void initMQTTClient() {
 }
 
 // ============================================================================
-// MQTT HOME ASSISTANT DISCOVERY - VERSION CORRIGÉE
+// MQTT TOPICS
 // ============================================================================
 
-void publishHASwitch(String id, String name, int relayIndex, String deviceConfig) {
-  String topic = "homeassistant/switch/" + id + "/config";
-  
-  LOG_D(LOG_MQTT, "Publication HA Switch Discovery: %s", name.c_str());
-  LOG_V(LOG_MQTT, "Topic: %s", topic.c_str());
-  
-  DynamicJsonDocument doc(2048);
-  doc["name"] = name;
-  doc["unique_id"] = "pool_" + id;
-  doc["command_topic"] = mqttTopic + "/relay/" + String(relayIndex) + "/set";
-  doc["state_topic"] = mqttTopic + "/relay/" + String(relayIndex) + "/state";
-  doc["payload_on"] = "1";
-  doc["payload_off"] = "0";
-  doc["optimistic"] = false;
-  doc["retain"] = true;
-  
-  DynamicJsonDocument deviceDoc(512);
-  deserializeJson(deviceDoc, deviceConfig);
-  doc["device"] = deviceDoc.as<JsonObject>();
-  
-  String payload;
-  serializeJson(doc, payload);
-  
-  LOG_V(LOG_MQTT, "Payload size: %d bytes", payload.length());
-  
-  bool published = mqttClient.publish(topic.c_str(), payload.c_str(), true);
+/*
+ * Topics de commande : <base>/<groupe>/set ou <base>/<groupe>/<argument>/set
+ * Le groupe est cherché dans mqttCommandRoutes (quelques entrées), le
+ * reste du topic est découpé en place : coût constant par message, sans
+ * String ni allocation.
+ */
+
+typedef void (*MqttCommandHandler)(const char* arg, const char* payload);
+
+struct MqttCommandRoute {
+  const char* group;
+  MqttCommandHandler handler;
+};
+
+// Topics calculés une fois, à chaque changement de mqttTopic
+struct MqttTopicTable {
+  char base[MQTT_BASE_TOPIC_LEN];
+  size_t baseLen;
+  char subscriptions[MQTT_MAX_SUBSCRIPTIONS][MQTT_TOPIC_MAX];
+  int subscriptionCount;
+};
+
+MqttTopicTable mqttTopics = {};
+uint32_t mqttConnectCount = 0;           // Nouvelle connexion : états complets à republier
+
+/**
+ * <topic>/relay/set  {"relay":1,"state":1}  (ancien format)
+ * <topic>/relay/<n>/set  "1" / "0"  (Home Assistant)
+ */
+void handleMqttRelayCommand(const char* arg, const char* payload) {
+  int relay;
+  bool state;
   
-  if (published) {
-    LOG_I(LOG_MQTT, "HA Switch '%s' publie avec succes", name.c_str());
-    LOG_MQTT_PUB(topic.c_str(), "[HA Discovery]");
+  if (arg == NULL) {
+    LOG_D(LOG_MQTT, "Reception commande relay globale");
+    StaticJsonDocument<128> doc;
+    if (deserializeJson(doc, payload)) {
+      LOG_E(LOG_MQTT, "Erreur parsing JSON de la commande relay");
+      return;
+    }
+    relay = doc["relay"] | -1;
+    // true/false ou 0/1
+    state = doc["state"].is<bool>() ? doc["state"].as<bool>() : doc["state"].as<int>() != 0;
   } else {
-    LOG_E(LOG_MQTT, "Echec publication HA Switch '%s'", name.c_str());
+    if (arg[0] < '0' || arg[0] > '9' || arg[1] != '\0') {
+      LOG_E(LOG_MQTT, "Index relay invalide: %s", arg);
+      return;
+    }
+    relay = arg[0] - '0';
+    state = strcmp(payload, "1") == 0;
   }
   
-  delay(100);
+  if (relay < 0 || relay >= NUM_RELAYS) {
+    LOG_E(LOG_MQTT, "Index relay invalide: %d", relay);
+    return;
+  }
+  
+  // Refus (protection) : état réel republié pour Home Assistant
+  if (!setRelay(relay, state, RELAY_SOURCE_MQTT)) {
+    queueRelayStatePublish(relay, isRelayOn(relay), true);
+    return;
+  }
+  LOG_I(LOG_MQTT, "Relais %d commande via MQTT: %s", relay, state ? "ON" : "OFF");
 }
 
-void publishHASensor(String id, String name, String deviceClass, String unit, String icon, String deviceConfig) {
-  String topic = "homeassistant/sensor/" + id + "/config";
-  
-  LOG_D(LOG_MQTT, "Publication HA Sensor Discovery: %s", name.c_str());
-  LOG_V(LOG_MQTT, "Topic: %s", topic.c_str());
-  
-  DynamicJsonDocument doc(2048);
-  doc["name"] = name;
-  doc["unique_id"] = "pool_" + id;
-  doc["state_topic"] = mqttTopic + "/sensor/" + id;
-  doc["device_class"] = deviceClass;
-  doc["unit_of_measurement"] = unit;
-  doc["icon"] = icon;
-  
-  DynamicJsonDocument deviceDoc(512);
-  deserializeJson(deviceDoc, deviceConfig);
-  doc["device"] = deviceDoc.as<JsonObject>();
-  
-  String payload;
-  serializeJson(doc, payload);
-  
-  LOG_V(LOG_MQTT, "Device class: %s, Unit: %s", deviceClass.c_str(), unit.c_str());
+/**
+ * <topic>/log/<categorie|all|flash>/set  "debug" ou 0-5
+ */
+void handleMqttLogCommand(const char* arg, const char* payload) {
+  if (arg == NULL) {
+    LOG_W(LOG_MQTT, "Commande de niveau de log sans categorie");
+    return;
+  }
+  handleLogLevelCommand(arg, payload);
+}
+
+MqttCommandRoute mqttCommandRoutes[MQTT_MAX_COMMAND_ROUTES];
+int mqttCommandRouteCount = 0;
+
+/**
+ * Ajoute un groupe de commandes (avant la première connexion de préférence).
+ */
+bool registerMqttCommand(const char* group, MqttCommandHandler handler) {
+  if (mqttCommandRouteCount >= MQTT_MAX_COMMAND_ROUTES) {
+    LOG_W(LOG_MQTT, "Table des commandes MQTT pleine - %s ignore", group);
+    return false;
+  }
   
-  bool published = mqttClient.publish(topic.c_str(), payload.c_str(), true);
+  mqttCommandRoutes[mqttCommandRouteCount].group = group;
+  mqttCommandRoutes[mqttCommandRouteCount].handler = handler;
+  mqttCommandRouteCount++;
+  mqttTopics.base[0] = '\0';   // Souscriptions recalculées à la prochaine connexion
+  return true;
+}
+
+/**
+ * Recalcule les topics après un changement de mqttTopic.
+ */
+void buildMqttTopicTable() {
+  strlcpy(mqttTopics.base, mqttTopic.c_str(), sizeof(mqttTopics.base));
+  mqttTopics.baseLen = strlen(mqttTopics.base);
+  if (mqttTopic.length() >= sizeof(mqttTopics.base)) {
+    LOG_W(LOG_MQTT, "Topic de base tronque a %d caracteres", (int)sizeof(mqttTopics.base) - 1);
+  }
   
-  if (published) {
-    LOG_I(LOG_MQTT, "HA Sensor '%s' publie avec succes", name.c_str());
-    LOG_MQTT_PUB(topic.c_str(), "[HA Discovery]");
-  } else {
-    LOG_E(LOG_MQTT, "Echec publication HA Sensor '%s'", name.c_str());
+  // Par groupe : <base>/<groupe>/set et <base>/<groupe>/+/set
+  mqttTopics.subscriptionCount = 0;
+  for (int i = 0; i < mqttCommandRouteCount; i++) {
+    snprintf(mqttTopics.subscriptions[mqttTopics.subscriptionCount++], MQTT_TOPIC_MAX,
+             "%s/%s/set", mqttTopics.base, mqttCommandRoutes[i].group);
+    snprintf(mqttTopics.subscriptions[mqttTopics.subscriptionCount++], MQTT_TOPIC_MAX,
+             "%s/%s/+/set", mqttTopics.base, mqttCommandRoutes[i].group);
   }
   
-  delay(100);
+  LOG_D(LOG_MQTT, "Table des topics: base %s, %d souscriptions", mqttTopics.base, mqttTopics.subscriptionCount);
 }
 
-void publishHABinarySensor(String id, String name, String deviceClass, String icon, String deviceConfig) {
-  String topic = "homeassistant/binary_sensor/" + id + "/config";
-  
-  LOG_D(LOG_MQTT, "Publication HA Binary Sensor Discovery: %s", name.c_str());
-  LOG_V(LOG_MQTT, "Topic: %s", topic.c_str());
+/**
+ * Construit <base>/<suffixe> dans un buffer fourni.
+ */
+const char* formatMqttTopic(char* buf, size_t size, const char* suffix) {
+  snprintf(buf, size, "%s/%s", mqttTopics.base, suffix);
+  return buf;
+}
+
+// ============================================================================
+// MQTT CALLBACK
+// ============================================================================
+
+void mqttCallback(char* topic, byte* payload, unsigned int length) {
+  char msg[MQTT_COMMAND_PAYLOAD_MAX];
+  if (length >= sizeof(msg)) length = sizeof(msg) - 1;
+  memcpy(msg, payload, length);
+  msg[length] = '\0';
   
-  DynamicJsonDocument doc(2048);
-  doc["name"] = name;
-  doc["unique_id"] = "pool_" + id;
-  doc["state_topic"] = mqttTopic + "/sensor/" + id;
-  doc["device_class"] = deviceClass;
-  doc["payload_on"] = "ON";
-  doc["payload_off"] = "OFF";
-  doc["icon"] = icon;
+  LOG_MQTT_SUB(topic, msg);
   
-  DynamicJsonDocument deviceDoc(512);
-  deserializeJson(deviceDoc, deviceConfig);
-  doc["device"] = deviceDoc.as<JsonObject>();
+  // <base>/
+  if (strncmp(topic, mqttTopics.base, mqttTopics.baseLen) != 0 || topic[mqttTopics.baseLen] != '/') {
+    LOG_W(LOG_MQTT, "Topic non gere: %s", topic);
+    return;
+  }
   
-  String payload;
-  serializeJson(doc, payload);
+  // <groupe>/set ou <groupe>/<argument>/set, découpé dans une copie
+  char path[MQTT_TOPIC_MAX];
+  strlcpy(path, topic + mqttTopics.baseLen + 1, sizeof(path));
   
-  LOG_V(LOG_MQTT, "Device class: %s", deviceClass.c_str());
+  char* group = path;
+  char* arg = NULL;
+  char* slash = strchr(group, '/');
+  if (slash == NULL) {
+    LOG_W(LOG_MQTT, "Topic non gere: %s", topic);
+    return;
+  }
+  *slash = '\0';
+  char* rest = slash + 1;
   
-  bool published = mqttClient.publish(topic.c_str(), payload.c_str(), true);
+  if (strcmp(rest, "set") != 0) {
+    slash = strchr(rest, '/');
+    if (slash == NULL || strcmp(slash + 1, "set") != 0) {
+      LOG_W(LOG_MQTT, "Topic non gere: %s", topic);
+      return;
+    }
+    *slash = '\0';
+    arg = rest;
+  }
   
-  if (published) {
-    LOG_I(LOG_MQTT, "HA Binary Sensor '%s' publie avec succes", name.c_str());
-    LOG_MQTT_PUB(topic.c_str(), "[HA Discovery]");
-  } else {
-    LOG_E(LOG_MQTT, "Echec publication HA Binary Sensor '%s'", name.c_str());
+  for (int i = 0; i < mqttCommandRouteCount; i++) {
+    if (strcmp(group, mqttCommandRoutes[i].group) == 0) {
+      mqttCommandRoutes[i].handler(arg, msg);
+      return;
+    }
   }
   
-  delay(100);
+  LOG_W(LOG_MQTT, "Topic non gere: %s", topic);
+}
+
+// ============================================================================
+// MQTT PUBLISH - SUR CHANGEMENT
+// ============================================================================
+
+// Dernières valeurs publiées (tâche réseau uniquement)
+struct MqttPublishedState {
+  float waterTemp;
+  float waterPressure;
+  float extTemp;
+  bool waterLeak;
+  bool coverOpen;
+  uint8_t relays;            // Bit i = relais i
+  unsigned long lastFullPublish;
+  bool valid;
+};
+
+MqttPublishedState mqttPublished = {};
+unsigned long mqttValuesPublished = 0;
+unsigned long mqttValuesSkipped = 0;
+
+bool mqttValueChanged(float current, float published, float deadband) {
+  if (isnan(current) || isnan(published)) return isnan(current) != isnan(published);
+  return fabsf(current - published) >= deadband;
+}
+
+/**
+ * Publie une valeur sur <topic>/<suffixe> (sans String).
+ */
+bool publishMqttValue(const char* suffix, const char* payload, bool retain = true) {
+  char topic[MQTT_TOPIC_MAX];
+  formatMqttTopic(topic, sizeof(topic), suffix);
+  bool published = mqttClient.publish(topic, payload, retain);
+  LOG_MQTT_PUB(topic, payload);
+  return published;
+}
+
+void formatMqttFloat(char* buf, size_t size, float value) {
+  if (isnan(value)) strlcpy(buf, "null", size);
+  else snprintf(buf, size, "%.2f", value);
+}
+
+/**
+ * <topic>/state : tout l'état en un message, pour les consommateurs groupés.
+ */
+void publishMqttStateJson(const MqttPublishedState& state) {
+  char temp[12], pressure[12], ext[12];
+  formatMqttFloat(temp, sizeof(temp), state.waterTemp);
+  formatMqttFloat(pressure, sizeof(pressure), state.waterPressure);
+  formatMqttFloat(ext, sizeof(ext), state.extTemp);
+
+  time_t now = getCachedEpoch();            // 0 si l'heure n'est pas réglée
+  char payload[256];
+  snprintf(payload, sizeof(payload),
+           "{\"water_temp\":%s,\"water_pressure\":%s,\"ext_temp\":%s,"
+           "\"water_leak\":%s,\"cover\":%s,\"relays\":[%d,%d,%d,%d,%d],\"time\":%lu}",
+           temp, pressure, ext, state.waterLeak ? "true" : "false", state.coverOpen ? "true" : "false",
+           state.relays & 1, (state.relays >> 1) & 1, (state.relays >> 2) & 1,
+           (state.relays >> 3) & 1, (state.relays >> 4) & 1,
+           (unsigned long)now);
+  publishMqttValue("state", payload);
 }
 
-void publishHomeAssistantDiscovery() {
+/**
+ * Publie les mesures et les relais qui ont changé depuis la dernière
+ * publication (au-delà des bandes mortes), tout au plus tard toutes les
+ * heartbeatSec secondes.
+ *
+ * @param force Tout publier (connexion, republication demandée)
+ */
+void publishSensorStates(bool force = false) {
   if (!mqttClient.connected()) {
-    LOG_E(LOG_MQTT, "MQTT non connecte - Home Assistant Discovery annulee");
+    LOG_W(LOG_MQTT, "MQTT non connecte - Publication des etats annulee");
     return;
   }
   
-  LOG_SEPARATOR();
-  LOG_I(LOG_MQTT, "Demarrage Home Assistant Discovery...");
+  // Copie sous mutex, publication réseau hors mutex
+  MqttPublishedState current = mqttPublished;
+  if (xSemaphoreTake(dataMutex, pdMS_TO_TICKS(100))) {
+    current.waterTemp = waterTemp;
+    current.waterPressure = waterPressure;
+    current.extTemp = tempExterieure;
+    current.waterLeak = waterLeak;
+    current.coverOpen = coverOpen;
+    xSemaphoreGive(dataMutex);
+  } else {
+    LOG_E(LOG_MQTT, "Impossible d'obtenir le mutex pour la lecture des capteurs");
+    return;
+  }
   
-  String deviceId = "pool_connect_" + String((uint32_t)ESP.getEfuseMac(), HEX);
-  LOG_I(LOG_MQTT, "Device ID: %s", deviceId.c_str());
+  current.relays = getRelayMask();
   
-  DynamicJsonDocument deviceDoc(512);
-  JsonArray identifiers = deviceDoc.createNestedArray("identifiers");
-  identifiers.add(deviceId);
-  deviceDoc["name"] = "Pool Connect Pro";
-  deviceDoc["model"] = "ESP32-S3 Controller";
-  deviceDoc["manufacturer"] = "Custom";
-  deviceDoc["sw_version"] = String(FIRMWARE_VERSION);
+  unsigned long now = millis();
+  bool full = force || !mqttPublished.valid ||
+              now - mqttPublished.lastFullPublish >= mqttPublishConfig.heartbeatSec * 1000UL;
+  int published = 0;
+  char value[16];
   
-  String deviceConfig;
-  serializeJson(deviceDoc, deviceConfig);
+  if (full || mqttValueChanged(current.waterTemp, mqttPublished.waterTemp, mqttPublishConfig.tempDeadband)) {
+    snprintf(value, sizeof(value), "%.2f", current.waterTemp);
+    publishMqttValue("sensor/water_temp", value);
+    mqttPublished.waterTemp = current.waterTemp;
+    published++;
+  }
   
-  LOG_D(LOG_MQTT, "Publication des switches (5 relais)...");
-  publishHASwitch("pompe", "Pompe", 0, deviceConfig);
-  publishHASwitch("electrolyseur", "Électrolyseur", 1, deviceConfig);
-  publishHASwitch("lampe", "Lampe", 2, deviceConfig);
-  publishHASwitch("electrovalve", "Électrovalve", 3, deviceConfig);
-  publishHASwitch("pac", "Pompe à Chaleur", 4, deviceConfig);
+  if (full || mqttValueChanged(current.waterPressure, mqttPublished.waterPressure, mqttPublishConfig.pressureDeadband)) {
+    snprintf(value, sizeof(value), "%.2f", current.waterPressure);
+    publishMqttValue("sensor/water_pressure", value);
+    mqttPublished.waterPressure = current.waterPressure;
+    published++;
+  }
   
-  LOG_D(LOG_MQTT, "Publication des sensors (3 capteurs)...");
-  publishHASensor("water_temp", "Température Eau", "temperature", "°C", "mdi:thermometer-water", deviceConfig);
-  publishHASensor("water_pressure", "Pression Eau", "pressure", "bar", "mdi:gauge", deviceConfig);
-  publishHASensor("ext_temp", "Température Extérieure", "temperature", "°C", "mdi:thermometer", deviceConfig);
+  if (full || mqttValueChanged(current.extTemp, mqttPublished.extTemp, mqttPublishConfig.tempDeadband)) {
+    snprintf(value, sizeof(value), "%.2f", current.extTemp);
+    publishMqttValue("sensor/ext_temp", value);
+    mqttPublished.extTemp = current.extTemp;
+    published++;
+  }
   
-  LOG_D(LOG_MQTT, "Publication des binary sensors (2 capteurs)...");
-  publishHABinarySensor("water_leak", "Fuite d'Eau", "moisture", "mdi:water-alert", deviceConfig);
-  publishHABinarySensor("cover", "Volet Piscine", "opening", "mdi:window-shutter", deviceConfig);
+  if (full || current.waterLeak != mqttPublished.waterLeak) {
+    publishMqttValue("sensor/water_leak", current.waterLeak ? "ON" : "OFF");
+    if (current.waterLeak) {
+      LOG_W(LOG_MQTT, "FUITE DETECTEE!");
+    }
+    mqttPublished.waterLeak = current.waterLeak;
+    published++;
+  }
   
-  LOG_I(LOG_MQTT, "Home Assistant Discovery terminee avec succes");
-  LOG_I(LOG_MQTT, "Total: 5 switches, 3 sensors, 2 binary sensors");
-  LOG_SEPARATOR();
-}
-
-// ============================================================================
-// MQTT CALLBACK
-// ============================================================================
-
-void mqttCallback(char* topic, byte* payload, unsigned int length) {
-  String msg;
-  for (unsigned int i = 0; i < length; i++) msg += (char)payload[i];
+  if (full || current.coverOpen != mqttPublished.coverOpen) {
+    publishMqttValue("sensor/cover", current.coverOpen ? "ON" : "OFF");
+    mqttPublished.coverOpen = current.coverOpen;
+    published++;
+  }
   
-  LOG_MQTT_SUB(topic, msg.c_str());
+  // Relais : normalement déjà publiés au changement (queueRelayStatePublish)
+  for (int i = 0; i < NUM_RELAYS; i++) {
+    bool state = current.relays & (1 << i);
+    if (!full && state == (bool)(mqttPublished.relays & (1 << i))) continue;
+    
+    char suffix[16];
+    snprintf(suffix, sizeof(suffix), "relay/%d/state", i);
+    publishMqttValue(suffix, state ? "1" : "0");
+    published++;
+  }
+  mqttPublished.relays = current.relays;
   
-  // Commande relay globale (legacy)
-  String setTopic = mqttTopic + String("/relay/set");
-  if (String(topic) == setTopic) {
-    LOG_D(LOG_MQTT, "Reception commande relay globale");
-    DynamicJsonDocument doc(256);
-    if (!deserializeJson(doc, msg)) {
-      int relay = doc["relay"];
-      int state = doc["state"];
-      
-      if (relay >= 0 && relay < NUM_RELAYS) {
-        digitalWrite(relayPins[relay], state ? HIGH : LOW);
-        LOG_I(LOG_MQTT, "Relais %d commande via MQTT: %s", relay, state ? "ON" : "OFF");
-        
-        String stateTopic = mqttTopic + "/relay/" + String(relay) + "/state";
-        mqttClient.publish(stateTopic.c_str(), state ? "1" : "0", true);
-        LOG_MQTT_PUB(stateTopic.c_str(), state ? "1" : "0");
-      } else {
-        LOG_E(LOG_MQTT, "Index relay invalide: %d", relay);
-      }
-    } else {
-      LOG_E(LOG_MQTT, "Erreur parsing JSON de la commande relay");
-    }
+  if (published > 0 && mqttPublishConfig.stateJson) {
+    publishMqttStateJson(mqttPublished);
   }
   
-  // Commandes relay individuelles (Home Assistant)
-  for (int i = 0; i < NUM_RELAYS; i++) {
-    String relaySetTopic = mqttTopic + "/relay/" + String(i) + "/set";
-    if (String(topic) == relaySetTopic) {
-      bool state = (msg == "1");
-      digitalWrite(relayPins[i], state ? HIGH : LOW);
-      LOG_I(LOG_MQTT, "Relais %d commande via MQTT: %s", i, state ? "ON" : "OFF");
-      
-      String stateTopic = mqttTopic + "/relay/" + String(i) + "/state";
-      mqttClient.publish(stateTopic.c_str(), state ? "1" : "0", true);
-      LOG_MQTT_PUB(stateTopic.c_str(), state ? "1" : "0");
-      return;
-    }
+  if (full) {
+    mqttPublished.lastFullPublish = now;
+    mqttPublished.valid = true;
   }
   
-  LOG_W(LOG_MQTT, "Topic non gere: %s", topic);
+  mqttValuesPublished += published;
+  mqttValuesSkipped += (5 + NUM_RELAYS) - published;
+  
+  if (published > 0) {
+    LOG_D(LOG_MQTT, "Publication %s: %d valeurs sur %d", full ? "complete" : "des changements",
+          published, 5 + NUM_RELAYS);
+  } else {
+    LOG_V(LOG_MQTT, "Aucun changement a publier");
+  }
 }
 
 // ============================================================================
-// MQTT PUBLISH - VERSION AVEC LOGS ET RETAIN
+// MQTT HOME ASSISTANT DISCOVERY
 // ============================================================================
 
-void publishSensorStates() {
-  if (!mqttClient.connected()) {
-    LOG_W(LOG_MQTT, "MQTT non connecte - Publication des etats annulee");
-    return;
+enum HaComponent {
+  HA_SWITCH,
+  HA_SENSOR,
+  HA_BINARY_SENSOR
+};
+
+struct HaEntity {
+  HaComponent component;
+  const char* id;
+  const char* name;
+  int relayIndex;            // HA_SWITCH uniquement
+  const char* deviceClass;
+  const char* unit;
+  const char* icon;
+};
+
+const HaEntity HA_ENTITIES[] = {
+  { HA_SWITCH, "pompe",         "Pompe",            0, NULL, NULL, NULL },
+  { HA_SWITCH, "electrolyseur", "Électrolyseur",    1, NULL, NULL, NULL },
+  { HA_SWITCH, "lampe",         "Lampe",            2, NULL, NULL, NULL },
+  { HA_SWITCH, "electrovalve",  "Électrovalve",     3, NULL, NULL, NULL },
+  { HA_SWITCH, "pac",           "Pompe à Chaleur",  4, NULL, NULL, NULL },
+  { HA_SENSOR, "water_temp",     "Température Eau",        -1, "temperature", "°C",  "mdi:thermometer-water" },
+  { HA_SENSOR, "water_pressure", "Pression Eau",           -1, "pressure",    "bar", "mdi:gauge" },
+  { HA_SENSOR, "ext_temp",       "Température Extérieure", -1, "temperature", "°C",  "mdi:thermometer" },
+  { HA_BINARY_SENSOR, "water_leak", "Fuite d'Eau",   -1, "moisture", NULL, "mdi:water-alert" },
+  { HA_BINARY_SENSOR, "cover",      "Volet Piscine", -1, "opening",  NULL, "mdi:window-shutter" }
+};
+
+#define HA_ENTITY_COUNT (sizeof(HA_ENTITIES) / sizeof(HA_ENTITIES[0]))
+
+// Message prêt à publier (topic et payload dans un seul bloc)
+struct HaDiscoveryMessage {
+  char* topic;
+  const char* payload;
+};
+
+HaDiscoveryMessage haDiscoveryCache[HA_ENTITY_COUNT];
+bool haDiscoveryCached = false;
+int haDiscoveryNext = -1;                // -1 : aucune découverte en cours
+int haDiscoveryFailed = 0;
+unsigned long haDiscoveryLast = 0;
+
+const char* getHaComponentName(HaComponent component) {
+  switch (component) {
+    case HA_SWITCH:        return "switch";
+    case HA_SENSOR:        return "sensor";
+    case HA_BINARY_SENSOR: return "binary_sensor";
   }
+  return "sensor";
+}
+
+/**
+ * Libère les messages (topic de base modifié).
+ */
+void clearHaDiscoveryCache() {
+  for (size_t i = 0; i < HA_ENTITY_COUNT; i++) {
+    free(haDiscoveryCache[i].topic);   // heap_caps_malloc : free() convient
+    haDiscoveryCache[i].topic = NULL;
+    haDiscoveryCache[i].payload = NULL;
+  }
+  haDiscoveryCached = false;
+  haDiscoveryNext = -1;
+}
+
+/**
+ * Construit les messages de découverte une fois pour toutes.
+ *
+ * @return false si la mémoire manque
+ */
+bool buildHaDiscoveryCache() {
+  clearHaDiscoveryCache();
+  
+  char deviceId[32];
+  snprintf(deviceId, sizeof(deviceId), "pool_connect_%x", (uint32_t)ESP.getEfuseMac());
+  LOG_I(LOG_MQTT, "Device ID: %s", deviceId);
   
-  LOG_D(LOG_MQTT, "Publication des etats des capteurs et relais...");
+  DynamicJsonDocument doc(1024);
+  char buffer[96];
+  size_t total = 0;
   
-  if (xSemaphoreTake(dataMutex, portMAX_DELAY)) {
-    String topic;
-    String payload;
+  for (size_t i = 0; i < HA_ENTITY_COUNT; i++) {
+    const HaEntity& entity = HA_ENTITIES[i];
+    doc.clear();
     
-    // Température eau
-    topic = mqttTopic + "/sensor/water_temp";
-    payload = String(waterTemp, 2);
-    mqttClient.publish(topic.c_str(), payload.c_str(), true);
-    LOG_MQTT_PUB(topic.c_str(), payload.c_str());
-    LOG_V(LOG_MQTT, "Temperature eau: %.2f C", waterTemp);
+    doc["name"] = entity.name;
+    snprintf(buffer, sizeof(buffer), "pool_%s", entity.id);
+    doc["unique_id"] = (const char*)buffer;   // Copié par ArduinoJson
     
-    // Pression
-    topic = mqttTopic + "/sensor/water_pressure";
-    payload = String(waterPressure, 2);
-    mqttClient.publish(topic.c_str(), payload.c_str(), true);
-    LOG_MQTT_PUB(topic.c_str(), payload.c_str());
-    LOG_V(LOG_MQTT, "Pression: %.2f BAR", waterPressure);
+    if (entity.component == HA_SWITCH) {
+      snprintf(buffer, sizeof(buffer), "%s/relay/%d/set", mqttTopics.base, entity.relayIndex);
+      doc["command_topic"] = (const char*)buffer;
+      snprintf(buffer, sizeof(buffer), "%s/relay/%d/state", mqttTopics.base, entity.relayIndex);
+      doc["state_topic"] = (const char*)buffer;
+      doc["payload_on"] = "1";
+      doc["payload_off"] = "0";
+      doc["optimistic"] = false;
+      doc["retain"] = true;
+    } else {
+      snprintf(buffer, sizeof(buffer), "%s/sensor/%s", mqttTopics.base, entity.id);
+      doc["state_topic"] = (const char*)buffer;
+      doc["device_class"] = entity.deviceClass;
+      if (entity.component == HA_BINARY_SENSOR) {
+        doc["payload_on"] = "ON";
+        doc["payload_off"] = "OFF";
+      } else {
+        doc["unit_of_measurement"] = entity.unit;
+      }
+      doc["icon"] = entity.icon;
+    }
     
-    // Température extérieure
-    topic = mqttTopic + "/sensor/ext_temp";
-    payload = String(tempExterieure, 2);
-    mqttClient.publish(topic.c_str(), payload.c_str(), true);
-    LOG_MQTT_PUB(topic.c_str(), payload.c_str());
-    LOG_V(LOG_MQTT, "Temperature exterieure: %.2f C", tempExterieure);
+    JsonObject device = doc.createNestedObject("device");
+    device.createNestedArray("identifiers").add((const char*)deviceId);
+    device["name"] = "Pool Connect Pro";
+    device["model"] = "ESP32-S3 Controller";
+    device["manufacturer"] = "Custom";
+    device["sw_version"] = FIRMWARE_VERSION;
     
-    // Fuite
-    topic = mqttTopic + "/sensor/water_leak";
-    payload = waterLeak ? "ON" : "OFF";
-    mqttClient.publish(topic.c_str(), payload.c_str(), true);
-    LOG_MQTT_PUB(topic.c_str(), payload.c_str());
-    if (waterLeak) {
-      LOG_W(LOG_MQTT, "FUITE DETECTEE!");
-    }
+    int topicLen = snprintf(buffer, sizeof(buffer), "homeassistant/%s/%s/config",
+                            getHaComponentName(entity.component), entity.id);
+    size_t payloadLen = measureJson(doc);
+    size_t size = topicLen + 1 + payloadLen + 1;
     
-    // Volet
-    topic = mqttTopic + "/sensor/cover";
-    payload = coverOpen ? "ON" : "OFF";
-    mqttClient.publish(topic.c_str(), payload.c_str(), true);
-    LOG_MQTT_PUB(topic.c_str(), payload.c_str());
-    LOG_V(LOG_MQTT, "Volet: %s", coverOpen ? "OUVERT" : "FERME");
+    char* block = (char*)heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (block == NULL) block = (char*)malloc(size);
+    if (block == NULL) {
+      LOG_E(LOG_MQTT, "Memoire insuffisante pour la decouverte HA (%u octets)", (unsigned)size);
+      clearHaDiscoveryCache();
+      return false;
+    }
     
-    xSemaphoreGive(dataMutex);
-  } else {
-    LOG_E(LOG_MQTT, "Impossible d'obtenir le mutex pour la lecture des capteurs");
+    memcpy(block, buffer, topicLen + 1);
+    serializeJson(doc, block + topicLen + 1, payloadLen + 1);
+    haDiscoveryCache[i].topic = block;
+    haDiscoveryCache[i].payload = block + topicLen + 1;
+    total += size;
   }
   
-  // États des relais
-  for (int i = 0; i < NUM_RELAYS; i++) {
-    bool state = digitalRead(relayPins[i]) == HIGH;
-    String topic = mqttTopic + "/relay/" + String(i) + "/state";
-    String payload = state ? "1" : "0";
-    mqttClient.publish(topic.c_str(), payload.c_str(), true);
-    LOG_MQTT_PUB(topic.c_str(), payload.c_str());
-    LOG_V(LOG_MQTT, "Relais %d: %s", i, state ? "ON" : "OFF");
+  haDiscoveryCached = true;
+  LOG_D(LOG_MQTT, "Decouverte HA preparee: %d messages, %u octets", (int)HA_ENTITY_COUNT, (unsigned)total);
+  return true;
+}
+
+/**
+ * Lance (ou relance) la publication de la découverte.
+ * Les messages partent ensuite depuis processHaDiscovery().
+ */
+void startHaDiscovery() {
+  if (!haDiscoveryCached && !buildHaDiscoveryCache()) return;
+  
+  LOG_I(LOG_MQTT, "Demarrage Home Assistant Discovery (%d entites)", (int)HA_ENTITY_COUNT);
+  haDiscoveryNext = 0;
+  haDiscoveryFailed = 0;
+  haDiscoveryLast = millis() - HA_DISCOVERY_INTERVAL_MS;
+}
+
+bool isHaDiscoveryRunning() {
+  return haDiscoveryNext >= 0;
+}
+
+/**
+ * Appelé à chaque tour de la tâche réseau (client connecté) : au plus un
+ * message toutes les HA_DISCOVERY_INTERVAL_MS, puis publication complète
+ * des états HA_STATE_DELAY_MS après le dernier.
+ */
+void processHaDiscovery() {
+  if (haDiscoveryNext < 0) return;
+  
+  unsigned long now = millis();
+  
+  if (haDiscoveryNext >= (int)HA_ENTITY_COUNT) {
+    if (now - haDiscoveryLast < HA_STATE_DELAY_MS) return;
+    
+    haDiscoveryNext = -1;
+    if (haDiscoveryFailed > 0) {
+      LOG_W(LOG_MQTT, "Home Assistant Discovery terminee: %d echecs sur %d",
+            haDiscoveryFailed, (int)HA_ENTITY_COUNT);
+    } else {
+      LOG_I(LOG_MQTT, "Home Assistant Discovery terminee avec succes");
+    }
+    publishSensorStates(true);
+    return;
   }
   
-  LOG_I(LOG_MQTT, "Publication des etats terminee (%d capteurs + %d relais)", 5, NUM_RELAYS);
+  if (now - haDiscoveryLast < HA_DISCOVERY_INTERVAL_MS) return;
+  haDiscoveryLast = now;
+  
+  const HaDiscoveryMessage& msg = haDiscoveryCache[haDiscoveryNext];
+  if (mqttClient.publish(msg.topic, msg.payload, true)) {
+    LOG_D(LOG_MQTT, "HA '%s' publie", HA_ENTITIES[haDiscoveryNext].name);
+    LOG_MQTT_PUB(msg.topic, "[HA Discovery]");
+  } else {
+    LOG_E(LOG_MQTT, "Echec publication HA '%s'", HA_ENTITIES[haDiscoveryNext].name);
+    haDiscoveryFailed++;
+  }
+  haDiscoveryNext++;
 }
 
 // ============================================================================
@@ -377,12 +692,19 @@ void mqttReconnect() {
   
   lastMqttAttempt = millis();
   
+  // Topic de base modifié (interface web, restauration) : topics recalculés
+  if (strcmp(mqttTopics.base, mqttTopic.c_str()) != 0) {
+    buildMqttTopicTable();
+    clearHaDiscoveryCache();
+  }
+  
   LOG_I(LOG_MQTT, "Tentative de connexion MQTT...");
   LOG_D(LOG_MQTT, "Serveur: %s:%d", mqttServer.c_str(), mqttPort);
   LOG_V(LOG_MQTT, "Client ID: ESP32PoolConnect");
   
   if (mqttClient.connect("ESP32PoolConnect", mqttUser.c_str(), mqttPassword.c_str())) {
     LOG_I(LOG_MQTT, "Connexion MQTT reussie!");
+    mqttConnectCount++;
     
     mqttClient.setCallback(mqttCallback);
     LOG_V(LOG_MQTT, "Callback MQTT enregistre");
@@ -390,23 +712,17 @@ void mqttReconnect() {
     // Souscriptions
     LOG_D(LOG_MQTT, "Souscription aux topics de commande...");
     
-    String topic = mqttTopic + "/relay/set";
-    mqttClient.subscribe(topic.c_str());
-    LOG_V(LOG_MQTT, "Souscrit: %s", topic.c_str());
-    
-    for (int i = 0; i < NUM_RELAYS; i++) {
-      topic = mqttTopic + "/relay/" + String(i) + "/set";
-      mqttClient.subscribe(topic.c_str());
-      LOG_V(LOG_MQTT, "Souscrit: %s", topic.c_str());
+    for (int i = 0; i < mqttTopics.subscriptionCount; i++) {
+      mqttClient.subscribe(mqttTopics.subscriptions[i]);
+      LOG_V(LOG_MQTT, "Souscrit: %s", mqttTopics.subscriptions[i]);
     }
     
-    LOG_I(LOG_MQTT, "Souscriptions terminees (%d topics)", NUM_RELAYS + 1);
+    LOG_I(LOG_MQTT, "Souscriptions terminees (%d topics)", mqttTopics.subscriptionCount);
     
-    // Publication immédiate après connexion
+    // Publication initiale après connexion
     LOG_D(LOG_MQTT, "Publication initiale apres connexion...");
-    publishHomeAssistantDiscovery();
-    delay(500);  // Laisser le temps à HA de traiter la découverte
-    publishSensorStates();
+    // Découverte HA publiée par la tâche réseau, puis états complets
+    startHaDiscovery();
     
   } else {
     int errorCode = mqttClient.state();
@@ -1,6 +1,6 @@
 /* 
  * POOL CONNECT - OTA SYSTEM
- * ota_manager.h   V0.4
+ * ota_manager.h   V0.5
  * 
  * FEATURES:
  * - Utilisation du système de logging centralisé
@@ -25,6 +25,8 @@
 #include <WebServer.h>
 #include <esp_ota_ops.h>
 #include "logging.h"
+#include "energy_meter.h"
+#include "task_bus.h"
 
 namespace OTAManager {
 
@@ -482,6 +484,10 @@ void handleFilesystemUpload(WebServer* server) {
             contentLength = upload.totalSize;
         }
         
+        // Points graphique et compteurs écrits avant que la partition soit
+        // réécrite : plus aucune écriture LittleFS jusqu'au redémarrage
+        flushPersistenceBeforeRestart();
+        
         if (!startFilesystemUpdate(contentLength)) {
             LOG_E(LOG_OTA, "Failed to initialize filesystem update!");
             // Ne pas envoyer de rÃ©ponse ici
@@ -572,6 +578,9 @@ void setupOTARoutes(WebServer* server) {
                     // IMPORTANT: Forcer l'envoi complet de la réponse HTTP
                     server->client().flush();
                     
+                    // Points graphique et compteurs de marche conservés
+                    flushPersistenceBeforeRestart();
+                    
                     // Attendre 3 secondes pour garantir que le client reçoit la réponse
                     LOG_I(LOG_OTA, "Waiting 3 seconds before reboot...");
                     delay(3000);
@@ -617,6 +626,8 @@ void setupOTARoutes(WebServer* server) {
                     // IMPORTANT: Forcer l'envoi complet de la réponse HTTP
                     server->client().flush();
                     
+                    // Sauvegarde faite au début de l'envoi (handleFilesystemUpload)
+                    
                     // Attendre 3 secondes pour garantir que le client reçoit la réponse
                     LOG_I(LOG_OTA, "Waiting 3 seconds before reboot...");
                     delay(3000);
@@ -624,8 +635,9 @@ void setupOTARoutes(WebServer* server) {
                     LOG_I(LOG_OTA, "Rebooting NOW!");
                     ESP.restart();
                 } else {
-                    // ❌ ÉCHEC: Envoyer erreur
+                    // ❌ ÉCHEC: Envoyer erreur, pas de redémarrage
                     LOG_E(LOG_OTA, "Sending error response");
+                    resumePersistence();
                     String errorJson = "{\"success\":false,\"error\":\"" + lastError + "\"}";
                     server->send(500, "application/json", errorJson);
                 }
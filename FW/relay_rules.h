@@ -0,0 +1,244 @@
+/*
+ * POOL CONNECT - RELAY RULES
+ * Règles de sécurité des relais (interverrouillages, durées minimales)
+ * relay_rules.h   V0.2
+ *
+ * Table déclarative compilée au démarrage en masques par relais :
+ *   RULE_REQUIRES  a, b     a ne s'allume que si b est allumé ;
+ *                           b qui s'éteint éteint a
+ *   RULE_FORBIDS   a, b     a et b jamais allumés ensemble (symétrique)
+ *   RULE_FORCES    a, b     allumer a allume d'abord b
+ *   RULE_MIN_ON    a, s     a reste allumé au moins s secondes
+ *   RULE_MIN_OFF   a, s     a reste éteint au moins s secondes
+ *
+ * Une commande est évaluée en temps constant (quelques opérations sur les
+ * masques), quelle que soit la taille de la table. Les arrêts de
+ * protection ignorent la durée minimale allumée : la sécurité passe avant.
+ *
+ * Module pur (aucune dépendance Arduino, pas d'allocation) : testable sur
+ * PC, l'état des relais et le temps sont passés en paramètres.
+ */
+
+#ifndef RELAY_RULES_H
+#define RELAY_RULES_H
+
+#include <stdint.h>
+
+// ============================================================================
+// CONSTANTES
+// ============================================================================
+
+#define RELAY_RULES_MAX_RELAYS 8             // Masques sur 8 bits
+
+// ============================================================================
+// STRUCTURES
+// ============================================================================
+
+enum RelayRuleType {
+  RULE_REQUIRES,
+  RULE_FORBIDS,
+  RULE_FORCES,
+  RULE_MIN_ON,
+  RULE_MIN_OFF
+};
+
+struct RelayRule {
+  RelayRuleType type;
+  int8_t relay;
+  int8_t other;               // Relais lié (REQUIRES, FORBIDS, FORCES)
+  uint16_t seconds;           // Durée (MIN_ON, MIN_OFF)
+};
+
+// Table compilée : une entrée par relais
+struct RelayRuleSet {
+  uint8_t relayCount;
+  uint8_t requires[RELAY_RULES_MAX_RELAYS];     // Doivent être allumés
+  uint8_t forbids[RELAY_RULES_MAX_RELAYS];      // Doivent être éteints
+  uint8_t forces[RELAY_RULES_MAX_RELAYS];       // Allumés avant lui
+  uint8_t dependents[RELAY_RULES_MAX_RELAYS];   // Éteints après lui
+  uint32_t minOnMs[RELAY_RULES_MAX_RELAYS];
+  uint32_t minOffMs[RELAY_RULES_MAX_RELAYS];
+};
+
+enum RelayRuleVerdict {
+  RULE_OK,
+  RULE_REFUSED_REQUIRES,
+  RULE_REFUSED_FORBIDS,
+  RULE_REFUSED_MIN_ON,
+  RULE_REFUSED_MIN_OFF
+};
+
+struct RelayRuleResult {
+  RelayRuleVerdict verdict;
+  int8_t other;               // Relais en cause (-1 si durée)
+  uint32_t waitMs;            // Attente restante (MIN_ON, MIN_OFF)
+};
+
+// ============================================================================
+// COMPILATION
+// ============================================================================
+
+/**
+ * Compile la table en masques. Les règles invalides (relais hors limites,
+ * relais lié à lui-même, FORCES sur un relais interdit) sont ignorées.
+ *
+ * @return nombre de règles ignorées
+ */
+inline int compileRelayRules(const RelayRule* rules, int count, int relayCount, RelayRuleSet& set) {
+  if (relayCount > RELAY_RULES_MAX_RELAYS) relayCount = RELAY_RULES_MAX_RELAYS;
+
+  set.relayCount = relayCount;
+  for (int i = 0; i < RELAY_RULES_MAX_RELAYS; i++) {
+    set.requires[i] = 0;
+    set.forbids[i] = 0;
+    set.forces[i] = 0;
+    set.dependents[i] = 0;
+    set.minOnMs[i] = 0;
+    set.minOffMs[i] = 0;
+  }
+
+  int ignored = 0;
+  for (int i = 0; i < count; i++) {
+    const RelayRule& rule = rules[i];
+    int a = rule.relay;
+    int b = rule.other;
+    bool linked = rule.type == RULE_REQUIRES || rule.type == RULE_FORBIDS || rule.type == RULE_FORCES;
+
+    if (a < 0 || a >= relayCount || (linked && (b < 0 || b >= relayCount || b == a))) {
+      ignored++;
+      continue;
+    }
+
+    switch (rule.type) {
+      case RULE_REQUIRES:
+        set.requires[a] |= (1 << b);
+        set.dependents[b] |= (1 << a);
+        break;
+      case RULE_FORBIDS:
+        set.forbids[a] |= (1 << b);
+        set.forbids[b] |= (1 << a);
+        break;
+      case RULE_FORCES:
+        set.forces[a] |= (1 << b);
+        break;
+      case RULE_MIN_ON:
+        set.minOnMs[a] = (uint32_t)rule.seconds * 1000;
+        break;
+      case RULE_MIN_OFF:
+        set.minOffMs[a] = (uint32_t)rule.seconds * 1000;
+        break;
+    }
+  }
+
+  // Allumer un relais interdit serait toujours refusé
+  for (int i = 0; i < relayCount; i++) {
+    uint8_t conflict = set.forces[i] & set.forbids[i];
+    if (conflict != 0) {
+      set.forces[i] &= ~conflict;
+      ignored++;
+    }
+  }
+
+  return ignored;
+}
+
+// ============================================================================
+// ÉVALUATION
+// ============================================================================
+
+inline int8_t lowestRelayBit(uint8_t mask) {
+  return mask != 0 ? (int8_t)__builtin_ctz(mask) : -1;
+}
+
+/**
+ * Évalue une commande (relais actuellement dans l'autre état).
+ *
+ * @param mask Relais allumés (bit i = relais i)
+ * @param sinceChangeMs Temps depuis le dernier changement de ce relais
+ * @param protection Arrêt de protection : durée minimale allumée ignorée
+ */
+inline RelayRuleResult evaluateRelayRule(const RelayRuleSet& set, int relay, bool on,
+                                         uint8_t mask, uint32_t sinceChangeMs, bool protection) {
+  RelayRuleResult result = { RULE_OK, -1, 0 };
+
+  if (on) {
+    if (sinceChangeMs < set.minOffMs[relay]) {
+      result.verdict = RULE_REFUSED_MIN_OFF;
+      result.waitMs = set.minOffMs[relay] - sinceChangeMs;
+      return result;
+    }
+    // Les relais forcés seront allumés avant celui-ci
+    uint8_t missing = set.requires[relay] & ~(mask | set.forces[relay]);
+    if (missing != 0) {
+      result.verdict = RULE_REFUSED_REQUIRES;
+      result.other = lowestRelayBit(missing);
+      return result;
+    }
+    uint8_t conflict = set.forbids[relay] & (mask | set.forces[relay]);
+    if (conflict != 0) {
+      result.verdict = RULE_REFUSED_FORBIDS;
+      result.other = lowestRelayBit(conflict);
+      return result;
+    }
+  } else if (!protection && sinceChangeMs < set.minOnMs[relay]) {
+    result.verdict = RULE_REFUSED_MIN_ON;
+    result.waitMs = set.minOnMs[relay] - sinceChangeMs;
+  }
+
+  return result;
+}
+
+/**
+ * Vérifie un état complet (scène) : dépendances et interdictions, sans les
+ * durées minimales.
+ */
+inline RelayRuleResult evaluateRelayMask(const RelayRuleSet& set, uint8_t target) {
+  RelayRuleResult result = { RULE_OK, -1, 0 };
+
+  for (int i = 0; i < set.relayCount; i++) {
+    if (!(target & (1 << i))) continue;
+    uint8_t missing = set.requires[i] & ~target;
+    uint8_t conflict = set.forbids[i] & target;
+    if (missing != 0 || conflict != 0) {
+      result.verdict = missing != 0 ? RULE_REFUSED_REQUIRES : RULE_REFUSED_FORBIDS;
+      result.other = lowestRelayBit(missing != 0 ? missing : conflict);
+      return result;
+    }
+  }
+
+  return result;
+}
+
+/**
+ * Durées minimales d'un passage de current à target (scène) : relais qui
+ * changent d'état et relais forcés allumés en plus. Vérifié avant toute
+ * commande, pour refuser la scène en entier plutôt qu'à moitié.
+ *
+ * @param sinceChangeMs Temps depuis le dernier changement, par relais
+ * @param relay Relais refusé (-1 si aucun)
+ */
+inline RelayRuleResult evaluateRelayTransition(const RelayRuleSet& set, uint8_t current, uint8_t target,
+                                               const uint32_t* sinceChangeMs, int* relay) {
+  uint8_t turningOn = target & ~current;
+  uint8_t turningOff = current & ~target;
+  for (int i = 0; i < set.relayCount; i++) {
+    if (target & ~current & (1 << i)) turningOn |= set.forces[i] & ~current;
+  }
+
+  *relay = -1;
+  for (int i = 0; i < set.relayCount; i++) {
+    bool on = turningOn & (1 << i);
+    if (!on && !(turningOff & (1 << i))) continue;
+
+    RelayRuleResult result = evaluateRelayRule(set, i, on, target | turningOn, sinceChangeMs[i], false);
+    if (result.verdict == RULE_REFUSED_MIN_ON || result.verdict == RULE_REFUSED_MIN_OFF) {
+      *relay = i;
+      return result;
+    }
+  }
+
+  RelayRuleResult ok = { RULE_OK, -1, 0 };
+  return ok;
+}
+
+#endif // RELAY_RULES_H
@@ -0,0 +1,298 @@
+/*
+ * POOL CONNECT - RELAY SERVICE
+ * Seul point d'écriture des relais, état en cache et événements de changement
+ * relay_service.h   V0.5
+ *
+ * Toutes les commandes (web, MQTT, timers, thermostat, protections) passent par
+ * setRelay() :
+ * - la sortie est écrite, l'état mis en cache avec l'heure et la source
+ * - la commande est d'abord évaluée par les règles de sécurité
+ *   (RELAY_RULES, compilées au démarrage par relay_rules.h) : refusée,
+ *   rien n'est écrit
+ * - chaque transition produit un seul événement, traité par
+ *   dispatchRelayEvent() : compteurs de marche, relais dépendants
+ *   éteints, publication MQTT (et flux direct), point graphique
+ * Les lectures (isRelayOn, getRelayMask) utilisent le cache : plus de
+ * digitalRead sur les sorties.
+ *
+ * Appelable depuis toutes les tâches : mutex récursif (une protection peut
+ * commander un autre relais pendant le traitement d'un événement).
+ */
+
+#ifndef RELAY_SERVICE_H
+#define RELAY_SERVICE_H
+
+#include <Arduino.h>
+#include "globals.h"
+#include "config.h"
+#include "logging.h"
+#include "time_service.h"
+#include "task_bus.h"
+#include "relay_rules.h"
+
+// ============================================================================
+// CONSTANTES
+// ============================================================================
+
+#define RELAY_PUMP 0
+#define RELAY_ELECTROLYSER 1
+#define RELAY_HEAT_PUMP 4                // RELAY_PAC : broche (config.h)
+#define RELAY_MUTEX_TIMEOUT_MS 100
+
+// Règles de sécurité (voir relay_rules.h)
+const RelayRule RELAY_RULES[] = {
+  { RULE_REQUIRES, RELAY_ELECTROLYSER, RELAY_PUMP, 0 },   // Pas de chlore sans circulation
+  { RULE_REQUIRES, RELAY_HEAT_PUMP, RELAY_PUMP, 0 },      // Pas de chauffe sans débit
+  { RULE_MIN_OFF, RELAY_HEAT_PUMP, -1, 180 },             // Anti-court-cycle compresseur
+};
+
+// ============================================================================
+// STRUCTURES
+// ============================================================================
+
+enum RelaySource {
+  RELAY_SOURCE_BOOT,
+  RELAY_SOURCE_WEB,
+  RELAY_SOURCE_MQTT,
+  RELAY_SOURCE_TIMER,
+  RELAY_SOURCE_THERMOSTAT,
+  RELAY_SOURCE_PROTECTION
+};
+
+struct RelayInfo {
+  bool on;
+  RelaySource source;          // Origine du dernier changement
+  unsigned long changedAt;     // millis()
+  uint32_t changedEpoch;       // 0 si l'heure n'était pas réglée
+  uint32_t transitions;
+};
+
+struct RelayEvent {
+  uint8_t relay;
+  bool on;
+  RelaySource source;
+};
+
+// ============================================================================
+// VARIABLES GLOBALES
+// ============================================================================
+
+RelayInfo relayInfo[NUM_RELAYS];
+RelayRuleSet relayRules;
+volatile uint8_t relayMask = 0;          // Bit i = relais i (lecture sans verrou)
+SemaphoreHandle_t relayMutex = NULL;
+portMUX_TYPE relayInfoMux = portMUX_INITIALIZER_UNLOCKED;
+unsigned long relayCommandsRefused = 0;
+
+// ============================================================================
+// DÉCLARATIONS FORWARD
+// ============================================================================
+
+void captureCurrentStateToChart();
+void recordRelayTransition(int relay, bool on);
+bool setRelay(int relay, bool on, RelaySource source, RelayRuleResult* refusal = nullptr);
+
+// ============================================================================
+// LECTURE
+// ============================================================================
+
+bool isRelayOn(int relay) {
+  return relay >= 0 && relay < NUM_RELAYS && (relayMask & (1 << relay));
+}
+
+uint8_t getRelayMask() {
+  return relayMask;
+}
+
+RelayInfo getRelayInfo(int relay) {
+  portENTER_CRITICAL(&relayInfoMux);
+  RelayInfo info = relayInfo[relay];
+  portEXIT_CRITICAL(&relayInfoMux);
+  return info;
+}
+
+const char* getRelaySourceName(RelaySource source) {
+  switch (source) {
+    case RELAY_SOURCE_BOOT:       return "boot";
+    case RELAY_SOURCE_WEB:        return "web";
+    case RELAY_SOURCE_MQTT:       return "mqtt";
+    case RELAY_SOURCE_TIMER:      return "timer";
+    case RELAY_SOURCE_THERMOSTAT: return "thermostat";
+    case RELAY_SOURCE_PROTECTION: return "protection";
+  }
+  return "boot";
+}
+
+const char* getRelayName(int relay) {
+  static const char* const names[] = {"Pompe", "Electrolyseur", "Lampe", "Electrovalve", "PAC"};
+  return relay >= 0 && relay < NUM_RELAYS ? names[relay] : "?";
+}
+
+/**
+ * Texte d'un refus (journal, réponse web, erreur de timer).
+ */
+void formatRelayRefusal(const RelayRuleResult& result, char* buf, size_t size) {
+  switch (result.verdict) {
+    case RULE_REFUSED_REQUIRES:
+      snprintf(buf, size, "%s doit etre active", getRelayName(result.other));
+      break;
+    case RULE_REFUSED_FORBIDS:
+      snprintf(buf, size, "%s doit etre arrete", getRelayName(result.other));
+      break;
+    case RULE_REFUSED_MIN_ON:
+      snprintf(buf, size, "Duree minimale de marche (encore %lu s)", (unsigned long)((result.waitMs + 999) / 1000));
+      break;
+    case RULE_REFUSED_MIN_OFF:
+      snprintf(buf, size, "Duree minimale d'arret (encore %lu s)", (unsigned long)((result.waitMs + 999) / 1000));
+      break;
+    default:
+      snprintf(buf, size, "Service relais occupe");
+      break;
+  }
+}
+
+// ============================================================================
+// INITIALISATION
+// ============================================================================
+
+/**
+ * Sorties à LOW et cache initialisé (avant le démarrage des tâches).
+ */
+void initRelayService() {
+  if (relayMutex == NULL) relayMutex = xSemaphoreCreateRecursiveMutex();
+
+  for (int i = 0; i < NUM_RELAYS; i++) {
+    pinMode(relayPins[i], OUTPUT);
+    digitalWrite(relayPins[i], LOW);
+    relayInfo[i].on = false;
+    relayInfo[i].source = RELAY_SOURCE_BOOT;
+    relayInfo[i].changedAt = millis();
+    relayInfo[i].changedEpoch = 0;
+    relayInfo[i].transitions = 0;
+    LOG_V(LOG_SYSTEM, "Relais %d (Pin %d) initialise a LOW", i, relayPins[i]);
+  }
+  relayMask = 0;
+
+  int ignored = compileRelayRules(RELAY_RULES, sizeof(RELAY_RULES) / sizeof(RELAY_RULES[0]),
+                                  NUM_RELAYS, relayRules);
+  if (ignored > 0) {
+    LOG_E(LOG_SYSTEM, "Regles relais: %d regles invalides ignorees", ignored);
+  }
+  LOG_D(LOG_SYSTEM, "Regles relais compilees: %d", (int)(sizeof(RELAY_RULES) / sizeof(RELAY_RULES[0])) - ignored);
+}
+
+// ============================================================================
+// ÉVÉNEMENTS
+// ============================================================================
+
+/**
+ * Effets d'une transition, dans l'ordre : compteurs de marche
+ * (energy_meter.h), relais dépendants (RULE_REQUIRES) éteints, publication
+ * MQTT et flux direct, point graphique (regroupé par chart_event_points.h).
+ */
+void dispatchRelayEvent(const RelayEvent& event) {
+  recordRelayTransition(event.relay, event.on);
+
+  // PROTECTION: Un relais requis s'arrête, ses dépendants aussi
+  if (!event.on) {
+    uint8_t dependents = relayRules.dependents[event.relay] & relayMask;
+    for (int i = 0; dependents != 0; i++, dependents >>= 1) {
+      if (!(dependents & 1)) continue;
+      LOG_W(LOG_SYSTEM, "PROTECTION: %s arrete automatiquement (%s arrete)",
+            getRelayName(i), getRelayName(event.relay));
+      setRelay(i, false, RELAY_SOURCE_PROTECTION);
+    }
+  }
+
+  queueRelayStatePublish(event.relay, event.on, true);
+  captureCurrentStateToChart();
+}
+
+// ============================================================================
+// COMMANDE
+// ============================================================================
+
+/**
+ * Commande un relais.
+ *
+ * @param source Origine de la commande (journal, /api/relays/status)
+ * @param refusal Motif du refus (optionnel, verdict RULE_OK si le service
+ *        était occupé). Fourni, les refus de durée minimale ne sont ni
+ *        journalisés ni comptés : l'appelant réessaie après waitMs
+ * @return false si la commande est refusée (relais invalide, règle de
+ *         sécurité, mutex indisponible) ; true si appliquée ou déjà dans
+ *         cet état
+ */
+bool setRelay(int relay, bool on, RelaySource source, RelayRuleResult* refusal) {
+  if (refusal != nullptr) *refusal = { RULE_OK, -1, 0 };
+
+  if (relay < 0 || relay >= NUM_RELAYS) {
+    LOG_E(LOG_SYSTEM, "Index relais invalide: %d", relay);
+    return false;
+  }
+
+  if (relayMutex == NULL || !xSemaphoreTakeRecursive(relayMutex, pdMS_TO_TICKS(RELAY_MUTEX_TIMEOUT_MS))) {
+    LOG_E(LOG_SYSTEM, "Relais %d: service occupe - Commande %s ignoree", relay, getRelaySourceName(source));
+    relayCommandsRefused++;
+    return false;
+  }
+
+  bool accepted = true;
+
+  if (isRelayOn(relay) != on) {
+    RelayRuleResult result = evaluateRelayRule(relayRules, relay, on, relayMask,
+                                               millis() - relayInfo[relay].changedAt,
+                                               source == RELAY_SOURCE_PROTECTION);
+
+    // Relais forcés (RULE_FORCES) allumés d'abord
+    uint8_t forced = on && result.verdict == RULE_OK ? relayRules.forces[relay] & ~relayMask : 0;
+    for (int i = 0; forced != 0 && result.verdict == RULE_OK; i++, forced >>= 1) {
+      if ((forced & 1) && !setRelay(i, true, RELAY_SOURCE_PROTECTION, &result)) {
+        if (result.verdict == RULE_OK) result.verdict = RULE_REFUSED_REQUIRES;
+        result.other = i;
+      }
+    }
+
+    if (result.verdict != RULE_OK) {
+      char reason[64];
+      formatRelayRefusal(result, reason, sizeof(reason));
+
+      // Durée minimale avec refus retourné : l'appelant attend et réessaie,
+      // pas d'avertissement à chaque essai
+      bool deferred = refusal != nullptr &&
+                      (result.verdict == RULE_REFUSED_MIN_ON || result.verdict == RULE_REFUSED_MIN_OFF);
+      if (deferred) {
+        LOG_D(LOG_SYSTEM, "%s %s differe (%s) - %s", getRelayName(relay), on ? "ON" : "OFF",
+              getRelaySourceName(source), reason);
+      } else {
+        LOG_W(LOG_SYSTEM, "PROTECTION: %s %s refuse (%s) - %s", getRelayName(relay), on ? "ON" : "OFF",
+              getRelaySourceName(source), reason);
+        relayCommandsRefused++;
+      }
+      if (refusal != nullptr) *refusal = result;
+      accepted = false;
+    } else {
+      digitalWrite(relayPins[relay], on ? HIGH : LOW);
+
+      portENTER_CRITICAL(&relayInfoMux);
+      relayInfo[relay].on = on;
+      relayInfo[relay].source = source;
+      relayInfo[relay].changedAt = millis();
+      relayInfo[relay].changedEpoch = (uint32_t)getCachedEpoch();
+      relayInfo[relay].transitions++;
+      if (on) relayMask |= (1 << relay);
+      else relayMask &= ~(1 << relay);
+      portEXIT_CRITICAL(&relayInfoMux);
+
+      LOG_D(LOG_SYSTEM, "Relais %d -> %s (%s)", relay, on ? "ON" : "OFF", getRelaySourceName(source));
+
+      RelayEvent event = { (uint8_t)relay, on, source };
+      dispatchRelayEvent(event);
+    }
+  }
+
+  xSemaphoreGiveRecursive(relayMutex);
+  return accepted;
+}
+
+#endif // RELAY_SERVICE_H
@@ -1,7 +1,7 @@
 /* 
  * POOL CONNECT - SCÉNARIOS PRÉ-CONFIGURÉS
  * Configurations types prêtes à l'emploi
- * scenarios.h   V0.2
+ * scenarios.h   V0.3
  */
 
 #ifndef SCENARIOS_H
@@ -9,6 +9,9 @@
 
 #include <Arduino.h>
 #include "types.h"
+#include "globals.h"
+#include "logging.h"
+#include "storage.h"
 
 // ============================================================================
 // DÉFINITION DES SCÉNARIOS
@@ -468,6 +471,34 @@ FlexibleTimer createTimerFromScenario(ScenarioType type) {
   return timer;
 }
 
+// ============================================================================
+// APPLICATION D'UN SCÉNARIO
+// ============================================================================
+
+/**
+ * Ajoute le timer d'un scénario et l'enregistre (web et MQTT).
+ *
+ * @param scenarioId Index dans SCENARIOS (vérifié par l'appelant)
+ * @return timer créé, nullptr si la limite de timers est atteinte
+ */
+FlexibleTimer* addScenarioTimer(int scenarioId) {
+  if (flexTimerCount >= MAX_TIMERS) {
+    LOG_E(LOG_SCENARIO, "Limite timers atteinte: %d/%d", flexTimerCount, MAX_TIMERS);
+    return nullptr;
+  }
+  
+  FlexibleTimer* timer = &flexTimers[flexTimerCount];
+  *timer = createTimerFromScenario((ScenarioType)scenarioId);
+  flexTimerCount++;
+  
+  LOG_I(LOG_SCENARIO, "Timer cree depuis scenario: '%s' (total: %d/%d)",
+        timer->name.c_str(), flexTimerCount, MAX_TIMERS);
+  
+  saveFlexTimer(*timer);
+  saveFlexTimerIndex();
+  return timer;
+}
+
 // ============================================================================
 // OBTENIR LISTE DES SCÉNARIOS (POUR API)
 // ============================================================================
@@ -1,7 +1,7 @@
 /* 
  * POOL CONNECT - SENSORS
  * Gestion des capteurs et calibration
- * sensor.h   V0.2
+ * sensor.h   V0.3
  */
 
 #ifndef SENSORS_H
@@ -15,6 +15,7 @@
 #include "config.h"
 #include "logging.h"
 #include "led_buzzer.h"
+#include "relay_service.h"
 #include "chart_storage.h"
 #include "chart_event_points.h"
 
@@ -313,7 +314,7 @@ void readSensors() {
           LOG_I(LOG_SENSOR, "Etat actuel des relais:");
           const char* relayNames[] = {"Pompe", "Electrolyseur", "Lampe", "Electrovalve", "PAC"};
           for (int i = 0; i < NUM_RELAYS; i++) {
-            bool state = digitalRead(relayPins[i]) == HIGH;
+            bool state = isRelayOn(i);
             LOG_I(LOG_SENSOR, "  %s: %s", relayNames[i], state ? "ON" : "OFF");
           }
 
@@ -347,14 +348,16 @@ void readSensors() {
     
     coverOpen = (digitalRead(SENSOR_VOLET) == LOW);
     
-    // Log uniquement si changement d'état
+    // Log sur changement d'état (rappel toutes les 60s)
     if (coverOpen != lastCoverState || (millis() - lastCoverLog > 60000)) {
       LOG_I(LOG_SENSOR, "Volet piscine: %s", coverOpen ? "OUVERT" : "FERME");
       lastCoverLog = millis();
-      lastCoverState = coverOpen;
 
-      //Capturer sur le graphique
-      captureCurrentStateToChart();
+      //Capturer sur le graphique uniquement sur changement réel
+      if (coverOpen != lastCoverState) {
+        captureCurrentStateToChart();
+      }
+      lastCoverState = coverOpen;
     }
     
     xSemaphoreGive(dataMutex);
@@ -1,7 +1,7 @@
 /* 
  * POOL CONNECT - STORAGE
  * Gestion du stockage et persistence
- * storage.h  V0.2
+ * storage.h  V0.6
  */
 
 #ifndef STORAGE_H
@@ -11,6 +11,7 @@
 #include <LittleFS.h>
 #include <ArduinoJson.h>
 #include "globals.h"
+#include "time_service.h"
 #include "config.h"
 #include "logging.h"
 
@@ -201,7 +202,7 @@ void addHistoryEntry(int duration, float avgTemp) {
   LOG_D(LOG_STORAGE, "Ajout d'une entree dans l'historique...");
   
   struct tm timeinfo;
-  if (!getLocalTime(&timeinfo)) {
+  if (!getCachedTime(&timeinfo)) {
     LOG_E(LOG_STORAGE, "NTP non synchronise - Impossible d'ajouter l'entree");
     return;
   }
@@ -230,190 +231,612 @@ void addHistoryEntry(int duration, float avgTemp) {
   saveHistory();
 }
 
+// ============================================================================
+// TIMERS - CONVERSION JSON
+// ============================================================================
+
+#define TIMER_HEAD_DOC_SIZE 2048      // Timer sans ses actions
+#define TIMER_ACTION_DOC_SIZE 512     // Une action
+#define TIMER_FILTER_DOC_SIZE 256     // Filtre de l'en-tête
+
+/**
+ * Flux en lecture sur un texte JSON en mémoire (corps de requête), relu
+ * en deux passes par readTimerHead() puis readTimerActions().
+ */
+class TimerJsonStream : public Stream {
+public:
+  TimerJsonStream(const String& text) : data(text.c_str()), length(text.length()), pos(0) {}
+
+  int available() override { return length - pos; }
+  int read() override { return pos < length ? (uint8_t)data[pos++] : -1; }
+  int peek() override { return pos < length ? (uint8_t)data[pos] : -1; }
+  size_t write(uint8_t) override { return 0; }
+  void rewind() { pos = 0; }
+
+private:
+  const char* data;
+  size_t length;
+  size_t pos;
+};
+
+void actionToJson(const Action& action, JsonObject act) {
+  act["type"] = (int)action.type;
+  act["relay"] = action.relay;
+  act["state"] = action.state;
+  act["delayMinutes"] = action.delayMinutes;
+  act["conditionValue"] = action.conditionValue;
+  act["maxWaitMinutes"] = action.maxWaitMinutes;
+  act["description"] = action.description;
+  act["buzzerCount"] = action.buzzerCount;
+  act["ledColor"] = action.ledColor;
+  act["ledMode"] = action.ledMode;
+  act["ledDuration"] = action.ledDuration;
+
+  // Équation personnalisée
+  if (action.type == ACTION_AUTO_DURATION || action.type == ACTION_PLANNED_FILTRATION) {
+    JsonObject eq = act.createNestedObject("customEquation");
+    eq["useCustom"] = action.customEquation.useCustom;
+    eq["expression"] = action.customEquation.expression;
+  }
+}
+
+void actionFromJson(Action& action, JsonObject a) {
+  action.type = (ActionType)(int)a["type"];
+  action.relay = a["relay"];
+  action.state = a["state"];
+  action.delayMinutes = a["delayMinutes"];
+  action.conditionValue = a["conditionValue"] | 0.0;
+  action.maxWaitMinutes = a["maxWaitMinutes"] | 0;
+  action.description = a["description"].as<String>();
+  action.buzzerCount = a["buzzerCount"] | 1;
+  action.ledColor = a["ledColor"] | 0;
+  action.ledMode = a["ledMode"] | 0;
+  action.ledDuration = a["ledDuration"] | 0;
+
+  if (a.containsKey("customEquation")) {
+    JsonObject eq = a["customEquation"];
+    action.customEquation.useCustom = eq["useCustom"] | false;
+    action.customEquation.expression = eq["expression"].as<String>();
+  }
+}
+
+void recurrenceToJson(const Recurrence& r, JsonObject obj) {
+  obj["type"] = (int)r.type;
+  obj["every"] = r.intervalMinutes;
+  obj["until"] = r.endMinutes;
+  JsonArray starts = obj.createNestedArray("starts");
+  for (int i = 0; i < r.startCount; i++) starts.add(r.starts[i]);
+  obj["parity"] = (int)r.parity;
+}
+
+/**
+ * Récurrence bornée : intervalle de 5 min minimum, heures dans la journée,
+ * liste triée sans doublon (MAX_TIMER_STARTS au plus).
+ */
+void recurrenceFromJson(Recurrence& r, JsonObject obj) {
+  r.type = (RecurrenceType)constrain(obj["type"] | 0, (int)RECUR_ONCE, (int)RECUR_LIST);
+  r.intervalMinutes = constrain(obj["every"] | 120, 5, 24 * 60);
+  r.endMinutes = constrain(obj["until"] | 20 * 60, 0, 24 * 60 - 1);
+  r.parity = (DayParity)constrain(obj["parity"] | 0, (int)DAYS_ALL, (int)DAYS_EVEN);
+
+  r.startCount = 0;
+  JsonArray starts = obj["starts"];
+  for (JsonVariant v : starts) {
+    if (r.startCount >= MAX_TIMER_STARTS) break;
+    int m = constrain(v.as<int>(), 0, 24 * 60 - 1);
+
+    // Insertion triée
+    int pos = r.startCount;
+    while (pos > 0 && r.starts[pos - 1] > m) pos--;
+    if (pos > 0 && r.starts[pos - 1] == m) continue;
+    for (int i = r.startCount; i > pos; i--) r.starts[i] = r.starts[i - 1];
+    r.starts[pos] = m;
+    r.startCount++;
+  }
+
+  // Liste vide : rien ne démarrerait jamais
+  if (r.type == RECUR_LIST && r.startCount == 0) r.type = RECUR_ONCE;
+}
+
+/**
+ * En-tête d'un timer (tous les champs sauf les actions) : la taille du
+ * document ne dépend pas du nombre d'actions.
+ */
+DeserializationError readTimerHead(Stream& in, JsonDocument& head) {
+  StaticJsonDocument<TIMER_FILTER_DOC_SIZE> filter;
+  filter["id"] = true;
+  filter["name"] = true;
+  filter["enabled"] = true;
+  filter["days"] = true;
+  filter["startTime"] = true;
+  filter["recurrence"] = true;
+  filter["conditions"] = true;
+  return deserializeJson(head, in, DeserializationOption::Filter(filter));
+}
+
+int skipJsonSpaces(Stream& in) {
+  int c = in.peek();
+  while (c == ' ' || c == '\n' || c == '\r' || c == '\t') {
+    in.read();
+    c = in.peek();
+  }
+  return c;
+}
+
+/**
+ * Avance le flux juste après le ':' d'une clé de l'objet racine. Les
+ * chaînes (valeurs, échappements) et les objets imbriqués sont sautés :
+ * un timer nommé "actions" ne trompe pas la recherche.
+ *
+ * @return false si la clé est absente (flux à la fin de l'objet racine)
+ */
+bool findTopLevelJsonKey(Stream& in, const char* key) {
+  size_t keyLength = strlen(key);
+  int depth = 0;
+  bool inString = false;
+  bool escaped = false;
+  bool candidate = false;                 // Chaîne au niveau racine, égale à key jusque-là
+  size_t matched = 0;
+
+  int c;
+  while ((c = in.read()) >= 0) {
+    if (inString) {
+      if (escaped) {
+        escaped = false;
+        candidate = false;
+      } else if (c == '\\') {
+        escaped = true;
+        candidate = false;
+      } else if (c == '"') {
+        inString = false;
+        if (candidate && matched == keyLength && skipJsonSpaces(in) == ':') {
+          in.read();
+          return true;
+        }
+      } else if (candidate) {
+        if (matched < keyLength && c == key[matched]) matched++;
+        else candidate = false;
+      }
+      continue;
+    }
+
+    if (c == '"') {
+      inString = true;
+      candidate = depth == 1;
+      matched = 0;
+    } else if (c == '{' || c == '[') {
+      depth++;
+    } else if (c == '}' || c == ']') {
+      if (--depth <= 0) return false;
+    }
+  }
+  return false;
+}
+
+/**
+ * Actions d'un timer lues une par une dans un document de
+ * TIMER_ACTION_DOC_SIZE (flux au début du JSON du timer). Au-delà de
+ * MAX_TIMER_ACTIONS, les actions sont ignorées.
+ *
+ * @param actions Destination, NULL pour seulement valider
+ * @param count Nombre d'actions, -1 si le timer n'a pas de champ "actions"
+ * @return false si le tableau ou une action est invalide
+ */
+bool readTimerActions(Stream& in, Action* actions, int* count) {
+  *count = -1;
+  if (!findTopLevelJsonKey(in, "actions")) return true;
+  if (skipJsonSpaces(in) != '[') return false;
+  in.read();
+
+  *count = 0;
+  if (skipJsonSpaces(in) == ']') return true;
+
+  StaticJsonDocument<TIMER_ACTION_DOC_SIZE> doc;
+  while (true) {
+    DeserializationError err = deserializeJson(doc, in);
+    if (err || !doc.is<JsonObject>()) return false;
+
+    if (*count < MAX_TIMER_ACTIONS) {
+      if (actions != NULL) actionFromJson(actions[*count], doc.as<JsonObject>());
+      (*count)++;
+    }
+
+    skipJsonSpaces(in);
+    int c = in.read();
+    if (c == ']') return true;
+    if (c != ',') return false;
+  }
+}
+
+/**
+ * Remplace les actions d'un timer par celles du flux (rembobiné au début
+ * du JSON). Sans champ "actions" : inchangées si partial, vidées sinon.
+ */
+bool timerActionsFromJson(FlexibleTimer& t, Stream& in, bool partial = false) {
+  int count;
+  if (!readTimerActions(in, t.actions, &count)) return false;
+  if (count >= 0) t.actionCount = count;
+  else if (!partial) t.actionCount = 0;
+  return true;
+}
+
+/**
+ * Applique un objet JSON à un timer (l'id et le contexte ne sont pas modifiés).
+ *
+ * @param partial true : seuls les champs présents sont appliqués (PATCH),
+ *                false : les champs absents prennent leur valeur par défaut
+ */
+void timerFromJson(FlexibleTimer& t, JsonObject obj, bool partial = false) {
+  if (!partial || obj.containsKey("name")) t.name = obj["name"].as<String>();
+  if (!partial || obj.containsKey("enabled")) t.enabled = obj["enabled"] | true;
+
+  if (!partial || obj.containsKey("days")) {
+    JsonArray days = obj["days"];
+    for (int i = 0; i < 7; i++) t.days[i] = days[i];
+  }
+
+  if (!partial || obj.containsKey("startTime")) {
+    JsonObject startObj = obj["startTime"];
+    t.startTime.type = (StartTimeType)(int)startObj["type"];
+    t.startTime.hour = startObj["hour"];
+    t.startTime.minute = startObj["minute"];
+    t.startTime.sunriseOffset = startObj["sunriseOffset"] | 0;
+  }
+
+  if (!partial || obj.containsKey("recurrence")) {
+    recurrenceFromJson(t.recurrence, obj["recurrence"]);
+  }
+
+  if (!partial || obj.containsKey("conditions")) {
+    JsonArray condArr = obj["conditions"];
+    t.conditionCount = constrain((int)condArr.size(), 0, MAX_TIMER_CONDITIONS);
+    for (int i = 0; i < t.conditionCount; i++) {
+      JsonObject c = condArr[i];
+      t.conditions[i].type = (ConditionType)(int)c["type"];
+      t.conditions[i].value = c["value"];
+      t.conditions[i].required = c["required"] | true;
+    }
+  }
+
+  if (!partial || obj.containsKey("actions")) {
+    JsonArray actArr = obj["actions"];
+    t.actionCount = constrain((int)actArr.size(), 0, MAX_TIMER_ACTIONS);
+    for (int i = 0; i < t.actionCount; i++) {
+      actionFromJson(t.actions[i], actArr[i]);
+    }
+  }
+}
+
+/**
+ * Écrit un timer en JSON sans construire le document complet :
+ * l'en-tête puis les actions une par une (mémoire bornée par action).
+ *
+ * @param withState true (API) : contexte d'exécution et nombre de conditions,
+ *                  false (fichier) : conditions complètes
+ */
+size_t writeTimerJson(Print& out, const FlexibleTimer& t, bool withState) {
+  DynamicJsonDocument head(TIMER_HEAD_DOC_SIZE);
+  head["id"] = t.id;
+  head["name"] = t.name;
+  head["enabled"] = t.enabled;
+
+  JsonArray days = head.createNestedArray("days");
+  for (int d = 0; d < 7; d++) days.add(t.days[d]);
+
+  JsonObject startObj = head.createNestedObject("startTime");
+  startObj["type"] = (int)t.startTime.type;
+  startObj["hour"] = t.startTime.hour;
+  startObj["minute"] = t.startTime.minute;
+  startObj["sunriseOffset"] = t.startTime.sunriseOffset;
+
+  recurrenceToJson(t.recurrence, head.createNestedObject("recurrence"));
+
+  if (withState) {
+    head["conditionCount"] = t.conditionCount;
+    head["actionCount"] = t.actionCount;
+
+    JsonObject ctx = head.createNestedObject("context");
+    ctx["state"] = (int)t.context.state;
+    ctx["currentAction"] = t.context.currentActionIndex;
+    ctx["totalElapsedMinutes"] = t.context.totalElapsedMinutes;
+    if (t.context.lastError.length() > 0) {
+      ctx["lastError"] = t.context.lastError;
+    }
+  } else {
+    JsonArray condArr = head.createNestedArray("conditions");
+    for (int c = 0; c < t.conditionCount; c++) {
+      JsonObject cond = condArr.createNestedObject();
+      cond["type"] = (int)t.conditions[c].type;
+      cond["value"] = t.conditions[c].value;
+      cond["required"] = t.conditions[c].required;
+    }
+  }
+
+  // En-tête sans son "}" final, suivi du tableau des actions
+  String headJson;
+  serializeJson(head, headJson);
+  size_t written = out.write((const uint8_t*)headJson.c_str(), headJson.length() - 1);
+  written += out.print(",\"actions\":[");
+
+  StaticJsonDocument<TIMER_ACTION_DOC_SIZE> actDoc;
+  for (int a = 0; a < t.actionCount; a++) {
+    actDoc.clear();
+    actionToJson(t.actions[a], actDoc.to<JsonObject>());
+    if (a > 0) written += out.print(",");
+    written += serializeJson(actDoc, out);
+  }
+
+  written += out.print("]}");
+  return written;
+}
+
 // ============================================================================
 // TIMERS PERSISTENCE
 // ============================================================================
 
-void saveFlexTimers() {
-  LOG_D(LOG_STORAGE, "Sauvegarde des timers flexibles...");
-  
-  File file = LittleFS.open("/timers_flex.json", "w");
+// Un fichier par timer + l'ordre d'affichage dans l'index :
+// modifier un timer ne réécrit que son propre fichier.
+#define TIMERS_DIR "/timers"
+#define TIMERS_INDEX_FILE "/timers/index.json"
+#define TIMERS_LEGACY_FILE "/timers_flex.json"
+#define TIMERS_LEGACY_BACKUP "/timers_flex.bak"
+
+void getTimerFilePath(int id, char* path, size_t size) {
+  snprintf(path, size, TIMERS_DIR "/%d.json", id);
+}
+
+void getTimerTmpPath(int id, char* path, size_t size) {
+  snprintf(path, size, TIMERS_DIR "/%d.json.tmp", id);
+}
+
+void ensureTimersDir() {
+  if (!LittleFS.exists(TIMERS_DIR)) {
+    LittleFS.mkdir(TIMERS_DIR);
+  }
+}
+
+/**
+ * Écrit le fichier d'un timer : fichier temporaire puis renommage sur
+ * l'ancien (remplacement atomique LittleFS, jamais de fichier absent).
+ */
+bool saveFlexTimer(const FlexibleTimer& t) {
+  ensureTimersDir();
+
+  char path[32];
+  char tmpPath[36];
+  getTimerFilePath(t.id, path, sizeof(path));
+  getTimerTmpPath(t.id, tmpPath, sizeof(tmpPath));
+
+  File file = LittleFS.open(tmpPath, "w");
+  if (!file) {
+    LOG_E(LOG_STORAGE, "Erreur ouverture %s en ecriture", tmpPath);
+    LOG_STORAGE_OP("WRITE", path, false);
+    return false;
+  }
+
+  size_t bytesWritten = writeTimerJson(file, t, false);
+  file.close();
+
+  if (!LittleFS.rename(tmpPath, path)) {
+    LOG_E(LOG_STORAGE, "Erreur renommage %s", tmpPath);
+    LOG_STORAGE_OP("WRITE", path, false);
+    return false;
+  }
+
+  LOG_D(LOG_STORAGE, "Timer '%s' sauvegarde: %s (%d bytes)", t.name.c_str(), path, bytesWritten);
+  LOG_STORAGE_OP("WRITE", path, true);
+  return true;
+}
+
+void removeFlexTimerFile(int id) {
+  char path[32];
+  getTimerFilePath(id, path, sizeof(path));
+  if (LittleFS.exists(path)) {
+    LittleFS.remove(path);
+    LOG_STORAGE_OP("DELETE", path, true);
+  }
+}
+
+/**
+ * Écrit l'ordre des timers (liste d'ids).
+ */
+void saveFlexTimerIndex() {
+  ensureTimersDir();
+
+  File file = LittleFS.open(TIMERS_INDEX_FILE, "w");
   if (!file) {
-    LOG_E(LOG_STORAGE, "Erreur ouverture /timers_flex.json en ecriture");
-    LOG_STORAGE_OP("WRITE", "/timers_flex.json", false);
+    LOG_E(LOG_STORAGE, "Erreur ouverture %s en ecriture", TIMERS_INDEX_FILE);
+    LOG_STORAGE_OP("WRITE", TIMERS_INDEX_FILE, false);
     return;
   }
-  
-  DynamicJsonDocument doc(32768);
-  JsonArray arr = doc.to<JsonArray>();
-  
+
+  file.print("[");
   for (int i = 0; i < flexTimerCount; i++) {
-    JsonObject obj = arr.createNestedObject();
-    FlexibleTimer* t = &flexTimers[i];
-    
-    obj["id"] = t->id;
-    obj["name"] = t->name;
-    obj["enabled"] = t->enabled;
-    
-    LOG_V(LOG_STORAGE, "Timer %d: '%s' (%s)", i, t->name.c_str(), t->enabled ? "active" : "inactif");
-    
-    JsonArray days = obj.createNestedArray("days");
-    for (int d = 0; d < 7; d++) days.add(t->days[d]);
-    
-    JsonObject startObj = obj.createNestedObject("startTime");
-    startObj["type"] = (int)t->startTime.type;
-    startObj["hour"] = t->startTime.hour;
-    startObj["minute"] = t->startTime.minute;
-    startObj["sunriseOffset"] = t->startTime.sunriseOffset;
-    
-    JsonArray condArr = obj.createNestedArray("conditions");
-    for (int c = 0; c < t->conditionCount; c++) {
-      JsonObject cond = condArr.createNestedObject();
-      cond["type"] = (int)t->conditions[c].type;
-      cond["value"] = t->conditions[c].value;
-      cond["required"] = t->conditions[c].required;
+    file.printf("%s%d", i > 0 ? "," : "", flexTimers[i].id);
+  }
+  file.print("]");
+  file.close();
+
+  LOG_STORAGE_OP("WRITE", TIMERS_INDEX_FILE, true);
+}
+
+bool isFlexTimerId(int id) {
+  for (int i = 0; i < flexTimerCount; i++) {
+    if (flexTimers[i].id == id) return true;
+  }
+  return false;
+}
+
+/**
+ * Réécrit tous les timers (restauration, migration) et supprime les
+ * fichiers des timers qui n'existent plus.
+ */
+void saveFlexTimers() {
+  LOG_D(LOG_STORAGE, "Sauvegarde des timers flexibles...");
+
+  for (int i = 0; i < flexTimerCount; i++) {
+    saveFlexTimer(flexTimers[i]);
+  }
+  saveFlexTimerIndex();
+
+  File dir = LittleFS.open(TIMERS_DIR, "r");
+  if (dir && dir.isDirectory()) {
+    File file = dir.openNextFile();
+    while (file) {
+      const char* name = file.name();
+      const char* slash = strrchr(name, '/');
+      if (slash != NULL) name = slash + 1;
+
+      int id = atoi(name);
+      bool stale = (id != 0 && !isFlexTimerId(id));
+      file.close();
+
+      if (stale) removeFlexTimerFile(id);
+      file = dir.openNextFile();
     }
-    
-    JsonArray actArr = obj.createNestedArray("actions");
-    for (int a = 0; a < t->actionCount; a++) {
-      JsonObject act = actArr.createNestedObject();
-      act["type"] = (int)t->actions[a].type;
-      act["relay"] = t->actions[a].relay;
-      act["state"] = t->actions[a].state;
-      act["delayMinutes"] = t->actions[a].delayMinutes;
-      act["conditionValue"] = t->actions[a].conditionValue;
-      act["maxWaitMinutes"] = t->actions[a].maxWaitMinutes;
-      act["description"] = t->actions[a].description;
-      act["buzzerCount"] = t->actions[a].buzzerCount;
-      act["ledColor"] = t->actions[a].ledColor;
-      act["ledMode"] = t->actions[a].ledMode;
-      act["ledDuration"] = t->actions[a].ledDuration;
-      
-      // Équation personnalisée
-      if (t->actions[a].type == ACTION_AUTO_DURATION) {
-        JsonObject eq = act.createNestedObject("customEquation");
-        eq["useCustom"] = t->actions[a].customEquation.useCustom;
-        eq["expression"] = t->actions[a].customEquation.expression;
-      }
+    dir.close();
+  }
+
+  LOG_I(LOG_STORAGE, "Timers flexibles sauvegardes: %d timers", flexTimerCount);
+}
+
+/**
+ * Lit le fichier d'un timer. Fichier absent mais temporaire présent
+ * (coupure pendant une sauvegarde d'une version précédente) : le
+ * temporaire est repris.
+ */
+bool loadFlexTimerFile(int id, FlexibleTimer& t) {
+  char path[32];
+  getTimerFilePath(id, path, sizeof(path));
+
+  if (!LittleFS.exists(path)) {
+    char tmpPath[36];
+    getTimerTmpPath(id, tmpPath, sizeof(tmpPath));
+    if (LittleFS.exists(tmpPath) && LittleFS.rename(tmpPath, path)) {
+      LOG_W(LOG_STORAGE, "Timer %d: %s repris depuis %s", id, path, tmpPath);
     }
-    
-    LOG_V(LOG_STORAGE, "  Conditions: %d, Actions: %d", t->conditionCount, t->actionCount);
   }
-  
-  size_t bytesWritten = serializeJson(doc, file);
+
+  File file = LittleFS.open(path, "r");
+  if (!file) {
+    LOG_E(LOG_STORAGE, "Timer %d: fichier %s introuvable", id, path);
+    LOG_STORAGE_OP("READ", path, false);
+    return false;
+  }
+
+  // En-tête puis actions une par une : mémoire bornée quel que soit le timer
+  DynamicJsonDocument head(TIMER_HEAD_DOC_SIZE);
+  DeserializationError err = readTimerHead(file, head);
+
+  bool ok = !err;
+  if (ok) {
+    t = FlexibleTimer();
+    t.id = id;
+    timerFromJson(t, head.as<JsonObject>());
+    file.seek(0);
+    ok = timerActionsFromJson(t, file);
+  }
   file.close();
-  
-  LOG_I(LOG_STORAGE, "Timers flexibles sauvegardes: %d timers (%d bytes)", 
-        flexTimerCount, bytesWritten);
-  LOG_STORAGE_OP("WRITE", "/timers_flex.json", true);
-}
 
-void loadFlexTimers() {
-  LOG_D(LOG_STORAGE, "Chargement des timers flexibles...");
-  
-  if (!LittleFS.exists("/timers_flex.json")) {
-    LOG_W(LOG_STORAGE, "Fichier /timers_flex.json non trouve - Aucun timer");
-    flexTimerCount = 0;
-    return;
+  if (!ok) {
+    LOG_E(LOG_STORAGE, "Erreur parsing %s: %s", path, err ? err.c_str() : "actions invalides");
+    LOG_STORAGE_OP("READ", path, false);
+    return false;
   }
-  
-  File file = LittleFS.open("/timers_flex.json", "r");
+  return true;
+}
+
+/**
+ * Ancien format (tous les timers dans /timers_flex.json) : chargé une
+ * fois, réécrit en fichiers séparés, puis renommé en .bak.
+ */
+void migrateLegacyFlexTimers() {
+  LOG_I(LOG_STORAGE, "Migration de %s vers %s/", TIMERS_LEGACY_FILE, TIMERS_DIR);
+
+  File file = LittleFS.open(TIMERS_LEGACY_FILE, "r");
   if (!file) {
-    LOG_E(LOG_STORAGE, "Erreur ouverture /timers_flex.json en lecture");
-    LOG_STORAGE_OP("READ", "/timers_flex.json", false);
-    flexTimerCount = 0;
+    LOG_E(LOG_STORAGE, "Erreur ouverture %s en lecture", TIMERS_LEGACY_FILE);
+    LOG_STORAGE_OP("READ", TIMERS_LEGACY_FILE, false);
     return;
   }
-  
+
   DynamicJsonDocument doc(32768);
   DeserializationError err = deserializeJson(doc, file);
   file.close();
-  
+
   if (err) {
     LOG_E(LOG_STORAGE, "Erreur parsing JSON timers: %s", err.c_str());
-    LOG_STORAGE_OP("READ", "/timers_flex.json", false);
-    flexTimerCount = 0;
+    LOG_STORAGE_OP("READ", TIMERS_LEGACY_FILE, false);
     return;
   }
-  
-  JsonArray arr = doc.as<JsonArray>();
-  flexTimerCount = 0;
-  
-  for (JsonObject obj : arr) {
+
+  for (JsonObject obj : doc.as<JsonArray>()) {
     if (flexTimerCount >= MAX_TIMERS) {
       LOG_W(LOG_STORAGE, "Limite MAX_TIMERS atteinte (%d), timers restants ignores", MAX_TIMERS);
       break;
     }
-    
-    FlexibleTimer* t = &flexTimers[flexTimerCount];
-    
-    t->id = obj["id"];
-    t->name = obj["name"].as<String>();
-    t->enabled = obj["enabled"] | true;
-    
-    LOG_V(LOG_STORAGE, "Chargement timer %d: '%s' (%s)", 
-          flexTimerCount, t->name.c_str(), t->enabled ? "active" : "inactif");
-    
-    JsonArray days = obj["days"];
-    for (int i = 0; i < 7; i++) t->days[i] = days[i];
-    
-    JsonObject startObj = obj["startTime"];
-    t->startTime.type = (StartTimeType)(int)startObj["type"];
-    t->startTime.hour = startObj["hour"];
-    t->startTime.minute = startObj["minute"];
-    t->startTime.sunriseOffset = startObj["sunriseOffset"] | 0;
-    
-    JsonArray condArr = obj["conditions"];
-    t->conditionCount = condArr.size();
-    LOG_V(LOG_STORAGE, "  %d conditions", t->conditionCount);
-    
-    for (int i = 0; i < t->conditionCount && i < 10; i++) {
-      JsonObject c = condArr[i];
-      t->conditions[i].type = (ConditionType)(int)c["type"];
-      t->conditions[i].value = c["value"];
-      t->conditions[i].required = c["required"] | true;
+
+    FlexibleTimer& t = flexTimers[flexTimerCount];
+    t = FlexibleTimer();
+    t.id = obj["id"];
+    timerFromJson(t, obj);
+    flexTimerCount++;
+  }
+
+  saveFlexTimers();
+  LittleFS.rename(TIMERS_LEGACY_FILE, TIMERS_LEGACY_BACKUP);
+  LOG_I(LOG_STORAGE, "Migration terminee: %d timers, ancien fichier -> %s",
+        flexTimerCount, TIMERS_LEGACY_BACKUP);
+}
+
+void loadFlexTimers() {
+  LOG_D(LOG_STORAGE, "Chargement des timers flexibles...");
+  flexTimerCount = 0;
+
+  if (!LittleFS.exists(TIMERS_INDEX_FILE)) {
+    if (LittleFS.exists(TIMERS_LEGACY_FILE)) {
+      migrateLegacyFlexTimers();
+    } else {
+      LOG_W(LOG_STORAGE, "Fichier %s non trouve - Aucun timer", TIMERS_INDEX_FILE);
     }
-    
-    JsonArray actArr = obj["actions"];
-    t->actionCount = actArr.size();
-    LOG_V(LOG_STORAGE, "  %d actions", t->actionCount);
-    
-    for (int i = 0; i < t->actionCount && i < 50; i++) {
-      JsonObject a = actArr[i];
-      t->actions[i].type = (ActionType)(int)a["type"];
-      t->actions[i].relay = a["relay"];
-      t->actions[i].state = a["state"];
-      t->actions[i].delayMinutes = a["delayMinutes"];
-      t->actions[i].conditionValue = a["conditionValue"] | 0.0;
-      t->actions[i].maxWaitMinutes = a["maxWaitMinutes"] | 0;
-      t->actions[i].description = a["description"].as<String>();
-      t->actions[i].buzzerCount = a["buzzerCount"] | 1;
-      t->actions[i].ledColor = a["ledColor"] | 0;
-      t->actions[i].ledMode = a["ledMode"] | 0;
-      t->actions[i].ledDuration = a["ledDuration"] | 0;
-      
-      // Équation personnalisée
-      if (a.containsKey("customEquation")) {
-        JsonObject eq = a["customEquation"];
-        t->actions[i].customEquation.useCustom = eq["useCustom"] | false;
-        t->actions[i].customEquation.expression = eq["expression"].as<String>();
-        
-        if (t->actions[i].customEquation.useCustom) {
-          LOG_V(LOG_STORAGE, "    Action %d: Equation personnalisee detectee", i);
-        }
-      }
+    return;
+  }
+
+  File file = LittleFS.open(TIMERS_INDEX_FILE, "r");
+  if (!file) {
+    LOG_E(LOG_STORAGE, "Erreur ouverture %s en lecture", TIMERS_INDEX_FILE);
+    LOG_STORAGE_OP("READ", TIMERS_INDEX_FILE, false);
+    return;
+  }
+
+  StaticJsonDocument<JSON_ARRAY_SIZE(MAX_TIMERS) + 64> index;
+  DeserializationError err = deserializeJson(index, file);
+  file.close();
+
+  if (err) {
+    LOG_E(LOG_STORAGE, "Erreur lecture %s: %s", TIMERS_INDEX_FILE, err.c_str());
+    LOG_STORAGE_OP("READ", TIMERS_INDEX_FILE, false);
+    return;
+  }
+
+  for (JsonVariant v : index.as<JsonArray>()) {
+    if (flexTimerCount >= MAX_TIMERS) {
+      LOG_W(LOG_STORAGE, "Limite MAX_TIMERS atteinte (%d), timers restants ignores", MAX_TIMERS);
+      break;
     }
-    
-    t->context.state = TIMER_IDLE;
-    t->context.currentActionIndex = 0;
-    t->lastTriggeredDay = -1;
-    
+
+    FlexibleTimer& t = flexTimers[flexTimerCount];
+    if (!loadFlexTimerFile(v.as<int>(), t)) continue;
+
+    LOG_V(LOG_STORAGE, "Chargement timer %d: '%s' (%s), %d conditions, %d actions",
+          flexTimerCount, t.name.c_str(), t.enabled ? "active" : "inactif",
+          t.conditionCount, t.actionCount);
     flexTimerCount++;
   }
-  
+
   LOG_I(LOG_STORAGE, "Timers flexibles charges: %d timers", flexTimerCount);
-  LOG_STORAGE_OP("READ", "/timers_flex.json", true);
-  
+  LOG_STORAGE_OP("READ", TIMERS_INDEX_FILE, true);
+
   // Résumé des timers actifs
   int activeCount = 0;
   for (int i = 0; i < flexTimerCount; i++) {
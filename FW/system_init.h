@@ -1,7 +1,7 @@
 /* 
  * POOL CONNECT - SYSTEM INITIALIZATION
  * Fonctions d'initialisation du système
- * system_init.h   V0.2
+ * system_init.h   V0.6
  */
 
 #ifndef SYSTEM_INIT_H
@@ -14,14 +14,19 @@
 #include <time.h>
 #include <Wire.h>
 #include "globals.h"
+#include "time_service.h"
 #include "config.h"
 #include "logging.h"
 #include "led_buzzer.h"
 #include "storage.h"
 #include "users.h"
 #include "sensors.h"
+#include "relay_service.h"
 #include "mqtt_manager.h"
+#include "mqtt_commands.h"
 #include "weather.h"
+#include "energy_meter.h"
+#include "heat_pump_control.h"
 #include "core_tasks.h"
 
 // ============================================================================
@@ -31,11 +36,7 @@
 void initRelays() {
   LOG_D(LOG_SYSTEM, "Initialisation des relais...");
   
-  for (int i = 0; i < NUM_RELAYS; i++) {
-    pinMode(relayPins[i], OUTPUT);
-    digitalWrite(relayPins[i], LOW);
-    LOG_V(LOG_SYSTEM, "Relais %d (Pin %d) initialise a LOW", i, relayPins[i]);
-  }
+  initRelayService();
   
   pinMode(SENSOR_VOLET, INPUT);
   LOG_V(LOG_SYSTEM, "Capteur volet (Pin %d) configure en INPUT", SENSOR_VOLET);
@@ -116,6 +117,17 @@ void loadAllConfigs() {
   
   LOG_D(LOG_STORAGE, "Chargement de la configuration meteo...");
   loadWeatherConfig();
+  loadWeatherCache();
+  
+  LOG_D(LOG_STORAGE, "Chargement de la configuration energie...");
+  loadEnergyConfig();
+  loadEnergyCounters();
+  
+  LOG_D(LOG_STORAGE, "Chargement du thermostat PAC...");
+  loadHeatPumpConfig();
+  
+  LOG_D(LOG_STORAGE, "Chargement des niveaux de log...");
+  initLogManager();
   
   LOG_I(LOG_STORAGE, "Toutes les configurations chargees avec succes");
   LOG_MEMORY();
@@ -158,12 +170,27 @@ void initSensors() {
 }
 
 // ============================================================================
-// INITIALISATION CORE 1 (Dual Core)
+// INITIALISATION DES TÂCHES (Contrôle, Réseau, Maintenance)
 // ============================================================================
 
-void initCore1() {
+bool startTask(TaskFunction_t fn, const char* name, uint32_t stack,
+               UBaseType_t priority, TaskHandle_t* handle, BaseType_t core) {
+  BaseType_t result = xTaskCreatePinnedToCore(fn, name, stack, NULL, priority, handle, core);
+  
+  if (result == pdPASS) {
+    registerMetricsTask(*handle, stack);
+    LOG_I(LOG_SYSTEM, "Tache %s lancee - Stack: %lu bytes, Priorite: %d, Core: %d",
+          name, (unsigned long)stack, (int)priority, (int)core);
+    return true;
+  }
+  
+  LOG_E(LOG_SYSTEM, "Echec du lancement de la tache %s", name);
+  return false;
+}
+
+void initTasks() {
   LOG_SEPARATOR();
-  LOG_I(LOG_SYSTEM, "Demarrage du systeme Dual Core...");
+  LOG_I(LOG_SYSTEM, "Demarrage des taches FreeRTOS...");
   
   // Créer le mutex pour la protection des données partagées
   LOG_D(LOG_SYSTEM, "Creation du mutex pour la protection des donnees...");
@@ -171,29 +198,25 @@ void initCore1() {
   
   if (dataMutex == NULL) {
     LOG_E(LOG_SYSTEM, "ERREUR CRITIQUE: Impossible de creer le mutex");
-    LOG_E(LOG_SYSTEM, "Le systeme dual-core ne peut pas demarrer");
+    LOG_E(LOG_SYSTEM, "Les taches ne peuvent pas demarrer");
     return;
   }
   LOG_I(LOG_SYSTEM, "Mutex cree avec succes");
   
-  // Démarrer la tâche sur le Core 1
-  LOG_D(LOG_SYSTEM, "Creation de la tache Core1Task...");
-  BaseType_t result = xTaskCreatePinnedToCore(
-    core1Task,          // Fonction à exécuter
-    "Core1Task",        // Nom de la tâche
-    10000,              // Taille de la pile (bytes)
-    NULL,               // Paramètre
-    1,                  // Priorité
-    &core1TaskHandle,   // Handle de la tâche
-    1                   // Core 1
-  );
-  
-  if (result == pdPASS) {
-    LOG_I(LOG_SYSTEM, "Core 1 lance avec succes");
-    LOG_V(LOG_SYSTEM, "Tache Core1Task - Stack: 10000 bytes, Priorite: 1");
-  } else {
-    LOG_E(LOG_SYSTEM, "Echec du lancement du Core 1");
+  // Files et événements entre tâches
+  if (!initTaskBus()) {
+    LOG_E(LOG_SYSTEM, "Les taches ne peuvent pas demarrer");
+    return;
   }
+  initMqttBuffer();  // Stockage des messages pendant les coupures du broker
+  initMqttCommands();  // Avant la première connexion (souscriptions)
+  
+  startTask(controlTask, "ControlTask", CONTROL_TASK_STACK,
+            CONTROL_TASK_PRIORITY, &controlTaskHandle, CONTROL_TASK_CORE);
+  startTask(networkTask, "NetworkTask", NETWORK_TASK_STACK,
+            NETWORK_TASK_PRIORITY, &networkTaskHandle, NETWORK_TASK_CORE);
+  startTask(housekeepingTask, "HousekeepingTask", HOUSEKEEPING_TASK_STACK,
+            HOUSEKEEPING_TASK_PRIORITY, &housekeepingTaskHandle, HOUSEKEEPING_TASK_CORE);
   
   LOG_MEMORY();
   LOG_SEPARATOR();
@@ -216,6 +239,7 @@ void initWiFi() {
   if (!wm.autoConnect("PoolConnect_AP")) {
     LOG_E(LOG_NETWORK, "Echec de la connexion WiFi apres timeout");
     LOG_W(LOG_NETWORK, "Redemarrage de l'ESP32...");
+    flushPersistenceBeforeRestart();
     delay(1000);
     ESP.restart();
   }
@@ -294,30 +318,8 @@ void initNTP() {
   LOG_V(LOG_NETWORK, "GMT Offset: %d secondes", GMT_OFFSET_SEC);
   LOG_V(LOG_NETWORK, "Daylight Offset: %d secondes", DAYLIGHT_OFFSET_SEC);
   
-  configTime(GMT_OFFSET_SEC, DAYLIGHT_OFFSET_SEC, NTP_SERVER);
-  LOG_I(LOG_NETWORK, "NTP configure - Attente de synchronisation...");
-  
-  // Attendre la synchronisation (max 10 secondes)
-  struct tm timeinfo;
-  int ntpRetry = 0;
-  
-  while (!getLocalTime(&timeinfo) && ntpRetry < 10) {
-    LOG_V(LOG_NETWORK, "Tentative de synchronisation NTP %d/10...", ntpRetry + 1);
-    delay(1000);
-    ntpRetry++;
-  }
-  
-  if (getLocalTime(&timeinfo)) {
-    char timeStr[64];
-    strftime(timeStr, sizeof(timeStr), "%d/%m/%Y %H:%M:%S", &timeinfo);
-    LOG_I(LOG_NETWORK, "NTP synchronise avec succes");
-    LOG_I(LOG_NETWORK, "Date et heure: %s", timeStr);
-    LOG_V(LOG_NETWORK, "Jour de l'annee: %d", timeinfo.tm_yday);
-    LOG_V(LOG_NETWORK, "Jour de la semaine: %d (0=Dimanche)", timeinfo.tm_wday);
-  } else {
-    LOG_W(LOG_NETWORK, "NTP non synchronise apres %d tentatives", ntpRetry);
-    LOG_W(LOG_NETWORK, "La synchronisation continuera en arriere-plan");
-  }
+  // Non bloquant : le service horaire (Core 1) suit la synchronisation
+  initTimeService();
   
   LOG_SEPARATOR();
 }
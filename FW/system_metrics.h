@@ -0,0 +1,522 @@
+/*
+ * POOL CONNECT - SYSTEM METRICS
+ * Mesures système : CPU et pile par tâche, tas/PSRAM, LittleFS, boucle contrôle
+ * system_metrics.h   V0.2
+ *
+ * Échantillonné toutes les 10 s par la tâche maintenance :
+ * - par tâche FreeRTOS : part de CPU depuis l'échantillon précédent (en %
+ *   d'un cœur) et marge de pile minimale jamais atteinte (high-water mark)
+ * - tas interne et PSRAM : libre, minimum, plus grand bloc, fragmentation
+ *   (100 - plus grand bloc / libre)
+ * - LittleFS : octets utilisés / total
+ * - tâche contrôle : durée de chaque section de la boucle (dernière,
+ *   moyenne et max sur la fenêtre, max depuis le démarrage) et nombre de
+ *   boucles plus longues que la période
+ *
+ * La part de CPU nécessite configGENERATE_RUN_TIME_STATS et
+ * configUSE_TRACE_FACILITY ; sans eux, seules les tâches lancées par
+ * startTask() sont listées (pile uniquement).
+ *
+ * GET /api/system/metrics   JSON du dernier échantillon
+ * GET /api/metrics          mêmes valeurs en jauges Prometheus
+ * MQTT (SYS_METRICS_MQTT)   résumé sur <topic>/system/... toutes les 60 s
+ */
+
+#ifndef SYSTEM_METRICS_H
+#define SYSTEM_METRICS_H
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <esp_heap_caps.h>
+#include "config.h"
+#include "globals.h"
+#include "logging.h"
+#include "task_bus.h"
+#include "web_stream.h"
+
+// ============================================================================
+// CONSTANTES
+// ============================================================================
+
+#define SYS_METRICS_SAMPLE_MS 10000
+#define SYS_METRICS_MAX_TASKS 24
+#define SYS_METRICS_MAX_KNOWN_TASKS 8
+#define SYS_METRICS_TASK_NAME_LEN 16
+#define SYS_METRICS_STACK_WARN 1024        // Octets de pile jamais utilisés
+#define SYS_METRICS_BLOCK_WARN 16384       // Plus grand bloc interne
+#define SYS_METRICS_WARN_INTERVAL_MS 600000
+#define SYS_METRICS_MQTT_MESSAGES 8
+
+#if configUSE_TRACE_FACILITY && configGENERATE_RUN_TIME_STATS
+  #define SYS_METRICS_TASK_STATS 1
+#else
+  #define SYS_METRICS_TASK_STATS 0
+#endif
+
+// Sections de la boucle de la tâche contrôle
+enum LoopSection {
+  LOOP_SECTION_TIME = 0,
+  LOOP_SECTION_SENSORS,
+  LOOP_SECTION_TIMERS,
+  LOOP_SECTION_HEATING,
+  LOOP_SECTION_ALARMS,
+  LOOP_SECTION_TOTAL,
+  LOOP_SECTION_COUNT
+};
+
+const char* const LOOP_SECTION_NAMES[LOOP_SECTION_COUNT] = {
+  "time", "sensors", "timers", "heating", "alarms", "total"
+};
+
+// ============================================================================
+// STRUCTURES
+// ============================================================================
+
+struct LoopSectionStats {
+  uint32_t count;
+  uint64_t sumUs;
+  uint32_t lastUs;
+  uint32_t maxUs;                          // Sur la fenêtre d'échantillonnage
+  uint32_t peakUs;                         // Depuis le démarrage
+};
+
+struct TaskMetrics {
+  char name[SYS_METRICS_TASK_NAME_LEN];
+  uint8_t priority;
+  uint32_t stackSize;                      // 0 si inconnue (tâche du système)
+  uint32_t stackFree;                      // High-water mark, en octets
+  float cpuPercent;                        // -1 si non disponible
+};
+
+struct HeapMetrics {
+  uint32_t total;
+  uint32_t free;
+  uint32_t minFree;
+  uint32_t largestBlock;
+  uint8_t fragmentation;                   // %
+};
+
+struct SystemMetrics {
+  unsigned long sampledAt;                 // millis()
+  uint8_t taskCount;
+  TaskMetrics tasks[SYS_METRICS_MAX_TASKS];
+  HeapMetrics internal;
+  HeapMetrics psram;                       // total = 0 sans PSRAM
+  uint32_t fsTotal;
+  uint32_t fsUsed;
+  LoopSectionStats loop[LOOP_SECTION_COUNT];
+  uint32_t loopBudgetUs;                   // Période de la tâche contrôle
+  uint32_t loopOverruns;                   // Boucles plus longues que la période
+};
+
+struct KnownTask {
+  TaskHandle_t handle;
+  uint32_t stackSize;
+};
+
+struct TaskRuntime {
+  TaskHandle_t handle;
+  uint32_t runtime;
+};
+
+// ============================================================================
+// VARIABLES GLOBALES
+// ============================================================================
+
+SystemMetrics systemMetrics;               // Dernier échantillon (sous metricsMux)
+portMUX_TYPE metricsMux = portMUX_INITIALIZER_UNLOCKED;
+
+LoopSectionStats loopStats[LOOP_SECTION_COUNT];
+uint32_t loopOverruns = 0;
+uint32_t loopBudgetUs = 0;
+portMUX_TYPE loopStatsMux = portMUX_INITIALIZER_UNLOCKED;
+
+KnownTask knownTasks[SYS_METRICS_MAX_KNOWN_TASKS];
+int knownTaskCount = 0;
+
+TaskRuntime previousRuntimes[SYS_METRICS_MAX_TASKS];
+int previousRuntimeCount = 0;
+uint32_t previousTotalRuntime = 0;
+
+unsigned long lastMetricsSample = 0;
+unsigned long lastMetricsMqtt = 0;
+unsigned long lastMetricsWarning = 0;
+
+// ============================================================================
+// ENREGISTREMENT
+// ============================================================================
+
+/**
+ * Note la taille de pile d'une tâche lancée par le firmware (appelé par
+ * startTask()) : le high-water mark seul ne dit pas quelle marge il reste.
+ */
+void registerMetricsTask(TaskHandle_t handle, uint32_t stackSize) {
+  if (handle == NULL || knownTaskCount >= SYS_METRICS_MAX_KNOWN_TASKS) return;
+  knownTasks[knownTaskCount].handle = handle;
+  knownTasks[knownTaskCount].stackSize = stackSize;
+  knownTaskCount++;
+}
+
+uint32_t getKnownTaskStackSize(TaskHandle_t handle) {
+  for (int i = 0; i < knownTaskCount; i++) {
+    if (knownTasks[i].handle == handle) return knownTasks[i].stackSize;
+  }
+  return 0;
+}
+
+// ============================================================================
+// BOUCLE DE LA TÂCHE CONTRÔLE
+// ============================================================================
+
+/**
+ * Enregistre la durée d'une section (appelé par la tâche contrôle).
+ */
+void recordLoopSection(LoopSection section, uint32_t elapsedUs) {
+  portENTER_CRITICAL(&loopStatsMux);
+  LoopSectionStats& s = loopStats[section];
+  s.count++;
+  s.sumUs += elapsedUs;
+  s.lastUs = elapsedUs;
+  if (elapsedUs > s.maxUs) s.maxUs = elapsedUs;
+  if (elapsedUs > s.peakUs) s.peakUs = elapsedUs;
+  portEXIT_CRITICAL(&loopStatsMux);
+}
+
+/**
+ * Fin d'itération : durée totale, dépassement si plus longue que la période.
+ */
+void recordLoopIteration(uint32_t elapsedUs, uint32_t budgetUs) {
+  recordLoopSection(LOOP_SECTION_TOTAL, elapsedUs);
+  loopBudgetUs = budgetUs;
+  if (elapsedUs > budgetUs) {
+    portENTER_CRITICAL(&loopStatsMux);
+    loopOverruns++;
+    portEXIT_CRITICAL(&loopStatsMux);
+  }
+}
+
+/**
+ * Mesure les sections successives d'une itération :
+ *   LoopTimer t;  ...  t.lap(LOOP_SECTION_TIME);  ...  t.finish(periodUs);
+ */
+class LoopTimer {
+public:
+  LoopTimer() : startUs(micros()), lapUs(startUs) {}
+
+  void lap(LoopSection section) {
+    unsigned long now = micros();
+    recordLoopSection(section, now - lapUs);
+    lapUs = now;
+  }
+
+  void finish(uint32_t budgetUs) {
+    recordLoopIteration(micros() - startUs, budgetUs);
+  }
+
+private:
+  unsigned long startUs;
+  unsigned long lapUs;
+};
+
+// ============================================================================
+// ÉCHANTILLONNAGE
+// ============================================================================
+
+void sampleHeap(HeapMetrics& heap, uint32_t caps) {
+  heap.total = heap_caps_get_total_size(caps);
+  heap.free = heap_caps_get_free_size(caps);
+  heap.minFree = heap_caps_get_minimum_free_size(caps);
+  heap.largestBlock = heap_caps_get_largest_free_block(caps);
+  heap.fragmentation = heap.free > 0 ? 100 - (uint8_t)((uint64_t)heap.largestBlock * 100 / heap.free) : 0;
+}
+
+#if SYS_METRICS_TASK_STATS
+/**
+ * Toutes les tâches du système, part de CPU calculée sur l'écart des
+ * compteurs depuis l'échantillon précédent.
+ */
+void sampleTasks(SystemMetrics& sample) {
+  static TaskStatus_t status[SYS_METRICS_MAX_TASKS];
+  uint32_t totalRuntime = 0;
+  UBaseType_t count = uxTaskGetSystemState(status, SYS_METRICS_MAX_TASKS, &totalRuntime);
+  if (count == 0) {
+    LOG_W(LOG_SYSTEM, "Metriques: plus de %d taches, liste ignoree", SYS_METRICS_MAX_TASKS);
+    sample.taskCount = 0;
+    return;
+  }
+
+  uint32_t totalDelta = totalRuntime - previousTotalRuntime;
+
+  for (UBaseType_t i = 0; i < count; i++) {
+    TaskMetrics& t = sample.tasks[i];
+    strlcpy(t.name, status[i].pcTaskName, sizeof(t.name));
+    t.priority = status[i].uxCurrentPriority;
+    t.stackSize = getKnownTaskStackSize(status[i].xHandle);
+    t.stackFree = status[i].usStackHighWaterMark;
+    t.cpuPercent = -1;
+
+    for (int p = 0; p < previousRuntimeCount && totalDelta > 0; p++) {
+      if (previousRuntimes[p].handle != status[i].xHandle) continue;
+      t.cpuPercent = (status[i].ulRunTimeCounter - previousRuntimes[p].runtime) * 100.0f / totalDelta;
+      break;
+    }
+  }
+  sample.taskCount = count;
+
+  for (UBaseType_t i = 0; i < count; i++) {
+    previousRuntimes[i].handle = status[i].xHandle;
+    previousRuntimes[i].runtime = status[i].ulRunTimeCounter;
+  }
+  previousRuntimeCount = count;
+  previousTotalRuntime = totalRuntime;
+}
+#else
+/**
+ * Sans statistiques FreeRTOS : tâches du firmware uniquement, sans CPU.
+ */
+void sampleTasks(SystemMetrics& sample) {
+  sample.taskCount = 0;
+  for (int i = 0; i < knownTaskCount; i++) {
+    TaskMetrics& t = sample.tasks[sample.taskCount++];
+    strlcpy(t.name, pcTaskGetName(knownTasks[i].handle), sizeof(t.name));
+    t.priority = uxTaskPriorityGet(knownTasks[i].handle);
+    t.stackSize = knownTasks[i].stackSize;
+    t.stackFree = uxTaskGetStackHighWaterMark(knownTasks[i].handle);
+    t.cpuPercent = -1;
+  }
+}
+#endif
+
+/**
+ * Signale une pile ou un tas proche de la limite (au plus toutes les 10 min).
+ */
+void checkMetricsThresholds(const SystemMetrics& sample) {
+  if (lastMetricsWarning != 0 && millis() - lastMetricsWarning < SYS_METRICS_WARN_INTERVAL_MS) return;
+
+  bool warned = false;
+  for (int i = 0; i < sample.taskCount; i++) {
+    const TaskMetrics& t = sample.tasks[i];
+    if (t.stackSize > 0 && t.stackFree < SYS_METRICS_STACK_WARN) {
+      LOG_W(LOG_SYSTEM, "Pile presque pleine: %s (%lu / %lu bytes libres)",
+            t.name, (unsigned long)t.stackFree, (unsigned long)t.stackSize);
+      warned = true;
+    }
+  }
+
+  if (sample.internal.largestBlock < SYS_METRICS_BLOCK_WARN) {
+    LOG_W(LOG_SYSTEM, "Tas fragmente: plus grand bloc %lu bytes (libre %lu, fragmentation %d%%)",
+          (unsigned long)sample.internal.largestBlock, (unsigned long)sample.internal.free,
+          sample.internal.fragmentation);
+    warned = true;
+  }
+
+  if (warned) lastMetricsWarning = millis();
+}
+
+/**
+ * Prend un nouvel échantillon (appelé par la tâche maintenance).
+ */
+void sampleSystemMetrics() {
+  static SystemMetrics sample;             // Hors pile de la tâche maintenance
+
+  sample.sampledAt = millis();
+  sampleTasks(sample);
+  sampleHeap(sample.internal, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+  sampleHeap(sample.psram, MALLOC_CAP_SPIRAM);
+  sample.fsTotal = LittleFS.totalBytes();
+  sample.fsUsed = LittleFS.usedBytes();
+
+  // Fenêtre de la boucle contrôle : copiée puis remise à zéro
+  portENTER_CRITICAL(&loopStatsMux);
+  memcpy(sample.loop, loopStats, sizeof(loopStats));
+  sample.loopOverruns = loopOverruns;
+  sample.loopBudgetUs = loopBudgetUs;
+  for (int i = 0; i < LOOP_SECTION_COUNT; i++) {
+    loopStats[i].count = 0;
+    loopStats[i].sumUs = 0;
+    loopStats[i].maxUs = 0;
+  }
+  portEXIT_CRITICAL(&loopStatsMux);
+
+  portENTER_CRITICAL(&metricsMux);
+  memcpy(&systemMetrics, &sample, sizeof(SystemMetrics));
+  portEXIT_CRITICAL(&metricsMux);
+
+  checkMetricsThresholds(sample);
+}
+
+/**
+ * Copie cohérente du dernier échantillon (autres tâches).
+ */
+void getSystemMetrics(SystemMetrics& out) {
+  portENTER_CRITICAL(&metricsMux);
+  memcpy(&out, &systemMetrics, sizeof(SystemMetrics));
+  portEXIT_CRITICAL(&metricsMux);
+}
+
+uint32_t getLoopSectionAverage(const LoopSectionStats& s) {
+  return s.count > 0 ? (uint32_t)(s.sumUs / s.count) : 0;
+}
+
+/**
+ * Plus petite marge de pile parmi les tâches du firmware.
+ */
+const TaskMetrics* getLowestStackTask(const SystemMetrics& sample) {
+  const TaskMetrics* lowest = NULL;
+  for (int i = 0; i < sample.taskCount; i++) {
+    const TaskMetrics& t = sample.tasks[i];
+    if (t.stackSize == 0) continue;
+    if (lowest == NULL || t.stackFree < lowest->stackFree) lowest = &t;
+  }
+  return lowest;
+}
+
+// ============================================================================
+// MQTT
+// ============================================================================
+
+/**
+ * Résumé publié via la file MQTT, seulement s'il reste de la place pour
+ * les états des relais.
+ */
+void publishSystemMetricsMqtt(const SystemMetrics& sample) {
+  if (mqttOutQueue == NULL) return;
+  if (uxQueueSpacesAvailable(mqttOutQueue) < SYS_METRICS_MQTT_MESSAGES + 4) {
+    LOG_V(LOG_MQTT, "File MQTT chargee - Metriques systeme reportees");
+    return;
+  }
+
+  char value[16];
+  snprintf(value, sizeof(value), "%lu", (unsigned long)sample.internal.free);
+  queueMqttPublish("system/heap_free", value);
+  snprintf(value, sizeof(value), "%lu", (unsigned long)sample.internal.minFree);
+  queueMqttPublish("system/heap_min_free", value);
+  snprintf(value, sizeof(value), "%lu", (unsigned long)sample.internal.largestBlock);
+  queueMqttPublish("system/heap_largest_block", value);
+  snprintf(value, sizeof(value), "%d", sample.internal.fragmentation);
+  queueMqttPublish("system/heap_fragmentation", value);
+  snprintf(value, sizeof(value), "%lu", (unsigned long)sample.psram.free);
+  queueMqttPublish("system/psram_free", value);
+  snprintf(value, sizeof(value), "%lu", (unsigned long)sample.fsUsed);
+  queueMqttPublish("system/fs_used", value);
+
+  const TaskMetrics* lowest = getLowestStackTask(sample);
+  snprintf(value, sizeof(value), "%lu", lowest ? (unsigned long)lowest->stackFree : 0UL);
+  queueMqttPublish("system/stack_min_free", value);
+  snprintf(value, sizeof(value), "%lu", (unsigned long)sample.loop[LOOP_SECTION_TOTAL].maxUs);
+  queueMqttPublish("system/control_loop_max_us", value);
+}
+
+/**
+ * Appelé à chaque tour de la tâche maintenance.
+ */
+void processSystemMetrics() {
+  unsigned long now = millis();
+  if (lastMetricsSample != 0 && now - lastMetricsSample < SYS_METRICS_SAMPLE_MS) return;
+  lastMetricsSample = now;
+
+  sampleSystemMetrics();
+
+  if (SYS_METRICS_MQTT && now - lastMetricsMqtt >= SYS_METRICS_MQTT_INTERVAL_MS) {
+    lastMetricsMqtt = now;
+    publishSystemMetricsMqtt(systemMetrics);
+  }
+}
+
+// ============================================================================
+// EXPORT
+// ============================================================================
+
+void writeHeapMetricsJson(ChunkedResponse& response, const char* name, const HeapMetrics& heap) {
+  response.printf("\"%s\":{\"total\":%lu,\"free\":%lu,\"minFree\":%lu,\"largestBlock\":%lu,\"fragmentation\":%d}",
+                  name, (unsigned long)heap.total, (unsigned long)heap.free, (unsigned long)heap.minFree,
+                  (unsigned long)heap.largestBlock, heap.fragmentation);
+}
+
+void writeSystemMetricsJson(ChunkedResponse& response, const SystemMetrics& sample) {
+  response.printf("{\"uptime\":%lu,\"age\":%lu,\"cpuStats\":%s,\"tasks\":[",
+                  millis() / 1000, (millis() - sample.sampledAt) / 1000,
+                  SYS_METRICS_TASK_STATS ? "true" : "false");
+
+  for (int i = 0; i < sample.taskCount; i++) {
+    const TaskMetrics& t = sample.tasks[i];
+    response.printf("%s{\"name\":\"%s\",\"priority\":%d,\"stackFree\":%lu",
+                    i == 0 ? "" : ",", t.name, t.priority, (unsigned long)t.stackFree);
+    if (t.stackSize > 0) response.printf(",\"stackSize\":%lu", (unsigned long)t.stackSize);
+    if (t.cpuPercent >= 0) response.printf(",\"cpu\":%.1f", t.cpuPercent);
+    response.print("}");
+  }
+
+  response.print("],\"heap\":{");
+  writeHeapMetricsJson(response, "internal", sample.internal);
+  response.print(",");
+  writeHeapMetricsJson(response, "psram", sample.psram);
+  response.printf("},\"fs\":{\"total\":%lu,\"used\":%lu},\"controlLoop\":{\"periodUs\":%lu,\"overruns\":%lu",
+                  (unsigned long)sample.fsTotal, (unsigned long)sample.fsUsed,
+                  (unsigned long)sample.loopBudgetUs, (unsigned long)sample.loopOverruns);
+
+  for (int i = 0; i < LOOP_SECTION_COUNT; i++) {
+    const LoopSectionStats& s = sample.loop[i];
+    response.printf(",\"%s\":{\"lastUs\":%lu,\"avgUs\":%lu,\"maxUs\":%lu,\"peakUs\":%lu}",
+                    LOOP_SECTION_NAMES[i], (unsigned long)s.lastUs, (unsigned long)getLoopSectionAverage(s),
+                    (unsigned long)s.maxUs, (unsigned long)s.peakUs);
+  }
+
+  response.print("}}");
+}
+
+void writeSystemMetricsPrometheus(ChunkedResponse& response, const SystemMetrics& sample) {
+  response.print("# HELP poolconnect_task_stack_free_bytes Pile jamais utilisee par tache\n"
+                 "# TYPE poolconnect_task_stack_free_bytes gauge\n"
+                 "# HELP poolconnect_task_cpu_percent Part de CPU (% d'un coeur) sur 10 s\n"
+                 "# TYPE poolconnect_task_cpu_percent gauge\n");
+  for (int i = 0; i < sample.taskCount; i++) {
+    const TaskMetrics& t = sample.tasks[i];
+    response.printf("poolconnect_task_stack_free_bytes{task=\"%s\"} %lu\n", t.name, (unsigned long)t.stackFree);
+    if (t.cpuPercent >= 0) response.printf("poolconnect_task_cpu_percent{task=\"%s\"} %.1f\n", t.name, t.cpuPercent);
+  }
+
+  const HeapMetrics* heaps[2] = { &sample.internal, &sample.psram };
+  const char* heapNames[2] = { "internal", "psram" };
+  response.print("# HELP poolconnect_heap_free_bytes Tas libre\n"
+                 "# TYPE poolconnect_heap_free_bytes gauge\n"
+                 "# HELP poolconnect_heap_min_free_bytes Tas libre minimum depuis le demarrage\n"
+                 "# TYPE poolconnect_heap_min_free_bytes gauge\n"
+                 "# HELP poolconnect_heap_largest_block_bytes Plus grand bloc allouable\n"
+                 "# TYPE poolconnect_heap_largest_block_bytes gauge\n");
+  for (int i = 0; i < 2; i++) {
+    response.printf("poolconnect_heap_free_bytes{heap=\"%s\"} %lu\n", heapNames[i], (unsigned long)heaps[i]->free);
+    response.printf("poolconnect_heap_min_free_bytes{heap=\"%s\"} %lu\n", heapNames[i], (unsigned long)heaps[i]->minFree);
+    response.printf("poolconnect_heap_largest_block_bytes{heap=\"%s\"} %lu\n", heapNames[i], (unsigned long)heaps[i]->largestBlock);
+  }
+
+  response.printf("# TYPE poolconnect_fs_used_bytes gauge\npoolconnect_fs_used_bytes %lu\n"
+                  "# TYPE poolconnect_fs_total_bytes gauge\npoolconnect_fs_total_bytes %lu\n",
+                  (unsigned long)sample.fsUsed, (unsigned long)sample.fsTotal);
+
+  response.print("# HELP poolconnect_control_loop_max_seconds Duree max par section (fenetre 10 s)\n"
+                 "# TYPE poolconnect_control_loop_max_seconds gauge\n");
+  for (int i = 0; i < LOOP_SECTION_COUNT; i++) {
+    response.printf("poolconnect_control_loop_max_seconds{section=\"%s\"} %.6f\n",
+                    LOOP_SECTION_NAMES[i], sample.loop[i].maxUs / 1000000.0);
+  }
+  response.printf("# TYPE poolconnect_control_loop_overruns_total counter\n"
+                  "poolconnect_control_loop_overruns_total %lu\n", (unsigned long)sample.loopOverruns);
+}
+
+/**
+ * GET /api/system/metrics
+ */
+void handleApiSystemMetrics() {
+  LOG_WEB_REQUEST("GET", "/api/system/metrics");
+
+  static SystemMetrics sample;             // Tâche web uniquement
+  getSystemMetrics(sample);
+
+  ChunkedResponse response;
+  response.begin(200, "application/json");
+  writeSystemMetricsJson(response, sample);
+  response.end();
+}
+
+#endif // SYSTEM_METRICS_H
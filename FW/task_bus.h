@@ -0,0 +1,199 @@
+/*
+ * POOL CONNECT - TASK BUS
+ * Communication entre les tâches FreeRTOS (contrôle, réseau, maintenance)
+ * task_bus.h   V0.2
+ *
+ * - Un groupe d'événements pour les demandes ponctuelles
+ *   (nouvelles mesures, rafraîchissement météo, reconfiguration MQTT...)
+ * - Une file bornée de messages MQTT à publier : la tâche de contrôle et le
+ *   serveur web n'appellent jamais mqttClient directement (PubSubClient n'est
+ *   pas thread-safe et une publication peut bloquer sur le réseau).
+ * - Une file bornée de points graphique : seule la tâche maintenance modifie
+ *   le buffer du graphique et l'écrit sur la flash.
+ * - Avant un redémarrage, la sauvegarde (graphique, compteurs) est demandée
+ *   à la tâche maintenance et attendue : jamais deux écritures du même
+ *   fichier en parallèle.
+ *
+ * Tous les envois sont non bloquants : si la file est pleine, le message est
+ * abandonné et compté.
+ */
+
+#ifndef TASK_BUS_H
+#define TASK_BUS_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "globals.h"
+#include "logging.h"
+#include "chart_storage.h"
+
+// ============================================================================
+// CONSTANTES
+// ============================================================================
+
+#define MQTT_OUT_QUEUE_LENGTH 16
+#define MQTT_OUT_TOPIC_LEN 48
+#define MQTT_OUT_PAYLOAD_LEN 32
+#define CHART_POINT_QUEUE_LENGTH 8
+#define PERSIST_FLUSH_TIMEOUT_MS 5000     // Période maintenance + écriture de current.json
+
+// Bits du groupe d'événements
+#define EVT_SYSTEM_READY      (1 << 0)   // Setup terminé (chart, archivage initialisés)
+#define EVT_SENSORS_UPDATED   (1 << 1)   // Contrôle -> Réseau : nouvelles mesures
+#define EVT_WEATHER_REFRESH   (1 << 2)   // Web -> Réseau : mise à jour météo demandée
+#define EVT_MQTT_RECONFIGURE  (1 << 3)   // Web -> Réseau : serveur MQTT modifié
+#define EVT_MQTT_REDISCOVER   (1 << 4)   // Web -> Réseau : republier la découverte HA
+#define EVT_LIVE_CHANGED      (1 << 5)   // -> Web : mesures ou relais modifiés (flux direct)
+#define EVT_PERSIST_FLUSH     (1 << 6)   // -> Maintenance : tout écrire, redémarrage imminent
+#define EVT_PERSIST_DONE      (1 << 7)   // Maintenance -> : écriture terminée
+
+// ============================================================================
+// STRUCTURES
+// ============================================================================
+
+struct MqttOutMessage {
+  char topic[MQTT_OUT_TOPIC_LEN];       // Relatif à mqttTopic (ex: "relay/1/state")
+  char payload[MQTT_OUT_PAYLOAD_LEN];
+  bool retain;
+};
+
+// ============================================================================
+// DÉCLARATIONS FORWARD
+// ============================================================================
+
+void flushEnergyCounters();
+
+// ============================================================================
+// VARIABLES GLOBALES
+// ============================================================================
+
+EventGroupHandle_t systemEvents = NULL;
+QueueHandle_t mqttOutQueue = NULL;
+QueueHandle_t chartPointQueue = NULL;
+unsigned long mqttOutDropped = 0;
+unsigned long chartPointsDropped = 0;
+volatile bool persistenceFrozen = false;    // Sauvegarde faite, redémarrage imminent
+
+// ============================================================================
+// INITIALISATION
+// ============================================================================
+
+bool initTaskBus() {
+  systemEvents = xEventGroupCreate();
+  mqttOutQueue = xQueueCreate(MQTT_OUT_QUEUE_LENGTH, sizeof(MqttOutMessage));
+  chartPointQueue = xQueueCreate(CHART_POINT_QUEUE_LENGTH, sizeof(ChartDataPoint));
+
+  if (systemEvents == NULL || mqttOutQueue == NULL || chartPointQueue == NULL) {
+    LOG_E(LOG_SYSTEM, "ERREUR CRITIQUE: Impossible de creer le bus inter-taches");
+    return false;
+  }
+
+  LOG_I(LOG_SYSTEM, "Bus inter-taches cree (file MQTT: %d messages)", MQTT_OUT_QUEUE_LENGTH);
+  return true;
+}
+
+// ============================================================================
+// ENVOI
+// ============================================================================
+
+/**
+ * Signale un événement aux autres tâches (non bloquant).
+ */
+void postSystemEvent(EventBits_t bits) {
+  if (systemEvents != NULL) {
+    xEventGroupSetBits(systemEvents, bits);
+  }
+}
+
+/**
+ * Place un message MQTT dans la file de la tâche réseau (non bloquant).
+ *
+ * @param topic Sous-topic relatif à mqttTopic
+ * @param payload Contenu du message
+ * @param retain Message retenu par le broker
+ * @return false si la file est pleine ou non initialisée
+ */
+bool queueMqttPublish(const char* topic, const char* payload, bool retain = false) {
+  if (mqttOutQueue == NULL) return false;
+
+  MqttOutMessage msg;
+  strlcpy(msg.topic, topic, sizeof(msg.topic));
+  strlcpy(msg.payload, payload, sizeof(msg.payload));
+  msg.retain = retain;
+
+  if (xQueueSend(mqttOutQueue, &msg, 0) != pdTRUE) {
+    mqttOutDropped++;
+    LOG_W(LOG_MQTT, "File MQTT pleine - Message %s abandonne (%lu perdus)", topic, mqttOutDropped);
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Publie l'état d'un relais via la file MQTT (et le signale au flux direct).
+ */
+bool queueRelayStatePublish(int relay, bool state, bool retain = false) {
+  char topic[MQTT_OUT_TOPIC_LEN];
+  snprintf(topic, sizeof(topic), "relay/%d/state", relay);
+  postSystemEvent(EVT_LIVE_CHANGED);
+  return queueMqttPublish(topic, state ? "1" : "0", retain);
+}
+
+/**
+ * Transmet un point périodique du graphique à la tâche maintenance (non bloquant).
+ */
+bool queueChartPoint(const ChartDataPoint& point) {
+  if (chartPointQueue == NULL) return false;
+
+  if (xQueueSend(chartPointQueue, &point, 0) != pdTRUE) {
+    chartPointsDropped++;
+    LOG_V(LOG_CHART, "File graphique pleine - Point abandonne");
+    return false;
+  }
+  return true;
+}
+
+// ============================================================================
+// REDÉMARRAGE
+// ============================================================================
+
+/**
+ * Écrit les points graphique et les compteurs en attente avant un
+ * ESP.restart(). La tâche maintenance fait l'écriture (seule à écrire ces
+ * fichiers) puis n'écrit plus rien jusqu'à resumePersistence() ; appel
+ * direct si elle ne tourne pas encore ou depuis elle-même.
+ *
+ * @return false si la maintenance n'a pas répondu à temps
+ */
+bool flushPersistenceBeforeRestart() {
+  bool housekeepingRunning = systemEvents != NULL && housekeepingTaskHandle != NULL &&
+                             (xEventGroupGetBits(systemEvents) & EVT_SYSTEM_READY);
+
+  if (!housekeepingRunning || xTaskGetCurrentTaskHandle() == housekeepingTaskHandle) {
+    flushChartPersistence(true);
+    flushEnergyCounters();
+    persistenceFrozen = true;
+    return true;
+  }
+
+  xEventGroupClearBits(systemEvents, EVT_PERSIST_DONE);
+  xEventGroupSetBits(systemEvents, EVT_PERSIST_FLUSH);
+  EventBits_t bits = xEventGroupWaitBits(systemEvents, EVT_PERSIST_DONE, pdTRUE, pdTRUE,
+                                         pdMS_TO_TICKS(PERSIST_FLUSH_TIMEOUT_MS));
+  if (!(bits & EVT_PERSIST_DONE)) {
+    LOG_W(LOG_SYSTEM, "Sauvegarde avant redemarrage sans reponse (%d ms)", PERSIST_FLUSH_TIMEOUT_MS);
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Redémarrage annulé (mise à jour en échec) : écritures groupées reprises.
+ */
+void resumePersistence() {
+  if (!persistenceFrozen) return;
+  persistenceFrozen = false;
+  LOG_I(LOG_SYSTEM, "Sauvegardes reprises (redemarrage annule)");
+}
+
+#endif // TASK_BUS_H
@@ -0,0 +1,307 @@
+/*
+ * POOL CONNECT - FILTRATION PLANNER TEST
+ * Tests sur PC de filtration_planner.h
+ * filtration_planner_test.cpp   V0.1
+ *
+ * Compilation et exécution (depuis FW/) :
+ *   g++ -std=c++11 -Wall -I. test/filtration_planner_test.cpp -o /tmp/filtration_planner_test
+ *   /tmp/filtration_planner_test
+ * ou test/run_tests.sh pour tous les tests.
+ */
+
+#include <stdio.h>
+#include "filtration_planner.h"
+
+// ============================================================================
+// OUTILS
+// ============================================================================
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+  if (!(cond)) { \
+    printf("ECHEC %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+    failures++; \
+  } \
+} while (0)
+
+static void fillTemps(float* temps, int hours, float value) {
+  for (int h = 0; h < hours; h++) temps[h] = value;
+}
+
+static int countRuns(const FiltrationPlan& plan) {
+  int runs = 0;
+  for (int h = 0; h < plan.hours; h++) {
+    if (plan.run[h] && (h == 0 || !plan.run[h - 1])) runs++;
+  }
+  return runs;
+}
+
+static int longestRun(const FiltrationPlan& plan) {
+  int best = 0, len = 0;
+  for (int h = 0; h < plan.hours; h++) {
+    len = plan.run[h] ? len + 1 : 0;
+    if (len > best) best = len;
+  }
+  return best;
+}
+
+static int countPlanned(const FiltrationPlan& plan) {
+  int n = 0;
+  for (int h = 0; h < plan.hours; h++) n += plan.run[h] ? 1 : 0;
+  return n;
+}
+
+static bool allPlanned(const FiltrationPlan& plan, int from, int to) {
+  for (int h = from; h <= to; h++) {
+    if (!plan.run[h]) return false;
+  }
+  return true;
+}
+
+// ============================================================================
+// PONDÉRATION TEMPÉRATURE
+// ============================================================================
+
+static void testWarmestHours() {
+  float temps[24];
+  buildDiurnalTemps(20, 30, 0, 24, temps);
+
+  PlannerParams p;
+  p.requiredHours = 5.5f;                 // Arrondi à 6 heures
+  p.offPeakStartHour = -1;                // Sans tarif
+
+  FiltrationPlan plan;
+  CHECK(planFiltration(temps, 24, 0, p, &plan) == 6);
+  CHECK(plan.hours == 24);
+  CHECK(countPlanned(plan) == 6);
+  CHECK(!plan.constraintRelaxed);
+
+  // Bloc unique autour du maximum (15h)
+  CHECK(countRuns(plan) == 1);
+  CHECK(allPlanned(plan, 13, 17));
+  CHECK(!plan.run[3]);
+}
+
+static void testStartHourOffset() {
+  float temps[24];
+  buildDiurnalTemps(20, 30, 10, 24, temps);   // Plan démarrant à 10h
+
+  PlannerParams p;
+  p.requiredHours = 1;
+  p.offPeakStartHour = -1;
+  p.minRunHours = 1;
+
+  FiltrationPlan plan;
+  planFiltration(temps, 24, 10, p, &plan);
+  CHECK(plan.run[5]);                         // 15h
+}
+
+// ============================================================================
+// PONDÉRATION HEURES CREUSES
+// ============================================================================
+
+static void testOffPeakBonus() {
+  float temps[24];
+  fillTemps(temps, 24, 20);
+  for (int h = 10; h <= 13; h++) temps[h] = 23;
+
+  PlannerParams p;
+  p.requiredHours = 4;
+  p.offPeakStartHour = 22;
+  p.offPeakEndHour = 6;
+
+  // Écart de température (3°C) supérieur au bonus : heures chaudes
+  p.offPeakBonus = 2;
+  FiltrationPlan plan;
+  planFiltration(temps, 24, 0, p, &plan);
+  CHECK(allPlanned(plan, 10, 13));
+
+  // Bonus supérieur : heures creuses (22h-6h, plage sur minuit)
+  p.offPeakBonus = 4;
+  planFiltration(temps, 24, 0, p, &plan);
+  CHECK(countPlanned(plan) == 4);
+  for (int h = 6; h < 22; h++) CHECK(!plan.run[h]);
+}
+
+static void testOffPeakMask() {
+  float temps[24];
+  fillTemps(temps, 24, 25);
+
+  // Calendrier tarifaire : masque prioritaire sur la plage
+  PlannerParams p;
+  p.requiredHours = 3;
+  p.offPeakMask = (1UL << 12) | (1UL << 13) | (1UL << 14);
+
+  FiltrationPlan plan;
+  planFiltration(temps, 24, 0, p, &plan);
+  CHECK(allPlanned(plan, 12, 14));
+  CHECK(countPlanned(plan) == 3);
+  CHECK(!plan.run[23]);
+}
+
+// ============================================================================
+// DURÉE CONTINUE MAXIMALE
+// ============================================================================
+
+static void testMaxContinuous() {
+  float temps[24];
+  buildDiurnalTemps(20, 30, 0, 24, temps);
+
+  PlannerParams p;
+  p.requiredHours = 10;
+  p.maxContinuousHours = 4;
+  p.offPeakStartHour = -1;
+
+  FiltrationPlan plan;
+  CHECK(planFiltration(temps, 24, 0, p, &plan) == 10);
+  CHECK(longestRun(plan) <= 4);
+  CHECK(!plan.constraintRelaxed);
+}
+
+static void testConstraintRelaxed() {
+  float temps[24];
+  fillTemps(temps, 24, 25);
+
+  // 2h max avec au moins 1h d'arrêt : 16h au plus sur 24
+  PlannerParams p;
+  p.requiredHours = 20;
+  p.maxContinuousHours = 2;
+  p.offPeakStartHour = -1;
+
+  FiltrationPlan plan;
+  CHECK(planFiltration(temps, 24, 0, p, &plan) == 20);
+  CHECK(plan.constraintRelaxed);
+}
+
+static void testRequiredBounds() {
+  float temps[24];
+  fillTemps(temps, 24, 25);
+
+  PlannerParams p;
+  FiltrationPlan plan;
+
+  p.requiredHours = 0;
+  CHECK(planFiltration(temps, 24, 0, p, &plan) == 0);
+  CHECK(countPlanned(plan) == 0);
+
+  p.requiredHours = 30;
+  p.maxContinuousHours = 0;
+  CHECK(planFiltration(temps, 24, 0, p, &plan) == 24);
+}
+
+// ============================================================================
+// FUSION DES BLOCS COURTS
+// ============================================================================
+
+/**
+ * Bloc chaud 10h-13h, pic isolé à 20h, légère pente pour départager
+ * les bordures (14h plus chaude que 9h).
+ */
+static void buildIsolatedPeak(float* temps) {
+  for (int h = 0; h < 24; h++) temps[h] = 20 + h * 0.01f;
+  for (int h = 10; h <= 13; h++) temps[h] = 30;
+  temps[20] = 29;
+}
+
+static void testMergeIsolatedHour() {
+  float temps[24];
+  buildIsolatedPeak(temps);
+
+  PlannerParams p;
+  p.requiredHours = 5;
+  p.offPeakStartHour = -1;
+
+  // Sans fusion : l'heure isolée est gardée
+  p.minRunHours = 1;
+  FiltrationPlan plan;
+  planFiltration(temps, 24, 0, p, &plan);
+  CHECK(plan.run[20]);
+  CHECK(countRuns(plan) == 2);
+
+  // Fusion : l'heure passe en bordure du bloc principal
+  p.minRunHours = 2;
+  CHECK(planFiltration(temps, 24, 0, p, &plan) == 5);
+  CHECK(!plan.run[20]);
+  CHECK(countRuns(plan) == 1);
+  CHECK(allPlanned(plan, 10, 14));
+  CHECK(countPlanned(plan) == 5);
+}
+
+static void testMergeRespectsMaxContinuous() {
+  float temps[24];
+  buildIsolatedPeak(temps);
+
+  // Bloc principal déjà à la durée maximale : heure isolée conservée
+  PlannerParams p;
+  p.requiredHours = 5;
+  p.maxContinuousHours = 4;
+  p.offPeakStartHour = -1;
+
+  FiltrationPlan plan;
+  planFiltration(temps, 24, 0, p, &plan);
+  CHECK(plan.run[20]);
+  CHECK(allPlanned(plan, 10, 13));
+  CHECK(longestRun(plan) <= 4);
+}
+
+static void testMergeSingleHour() {
+  float temps[24];
+  buildIsolatedPeak(temps);
+
+  // Une seule heure demandée : aucun bloc à prolonger
+  PlannerParams p;
+  p.requiredHours = 1;
+  p.minRunHours = 3;
+  p.offPeakStartHour = -1;
+
+  FiltrationPlan plan;
+  CHECK(planFiltration(temps, 24, 0, p, &plan) == 1);
+  CHECK(countPlanned(plan) == 1);
+}
+
+static void testMergeMinRunLonger() {
+  float temps[24];
+  fillTemps(temps, 24, 20);
+  for (int h = 8; h <= 12; h++) temps[h] = 30;   // Bloc de 5h
+  temps[18] = 29;                                // Bloc de 2h
+  temps[19] = 29;
+  temps[13] = 21;                                // Bordure préférée
+
+  PlannerParams p;
+  p.requiredHours = 7;
+  p.minRunHours = 3;
+  p.offPeakStartHour = -1;
+
+  FiltrationPlan plan;
+  planFiltration(temps, 24, 0, p, &plan);
+  CHECK(countPlanned(plan) == 7);
+  CHECK(countRuns(plan) == 1);
+  CHECK(!plan.run[18] && !plan.run[19]);
+  CHECK(plan.run[13]);
+}
+
+// ============================================================================
+// MAIN
+// ============================================================================
+
+int main() {
+  testWarmestHours();
+  testStartHourOffset();
+  testOffPeakBonus();
+  testOffPeakMask();
+  testMaxContinuous();
+  testConstraintRelaxed();
+  testRequiredBounds();
+  testMergeIsolatedHour();
+  testMergeRespectsMaxContinuous();
+  testMergeSingleHour();
+  testMergeMinRunLonger();
+
+  if (failures != 0) {
+    printf("filtration_planner: %d echec(s)\n", failures);
+    return 1;
+  }
+  printf("filtration_planner: OK\n");
+  return 0;
+}
@@ -0,0 +1,235 @@
+/*
+ * POOL CONNECT - RELAY RULES TEST
+ * Tests sur PC de relay_rules.h
+ * relay_rules_test.cpp   V0.2
+ *
+ * Compilation et exécution (depuis FW/) :
+ *   g++ -std=c++11 -Wall -I. test/relay_rules_test.cpp -o /tmp/relay_rules_test
+ *   /tmp/relay_rules_test
+ * ou test/run_tests.sh pour tous les tests.
+ */
+
+#include <stdio.h>
+#include "relay_rules.h"
+
+// ============================================================================
+// OUTILS
+// ============================================================================
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+  if (!(cond)) { \
+    printf("ECHEC %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+    failures++; \
+  } \
+} while (0)
+
+// Relais de la carte (ordre de config.h)
+enum {
+  PUMP, ELECTRO, LIGHT, VALVE, HEAT_PUMP, SPARE, RELAYS
+};
+
+#define BIT(r) (1 << (r))
+
+static const RelayRule testRules[] = {
+  { RULE_REQUIRES, ELECTRO,   PUMP,    0 },
+  { RULE_REQUIRES, HEAT_PUMP, PUMP,    0 },
+  { RULE_FORBIDS,  ELECTRO,   VALVE,   0 },
+  { RULE_FORCES,   HEAT_PUMP, PUMP,    0 },
+  { RULE_MIN_ON,   HEAT_PUMP, 0,     300 },
+  { RULE_MIN_OFF,  HEAT_PUMP, 0,     180 },
+};
+
+// ============================================================================
+// COMPILATION
+// ============================================================================
+
+static void testCompile() {
+  RelayRuleSet set;
+  int ignored = compileRelayRules(testRules, sizeof(testRules) / sizeof(testRules[0]), RELAYS, set);
+
+  CHECK(ignored == 0);
+  CHECK(set.relayCount == RELAYS);
+  CHECK(set.requires[ELECTRO] == BIT(PUMP));
+  CHECK(set.dependents[PUMP] == (BIT(ELECTRO) | BIT(HEAT_PUMP)));
+  CHECK(set.forbids[ELECTRO] == BIT(VALVE));
+  CHECK(set.forbids[VALVE] == BIT(ELECTRO));         // Symétrique
+  CHECK(set.forces[HEAT_PUMP] == BIT(PUMP));
+  CHECK(set.minOnMs[HEAT_PUMP] == 300000);
+  CHECK(set.minOffMs[HEAT_PUMP] == 180000);
+}
+
+static void testCompileRejects() {
+  const RelayRule rules[] = {
+    { RULE_REQUIRES, LIGHT,  LIGHT,  0 },     // Lié à lui-même
+    { RULE_FORBIDS,  RELAYS, PUMP,   0 },     // Relais hors limites
+    { RULE_FORCES,   LIGHT,  -1,     0 },     // Relais lié hors limites
+    { RULE_MIN_ON,   -1,     0,     10 },
+    { RULE_FORBIDS,  ELECTRO, VALVE, 0 },
+    { RULE_FORCES,   ELECTRO, VALVE, 0 },     // Conflit avec FORBIDS
+  };
+  RelayRuleSet set;
+  int ignored = compileRelayRules(rules, sizeof(rules) / sizeof(rules[0]), RELAYS, set);
+
+  CHECK(ignored == 5);
+  CHECK(set.requires[LIGHT] == 0);
+  CHECK(set.forces[LIGHT] == 0);
+  CHECK(set.forces[ELECTRO] == 0);
+  CHECK(set.forbids[ELECTRO] == BIT(VALVE));          // Règle valide conservée
+}
+
+// ============================================================================
+// ÉVALUATION D'UNE COMMANDE
+// ============================================================================
+
+static void testRequires() {
+  RelayRuleSet set;
+  compileRelayRules(testRules, sizeof(testRules) / sizeof(testRules[0]), RELAYS, set);
+
+  RelayRuleResult r = evaluateRelayRule(set, ELECTRO, true, 0, 1000000, false);
+  CHECK(r.verdict == RULE_REFUSED_REQUIRES);
+  CHECK(r.other == PUMP);
+
+  r = evaluateRelayRule(set, ELECTRO, true, BIT(PUMP), 1000000, false);
+  CHECK(r.verdict == RULE_OK);
+}
+
+static void testForbids() {
+  RelayRuleSet set;
+  compileRelayRules(testRules, sizeof(testRules) / sizeof(testRules[0]), RELAYS, set);
+
+  RelayRuleResult r = evaluateRelayRule(set, ELECTRO, true, BIT(PUMP) | BIT(VALVE), 1000000, false);
+  CHECK(r.verdict == RULE_REFUSED_FORBIDS);
+  CHECK(r.other == VALVE);
+
+  r = evaluateRelayRule(set, VALVE, true, BIT(PUMP) | BIT(ELECTRO), 1000000, false);
+  CHECK(r.verdict == RULE_REFUSED_FORBIDS);
+  CHECK(r.other == ELECTRO);
+
+  // Éteindre n'est jamais interdit par FORBIDS
+  r = evaluateRelayRule(set, VALVE, false, BIT(VALVE), 1000000, false);
+  CHECK(r.verdict == RULE_OK);
+}
+
+static void testForces() {
+  RelayRuleSet set;
+  compileRelayRules(testRules, sizeof(testRules) / sizeof(testRules[0]), RELAYS, set);
+
+  // Pompe éteinte : acceptée, elle sera allumée d'abord
+  RelayRuleResult r = evaluateRelayRule(set, HEAT_PUMP, true, 0, 1000000, false);
+  CHECK(r.verdict == RULE_OK);
+}
+
+static void testMinOff() {
+  RelayRuleSet set;
+  compileRelayRules(testRules, sizeof(testRules) / sizeof(testRules[0]), RELAYS, set);
+
+  RelayRuleResult r = evaluateRelayRule(set, HEAT_PUMP, true, BIT(PUMP), 60000, false);
+  CHECK(r.verdict == RULE_REFUSED_MIN_OFF);
+  CHECK(r.other == -1);
+  CHECK(r.waitMs == 120000);
+
+  r = evaluateRelayRule(set, HEAT_PUMP, true, BIT(PUMP), 180000, false);
+  CHECK(r.verdict == RULE_OK);
+
+  // Protection : l'arrêt minimal s'applique toujours à l'allumage
+  r = evaluateRelayRule(set, HEAT_PUMP, true, BIT(PUMP), 60000, true);
+  CHECK(r.verdict == RULE_REFUSED_MIN_OFF);
+}
+
+static void testMinOn() {
+  RelayRuleSet set;
+  compileRelayRules(testRules, sizeof(testRules) / sizeof(testRules[0]), RELAYS, set);
+
+  uint8_t mask = BIT(PUMP) | BIT(HEAT_PUMP);
+  RelayRuleResult r = evaluateRelayRule(set, HEAT_PUMP, false, mask, 100000, false);
+  CHECK(r.verdict == RULE_REFUSED_MIN_ON);
+  CHECK(r.waitMs == 200000);
+
+  r = evaluateRelayRule(set, HEAT_PUMP, false, mask, 300000, false);
+  CHECK(r.verdict == RULE_OK);
+
+  // Arrêt de protection : durée minimale allumée ignorée
+  r = evaluateRelayRule(set, HEAT_PUMP, false, mask, 100000, true);
+  CHECK(r.verdict == RULE_OK);
+
+  // Relais sans durée minimale
+  r = evaluateRelayRule(set, LIGHT, false, BIT(LIGHT), 0, false);
+  CHECK(r.verdict == RULE_OK);
+}
+
+// ============================================================================
+// ÉVALUATION D'UN ÉTAT COMPLET
+// ============================================================================
+
+static void testMask() {
+  RelayRuleSet set;
+  compileRelayRules(testRules, sizeof(testRules) / sizeof(testRules[0]), RELAYS, set);
+
+  CHECK(evaluateRelayMask(set, 0).verdict == RULE_OK);
+  CHECK(evaluateRelayMask(set, BIT(PUMP) | BIT(ELECTRO) | BIT(HEAT_PUMP)).verdict == RULE_OK);
+
+  RelayRuleResult r = evaluateRelayMask(set, BIT(ELECTRO));
+  CHECK(r.verdict == RULE_REFUSED_REQUIRES);
+  CHECK(r.other == PUMP);
+
+  r = evaluateRelayMask(set, BIT(PUMP) | BIT(ELECTRO) | BIT(VALVE));
+  CHECK(r.verdict == RULE_REFUSED_FORBIDS);
+  CHECK(r.other == VALVE);
+
+  // Durées minimales ignorées pour une scène
+  CHECK(evaluateRelayMask(set, BIT(PUMP)).verdict == RULE_OK);
+}
+
+static void testTransition() {
+  RelayRuleSet set;
+  compileRelayRules(testRules, sizeof(testRules) / sizeof(testRules[0]), RELAYS, set);
+
+  uint32_t since[RELAYS] = { 1000000, 1000000, 1000000, 1000000, 60000, 1000000 };
+  int relay = 0;
+
+  // PAC éteinte depuis 60 s : scène qui l'allume refusée
+  RelayRuleResult r = evaluateRelayTransition(set, BIT(PUMP), BIT(PUMP) | BIT(HEAT_PUMP), since, &relay);
+  CHECK(r.verdict == RULE_REFUSED_MIN_OFF);
+  CHECK(relay == HEAT_PUMP);
+  CHECK(r.waitMs == 120000);
+
+  // PAC allumée depuis 60 s : scène qui l'éteint refusée
+  r = evaluateRelayTransition(set, BIT(PUMP) | BIT(HEAT_PUMP), BIT(PUMP), since, &relay);
+  CHECK(r.verdict == RULE_REFUSED_MIN_ON);
+  CHECK(relay == HEAT_PUMP);
+
+  // PAC inchangée : durées ignorées
+  r = evaluateRelayTransition(set, BIT(PUMP) | BIT(HEAT_PUMP), BIT(PUMP) | BIT(HEAT_PUMP) | BIT(LIGHT), since, &relay);
+  CHECK(r.verdict == RULE_OK);
+  CHECK(relay == -1);
+
+  // Durée écoulée
+  since[HEAT_PUMP] = 300000;
+  r = evaluateRelayTransition(set, BIT(PUMP) | BIT(HEAT_PUMP), 0, since, &relay);
+  CHECK(r.verdict == RULE_OK);
+}
+
+// ============================================================================
+// MAIN
+// ============================================================================
+
+int main() {
+  testCompile();
+  testCompileRejects();
+  testRequires();
+  testForbids();
+  testForces();
+  testMinOff();
+  testMinOn();
+  testMask();
+  testTransition();
+
+  if (failures != 0) {
+    printf("relay_rules: %d echec(s)\n", failures);
+    return 1;
+  }
+  printf("relay_rules: OK\n");
+  return 0;
+}
@@ -0,0 +1,38 @@
+#!/bin/sh
+#
+# POOL CONNECT - HOST TESTS
+# Compile et exécute les tests sur PC des modules purs (test/*_test.cpp)
+# run_tests.sh   V0.1
+#
+# Usage (depuis n'importe quel dossier) :
+#   FW/test/run_tests.sh
+#   ARDUINOJSON_DIR=~/Arduino/libraries/ArduinoJson FW/test/run_tests.sh
+#
+# Les tests qui incluent ArduinoJson sont ignorés sans ARDUINOJSON_DIR.
+#
+
+cd "$(dirname "$0")/.." || exit 1
+
+OUT="${TMPDIR:-/tmp}/poolconnect_tests"
+mkdir -p "$OUT"
+
+status=0
+for src in test/*_test.cpp; do
+  name=$(basename "$src" .cpp)
+  flags=""
+  if grep -q "<ArduinoJson.h>" "$src"; then
+    if [ -z "$ARDUINOJSON_DIR" ]; then
+      echo "$name: ignore (ARDUINOJSON_DIR non defini)"
+      continue
+    fi
+    flags="-I$ARDUINOJSON_DIR/src"
+  fi
+  if ! g++ -std=c++11 -Wall -I. $flags "$src" -o "$OUT/$name"; then
+    echo "$name: erreur de compilation"
+    status=1
+    continue
+  fi
+  "$OUT/$name" || status=1
+done
+
+exit $status
@@ -0,0 +1,182 @@
+/*
+ * POOL CONNECT - WEATHER TEST
+ * Tests sur PC de weather_parse.h (réponses OpenWeatherMap enregistrées)
+ * weather_test.cpp   V0.1
+ *
+ * Nécessite la bibliothèque ArduinoJson 6 (dossier de la bibliothèque
+ * Arduino, en-têtes seuls) :
+ *   g++ -std=c++11 -Wall -I. -I$ARDUINOJSON_DIR/src test/weather_test.cpp -o /tmp/weather_test
+ *   /tmp/weather_test
+ * ou ARDUINOJSON_DIR=... test/run_tests.sh
+ */
+
+#include <stdio.h>
+#include <math.h>
+#include <ArduinoJson.h>
+#include "weather_parse.h"
+
+// ============================================================================
+// OUTILS
+// ============================================================================
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+  if (!(cond)) { \
+    printf("ECHEC %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+    failures++; \
+  } \
+} while (0)
+
+#define CHECK_NEAR(a, b) CHECK(fabs((a) - (b)) < 0.01)
+
+#define FORECAST_START 1750000000L           // Premier créneau
+#define FORECAST_STEP 10800L                 // 3h
+
+/**
+ * Réponse "forecast" de n créneaux : 20°C + i, sauf le créneau sans
+ * température (skip, -1 pour aucun).
+ */
+static void buildForecast(DynamicJsonDocument& doc, int n, int skip) {
+  doc.clear();
+  doc["cod"] = "200";
+  doc["cnt"] = n;
+  JsonArray list = doc.createNestedArray("list");
+  for (int i = 0; i < n; i++) {
+    JsonObject item = list.createNestedObject();
+    item["dt"] = FORECAST_START + i * FORECAST_STEP;
+    JsonObject main = item.createNestedObject("main");
+    if (i != skip) main["temp"] = 20.0 + i;
+    main["humidity"] = 60;
+  }
+}
+
+// ============================================================================
+// PRÉVISIONS
+// ============================================================================
+
+static void testForecastSlots() {
+  DynamicJsonDocument doc(16384);
+  time_t times[WEATHER_FORECAST_SLOTS];
+  float temps[WEATHER_FORECAST_SLOTS];
+  int count = 0;
+  float minT = 0, maxT = 0;
+
+  // 40 créneaux (réponse complète de 5 jours) : 16 gardés
+  buildForecast(doc, 40, -1);
+  CHECK(parseForecast(doc, times, temps, &count, &minT, &maxT));
+  CHECK(count == WEATHER_FORECAST_SLOTS);
+  CHECK(times[0] == FORECAST_START);
+  CHECK(times[15] == FORECAST_START + 15 * FORECAST_STEP);
+  CHECK_NEAR(temps[15], 35.0);
+
+  // Min/max sur les 8 premiers créneaux (24h) seulement
+  CHECK_NEAR(minT, 20.0);
+  CHECK_NEAR(maxT, 27.0);
+}
+
+static void testForecastMissingTemp() {
+  DynamicJsonDocument doc(8192);
+  time_t times[WEATHER_FORECAST_SLOTS];
+  float temps[WEATHER_FORECAST_SLOTS];
+  int count = 0;
+  float minT = 0, maxT = 0;
+
+  // Créneau sans température ignoré, les suivants décalés
+  buildForecast(doc, 4, 1);
+  CHECK(parseForecast(doc, times, temps, &count, &minT, &maxT));
+  CHECK(count == 3);
+  CHECK(times[1] == FORECAST_START + 2 * FORECAST_STEP);
+  CHECK_NEAR(temps[1], 22.0);
+  CHECK_NEAR(maxT, 23.0);
+}
+
+static void testForecastEmpty() {
+  DynamicJsonDocument doc(1024);
+  time_t times[WEATHER_FORECAST_SLOTS];
+  float temps[WEATHER_FORECAST_SLOTS];
+  int count = -1;
+  float minT = -1, maxT = -1;
+
+  buildForecast(doc, 0, -1);
+  CHECK(!parseForecast(doc, times, temps, &count, &minT, &maxT));
+  CHECK(count == -1);                               // Sorties inchangées
+
+  // Réponse d'erreur (clé invalide)
+  deserializeJson(doc, "{\"cod\":401,\"message\":\"Invalid API key\"}");
+  CHECK(!parseForecast(doc, times, temps, &count, &minT, &maxT));
+}
+
+// ============================================================================
+// MÉTÉO COURANTE
+// ============================================================================
+
+static void testCurrentWeather() {
+  DynamicJsonDocument doc(1024);
+  float temp = 0, sunshine = -1;
+
+  deserializeJson(doc, "{\"main\":{\"temp\":24.5,\"humidity\":40},\"clouds\":{\"all\":30}}");
+  CHECK(parseCurrentWeather(doc, &temp, &sunshine));
+  CHECK_NEAR(temp, 24.5);
+  CHECK_NEAR(sunshine, 70.0);
+
+  // Nuages absents : ensoleillement précédent conservé
+  sunshine = 55;
+  deserializeJson(doc, "{\"main\":{\"temp\":18}}");
+  CHECK(parseCurrentWeather(doc, &temp, &sunshine));
+  CHECK_NEAR(temp, 18.0);
+  CHECK_NEAR(sunshine, 55.0);
+
+  deserializeJson(doc, "{\"cod\":429,\"message\":\"Too many requests\"}");
+  CHECK(!parseCurrentWeather(doc, &temp, &sunshine));
+}
+
+// ============================================================================
+// REPORT SUR ERREUR
+// ============================================================================
+
+static void testRetryDelay() {
+  const unsigned long expected[] = {
+    60000, 120000, 240000, 480000, 960000, 1920000, 3600000, 3600000
+  };
+
+  unsigned long delay = 0;
+  for (unsigned i = 0; i < sizeof(expected) / sizeof(expected[0]); i++) {
+    delay = nextWeatherRetryDelay(delay);
+    CHECK(delay == expected[i]);
+  }
+
+  CHECK(nextWeatherRetryDelay(1) == WEATHER_RETRY_MIN_MS);
+  CHECK(nextWeatherRetryDelay(WEATHER_RETRY_MAX_MS * 4) == WEATHER_RETRY_MAX_MS);
+}
+
+static void testRetryableErrors() {
+  CHECK(isWeatherErrorRetryable(-1));               // Connexion impossible
+  CHECK(isWeatherErrorRetryable(-11));              // Timeout de lecture
+  CHECK(isWeatherErrorRetryable(429));
+  CHECK(isWeatherErrorRetryable(500));
+  CHECK(isWeatherErrorRetryable(503));
+  CHECK(!isWeatherErrorRetryable(200));
+  CHECK(!isWeatherErrorRetryable(401));             // Clé invalide : pas de report
+  CHECK(!isWeatherErrorRetryable(404));
+}
+
+// ============================================================================
+// MAIN
+// ============================================================================
+
+int main() {
+  testForecastSlots();
+  testForecastMissingTemp();
+  testForecastEmpty();
+  testCurrentWeather();
+  testRetryDelay();
+  testRetryableErrors();
+
+  if (failures != 0) {
+    printf("weather: %d echec(s)\n", failures);
+    return 1;
+  }
+  printf("weather: OK\n");
+  return 0;
+}
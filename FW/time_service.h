@@ -0,0 +1,221 @@
+/*
+ * POOL CONNECT - TIME SERVICE
+ * Heure civile en cache, état de synchronisation NTP et changement de jour
+ * time_service.h   V0.1
+ *
+ * getLocalTime() peut bloquer jusqu'à 5 secondes tant que le NTP n'est pas
+ * synchronisé. La tâche contrôle lit l'horloge système une fois par seconde
+ * et le module sert une copie de la structure tm sans jamais attendre.
+ *
+ * Si l'horloge système devient invalide après une première synchronisation,
+ * l'heure continue d'avancer sur millis() (mode HOLDOVER).
+ *
+ * Chaque passage à un nouveau jour incrémente un compteur : les modules
+ * intéressés (timers, archivage) consomment l'événement avec
+ * consumeDayRollover().
+ */
+
+#ifndef TIME_SERVICE_H
+#define TIME_SERVICE_H
+
+#include <Arduino.h>
+#include <time.h>
+#include <esp_sntp.h>
+#include "globals.h"
+#include "config.h"
+#include "logging.h"
+
+// ============================================================================
+// CONSTANTES
+// ============================================================================
+
+#define TIME_VALID_EPOCH 1672531200UL       // 01/01/2023 : en dessous, horloge non réglée
+#define TIME_UPDATE_INTERVAL_MS 1000        // Rafraîchissement du cache
+#define TIME_SYNC_STALE_MS 10800000UL       // 3h sans synchro NTP = HOLDOVER
+
+// ============================================================================
+// TYPES
+// ============================================================================
+
+enum TimeSyncState {
+  TIME_NOT_SET,     // Jamais synchronisé, heure inconnue
+  TIME_SYNCED,      // Synchronisé NTP récemment
+  TIME_HOLDOVER     // Heure valide mais NTP perdu (horloge interne / millis)
+};
+
+// ============================================================================
+// VARIABLES GLOBALES
+// ============================================================================
+
+struct tm cachedTimeInfo;
+time_t cachedEpoch = 0;
+volatile TimeSyncState timeSyncState = TIME_NOT_SET;
+volatile uint32_t timeDayCounter = 0;
+portMUX_TYPE timeMux = portMUX_INITIALIZER_UNLOCKED;
+
+unsigned long lastTimeUpdate = 0;
+int cachedYday = -1;
+
+// Ancre pour l'extrapolation monotone
+time_t timeAnchorEpoch = 0;
+unsigned long timeAnchorMillis = 0;
+
+// Renseignés par le callback SNTP (tâche lwIP)
+volatile unsigned long lastNtpSyncMs = 0;
+volatile bool ntpSyncEvent = false;
+unsigned long ntpSyncCount = 0;
+
+// ============================================================================
+// CALLBACK SNTP
+// ============================================================================
+
+/**
+ * Appelé par la pile SNTP à chaque synchronisation réussie.
+ * Exécuté hors des tâches du projet : uniquement des affectations.
+ */
+void onNtpTimeSync(struct timeval* tv) {
+  lastNtpSyncMs = millis();
+  ntpSyncEvent = true;
+}
+
+// ============================================================================
+// INITIALISATION
+// ============================================================================
+
+/**
+ * Configure le NTP et rend la main immédiatement.
+ * La synchronisation se poursuit en arrière-plan.
+ */
+void initTimeService() {
+  memset(&cachedTimeInfo, 0, sizeof(cachedTimeInfo));
+
+  sntp_set_time_sync_notification_cb(onNtpTimeSync);
+  configTime(GMT_OFFSET_SEC, DAYLIGHT_OFFSET_SEC, NTP_SERVER);
+
+  LOG_I(LOG_NETWORK, "Service horaire demarre - Synchronisation NTP en arriere-plan");
+}
+
+// ============================================================================
+// MISE À JOUR (TÂCHE CONTRÔLE)
+// ============================================================================
+
+/**
+ * Rafraîchit l'heure en cache (au plus une fois par seconde).
+ * Non bloquant : à appeler à chaque itération de la tâche contrôle.
+ */
+void updateTimeService() {
+  unsigned long nowMs = millis();
+  if (lastTimeUpdate != 0 && nowMs - lastTimeUpdate < TIME_UPDATE_INTERVAL_MS) {
+    return;
+  }
+  lastTimeUpdate = nowMs;
+
+  if (ntpSyncEvent) {
+    ntpSyncEvent = false;
+    ntpSyncCount++;
+    LOG_I(LOG_NETWORK, "NTP synchronise (synchro #%lu)", ntpSyncCount);
+  }
+
+  time_t now;
+  time(&now);
+
+  TimeSyncState state;
+  if ((unsigned long)now >= TIME_VALID_EPOCH) {
+    // Horloge système valide
+    timeAnchorEpoch = now;
+    timeAnchorMillis = nowMs;
+
+    bool recentSync = (lastNtpSyncMs != 0 && nowMs - lastNtpSyncMs < TIME_SYNC_STALE_MS);
+    state = recentSync ? TIME_SYNCED : TIME_HOLDOVER;
+  } else if (timeAnchorEpoch != 0) {
+    // Horloge système perdue : extrapolation depuis la dernière heure valide
+    now = timeAnchorEpoch + (time_t)((nowMs - timeAnchorMillis) / 1000);
+    state = TIME_HOLDOVER;
+  } else {
+    timeSyncState = TIME_NOT_SET;
+    return;
+  }
+
+  if (state != timeSyncState) {
+    if (state == TIME_SYNCED) {
+      LOG_I(LOG_NETWORK, "Heure systeme valide (NTP)");
+    } else {
+      LOG_W(LOG_NETWORK, "Heure en mode HOLDOVER (NTP non disponible)");
+    }
+  }
+
+  struct tm timeinfo;
+  localtime_r(&now, &timeinfo);
+
+  // Détection du changement de jour
+  if (cachedYday != -1 && timeinfo.tm_yday != cachedYday) {
+    timeDayCounter++;
+    LOG_I(LOG_SYSTEM, "Nouveau jour: %04d-%02d-%02d",
+          timeinfo.tm_year + 1900, timeinfo.tm_mon + 1, timeinfo.tm_mday);
+  }
+  cachedYday = timeinfo.tm_yday;
+
+  portENTER_CRITICAL(&timeMux);
+  cachedTimeInfo = timeinfo;
+  cachedEpoch = now;
+  timeSyncState = state;
+  portEXIT_CRITICAL(&timeMux);
+}
+
+// ============================================================================
+// ACCÈS (TOUS CORES)
+// ============================================================================
+
+/**
+ * Copie l'heure en cache (précision 1 seconde). Ne bloque jamais.
+ *
+ * @param timeinfo Structure à remplir
+ * @return false si l'heure n'a jamais été réglée
+ */
+bool getCachedTime(struct tm* timeinfo) {
+  if (timeSyncState == TIME_NOT_SET) return false;
+
+  portENTER_CRITICAL(&timeMux);
+  *timeinfo = cachedTimeInfo;
+  portEXIT_CRITICAL(&timeMux);
+  return true;
+}
+
+/**
+ * Timestamp Unix en cache (0 si l'heure n'a jamais été réglée).
+ */
+time_t getCachedEpoch() {
+  portENTER_CRITICAL(&timeMux);
+  time_t now = cachedEpoch;
+  portEXIT_CRITICAL(&timeMux);
+  return now;
+}
+
+bool isTimeValid() {
+  return timeSyncState != TIME_NOT_SET;
+}
+
+const char* getTimeSyncStateName() {
+  switch (timeSyncState) {
+    case TIME_SYNCED:   return "synced";
+    case TIME_HOLDOVER: return "holdover";
+    default:            return "not_set";
+  }
+}
+
+/**
+ * Indique si un changement de jour a eu lieu depuis le dernier appel.
+ * Chaque consommateur garde son propre compteur.
+ *
+ * @param lastSeen Compteur du consommateur (mis à jour)
+ * @return true une fois par changement de jour
+ */
+bool consumeDayRollover(uint32_t* lastSeen) {
+  uint32_t current = timeDayCounter;
+  if (*lastSeen == current) return false;
+
+  *lastSeen = current;
+  return true;
+}
+
+#endif // TIME_SERVICE_H
@@ -1,6 +1,12 @@
 /* 
  * POOL CONNECT - TIMER PROCESSOR
  * Logique d'exécution des timers flexibles
+ *
+ * Départs (recurrence) : une fois par jour à startTime, toutes les N
+ * minutes de startTime à endMinutes, ou liste d'heures ; jours filtrés par
+ * days[] et la parité du jour du mois. Le dernier départ atteint est
+ * mémorisé (lastTriggeredDay, lastTriggeredStart) : un timer encore en
+ * cours à l'heure d'un départ ne le rattrape pas.
  */
 
 #ifndef TIMER_PROCESSOR_H
@@ -9,16 +15,142 @@
 #include <Arduino.h>
 #include <time.h>
 #include "globals.h"
+#include "time_service.h"
 #include "config.h"
 #include "logging.h"
 #include "timer_system.h"
 #include "equation_parser.h"
+#include "energy_meter.h"
 #include "led_buzzer.h"
+#include "task_bus.h"
+#include "relay_service.h"
+#include "weather.h"
+#include "filtration_planner.h"
+
+// ============================================================================
+// CONSTANTES
+// ============================================================================
+
+#define PLANNED_FILTRATION_SETTLE_MS 30000UL   // Débit établi avant le relais asservi
+#define TIMER_RELAY_RETRY_MS 5000UL            // Nouvel essai (service occupé, refus)
+
+// ============================================================================
+// DÉCLARATIONS FORWARD
+// ============================================================================
+
+bool setPlannedFiltrationRelays(FlexibleTimer* timer, Action* action, bool on, bool settle = false);
 
 // ============================================================================
 // UTILITAIRES
 // ============================================================================
 
+FlexibleTimer* findFlexTimer(int id) {
+  for (int i = 0; i < flexTimerCount; i++) {
+    if (flexTimers[i].id == id) return &flexTimers[i];
+  }
+  return nullptr;
+}
+
+/**
+ * Arrête un timer en cours (relais qu'il a allumés) et remet son contexte à zéro.
+ */
+void stopFlexTimer(FlexibleTimer* timer) {
+  if (timer->context.state == TIMER_RUNNING) {
+    LOG_W(LOG_TIMER, "Timer ID %d en cours d'execution - Arret des relais", timer->id);
+    for (int a = 0; a < timer->actionCount; a++) {
+      if (timer->actions[a].type == ACTION_RELAY && timer->actions[a].state) {
+        setRelay(timer->actions[a].relay, false, RELAY_SOURCE_TIMER);
+        LOG_V(LOG_TIMER, "Relais %d eteint", timer->actions[a].relay);
+      } else if (timer->actions[a].type == ACTION_PLANNED_FILTRATION) {
+        setPlannedFiltrationRelays(timer, &timer->actions[a], false);
+      }
+    }
+  }
+
+  timer->context.state = TIMER_IDLE;
+  timer->context.currentActionIndex = 0;
+  timer->context.tempMeasured = false;
+  timer->context.planReady = false;
+  timer->context.relayRetryAt = 0;
+  timer->context.lastError = "";
+  timer->lastTriggeredDay = -1;
+  timer->lastTriggeredStart = -1;
+}
+
+// ============================================================================
+// RÉCURRENCE
+// ============================================================================
+
+/**
+ * Heure de départ de base (minutes depuis minuit) : startTime.
+ */
+int getTimerBaseStartMinutes(const FlexibleTimer* timer) {
+  switch(timer->startTime.type) {
+    case START_SUNRISE: return 7 * 60 + timer->startTime.sunriseOffset;
+    case START_SUNSET:  return 20 * 60 + timer->startTime.sunriseOffset;
+    default:            return timer->startTime.hour * 60 + timer->startTime.minute;
+  }
+}
+
+/**
+ * Jour actif : jour de la semaine coché et parité du jour du mois.
+ */
+bool isTimerDayActive(const FlexibleTimer* timer, struct tm* timeinfo) {
+  if (!timer->days[timeinfo->tm_wday]) return false;
+  switch(timer->recurrence.parity) {
+    case DAYS_ODD:  return (timeinfo->tm_mday % 2) == 1;
+    case DAYS_EVEN: return (timeinfo->tm_mday % 2) == 0;
+    default:        return true;
+  }
+}
+
+/**
+ * Dernier départ atteint aujourd'hui (minutes depuis minuit), -1 si aucun.
+ * Un seul départ en retard est rattrapé : le plus récent.
+ */
+int getDueTimerStart(const FlexibleTimer* timer, int currentMinutes) {
+  const Recurrence& r = timer->recurrence;
+  
+  switch(r.type) {
+    case RECUR_INTERVAL:
+    {
+      int base = getTimerBaseStartMinutes(timer);
+      int limit = currentMinutes < r.endMinutes ? currentMinutes : r.endMinutes;
+      if (r.intervalMinutes <= 0 || limit < base) return -1;
+      return base + ((limit - base) / r.intervalMinutes) * r.intervalMinutes;
+    }
+    
+    case RECUR_LIST:
+      for (int i = r.startCount - 1; i >= 0; i--) {
+        if (r.starts[i] <= currentMinutes) return r.starts[i];
+      }
+      return -1;
+    
+    default:
+    {
+      int base = getTimerBaseStartMinutes(timer);
+      return currentMinutes >= base ? base : -1;
+    }
+  }
+}
+
+/**
+ * Un départ atteint n'a pas encore été consommé.
+ */
+bool isTimerStartPending(const FlexibleTimer* timer, int currentDayOfYear, int currentMinutes) {
+  int due = getDueTimerStart(timer, currentMinutes);
+  if (due < 0) return false;
+  return timer->lastTriggeredDay != currentDayOfYear || timer->lastTriggeredStart < due;
+}
+
+/**
+ * Marque le départ atteint comme consommé (exécuté ou annulé).
+ */
+void consumeTimerStart(FlexibleTimer* timer, int currentDayOfYear, int currentMinutes) {
+  timer->lastTriggeredDay = currentDayOfYear;
+  timer->lastTriggeredStart = getDueTimerStart(timer, currentMinutes);
+}
+
 bool willTimerRestartImmediately(FlexibleTimer* timer, struct tm* timeinfo, 
                                  int currentDayOfYear, int currentMinutes,
                                  float wTemp, float wPress, float eTemp,
@@ -26,42 +158,16 @@ bool willTimerRestartImmediately(FlexibleTimer* timer, struct tm* timeinfo,
   
   LOG_V(LOG_TIMER, "Verification redemarrage immediat pour timer '%s'", timer->name.c_str());
   
-  // Vérifier si on est sur un nouveau jour
-  if (timer->lastTriggeredDay == currentDayOfYear) {
-    LOG_V(LOG_TIMER, "Timer deja execute aujourd'hui (jour %d)", currentDayOfYear);
-    return false;
-  }
-  
   // Vérifier si le jour est activé
-  if (!timer->days[timeinfo->tm_wday]) {
+  if (!isTimerDayActive(timer, timeinfo)) {
     LOG_V(LOG_TIMER, "Jour %d non actif pour ce timer", timeinfo->tm_wday);
     return false;
   }
   
-  // Vérifier l'heure de démarrage
-  int startMinutes = 0;
-  bool timeOK = false;
-  
-  switch(timer->startTime.type) {
-    case START_FIXED:
-      startMinutes = timer->startTime.hour * 60 + timer->startTime.minute;
-      timeOK = (currentMinutes >= startMinutes);
-      LOG_V(LOG_TIMER, "START_FIXED: %d min >= %d min ? %s", currentMinutes, startMinutes, timeOK ? "OUI" : "NON");
-      break;
-    case START_SUNRISE:
-      startMinutes = 7 * 60 + timer->startTime.sunriseOffset;
-      timeOK = (currentMinutes >= startMinutes);
-      LOG_V(LOG_TIMER, "START_SUNRISE: %d min >= %d min ? %s", currentMinutes, startMinutes, timeOK ? "OUI" : "NON");
-      break;
-    case START_SUNSET:
-      startMinutes = 20 * 60 + timer->startTime.sunriseOffset;
-      timeOK = (currentMinutes >= startMinutes);
-      LOG_V(LOG_TIMER, "START_SUNSET: %d min >= %d min ? %s", currentMinutes, startMinutes, timeOK ? "OUI" : "NON");
-      break;
-  }
-  
-  if (!timeOK) {
-    LOG_V(LOG_TIMER, "Heure de demarrage non atteinte");
+  // Vérifier qu'un départ est atteint et pas encore consommé
+  if (!isTimerStartPending(timer, currentDayOfYear, currentMinutes)) {
+    LOG_V(LOG_TIMER, "Pas de nouveau depart (dernier: jour %d, %d min)",
+          timer->lastTriggeredDay, timer->lastTriggeredStart);
     return false;
   }
   
@@ -92,6 +198,235 @@ bool willTimerRestartImmediately(FlexibleTimer* timer, struct tm* timeinfo,
   return true;
 }
 
+// ============================================================================
+// DURÉE DE FILTRATION
+// ============================================================================
+
+/**
+ * Durée de filtration en heures : équation personnalisée de l'action ou
+ * température / 2, limitée entre 3h et 24h.
+ * 
+ * @param wTemp Température de l'eau à utiliser
+ * @param hoursOut Durée calculée
+ * @return false si l'équation personnalisée est invalide
+ */
+bool computeFiltrationHours(FlexibleTimer* timer, Action* action, float wTemp, float* hoursOut) {
+  float durationHours;
+  
+  if (action->customEquation.useCustom && action->customEquation.expression.length() > 0) {
+    // Équation personnalisée
+    LOG_I(LOG_TIMER, "Timer %d: Calcul avec equation personnalisee", timer->id);
+    LOG_D(LOG_TIMER, "Expression: %s", action->customEquation.expression.c_str());
+    
+    EquationParser parser;
+    bool error = false;
+    
+    float eTemp, wMax, wMin, sun;
+    
+    if (xSemaphoreTake(dataMutex, portMAX_DELAY)) {
+      eTemp = tempExterieure;
+      wMax = weatherTempMax;
+      wMin = weatherTempMin;
+      sun = weatherSunshine;
+      xSemaphoreGive(dataMutex);
+    }
+    
+    parser.setVariables(wTemp, eTemp, wMax, wMin, sun);
+    parser.setTariff(isOffPeakNow(), getCurrentTariffPrice());
+    durationHours = parser.calculate(action->customEquation.expression, error);
+    
+    if (error || isnan(durationHours) || isinf(durationHours)) {
+      LOG_E(LOG_TIMER, "Timer %d: Erreur dans l'equation '%s'", 
+            timer->id, action->customEquation.expression.c_str());
+      return false;
+    }
+    
+    LOG_I(LOG_TIMER, "Timer %d: Resultat equation = %.2f heures", timer->id, durationHours);
+    LOG_V(LOG_TIMER, "Variables: waterTemp=%.2f, extTemp=%.2f, max=%.2f, min=%.2f, sun=%.0f%%",
+          wTemp, eTemp, wMax, wMin, sun);
+    
+  } else {
+    // Formule par défaut
+    durationHours = wTemp / 2.0;
+    LOG_I(LOG_TIMER, "Timer %d: Calcul avec formule par defaut (temp/2)", timer->id);
+    LOG_I(LOG_TIMER, "Duree calculee: %.2f heures", durationHours);
+  }
+  
+  // Limiter entre 3h et 24h
+  if (durationHours < 3.0) {
+    LOG_W(LOG_TIMER, "Timer %d: Duree %.2fh < 3h, ajuste a 3h", timer->id, durationHours);
+    durationHours = 3.0;
+  }
+  
+  if (durationHours > 24.0) {
+    LOG_W(LOG_TIMER, "Timer %d: Duree %.2fh > 24h, ajuste a 24h", timer->id, durationHours);
+    durationHours = 24.0;
+  }
+  
+  *hoursOut = durationHours;
+  return true;
+}
+
+// ============================================================================
+// COMMANDE DES RELAIS
+// ============================================================================
+
+/**
+ * Un relais refusé attend la fin de la durée minimale : pas de nouvel
+ * essai (ni de refus journalisé) à chaque passage.
+ */
+bool isTimerRelayRetryPending(FlexibleTimer* timer) {
+  return timer->context.relayRetryAt != 0 && (long)(millis() - timer->context.relayRetryAt) < 0;
+}
+
+/**
+ * Commande un relais pour le timer. Refus de durée minimale ou service
+ * occupé : prochain essai programmé (relayRetryAt non nul au retour).
+ *
+ * @return true si la commande est appliquée
+ */
+bool setTimerRelay(FlexibleTimer* timer, int relay, bool on, RelayRuleResult* refusal) {
+  timer->context.relayRetryAt = 0;
+  if (setRelay(relay, on, RELAY_SOURCE_TIMER, refusal)) return true;
+
+  unsigned long wait = 0;
+  if (refusal->verdict == RULE_REFUSED_MIN_ON || refusal->verdict == RULE_REFUSED_MIN_OFF) {
+    wait = refusal->waitMs;
+  } else if (refusal->verdict == RULE_OK && relay >= 0 && relay < NUM_RELAYS) {
+    wait = TIMER_RELAY_RETRY_MS;
+  }
+  if (wait > 0) timer->context.relayRetryAt = (millis() + wait) | 1;
+  return false;
+}
+
+// ============================================================================
+// FILTRATION PLANIFIÉE
+// ============================================================================
+
+/**
+ * Pilote la pompe et le relais asservi (électrolyseur ou PAC).
+ * Avec settle (plan en cours, appelée à chaque passage) : le relais asservi
+ * démarre PLANNED_FILTRATION_SETTLE_MS après la pompe et la pompe s'arrête
+ * autant après lui ; un relais refusé n'est recommandé qu'après
+ * relayRetryAt. Sans settle (arrêt du timer, urgence) : asservi puis
+ * pompe, sans attente.
+ *
+ * @return true quand pompe et relais asservi sont dans l'état demandé
+ */
+bool setPlannedFiltrationRelays(FlexibleTimer* timer, Action* action, bool on, bool settle) {
+  int follower = action->relay;
+  bool hasFollower = (follower > 0 && follower < NUM_RELAYS);
+  
+  bool pumpOK = isRelayOn(RELAY_PUMP) == on;
+  bool followerOK = !hasFollower || isRelayOn(follower) == on;
+  if (pumpOK && followerOK) return true;
+  
+  if (!settle) {
+    if (on) {
+      if (!pumpOK) setRelay(RELAY_PUMP, true, RELAY_SOURCE_TIMER);
+      if (!followerOK) setRelay(follower, true, RELAY_SOURCE_TIMER);
+    } else {
+      if (!followerOK) setRelay(follower, false, RELAY_SOURCE_TIMER);
+      if (!pumpOK) setRelay(RELAY_PUMP, false, RELAY_SOURCE_TIMER);
+    }
+  } else {
+    if (isTimerRelayRetryPending(timer)) return false;
+    
+    // Pompe d'abord à l'allumage, relais asservi d'abord à l'arrêt
+    int first = on ? RELAY_PUMP : follower;
+    int second = on ? follower : RELAY_PUMP;
+    bool firstOK = on ? pumpOK : followerOK;
+    bool secondOK = on ? followerOK : pumpOK;
+    RelayRuleResult refusal;
+    
+    if (!firstOK) {
+      if (!setTimerRelay(timer, first, on, &refusal)) {
+        if (timer->context.relayRetryAt == 0) timer->context.relayRetryAt = (millis() + TIMER_RELAY_RETRY_MS) | 1;
+        return false;
+      }
+      if (!secondOK) return false;
+    }
+    if (!secondOK) {
+      if (first >= 0 && first < NUM_RELAYS && millis() - getRelayInfo(first).changedAt < PLANNED_FILTRATION_SETTLE_MS) return false;
+      if (!setTimerRelay(timer, second, on, &refusal)) {
+        if (timer->context.relayRetryAt == 0) timer->context.relayRetryAt = (millis() + TIMER_RELAY_RETRY_MS) | 1;
+        return false;
+      }
+    }
+  }
+  
+  bool done = isRelayOn(RELAY_PUMP) == on && (!hasFollower || isRelayOn(follower) == on);
+  if (done) LOG_I(LOG_TIMER, "Timer %d: Filtration planifiee -> %s", timer->id, on ? "ON" : "OFF");
+  return done;
+}
+
+/**
+ * Calcule le plan des 24 prochaines heures à partir des prévisions horaires
+ * (ou d'un modèle diurne min/max à défaut) et le stocke dans le contexte.
+ * 
+ * @return false si la durée de filtration ne peut pas être calculée
+ */
+bool buildFiltrationPlan(FlexibleTimer* timer, Action* action, float wTemp) {
+  float requiredHours;
+  if (!computeFiltrationHours(timer, action, wTemp, &requiredHours)) return false;
+  
+  time_t now = getCachedEpoch();
+  time_t start = now - (now % 3600);
+  struct tm startTm;
+  localtime_r(&start, &startTm);
+  
+  float temps[24];
+  bool haveForecast = false;
+  float tMin = 0, tMax = 0;
+  
+  if (xSemaphoreTake(dataMutex, portMAX_DELAY)) {
+    // Prévisions exploitables uniquement si elles couvrent l'heure courante
+    if (weatherForecastCount > 0 && weatherForecastTimes[weatherForecastCount - 1] >= start) {
+      haveForecast = buildHourlyTemps(weatherForecastTimes, weatherForecastTemps,
+                                      weatherForecastCount, start, 24, temps);
+    }
+    tMin = weatherTempMin;
+    tMax = weatherTempMax;
+    xSemaphoreGive(dataMutex);
+  }
+  
+  if (!haveForecast) {
+    LOG_W(LOG_TIMER, "Timer %d: Pas de previsions horaires - Modele min/max", timer->id);
+    buildDiurnalTemps(tMin, tMax, startTm.tm_hour, 24, temps);
+  }
+  
+  PlannerParams params;
+  params.requiredHours = requiredHours;
+  if (action->conditionValue > 0) {
+    params.maxContinuousHours = (int)action->conditionValue;
+  }
+  params.offPeakMask = tariffOffPeakMask;   // Calendrier tarifaire (energy_meter.h)
+  
+  FiltrationPlan plan;
+  planFiltration(temps, 24, startTm.tm_hour, params, &plan);
+  
+  uint32_t mask = 0;
+  char line[25];
+  for (int h = 0; h < 24; h++) {
+    if (plan.run[h]) mask |= (1UL << h);
+    line[h] = plan.run[h] ? '#' : '.';
+  }
+  line[24] = '\0';
+  
+  timer->context.plannedHoursMask = mask;
+  timer->context.planStartEpoch = start;
+  timer->context.planReady = true;
+  timer->context.calculatedDurationHours = requiredHours;
+  
+  LOG_I(LOG_TIMER, "Timer %d: Plan filtration %dh a partir de %02dh: %s",
+        timer->id, plan.plannedHours, startTm.tm_hour, line);
+  if (plan.constraintRelaxed) {
+    LOG_W(LOG_TIMER, "Timer %d: Duree continue max depassee pour placer %.1fh", 
+          timer->id, requiredHours);
+  }
+  return true;
+}
+
 // ============================================================================
 // TRAITEMENT DES TIMERS
 // ============================================================================
@@ -120,20 +455,23 @@ void processFlexTimers(struct tm* timeinfo) {
     lastMinute = timeinfo->tm_min;
   }
   
-  // PROTECTION: Si la pompe s'arrête, arrêter aussi l'électrolyseur
-  static bool lastPompeState = false;
-  bool currentPompeState = (digitalRead(relayPins[0]) == HIGH);
-  if (lastPompeState && !currentPompeState) {
-    if (digitalRead(relayPins[1]) == HIGH) {
-      digitalWrite(relayPins[1], LOW);
-      LOG_W(LOG_TIMER, "PROTECTION: Electrolyseur arrete automatiquement (pompe arretee)");
-      if (mqttClient.connected()) {
-        mqttClient.publish((mqttTopic + "/relay/1/state").c_str(), "0");
-        LOG_MQTT_PUB((mqttTopic + "/relay/1/state").c_str(), "0");
+  // Nouveau jour : réarmer les timers terminés ou en erreur
+  static uint32_t timerDaySeen = 0;
+  if (consumeDayRollover(&timerDaySeen)) {
+    for (int i = 0; i < flexTimerCount; i++) {
+      FlexibleTimer* timer = &flexTimers[i];
+      
+      if (timer->context.state == TIMER_COMPLETED) {
+        LOG_D(LOG_TIMER, "Timer %d: Nouveau jour detecte, retour a IDLE", timer->id);
+        timer->context.state = TIMER_IDLE;
+      } else if (timer->context.state == TIMER_ERROR) {
+        LOG_I(LOG_TIMER, "Timer %d: Reset erreur (nouveau jour)", timer->id);
+        LOG_V(LOG_TIMER, "Erreur precedente: %s", timer->context.lastError.c_str());
+        timer->context.state = TIMER_IDLE;
+        timer->context.lastError = "";
       }
     }
   }
-  lastPompeState = currentPompeState;
   
   for (int i = 0; i < flexTimerCount; i++) {
     FlexibleTimer* timer = &flexTimers[i];
@@ -145,8 +483,10 @@ void processFlexTimers(struct tm* timeinfo) {
         // Arrêter tous les relais de ce timer
         for (int a = 0; a < timer->actionCount; a++) {
           if (timer->actions[a].type == ACTION_RELAY && timer->actions[a].state) {
-            digitalWrite(relayPins[timer->actions[a].relay], LOW);
+            setRelay(timer->actions[a].relay, false, RELAY_SOURCE_TIMER);
             LOG_D(LOG_TIMER, "Relais %d eteint", timer->actions[a].relay);
+          } else if (timer->actions[a].type == ACTION_PLANNED_FILTRATION) {
+            setPlannedFiltrationRelays(timer, &timer->actions[a], false);
           }
         }
         timer->context.state = TIMER_IDLE;
@@ -156,7 +496,7 @@ void processFlexTimers(struct tm* timeinfo) {
     }
     
     // Vérifier jour d'activation
-    if (!timer->days[timeinfo->tm_wday]) {
+    if (!isTimerDayActive(timer, timeinfo)) {
       if (timer->context.state != TIMER_IDLE) {
         LOG_V(LOG_TIMER, "Timer %d - Jour %d non actif, retour a IDLE", timer->id, timeinfo->tm_wday);
         timer->context.state = TIMER_IDLE;
@@ -174,8 +514,10 @@ void processFlexTimers(struct tm* timeinfo) {
       
       for (int a = 0; a < timer->actionCount; a++) {
         if (timer->actions[a].type == ACTION_RELAY && timer->actions[a].state) {
-          digitalWrite(relayPins[timer->actions[a].relay], LOW);
+          setRelay(timer->actions[a].relay, false, RELAY_SOURCE_PROTECTION);
           LOG_W(LOG_TIMER, "Relais %d eteint (urgence)", timer->actions[a].relay);
+        } else if (timer->actions[a].type == ACTION_PLANNED_FILTRATION) {
+          setPlannedFiltrationRelays(timer, &timer->actions[a], false);
         }
       }
       timer->context.state = TIMER_ERROR;
@@ -190,39 +532,10 @@ void processFlexTimers(struct tm* timeinfo) {
       case TIMER_IDLE:
       {
         // Vérifier si c'est le moment de démarrer
-        bool shouldStart = false;
-        int startMinutes = 0;
-        
-        switch(timer->startTime.type) {
-          case START_FIXED:
-            startMinutes = timer->startTime.hour * 60 + timer->startTime.minute;
-            shouldStart = (currentMinutes >= startMinutes && 
-                          timer->lastTriggeredDay != currentDayOfYear);
-            if (shouldStart) {
-              LOG_V(LOG_TIMER, "Timer %d: Heure fixe atteinte (%02d:%02d)", 
-                    timer->id, timer->startTime.hour, timer->startTime.minute);
-            }
-            break;
-            
-          case START_SUNRISE:
-            startMinutes = 7 * 60 + timer->startTime.sunriseOffset;
-            shouldStart = (currentMinutes >= startMinutes && 
-                          timer->lastTriggeredDay != currentDayOfYear);
-            if (shouldStart) {
-              LOG_V(LOG_TIMER, "Timer %d: Lever du soleil + %d min atteint", 
-                    timer->id, timer->startTime.sunriseOffset);
-            }
-            break;
-            
-          case START_SUNSET:
-            startMinutes = 20 * 60 + timer->startTime.sunriseOffset;
-            shouldStart = (currentMinutes >= startMinutes && 
-                          timer->lastTriggeredDay != currentDayOfYear);
-            if (shouldStart) {
-              LOG_V(LOG_TIMER, "Timer %d: Coucher du soleil + %d min atteint", 
-                    timer->id, timer->startTime.sunriseOffset);
-            }
-            break;
+        bool shouldStart = isTimerStartPending(timer, currentDayOfYear, currentMinutes);
+        if (shouldStart) {
+          int due = getDueTimerStart(timer, currentMinutes);
+          LOG_V(LOG_TIMER, "Timer %d: Depart %02d:%02d atteint", timer->id, due / 60, due % 60);
         }
         
         if (shouldStart) {
@@ -294,12 +607,14 @@ void processFlexTimers(struct tm* timeinfo) {
             timer->context.currentActionIndex = 0;
             timer->context.actionStartMillis = nowMillis;
             timer->context.tempMeasured = false;
-            timer->lastTriggeredDay = currentDayOfYear;
+            timer->context.planReady = false;
+            timer->context.relayRetryAt = 0;
+            consumeTimerStart(timer, currentDayOfYear, currentMinutes);
             
             LOG_TIMER_EVENT("START", timer->name.c_str());
           } else {
             LOG_W(LOG_TIMER, "Timer %d en attente - Conditions non remplies", timer->id);
-            timer->lastTriggeredDay = currentDayOfYear;
+            consumeTimerStart(timer, currentDayOfYear, currentMinutes);
           }
         }
         break;
@@ -378,6 +693,14 @@ void processFlexTimers(struct tm* timeinfo) {
         // └────────────────────────────────────────────────────────────────┘
         if (timer->context.currentActionIndex >= timer->actionCount) {
           
+          // Départs passés pendant l'exécution : non rattrapés
+          if (timer->recurrence.type != RECUR_ONCE && timer->lastTriggeredDay == currentDayOfYear &&
+              getDueTimerStart(timer, currentMinutes) < currentMinutes &&
+              isTimerStartPending(timer, currentDayOfYear, currentMinutes)) {
+            LOG_W(LOG_TIMER, "Timer %d: depart(s) saute(s) pendant l'execution", timer->id);
+            consumeTimerStart(timer, currentDayOfYear, currentMinutes);
+          }
+          
           bool willRestartImmediately = willTimerRestartImmediately(
             timer, timeinfo, currentDayOfYear, currentMinutes,
             waterTemp, waterPressure, tempExterieure, coverOpen, waterLeak
@@ -398,7 +721,7 @@ void processFlexTimers(struct tm* timeinfo) {
             // Arrêter tous les relais
             for (int a = 0; a < timer->actionCount; a++) {
               if (timer->actions[a].type == ACTION_RELAY) {
-                digitalWrite(relayPins[timer->actions[a].relay], LOW);
+                setRelay(timer->actions[a].relay, false, RELAY_SOURCE_TIMER);
                 LOG_V(LOG_TIMER, "  Relais %d OFF", timer->actions[a].relay);
               }
             }
@@ -440,28 +763,31 @@ void processFlexTimers(struct tm* timeinfo) {
         
         switch(action->type) {
           case ACTION_RELAY:
-            // Protection électrolyseur
-            if (action->relay == 1 && action->state) {
-              if (digitalRead(relayPins[0]) != HIGH) {
-                LOG_E(LOG_TIMER, "Timer %d: ERREUR - Pompe doit etre active pour electrolyseur", timer->id);
-                timer->context.lastError = "Pompe doit être active";
+            // Règles de sécurité (refus du service relais)
+            {
+              if (isTimerRelayRetryPending(timer)) break;
+              
+              RelayRuleResult refusal;
+              if (!setTimerRelay(timer, action->relay, action->state, &refusal)) {
+                char reason[64];
+                formatRelayRefusal(refusal, reason, sizeof(reason));
+                
+                // Durée minimale en cours ou service occupé : l'action reste
+                // en cours, nouvel essai à la fin de l'attente
+                if (timer->context.relayRetryAt != 0) {
+                  LOG_I(LOG_TIMER, "Timer %d: Relais %d en attente: %s", timer->id, action->relay, reason);
+                  break;
+                }
+                
+                LOG_E(LOG_TIMER, "Timer %d: ERREUR - Relais %d refuse: %s", timer->id, action->relay, reason);
+                timer->context.lastError = reason;
                 timer->context.state = TIMER_ERROR;
                 break;
               }
             }
-            digitalWrite(relayPins[action->relay], action->state ? HIGH : LOW);
             LOG_I(LOG_TIMER, "Timer %d: Relais %d -> %s", 
                   timer->id, action->relay, action->state ? "ON" : "OFF");
             
-            // Capturer le changement d'état sur le graphique
-            captureCurrentStateToChart();
-            
-            if (mqttClient.connected()) {
-              String topic = mqttTopic + "/relay/" + String(action->relay) + "/state";
-              mqttClient.publish(topic.c_str(), action->state ? "1" : "0", true);
-              LOG_MQTT_PUB(topic.c_str(), action->state ? "1" : "0");
-            }
-            
             actionComplete = true;
             break;
             
@@ -475,9 +801,9 @@ void processFlexTimers(struct tm* timeinfo) {
           case ACTION_MEASURE_TEMP:
           {
             // Vérifier pompe active
-            if (digitalRead(relayPins[0]) != HIGH) {
+            if (!isRelayOn(RELAY_PUMP)) {
               LOG_W(LOG_TIMER, "Timer %d: Demarrage pompe pour mesure temperature", timer->id);
-              digitalWrite(relayPins[0], HIGH);
+              setRelay(RELAY_PUMP, true, RELAY_SOURCE_TIMER);
               timer->context.timerStartMillis = nowMillis;
               timer->context.tempMeasureCount = 0;
               break;
@@ -536,56 +862,10 @@ void processFlexTimers(struct tm* timeinfo) {
               if (action->maxWaitMinutes == 0) {
                 float durationHours;
                 
-                if (action->customEquation.useCustom && action->customEquation.expression.length() > 0) {
-                  // Équation personnalisée
-                  LOG_I(LOG_TIMER, "Timer %d: Calcul avec equation personnalisee", timer->id);
-                  LOG_D(LOG_TIMER, "Expression: %s", action->customEquation.expression.c_str());
-                  
-                  EquationParser parser;
-                  bool error = false;
-                  
-                  float wTemp, eTemp, wMax, wMin, sun;
-                  
-                  if (xSemaphoreTake(dataMutex, portMAX_DELAY)) {
-                    wTemp = timer->context.measuredTempAvg;
-                    eTemp = tempExterieure;
-                    wMax = weatherTempMax;
-                    wMin = weatherTempMin;
-                    sun = weatherSunshine;
-                    xSemaphoreGive(dataMutex);
-                  }
-                  
-                  parser.setVariables(wTemp, eTemp, wMax, wMin, sun);
-                  durationHours = parser.calculate(action->customEquation.expression, error);
-                  
-                  if (error || isnan(durationHours) || isinf(durationHours)) {
-                    LOG_E(LOG_TIMER, "Timer %d: Erreur dans l'equation '%s'", 
-                          timer->id, action->customEquation.expression.c_str());
-                    timer->context.lastError = "Erreur dans l'équation personnalisée";
-                    timer->context.state = TIMER_ERROR;
-                    break;
-                  }
-                  
-                  LOG_I(LOG_TIMER, "Timer %d: Resultat equation = %.2f heures", timer->id, durationHours);
-                  LOG_V(LOG_TIMER, "Variables: waterTemp=%.2f, extTemp=%.2f, max=%.2f, min=%.2f, sun=%.0f%%",
-                        wTemp, eTemp, wMax, wMin, sun);
-                  
-                } else {
-                  // Formule par défaut
-                  durationHours = timer->context.measuredTempAvg / 2.0;
-                  LOG_I(LOG_TIMER, "Timer %d: Calcul avec formule par defaut (temp/2)", timer->id);
-                  LOG_I(LOG_TIMER, "Duree calculee: %.2f heures", durationHours);
-                }
-                
-                // Limiter entre 3h et 24h
-                if (durationHours < 3.0) {
-                  LOG_W(LOG_TIMER, "Timer %d: Duree %.2fh < 3h, ajuste a 3h", timer->id, durationHours);
-                  durationHours = 3.0;
-                }
-                
-                if (durationHours > 24.0) {
-                  LOG_W(LOG_TIMER, "Timer %d: Duree %.2fh > 24h, ajuste a 24h", timer->id, durationHours);
-                  durationHours = 24.0;
+                if (!computeFiltrationHours(timer, action, timer->context.measuredTempAvg, &durationHours)) {
+                  timer->context.lastError = "Erreur dans l'équation personnalisée";
+                  timer->context.state = TIMER_ERROR;
+                  break;
                 }
                 
                 action->maxWaitMinutes = (int)(durationHours * 60);
@@ -626,6 +906,34 @@ void processFlexTimers(struct tm* timeinfo) {
             }
             break;
           
+          case ACTION_PLANNED_FILTRATION:
+          {
+            if (!timer->context.planReady) {
+              float wTemp = timer->context.tempMeasured ? timer->context.measuredTempAvg : waterTemp;
+              
+              if (!buildFiltrationPlan(timer, action, wTemp)) {
+                timer->context.lastError = "Erreur dans l'équation personnalisée";
+                timer->context.state = TIMER_ERROR;
+                break;
+              }
+            }
+            
+            long hourIndex = (long)((getCachedEpoch() - timer->context.planStartEpoch) / 3600);
+            if (hourIndex < 0) hourIndex = 0;
+            
+            // Plan terminé : horizon atteint ou plus aucune heure prévue
+            if (hourIndex >= 24 || (timer->context.plannedHoursMask >> hourIndex) == 0) {
+              if (!setPlannedFiltrationRelays(timer, action, false, true)) break;
+              LOG_I(LOG_TIMER, "Timer %d: Filtration planifiee terminee", timer->id);
+              timer->context.planReady = false;
+              actionComplete = true;
+              break;
+            }
+            
+            setPlannedFiltrationRelays(timer, action, (timer->context.plannedHoursMask >> hourIndex) & 1, true);
+            break;
+          }
+          
           case ACTION_BUZZER:
             if (!buzzerMuted && sysConfig.buzzerEnabled) {
               if (action->buzzerCount == 0) {
@@ -672,6 +980,7 @@ void processFlexTimers(struct tm* timeinfo) {
         if (actionComplete) {
           timer->context.currentActionIndex++;
           timer->context.actionStartMillis = nowMillis;
+          timer->context.relayRetryAt = 0;
           
           if (timer->context.currentActionIndex < timer->actionCount) {
             LOG_I(LOG_TIMER, "Timer %d: Passage a l'action %d/%d", 
@@ -683,24 +992,16 @@ void processFlexTimers(struct tm* timeinfo) {
       }
       
       case TIMER_COMPLETED:
-      {
-        if (timer->lastTriggeredDay != currentDayOfYear) {
-          LOG_D(LOG_TIMER, "Timer %d: Nouveau jour detecte, retour a IDLE", timer->id);
+        // Départ suivant de la journée (récurrence), sinon réarmé au changement de jour
+        if (isTimerStartPending(timer, currentDayOfYear, currentMinutes)) {
+          LOG_D(LOG_TIMER, "Timer %d: Depart suivant atteint, retour a IDLE", timer->id);
           timer->context.state = TIMER_IDLE;
         }
         break;
-      }
-      
+        
       case TIMER_ERROR:
-      {
-        if (timer->lastTriggeredDay != currentDayOfYear) {
-          LOG_I(LOG_TIMER, "Timer %d: Reset erreur (nouveau jour)", timer->id);
-          LOG_V(LOG_TIMER, "Erreur precedente: %s", timer->context.lastError.c_str());
-          timer->context.state = TIMER_IDLE;
-          timer->context.lastError = "";
-        }
+        // Réarmé au changement de jour (voir début de fonction)
         break;
-      }
     }
   }
 }
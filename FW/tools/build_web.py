@@ -0,0 +1,302 @@
+"""
+POOL CONNECT - BUILD WEB
+Prépare l'interface web pour la partition LittleFS
+Version: 0.2
+
+- Regroupe les scripts locaux de index.html en un bundle minifié et hashé
+  (app.<hash>.js) : 3 requêtes au premier affichage au lieu de 18
+- Compresse en gzip les fichiers texte de data/ (HTML, CSS, JS, SVG)
+- Copie les autres fichiers tels quels (images déjà compressées)
+- Écrit /assets.json : ETag (hash du contenu) de chaque fichier servi
+- Option --image : génère le binaire LittleFS avec mklittlefs
+
+Le firmware sert la version .gz quand elle existe, sinon le fichier brut :
+un upload direct de data/ reste fonctionnel.
+
+Usage:
+    python tools/build_web.py
+    python tools/build_web.py --image build/littlefs_web.bin
+    python tools/build_web.py --no-bundle
+"""
+
+import argparse
+import gzip
+import hashlib
+import json
+import re
+import shutil
+import subprocess
+import sys
+from pathlib import Path
+
+# ============================================================================
+# CONSTANTES
+# ============================================================================
+
+FW_DIR = Path(__file__).resolve().parent.parent
+DEFAULT_SRC = FW_DIR / "data"
+DEFAULT_OUT = FW_DIR / "build" / "data"
+
+COMPRESSED_EXTENSIONS = {".html", ".css", ".js", ".svg"}
+MANIFEST_NAME = "assets.json"
+INDEX_NAME = "index.html"
+BUNDLE_PREFIX = "app"
+
+# <script src="/...js"></script> locaux (les CDN sont conservés)
+LOCAL_SCRIPT_RE = re.compile(r'^[ \t]*<script src="(/[^"]+\.js)"></script>[ \t]*\r?\n', re.MULTILINE)
+
+# Caractères après lesquels un "/" commence une regex (et non une division)
+REGEX_PRECEDERS = set("(,=:[!&|?{};+-*%<>~^")
+
+# Partition "spiffs" de partitions.csv (0x620000, 0x9E0000)
+LITTLEFS_SIZE = 0x9E0000
+LITTLEFS_BLOCK = 4096
+LITTLEFS_PAGE = 256
+
+
+# ============================================================================
+# BUNDLE JS
+# ============================================================================
+
+def skip_literal(src, i):
+    """
+    Fin (exclue) de la chaîne ou du template commençant en i.
+    Les expressions ${...} d'un template peuvent contenir d'autres templates.
+    """
+    quote = src[i]
+    n = len(src)
+    j = i + 1
+    while j < n:
+        c = src[j]
+        if c == "\\":
+            j += 2
+            continue
+        if c == quote:
+            return j + 1
+        if quote == "`" and c == "$" and j + 1 < n and src[j + 1] == "{":
+            depth = 1
+            j += 2
+            while j < n and depth > 0:
+                if src[j] in "'\"`":
+                    j = skip_literal(src, j)
+                    continue
+                if src[j] == "{":
+                    depth += 1
+                elif src[j] == "}":
+                    depth -= 1
+                j += 1
+            continue
+        j += 1
+    return n
+
+
+def minify_js(src):
+    """
+    Minification prudente : supprime les commentaires, l'indentation et les
+    lignes vides. Les retours à la ligne sont conservés (insertion
+    automatique des points-virgules) ainsi que le contenu des chaînes,
+    templates et regex.
+    """
+    out = []
+    i = 0
+    n = len(src)
+    line_start = True
+    last_sig = ""          # Dernier caractère significatif émis
+
+    while i < n:
+        c = src[i]
+        nxt = src[i + 1] if i + 1 < n else ""
+
+        # Indentation en début de ligne
+        if line_start and c in " \t\r":
+            i += 1
+            continue
+
+        if c == "\n":
+            # Lignes vides supprimées, espaces de fin retirés
+            while out and out[-1] in " \t\r":
+                out.pop()
+            if out and out[-1] != "\n":
+                out.append("\n")
+            line_start = True
+            i += 1
+            continue
+
+        line_start = False
+
+        # Commentaires
+        if c == "/" and nxt == "/":
+            while i < n and src[i] != "\n":
+                i += 1
+            continue
+        if c == "/" and nxt == "*":
+            end = src.find("*/", i + 2)
+            i = n if end < 0 else end + 2
+            continue
+
+        # Chaînes et templates (recopiés tels quels)
+        if c in "'\"`":
+            j = skip_literal(src, i)
+            out.append(src[i:j])
+            last_sig = c
+            i = j
+            continue
+
+        # Regex littérale
+        if c == "/" and (last_sig == "" or last_sig in REGEX_PRECEDERS or last_sig == "\n"):
+            j = i + 1
+            in_class = False
+            while j < n and src[j] != "\n":
+                if src[j] == "\\":
+                    j += 2
+                    continue
+                if src[j] == "[":
+                    in_class = True
+                elif src[j] == "]":
+                    in_class = False
+                elif src[j] == "/" and not in_class:
+                    break
+                j += 1
+            out.append(src[i:j + 1])
+            last_sig = "/"
+            i = j + 1
+            continue
+
+        out.append(c)
+        if c not in " \t\r":
+            last_sig = c
+        i += 1
+
+    return "".join(out).strip() + "\n"
+
+
+def bundle_scripts(src, index_html):
+    """
+    Concatène les scripts locaux dans l'ordre de index.html.
+
+    @return (html réécrit, contenu du bundle, nom du bundle, urls regroupées)
+    """
+    urls = LOCAL_SCRIPT_RE.findall(index_html)
+    if not urls:
+        return index_html, None, None, []
+
+    parts = []
+    for url in urls:
+        code = (src / url.lstrip("/")).read_text(encoding="utf-8-sig")
+        parts.append(minify_js(code))
+
+    # ";" entre les fichiers : chaque script reste une instruction complète
+    bundle = ";\n".join(parts).encode("utf-8")
+    name = f"{BUNDLE_PREFIX}.{hashlib.sha1(bundle).hexdigest()[:8]}.js"
+
+    # Remplace le premier tag par le bundle, supprime les autres
+    first = LOCAL_SCRIPT_RE.search(index_html)
+    indent = re.match(r"[ \t]*", first.group(0)).group(0)
+    html = (index_html[:first.start()]
+            + f'{indent}<script src="/{name}"></script>\n'
+            + LOCAL_SCRIPT_RE.sub("", index_html[first.start():]))
+    return html, bundle, name, urls
+
+
+# ============================================================================
+# CONSTRUCTION
+# ============================================================================
+
+def content_etag(data):
+    """Hash court du contenu d'origine (identique pour la version brute et .gz)."""
+    return hashlib.sha1(data).hexdigest()[:16]
+
+
+def collect_files(src, bundle):
+    """
+    Liste (url, contenu) des fichiers à écrire, bundle compris.
+    """
+    files = {}
+    for path in sorted(p for p in src.rglob("*") if p.is_file()):
+        files["/" + path.relative_to(src).as_posix()] = path.read_bytes()
+
+    if not bundle:
+        return files
+
+    index_url = "/" + INDEX_NAME
+    html, code, name, urls = bundle_scripts(src, files[index_url].decode("utf-8-sig"))
+    if code is None:
+        return files
+
+    for url in urls:
+        files.pop(url, None)
+    files[index_url] = html.encode("utf-8")
+    files["/" + name] = code
+
+    print(f"Bundle /{name}: {len(urls)} scripts, {len(code)} bytes")
+    return files
+
+
+def build(src, out, bundle=True):
+    if out.exists():
+        shutil.rmtree(out)
+    out.mkdir(parents=True)
+
+    manifest = {}
+    total_in = 0
+    total_out = 0
+
+    for url, data in sorted(collect_files(src, bundle).items()):
+        target = out / url.lstrip("/")
+        target.parent.mkdir(parents=True, exist_ok=True)
+
+        if target.suffix in COMPRESSED_EXTENSIONS:
+            # mtime=0 : sortie identique d'un build à l'autre
+            packed = gzip.compress(data, compresslevel=9, mtime=0)
+            target = target.with_name(target.name + ".gz")
+            target.write_bytes(packed)
+        else:
+            packed = data
+            target.write_bytes(packed)
+
+        manifest[url] = content_etag(data)
+        total_in += len(data)
+        total_out += len(packed)
+        print(f"  {url:<32} {len(data):>8} -> {len(packed):>8} bytes")
+
+    (out / MANIFEST_NAME).write_text(json.dumps(manifest, indent=1), encoding="utf-8")
+
+    ratio = 100.0 * total_out / total_in if total_in else 0
+    print(f"Total: {total_in} -> {total_out} bytes ({ratio:.0f}%)")
+
+
+def build_image(out, image, mklittlefs):
+    image.parent.mkdir(parents=True, exist_ok=True)
+    cmd = [mklittlefs, "-c", str(out), "-b", str(LITTLEFS_BLOCK),
+           "-p", str(LITTLEFS_PAGE), "-s", str(LITTLEFS_SIZE), str(image)]
+    print("Image LittleFS: " + " ".join(cmd))
+    subprocess.run(cmd, check=True)
+
+
+# ============================================================================
+# MAIN
+# ============================================================================
+
+def main():
+    parser = argparse.ArgumentParser(description="Compresse l'interface web PoolConnect")
+    parser.add_argument("--src", type=Path, default=DEFAULT_SRC, help="Répertoire source (data/)")
+    parser.add_argument("--out", type=Path, default=DEFAULT_OUT, help="Répertoire de sortie")
+    parser.add_argument("--image", type=Path, help="Binaire LittleFS à générer")
+    parser.add_argument("--mklittlefs", default="mklittlefs", help="Chemin de mklittlefs")
+    parser.add_argument("--no-bundle", action="store_true", help="Garder les scripts séparés")
+    args = parser.parse_args()
+
+    if not args.src.is_dir():
+        print(f"Répertoire source introuvable: {args.src}")
+        return 1
+
+    build(args.src, args.out, bundle=not args.no_bundle)
+
+    if args.image:
+        build_image(args.out, args.image, args.mklittlefs)
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,158 @@
+/*
+ * POOL CONNECT - HEAT PUMP SIMULATION
+ * Simulation sur PC du thermostat PAC (heat_pump_thermostat.h) contre un
+ * modèle thermique du bassin
+ * heat_pump_sim.cpp   V0.1
+ *
+ * Bassin à une capacité : C dT/dt = P_pac - UA (T - T_ext). Température
+ * extérieure sinusoïdale (minimum à 3 h, maximum à 15 h), pompe en marche
+ * de 8 h à 20 h, mesure quantifiée comme le DS18B20 (1/16 °C).
+ *
+ * Trois stratégies comparées pour chaque coefficient de pertes :
+ *   timer8h   plage fixe de 10 h à 18 h (ancien fonctionnement par timer)
+ *   hyst      THERMOSTAT_HYSTERESIS
+ *   pid       THERMOSTAT_PID
+ * Résultats hors 2 premiers jours (mise en température) : énergie
+ * électrique, écart RMS à la consigne, min/max, nombre de démarrages.
+ *
+ * Compilation et exécution (depuis FW/) :
+ *   g++ -std=c++11 -O2 -I. tools/heat_pump_sim.cpp -o /tmp/heat_pump_sim
+ *   /tmp/heat_pump_sim            (14 jours, consigne 28 °C)
+ *   /tmp/heat_pump_sim 30 27.5    (jours, consigne)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "heat_pump_thermostat.h"
+
+// ============================================================================
+// MODÈLE DU BASSIN
+// ============================================================================
+
+#define SIM_STEP_SEC 10
+#define SIM_WARMUP_SEC (2u * 86400u)
+
+#define POOL_VOLUME_L 50000.0        // 50 m3
+#define WATER_HEAT_J_PER_L_K 4186.0
+#define HEATPUMP_THERMAL_W 6000.0
+#define HEATPUMP_ELECTRIC_W 1200.0   // COP 5
+#define POOL_START_TEMP 27.0
+
+#define EXT_TEMP_MEAN 18.0
+#define EXT_TEMP_SWING 6.0
+
+struct SimResult {
+  double kwh;
+  double rmsError;
+  double minTemp;
+  double maxTemp;
+  int starts;
+};
+
+enum SimStrategy {
+  SIM_TIMER,
+  SIM_HYSTERESIS,
+  SIM_PID
+};
+
+static double extTempAt(double hour) {
+  return EXT_TEMP_MEAN + EXT_TEMP_SWING * cos((hour - 15) * M_PI / 12);
+}
+
+static bool pumpOnAt(double hour) {
+  return hour >= 8 && hour < 20;
+}
+
+// ============================================================================
+// SIMULATION
+// ============================================================================
+
+static SimResult runSimulation(SimStrategy strategy, double ua, float setpoint, uint32_t days) {
+  ThermostatParams p;
+  p.mode = strategy == SIM_PID ? THERMOSTAT_PID : THERMOSTAT_HYSTERESIS;
+  p.setpoint = setpoint;
+  p.hysteresis = 0.5f;
+  p.kp = 0.3f;
+  p.ki = 0.1f;
+  p.kd = 0.0f;
+  p.kff = 0.0f;
+  p.cyclePeriodSec = 3600;
+  p.minOnSec = 900;
+  p.minOffSec = 300;
+  p.minExtTemp = 5.0f;
+  p.filterTauSec = 300.0f;
+
+  ThermostatState s;
+  resetThermostat(s);
+
+  double capacity = POOL_VOLUME_L * WATER_HEAT_J_PER_L_K;
+  double temp = POOL_START_TEMP;
+  bool heating = false;
+  uint32_t changedMs = 0;
+
+  SimResult r = { 0, 0, 99, -99, 0 };
+  double error2 = 0;
+  long samples = 0;
+
+  for (uint32_t t = 0; t < days * 86400u; t += SIM_STEP_SEC) {
+    double hour = fmod(t / 3600.0, 24);
+    double ext = extTempAt(hour);
+    bool pump = pumpOnAt(hour);
+    uint32_t nowMs = t * 1000u;
+
+    bool want;
+    if (strategy == SIM_TIMER) {
+      want = pump && hour >= 10 && hour < 18;
+    } else {
+      float measured = roundf((float)temp * 16) / 16;
+      want = stepThermostat(p, s, measured, (float)ext, pump, heating,
+                            nowMs - changedMs, nowMs, SIM_STEP_SEC);
+    }
+
+    if (want != heating) {
+      heating = want;
+      changedMs = nowMs;
+      if (heating) r.starts++;
+    }
+
+    double power = (heating ? HEATPUMP_THERMAL_W : 0) - ua * (temp - ext);
+    temp += power * SIM_STEP_SEC / capacity;
+
+    if (t >= SIM_WARMUP_SEC) {
+      if (heating) r.kwh += HEATPUMP_ELECTRIC_W * SIM_STEP_SEC / 3.6e6;
+      error2 += (temp - setpoint) * (temp - setpoint);
+      samples++;
+      if (temp < r.minTemp) r.minTemp = temp;
+      if (temp > r.maxTemp) r.maxTemp = temp;
+    }
+  }
+
+  r.rmsError = samples > 0 ? sqrt(error2 / samples) : 0;
+  return r;
+}
+
+// ============================================================================
+// MAIN
+// ============================================================================
+
+int main(int argc, char** argv) {
+  uint32_t days = argc > 1 ? (uint32_t)atoi(argv[1]) : 14;
+  float setpoint = argc > 2 ? (float)atof(argv[2]) : 28.0f;
+  if (days < 3) days = 3;
+
+  const double losses[] = { 150.0, 250.0, 350.0 };   // UA (W/K)
+  const char* names[] = { "timer8h", "hyst", "pid" };
+
+  printf("Simulation %u jours, consigne %.1f C (hors %u premiers jours)\n",
+         days, setpoint, SIM_WARMUP_SEC / 86400u);
+
+  for (unsigned i = 0; i < sizeof(losses) / sizeof(losses[0]); i++) {
+    for (int k = SIM_TIMER; k <= SIM_PID; k++) {
+      SimResult r = runSimulation((SimStrategy)k, losses[i], setpoint, days);
+      printf("UA=%3.0f %-8s kWh=%6.1f rms=%.2f min=%.2f max=%.2f starts=%d\n",
+             losses[i], names[k], r.kwh, r.rmsError, r.minTemp, r.maxTemp, r.starts);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,155 @@
+"""
+POOL CONNECT - WEB BENCH
+Charge HTTP : plusieurs tableaux de bord ouverts en même temps
+Version: 0.1
+
+Chaque client simulé ouvre l'interface puis interroge l'API comme
+dashboard.js (capteurs, relais, pompe) et télécharge régulièrement les
+données du graphique du jour. Une sonde séparée mesure en parallèle la
+latence de /api/relays, représentative d'une commande utilisateur.
+
+Aucune commande n'est envoyée aux relais.
+
+Usage:
+    python tools/web_bench.py 192.168.1.50
+    python tools/web_bench.py 192.168.1.50 --clients 4 --duration 60
+"""
+
+import argparse
+import http.client
+import threading
+import time
+from collections import defaultdict
+from datetime import date
+
+# ============================================================================
+# CONSTANTES
+# ============================================================================
+
+POLL_ENDPOINTS = ["/api/sensors", "/api/relays", "/api/pump/status"]
+PAGE_ENDPOINTS = ["/", "/style.css"]
+POLL_INTERVAL_S = 1.0
+CHART_INTERVAL_S = 10.0
+PROBE_INTERVAL_S = 0.5
+TIMEOUT_S = 15
+
+
+# ============================================================================
+# MESURES
+# ============================================================================
+
+class Stats:
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.latencies = defaultdict(list)
+        self.errors = defaultdict(int)
+        self.bytes = 0
+
+    def add(self, name, seconds, size):
+        with self.lock:
+            self.latencies[name].append(seconds * 1000.0)
+            self.bytes += size
+
+    def error(self, name):
+        with self.lock:
+            self.errors[name] += 1
+
+
+def percentile(values, p):
+    ordered = sorted(values)
+    k = min(len(ordered) - 1, int(round(p / 100.0 * (len(ordered) - 1))))
+    return ordered[k]
+
+
+def timed_get(host, path, stats, name=None, etags=None):
+    name = name or path
+    headers = {"Accept-Encoding": "gzip"}
+    if etags is not None and path in etags:
+        headers["If-None-Match"] = etags[path]
+
+    start = time.monotonic()
+    try:
+        conn = http.client.HTTPConnection(host, timeout=TIMEOUT_S)
+        conn.request("GET", path, headers=headers)
+        resp = conn.getresponse()
+        body = resp.read()
+        conn.close()
+    except (OSError, http.client.HTTPException):
+        stats.error(name)
+        return
+
+    if resp.status >= 400:
+        stats.error(name)
+        return
+    if etags is not None and resp.getheader("ETag"):
+        etags[path] = resp.getheader("ETag")
+    stats.add(name, time.monotonic() - start, len(body))
+
+
+# ============================================================================
+# CLIENTS
+# ============================================================================
+
+def dashboard_client(host, stop, stats):
+    etags = {}
+    chart_path = "/api/chart/data?date=" + date.today().isoformat()
+
+    for path in PAGE_ENDPOINTS:
+        timed_get(host, path, stats, etags=etags)
+
+    next_chart = 0
+    while not stop.is_set():
+        for path in POLL_ENDPOINTS:
+            timed_get(host, path, stats)
+
+        if time.monotonic() >= next_chart:
+            timed_get(host, chart_path, stats, name="/api/chart/data")
+            next_chart = time.monotonic() + CHART_INTERVAL_S
+
+        stop.wait(POLL_INTERVAL_S)
+
+
+def command_probe(host, stop, stats):
+    while not stop.is_set():
+        timed_get(host, "/api/relays", stats, name="probe /api/relays")
+        stop.wait(PROBE_INTERVAL_S)
+
+
+# ============================================================================
+# MAIN
+# ============================================================================
+
+def main():
+    parser = argparse.ArgumentParser(description="Test de charge du serveur web PoolConnect")
+    parser.add_argument("host", help="Adresse IP ou nom de l'ESP32")
+    parser.add_argument("--clients", type=int, default=3, help="Tableaux de bord simultanés")
+    parser.add_argument("--duration", type=int, default=30, help="Durée du test (secondes)")
+    args = parser.parse_args()
+
+    stats = Stats()
+    stop = threading.Event()
+    threads = [threading.Thread(target=dashboard_client, args=(args.host, stop, stats))
+               for _ in range(args.clients)]
+    threads.append(threading.Thread(target=command_probe, args=(args.host, stop, stats)))
+
+    print(f"{args.clients} clients pendant {args.duration}s sur {args.host}...")
+    for t in threads:
+        t.start()
+    time.sleep(args.duration)
+    stop.set()
+    for t in threads:
+        t.join()
+
+    print(f"\n{'Endpoint':<28} {'n':>5} {'p50 ms':>8} {'p95 ms':>8} {'max ms':>8} {'err':>5}")
+    for name in sorted(set(stats.latencies) | set(stats.errors)):
+        values = stats.latencies.get(name, [])
+        if values:
+            print(f"{name:<28} {len(values):>5} {percentile(values, 50):>8.0f} "
+                  f"{percentile(values, 95):>8.0f} {max(values):>8.0f} {stats.errors[name]:>5}")
+        else:
+            print(f"{name:<28} {0:>5} {'-':>8} {'-':>8} {'-':>8} {stats.errors[name]:>5}")
+    print(f"\nTotal recu: {stats.bytes / 1024:.0f} KB")
+
+
+if __name__ == "__main__":
+    main()
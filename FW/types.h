@@ -1,13 +1,14 @@
 /* 
  * POOL CONNECT - TYPES & STRUCTURES
  * Définitions de toutes les structures de données
- * types.h   V0.3
+ * types.h   V0.5
  */
 
 #ifndef TYPES_H
 #define TYPES_H
 
 #include <Arduino.h>
+#include "config.h"
 
 // ============================================================================
 // STRUCTURES
@@ -18,6 +19,14 @@ struct SystemConfig {
   bool buzzerEnabled;
 };
 
+// Publication MQTT des mesures (sur changement)
+struct MqttPublishConfig {
+  float tempDeadband;        // °C
+  float pressureDeadband;    // bar
+  uint16_t heartbeatSec;     // Republication complète au plus tard après
+  bool stateJson;            // Topic <topic>/state avec tout l'état en JSON
+};
+
 struct CalibrationConfig {
   // Température
   bool tempUseCalibration;
@@ -88,7 +97,8 @@ enum ActionType {
   ACTION_AUTO_DURATION,   // Durée automatique = équation personnalisée
   ACTION_IF_CONDITION,    // Action conditionnelle
   ACTION_BUZZER,          // Buzzer (beep ou alarme)
-  ACTION_LED              // LED (couleur et mode)
+  ACTION_LED,             // LED (couleur et mode)
+  ACTION_PLANNED_FILTRATION // Filtration planifiée sur 24h (prévisions météo)
 };
 
 enum ConditionType {
@@ -109,6 +119,18 @@ enum StartTimeType {
   START_SUNSET    // Coucher du soleil
 };
 
+enum RecurrenceType {
+  RECUR_ONCE,     // Une fois par jour à startTime
+  RECUR_INTERVAL, // Toutes les N minutes de startTime à endMinutes
+  RECUR_LIST      // Liste d'heures de départ (starts)
+};
+
+enum DayParity {
+  DAYS_ALL,       // Tous les jours actifs (days)
+  DAYS_ODD,       // Jours impairs du mois
+  DAYS_EVEN       // Jours pairs du mois
+};
+
 enum TimerState {
   TIMER_IDLE,           // En attente de démarrage
   TIMER_WAITING_START,  // Attente heure de début
@@ -152,7 +174,9 @@ struct Action {
   int ledMode;
   int ledDuration;
   
-  // Équation personnalisée pour ACTION_AUTO_DURATION
+  // Équation personnalisée pour ACTION_AUTO_DURATION et ACTION_PLANNED_FILTRATION
+  // (ACTION_PLANNED_FILTRATION : relay = relais asservi à la pompe (0 = aucun),
+  //  conditionValue = heures continues max)
   CustomEquation customEquation;
   
   Action() : type(ACTION_RELAY), relay(0), state(false), 
@@ -169,6 +193,19 @@ struct StartTime {
   StartTime() : type(START_FIXED), hour(9), minute(0), sunriseOffset(0) {}
 };
 
+// Déclenchements d'un timer dans la journée (un seul objet par motif)
+struct Recurrence {
+  RecurrenceType type;
+  int intervalMinutes;          // RECUR_INTERVAL
+  int endMinutes;               // RECUR_INTERVAL : dernier départ possible (minutes depuis minuit)
+  int starts[MAX_TIMER_STARTS]; // RECUR_LIST : minutes depuis minuit, croissantes
+  int startCount;
+  DayParity parity;
+  
+  Recurrence() : type(RECUR_ONCE), intervalMinutes(120), endMinutes(20 * 60),
+                 startCount(0), parity(DAYS_ALL) {}
+};
+
 struct TimerExecutionContext {
   int currentActionIndex;
   unsigned long actionStartMillis;
@@ -185,6 +222,14 @@ struct TimerExecutionContext {
   // Durée calculée
   float calculatedDurationHours;
   
+  // Filtration planifiée : 1 bit par heure à partir de planStartEpoch
+  uint32_t plannedHoursMask;
+  time_t planStartEpoch;
+  bool planReady;
+  
+  // Relais refusé (durée minimale, service occupé) : millis() du prochain essai
+  unsigned long relayRetryAt;
+  
   bool pumpRunning15min;
   TimerState state;
   String lastError;
@@ -195,6 +240,8 @@ struct TimerExecutionContext {
                            measuredTemp1(0), measuredTemp2(0), measuredTemp3(0),
                            measuredTempAvg(0), tempMeasureCount(0),
                            tempMeasured(false), calculatedDurationHours(0),
+                           plannedHoursMask(0), planStartEpoch(0), planReady(false),
+                           relayRetryAt(0),
                            pumpRunning15min(false), state(TIMER_IDLE), 
                            totalElapsedMinutes(0) {}
 };
@@ -205,15 +252,17 @@ struct FlexibleTimer {
   bool enabled;
   bool days[7];
   StartTime startTime;
-  Condition conditions[10];
+  Recurrence recurrence;
+  Condition conditions[MAX_TIMER_CONDITIONS];
   int conditionCount;
-  Action actions[50];
+  Action actions[MAX_TIMER_ACTIONS];
   int actionCount;
   int lastTriggeredDay;
+  int lastTriggeredStart;       // Départ consommé ce jour-là (minutes), -1 = aucun
   TimerExecutionContext context;
   
   FlexibleTimer() : id(0), name(""), enabled(true), conditionCount(0),
-                   actionCount(0), lastTriggeredDay(-1) {
+                   actionCount(0), lastTriggeredDay(-1), lastTriggeredStart(-1) {
     for (int i = 0; i < 7; i++) days[i] = false;
   }
 };
@@ -1,7 +1,12 @@
 /* 
  * POOL CONNECT - WEATHER
  * Gestion des données météo 
- * weather.h  V0.2
+ * weather.h  V0.5
+ * 
+ * Les requêtes OpenWeatherMap sont exécutées par la tâche réseau
+ * (processWeatherFetcher) avec timeouts, parsing JSON en flux filtré et
+ * report exponentiel sur erreur 429/5xx. Les dernières valeurs valides sont
+ * sauvegardées sur la flash et rechargées au démarrage.
  */
 
 #ifndef WEATHER_H
@@ -14,28 +19,170 @@
 #include "globals.h"
 #include "config.h"
 #include "logging.h"
+#include "time_service.h"
+#include "weather_parse.h"
 
 // ============================================================================
-// MÉTÉO
+// CONSTANTES
 // ============================================================================
 
-void updateWeatherData() {
-  LOG_D(LOG_WEATHER, "Demarrage mise a jour des donnees meteo...");
+#define WEATHER_CACHE_FILE "/weather_cache.json"
+#define WEATHER_HTTP_TIMEOUT_MS 5000        // Timeout connexion et lecture
+#define WEATHER_WIFI_RETRY_MS 30000UL       // Nouvel essai si WiFi absent
+
+// ============================================================================
+// VARIABLES GLOBALES
+// ============================================================================
+
+unsigned long nextWeatherFetch = 0;     // millis() du prochain appel
+unsigned long weatherRetryDelay = 0;    // Report courant (0 = pas d'erreur)
+bool weatherScheduled = false;
+time_t weatherLastSuccess = 0;          // Epoch des dernières données valides
+unsigned long weatherUndatedSuccess = 0; // millis() d'un succès avant réglage de l'heure (0 = aucun)
+int weatherLastHttpCode = 0;
+unsigned int weatherFailures = 0;
+
+// Prévisions par créneaux de 3h (protégées par dataMutex)
+time_t weatherForecastTimes[WEATHER_FORECAST_SLOTS];
+float weatherForecastTemps[WEATHER_FORECAST_SLOTS];
+int weatherForecastCount = 0;
+
+// ============================================================================
+// CACHE FLASH
+// ============================================================================
+
+void saveWeatherCache() {
+  File f = LittleFS.open(WEATHER_CACHE_FILE, FILE_WRITE);
+  if (!f) {
+    LOG_E(LOG_WEATHER, "Erreur ouverture %s en ecriture", WEATHER_CACHE_FILE);
+    LOG_STORAGE_OP("WRITE", WEATHER_CACHE_FILE, false);
+    return;
+  }
   
-  if (weatherApiKey == "") {
-    LOG_W(LOG_WEATHER, "Cle API meteo non configuree - Mise a jour annulee");
+  StaticJsonDocument<1024> doc;
+  doc["time"] = (uint32_t)weatherLastSuccess;
+  doc["temp"] = tempExterieure;
+  doc["sunshine"] = weatherSunshine;
+  doc["min"] = weatherTempMin;
+  doc["max"] = weatherTempMax;
+  
+  JsonArray slots = doc.createNestedArray("forecast");
+  for (int i = 0; i < weatherForecastCount; i++) {
+    JsonArray slot = slots.createNestedArray();
+    slot.add((uint32_t)weatherForecastTimes[i]);
+    slot.add(weatherForecastTemps[i]);
+  }
+  
+  serializeJson(doc, f);
+  f.close();
+  
+  LOG_V(LOG_WEATHER, "Cache meteo sauvegarde");
+}
+
+/**
+ * Recharge les dernières valeurs valides au démarrage : les équations
+ * disposent de weatherMax/weatherMin avant la première requête.
+ */
+void loadWeatherCache() {
+  if (!LittleFS.exists(WEATHER_CACHE_FILE)) {
+    LOG_D(LOG_WEATHER, "Pas de cache meteo");
     return;
   }
   
-  if (WiFi.status() != WL_CONNECTED) {
-    LOG_W(LOG_WEATHER, "WiFi non connecte - Mise a jour meteo annulee");
+  File f = LittleFS.open(WEATHER_CACHE_FILE, FILE_READ);
+  if (!f) {
+    LOG_E(LOG_WEATHER, "Erreur ouverture %s en lecture", WEATHER_CACHE_FILE);
+    LOG_STORAGE_OP("READ", WEATHER_CACHE_FILE, false);
+    return;
+  }
+  
+  StaticJsonDocument<1024> doc;
+  DeserializationError err = deserializeJson(doc, f);
+  f.close();
+  
+  if (err) {
+    LOG_E(LOG_WEATHER, "Erreur parsing cache meteo: %s", err.c_str());
     return;
   }
   
-  LOG_I(LOG_WEATHER, "Cle API presente, WiFi connecte - Lancement des requetes API");
+  weatherLastSuccess = doc["time"] | 0;
+  tempExterieure = doc["temp"] | tempExterieure;
+  weatherSunshine = doc["sunshine"] | weatherSunshine;
+  weatherTempMin = doc["min"] | weatherTempMin;
+  weatherTempMax = doc["max"] | weatherTempMax;
+  
+  weatherForecastCount = 0;
+  for (JsonArray slot : doc["forecast"].as<JsonArray>()) {
+    if (weatherForecastCount >= WEATHER_FORECAST_SLOTS) break;
+    weatherForecastTimes[weatherForecastCount] = slot[0] | 0;
+    weatherForecastTemps[weatherForecastCount] = slot[1] | 0.0f;
+    weatherForecastCount++;
+  }
+  
+  LOG_I(LOG_WEATHER, "Cache meteo charge: Temp ext=%.2f C, Min/Max=%.2f/%.2f C",
+        tempExterieure, weatherTempMin, weatherTempMax);
+}
+
+// ============================================================================
+// REQUÊTES HTTP
+// ============================================================================
+
+void logWeatherHttpError(const char* api, int httpCode) {
+  if (httpCode <= 0) {
+    LOG_E(LOG_WEATHER, "Erreur de connexion API %s: %s", api, HTTPClient::errorToString(httpCode).c_str());
+    return;
+  }
+  
+  LOG_E(LOG_WEATHER, "Erreur API %s - Code HTTP: %d", api, httpCode);
+  
+  // Détails des codes d'erreur courants
+  switch(httpCode) {
+    case 401:
+      LOG_E(LOG_WEATHER, "Erreur 401: Cle API invalide ou expiree");
+      break;
+    case 404:
+      LOG_E(LOG_WEATHER, "Erreur 404: Coordonnees invalides");
+      break;
+    case 429:
+      LOG_E(LOG_WEATHER, "Erreur 429: Limite d'appels API depassee");
+      break;
+    case 500:
+    case 502:
+    case 503:
+      LOG_E(LOG_WEATHER, "Erreur serveur OpenWeatherMap");
+      break;
+  }
+}
+
+/**
+ * GET avec timeouts, en HTTP/1.0 pour lire le corps en flux
+ * (pas de transfert chunked).
+ */
+int weatherHttpGet(HTTPClient& http, const String& url) {
+  http.setConnectTimeout(WEATHER_HTTP_TIMEOUT_MS);
+  http.setTimeout(WEATHER_HTTP_TIMEOUT_MS);
+  http.useHTTP10(true);
+  
+  if (!http.begin(url)) return -1;
+  return http.GET();
+}
+
+// ============================================================================
+// MÉTÉO
+// ============================================================================
+
+/**
+ * Interroge les API "weather" et "forecast".
+ * Bloquant (au plus 2 x timeout) : appelée uniquement par la tâche réseau.
+ * 
+ * @return code HTTP de la première erreur, ou 200 si tout a réussi
+ */
+int updateWeatherData() {
+  LOG_D(LOG_WEATHER, "Demarrage mise a jour des donnees meteo...");
   LOG_V(LOG_WEATHER, "Coordonnees: lat=%s, lon=%s", latitude.c_str(), longitude.c_str());
 
   HTTPClient http;
+  int result = 200;
   
   // ========================================================================
   // API MÉTÉO ACTUELLE
@@ -48,160 +195,197 @@ void updateWeatherData() {
   LOG_V(LOG_WEATHER, "URL: http://api.openweathermap.org/data/2.5/weather?lat=%s&lon=%s&appid=***&units=metric",
         latitude.c_str(), longitude.c_str());
   
-  http.begin(url);
-  int httpCode = http.GET();
-  
+  int httpCode = weatherHttpGet(http, url);
   LOG_D(LOG_WEATHER, "Code HTTP recu: %d", httpCode);
   
   if (httpCode == 200) {
-    LOG_I(LOG_WEATHER, "Requete API meteo actuelle reussie (HTTP 200)");
+    // Ne conserver que les champs utilisés
+    StaticJsonDocument<64> filter;
+    filter["main"]["temp"] = true;
+    filter["clouds"]["all"] = true;
     
-    String payload = http.getString();
-    LOG_V(LOG_WEATHER, "Taille reponse JSON: %d bytes", payload.length());
+    StaticJsonDocument<256> doc;
+    DeserializationError error = deserializeJson(doc, http.getStream(),
+                                                 DeserializationOption::Filter(filter));
     
-    DynamicJsonDocument doc(2048);
-    DeserializationError error = deserializeJson(doc, payload);
+    float temp = tempExterieure;
+    float sunshine = weatherSunshine;
     
     if (error) {
       LOG_E(LOG_WEATHER, "Erreur parsing JSON meteo actuelle: %s", error.c_str());
-    } else {
-      LOG_D(LOG_WEATHER, "JSON meteo actuelle parse avec succes");
+      result = -1;
+    } else if (!parseCurrentWeather(doc, &temp, &sunshine)) {
+      LOG_E(LOG_WEATHER, "Temperature absente de la reponse meteo actuelle");
+      result = -1;
+    } else if (xSemaphoreTake(dataMutex, portMAX_DELAY)) {
+      tempExterieure = temp;
+      weatherSunshine = sunshine;
+      xSemaphoreGive(dataMutex);
       
-      if (xSemaphoreTake(dataMutex, portMAX_DELAY)) {
-        tempExterieure = doc["main"]["temp"].as<float>();
-        LOG_V(LOG_WEATHER, "Temperature exterieure recuperee: %.2f C", tempExterieure);
-        
-        // Récupérer les nuages pour estimer l'ensoleillement
-        if (doc.containsKey("clouds")) {
-          float cloudiness = doc["clouds"]["all"].as<float>(); // 0-100%
-          weatherSunshine = 100.0 - cloudiness; // Inverser
-          LOG_V(LOG_WEATHER, "Couverture nuageuse: %.0f%%, Ensoleillement: %.0f%%", 
-                cloudiness, weatherSunshine);
-        } else {
-          LOG_W(LOG_WEATHER, "Donnees de couverture nuageuse non disponibles");
-        }
-        
-        xSemaphoreGive(dataMutex);
-        
-        LOG_I(LOG_WEATHER, "Meteo actuelle: %.2f C, Ensoleillement: %.0f%%", 
-              tempExterieure, weatherSunshine);
-      } else {
-        LOG_E(LOG_WEATHER, "Impossible d'obtenir le mutex pour meteo actuelle");
-      }
-    }
-  } else if (httpCode > 0) {
-    LOG_E(LOG_WEATHER, "Erreur API meteo actuelle - Code HTTP: %d", httpCode);
-    
-    // Détails des codes d'erreur courants
-    switch(httpCode) {
-      case 401:
-        LOG_E(LOG_WEATHER, "Erreur 401: Cle API invalide ou expiree");
-        break;
-      case 404:
-        LOG_E(LOG_WEATHER, "Erreur 404: Coordonnees invalides");
-        break;
-      case 429:
-        LOG_E(LOG_WEATHER, "Erreur 429: Limite d'appels API depassee");
-        break;
-      case 500:
-      case 502:
-      case 503:
-        LOG_E(LOG_WEATHER, "Erreur serveur OpenWeatherMap");
-        break;
+      LOG_I(LOG_WEATHER, "Meteo actuelle: %.2f C, Ensoleillement: %.0f%%", 
+            tempExterieure, weatherSunshine);
     }
   } else {
-    LOG_E(LOG_WEATHER, "Erreur de connexion API meteo actuelle: %s", http.errorToString(httpCode).c_str());
+    logWeatherHttpError("meteo actuelle", httpCode);
+    result = httpCode;
   }
   
   http.end();
-  LOG_V(LOG_WEATHER, "Connexion HTTP meteo actuelle fermee");
+  
+  // Inutile d'appeler la seconde API si le service refuse ou est injoignable
+  if (result != 200 && isWeatherErrorRetryable(result)) {
+    return result;
+  }
   
   // ========================================================================
-  // API PRÉVISIONS (24h) pour MIN/MAX
+  // API PRÉVISIONS (48h) pour MIN/MAX et planificateur
   // ========================================================================
-  LOG_D(LOG_WEATHER, "Requete API previsions 24h (OpenWeatherMap)...");
+  LOG_D(LOG_WEATHER, "Requete API previsions 48h (OpenWeatherMap)...");
   
   url = "http://api.openweathermap.org/data/2.5/forecast?lat=" + latitude +
-        "&lon=" + longitude + "&appid=" + weatherApiKey + "&units=metric&cnt=8";
-  
-  LOG_V(LOG_WEATHER, "URL: http://api.openweathermap.org/data/2.5/forecast?lat=%s&lon=%s&appid=***&units=metric&cnt=8",
-        latitude.c_str(), longitude.c_str());
+        "&lon=" + longitude + "&appid=" + weatherApiKey + "&units=metric&cnt=" +
+        String(WEATHER_FORECAST_SLOTS);
   
-  http.begin(url);
-  httpCode = http.GET();
+  LOG_V(LOG_WEATHER, "URL: http://api.openweathermap.org/data/2.5/forecast?lat=%s&lon=%s&appid=***&units=metric&cnt=%d",
+        latitude.c_str(), longitude.c_str(), WEATHER_FORECAST_SLOTS);
   
+  httpCode = weatherHttpGet(http, url);
   LOG_D(LOG_WEATHER, "Code HTTP recu: %d", httpCode);
   
   if (httpCode == 200) {
-    LOG_I(LOG_WEATHER, "Requete API previsions reussie (HTTP 200)");
+    StaticJsonDocument<96> filter;
+    filter["list"][0]["dt"] = true;
+    filter["list"][0]["main"]["temp"] = true;
     
-    String payload = http.getString();
-    LOG_V(LOG_WEATHER, "Taille reponse JSON: %d bytes", payload.length());
+    DynamicJsonDocument doc(2048);
+    DeserializationError error = deserializeJson(doc, http.getStream(),
+                                                 DeserializationOption::Filter(filter));
     
-    DynamicJsonDocument doc(8192);
-    DeserializationError error = deserializeJson(doc, payload);
+    float minTemp, maxTemp;
+    time_t times[WEATHER_FORECAST_SLOTS];
+    float temps[WEATHER_FORECAST_SLOTS];
+    int slotCount = 0;
     
     if (error) {
       LOG_E(LOG_WEATHER, "Erreur parsing JSON previsions: %s", error.c_str());
-    } else {
-      LOG_D(LOG_WEATHER, "JSON previsions parse avec succes");
-      
-      JsonArray list = doc["list"];
-      int forecastCount = list.size();
-      LOG_V(LOG_WEATHER, "Nombre de previsions recues: %d", forecastCount);
-      
-      float minTemp = 999.0;
-      float maxTemp = -999.0;
-      
-      for (JsonObject item : list) {
-        float temp = item["main"]["temp"].as<float>();
-        if (temp < minTemp) minTemp = temp;
-        if (temp > maxTemp) maxTemp = temp;
+      if (result == 200) result = -1;
+    } else if (!parseForecast(doc, times, temps, &slotCount, &minTemp, &maxTemp)) {
+      LOG_E(LOG_WEATHER, "Aucune prevision exploitable");
+      if (result == 200) result = -1;
+    } else if (xSemaphoreTake(dataMutex, portMAX_DELAY)) {
+      weatherTempMin = minTemp;
+      weatherTempMax = maxTemp;
+      for (int i = 0; i < slotCount; i++) {
+        weatherForecastTimes[i] = times[i];
+        weatherForecastTemps[i] = temps[i];
       }
+      weatherForecastCount = slotCount;
+      xSemaphoreGive(dataMutex);
       
-      if (xSemaphoreTake(dataMutex, portMAX_DELAY)) {
-        weatherTempMin = minTemp;
-        weatherTempMax = maxTemp;
-        xSemaphoreGive(dataMutex);
-        
-        LOG_I(LOG_WEATHER, "Previsions 24h: Min=%.2f C, Max=%.2f C", minTemp, maxTemp);
-        LOG_V(LOG_WEATHER, "Amplitude thermique: %.2f C", maxTemp - minTemp);
-      } else {
-        LOG_E(LOG_WEATHER, "Impossible d'obtenir le mutex pour previsions");
-      }
-    }
-  } else if (httpCode > 0) {
-    LOG_E(LOG_WEATHER, "Erreur API previsions - Code HTTP: %d", httpCode);
-    
-    // Détails des codes d'erreur courants
-    switch(httpCode) {
-      case 401:
-        LOG_E(LOG_WEATHER, "Erreur 401: Cle API invalide ou expiree");
-        break;
-      case 404:
-        LOG_E(LOG_WEATHER, "Erreur 404: Coordonnees invalides");
-        break;
-      case 429:
-        LOG_E(LOG_WEATHER, "Erreur 429: Limite d'appels API depassee");
-        break;
-      case 500:
-      case 502:
-      case 503:
-        LOG_E(LOG_WEATHER, "Erreur serveur OpenWeatherMap");
-        break;
+      LOG_I(LOG_WEATHER, "Previsions 24h: Min=%.2f C, Max=%.2f C (%d creneaux)", minTemp, maxTemp, slotCount);
+      LOG_V(LOG_WEATHER, "Amplitude thermique: %.2f C", maxTemp - minTemp);
     }
   } else {
-    LOG_E(LOG_WEATHER, "Erreur de connexion API previsions: %s", http.errorToString(httpCode).c_str());
+    logWeatherHttpError("previsions", httpCode);
+    if (result == 200) result = httpCode;
   }
   
   http.end();
-  LOG_V(LOG_WEATHER, "Connexion HTTP previsions fermee");
   
   LOG_SEPARATOR();
-  LOG_I(LOG_WEATHER, "Mise a jour meteo terminee");
+  LOG_I(LOG_WEATHER, "Mise a jour meteo terminee (resultat: %d)", result);
   LOG_I(LOG_WEATHER, "Resume: Temp ext=%.2f C, Sunshine=%.0f%%, Min/Max=%.2f/%.2f C",
         tempExterieure, weatherSunshine, weatherTempMin, weatherTempMax);
   LOG_SEPARATOR();
+  
+  return result;
+}
+
+// ============================================================================
+// PLANIFICATION (TÂCHE RÉSEAU)
+// ============================================================================
+
+/**
+ * Déclenche la mise à jour météo quand elle est due.
+ * - Au démarrage, le cache flash évite une requête si les données sont récentes
+ * - Après une erreur 429/5xx ou de connexion, report exponentiel (1 min -> 1h)
+ * 
+ * @param forceRefresh Demande explicite (configuration modifiée)
+ */
+void processWeatherFetcher(bool forceRefresh) {
+  unsigned long now = millis();
+  
+  // Succès obtenu avant le réglage de l'heure : daté dès qu'elle est connue
+  if (weatherUndatedSuccess != 0 && isTimeValid()) {
+    weatherLastSuccess = getCachedEpoch() - (time_t)((now - weatherUndatedSuccess) / 1000);
+    weatherUndatedSuccess = 0;
+    saveWeatherCache();
+    LOG_D(LOG_WEATHER, "Donnees meteo datees apres reglage de l'heure");
+  }
+  
+  if (forceRefresh) {
+    weatherRetryDelay = 0;
+    nextWeatherFetch = now;
+    weatherScheduled = true;
+  }
+  
+  // Première planification : tenir compte de l'âge du cache
+  if (!weatherScheduled) {
+    // Âge du cache inconnu tant que l'heure n'est pas réglée (attente max 1 min)
+    if (!isTimeValid() && weatherLastSuccess > 0 && now < 60000) return;
+    
+    weatherScheduled = true;
+    nextWeatherFetch = now;
+    
+    time_t age = getCachedEpoch() - weatherLastSuccess;
+    if (weatherLastSuccess > 0 && age >= 0 && (unsigned long)age * 1000UL < WEATHER_UPDATE_INTERVAL) {
+      nextWeatherFetch = now + (WEATHER_UPDATE_INTERVAL - (unsigned long)age * 1000UL);
+      LOG_I(LOG_WEATHER, "Cache meteo recent (%ld s) - Prochaine requete dans %lu s",
+            (long)age, (nextWeatherFetch - now) / 1000);
+      return;
+    }
+  }
+  
+  if ((long)(now - nextWeatherFetch) < 0) return;
+  
+  if (weatherApiKey == "") {
+    nextWeatherFetch = now + WEATHER_UPDATE_INTERVAL;
+    LOG_W(LOG_WEATHER, "Cle API meteo non configuree - Mise a jour annulee");
+    return;
+  }
+  
+  if (WiFi.status() != WL_CONNECTED) {
+    nextWeatherFetch = now + WEATHER_WIFI_RETRY_MS;
+    LOG_W(LOG_WEATHER, "WiFi non connecte - Mise a jour meteo reportee");
+    return;
+  }
+  
+  weatherLastHttpCode = updateWeatherData();
+  
+  if (weatherLastHttpCode == 200) {
+    weatherFailures = 0;
+    weatherRetryDelay = 0;
+    // Heure pas encore réglée (getCachedEpoch() = 0) : daté au réglage
+    if (isTimeValid()) {
+      weatherLastSuccess = getCachedEpoch();
+      weatherUndatedSuccess = 0;
+    } else {
+      weatherUndatedSuccess = millis() | 1;
+    }
+    saveWeatherCache();
+    nextWeatherFetch = millis() + WEATHER_UPDATE_INTERVAL;
+    LOG_V(LOG_WEATHER, "Prochaine mise a jour dans %lu ms", WEATHER_UPDATE_INTERVAL);
+  } else if (isWeatherErrorRetryable(weatherLastHttpCode)) {
+    weatherFailures++;
+    weatherRetryDelay = nextWeatherRetryDelay(weatherRetryDelay);
+    nextWeatherFetch = millis() + weatherRetryDelay;
+    LOG_W(LOG_WEATHER, "Echec meteo #%u - Nouvel essai dans %lu s",
+          weatherFailures, weatherRetryDelay / 1000);
+  } else {
+    // Erreur de configuration (401, 404...) : inutile d'insister
+    weatherFailures++;
+    nextWeatherFetch = millis() + WEATHER_UPDATE_INTERVAL;
+  }
 }
 
 void saveWeatherConfig() {
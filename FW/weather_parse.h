@@ -0,0 +1,103 @@
+/*
+ * POOL CONNECT - WEATHER PARSE
+ * Lecture des réponses OpenWeatherMap et report sur erreur
+ * weather_parse.h   V0.1
+ *
+ * Module pur (ArduinoJson seulement, pas d'appel réseau ni de flash) :
+ * testable sur PC avec des réponses enregistrées (test/weather_test.cpp).
+ */
+
+#ifndef WEATHER_PARSE_H
+#define WEATHER_PARSE_H
+
+#include <stdint.h>
+#include <time.h>
+#include <ArduinoJson.h>
+
+// ============================================================================
+// CONSTANTES
+// ============================================================================
+
+#define WEATHER_RETRY_MIN_MS 60000UL        // Premier report après erreur (1 min)
+#define WEATHER_RETRY_MAX_MS 3600000UL      // Report maximum (1h)
+#define WEATHER_FORECAST_SLOTS 16           // Créneaux de 3h = 48h (planificateur)
+#define WEATHER_MINMAX_SLOTS 8              // Min/max calculés sur 24h
+
+// ============================================================================
+// PARSING
+// ============================================================================
+
+/**
+ * Extrait température et ensoleillement de la réponse "weather".
+ * 
+ * @return false si la température est absente
+ */
+inline bool parseCurrentWeather(JsonDocument& doc, float* temp, float* sunshine) {
+  if (!doc["main"]["temp"].is<float>()) return false;
+  
+  *temp = doc["main"]["temp"].as<float>();
+  
+  // Récupérer les nuages pour estimer l'ensoleillement
+  if (doc["clouds"]["all"].is<float>()) {
+    float cloudiness = doc["clouds"]["all"].as<float>(); // 0-100%
+    *sunshine = 100.0 - cloudiness; // Inverser
+  }
+  return true;
+}
+
+/**
+ * Extrait les créneaux de la réponse "forecast" et calcule min/max sur les
+ * 8 premiers (24h).
+ * 
+ * @param times Epoch des créneaux (WEATHER_FORECAST_SLOTS max)
+ * @param temps Températures des créneaux
+ * @param count Nombre de créneaux extraits
+ * @return false si aucune prévision exploitable
+ */
+inline bool parseForecast(JsonDocument& doc, time_t* times, float* temps, int* count,
+                          float* minTemp, float* maxTemp) {
+  float minT = 999.0;
+  float maxT = -999.0;
+  int n = 0;
+  
+  for (JsonObject item : doc["list"].as<JsonArray>()) {
+    if (n >= WEATHER_FORECAST_SLOTS) break;
+    if (!item["main"]["temp"].is<float>()) continue;
+    
+    float temp = item["main"]["temp"].as<float>();
+    times[n] = item["dt"] | 0;
+    temps[n] = temp;
+    
+    if (n < WEATHER_MINMAX_SLOTS) {
+      if (temp < minT) minT = temp;
+      if (temp > maxT) maxT = temp;
+    }
+    n++;
+  }
+  
+  if (n == 0) return false;
+  
+  *count = n;
+  *minTemp = minT;
+  *maxTemp = maxT;
+  return true;
+}
+
+/**
+ * Erreurs pour lesquelles on espace les tentatives
+ * (connexion impossible, limite d'appels, erreur serveur).
+ */
+inline bool isWeatherErrorRetryable(int httpCode) {
+  return httpCode <= 0 || httpCode == 429 || httpCode >= 500;
+}
+
+/**
+ * Report suivant : double à chaque échec, borné entre 1 min et 1h.
+ */
+inline unsigned long nextWeatherRetryDelay(unsigned long current) {
+  if (current < WEATHER_RETRY_MIN_MS) return WEATHER_RETRY_MIN_MS;
+  if (current >= WEATHER_RETRY_MAX_MS / 2) return WEATHER_RETRY_MAX_MS;
+  return current * 2;
+}
+
+#endif // WEATHER_PARSE_H
@@ -0,0 +1,365 @@
+/*
+ * POOL CONNECT - WEB EVENTS
+ * Mesures et états en direct vers l'interface (Server-Sent Events)
+ * web_events.h   V0.3
+ *
+ * GET /api/events ouvre un flux text/event-stream gardé ouvert :
+ * - à la connexion, un événement "state" avec l'état complet
+ * - ensuite des événements "delta" ne contenant que les champs modifiés
+ *   (températures et pression avec une bande morte)
+ * - un commentaire keep-alive si rien n'a été envoyé depuis 15 s
+ *
+ * Les changements sont signalés par EVT_LIVE_CHANGED, posté aux mêmes
+ * endroits que les publications MQTT (nouvelles mesures, changement de
+ * relais), et vérifiés toutes les 250 ms pour les autres chemins.
+ * Chaque changement est formaté une seule fois puis écrit sur tous les
+ * clients : le coût ne dépend plus du nombre de tableaux de bord ouverts.
+ *
+ * Écriture sans attente (writeSocketNow) : ce que la socket n'accepte
+ * pas reste dans le tampon du client et part aux passages suivants. Un
+ * client dont le tampon déborde est fermé (le navigateur se reconnecte
+ * et reçoit l'état complet).
+ *
+ * Tout est exécuté par la tâche web (seule à écrire sur les sockets).
+ */
+
+#ifndef WEB_EVENTS_H
+#define WEB_EVENTS_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <WebServer.h>
+#include "globals.h"
+#include "logging.h"
+#include "time_service.h"
+#include "task_bus.h"
+#include "relay_service.h"
+#include "web_stream.h"
+
+// ============================================================================
+// CONSTANTES
+// ============================================================================
+
+#define LIVE_MAX_CLIENTS 4
+#define LIVE_CHECK_INTERVAL_MS 250       // Filet de sécurité (relais sans événement)
+#define LIVE_KEEPALIVE_MS 15000
+#define LIVE_RETRY_MS 3000               // Délai de reconnexion du navigateur
+#define LIVE_EVENT_MAX 320
+#define LIVE_PENDING_MAX (2 * LIVE_EVENT_MAX)   // Non envoyé, par client
+#define LIVE_TEMP_DEADBAND 0.05f         // °C
+#define LIVE_PRESSURE_DEADBAND 0.01f     // bar
+
+// ============================================================================
+// STRUCTURES
+// ============================================================================
+
+struct LiveState {
+  float waterTemp;          // NAN si capteur en erreur
+  float waterPressure;
+  float extTemp;
+  bool waterLeak;
+  bool coverOpen;
+  uint8_t relays;           // Bit i = relais i
+  uint8_t activeTimers;
+  char time[20];            // "jj/mm/aaaa hh:mm:ss", vide si NTP absent
+};
+
+struct LiveClient {
+  WiFiClient client;
+  bool active;
+  unsigned long lastWrite;
+  char pending[LIVE_PENDING_MAX];
+  size_t pendingLength;
+};
+
+// ============================================================================
+// VARIABLES GLOBALES
+// ============================================================================
+
+LiveClient liveClients[LIVE_MAX_CLIENTS];
+LiveState liveSent;                      // Valeurs déjà diffusées
+uint32_t liveEventId = 0;
+unsigned long lastLiveCheck = 0;
+unsigned long liveEventsSent = 0;
+unsigned long liveClientsDropped = 0;
+
+// ============================================================================
+// ÉTAT COURANT
+// ============================================================================
+
+void captureLiveState(LiveState& state) {
+  // Valeurs précédentes si le mutex est occupé (prochaine vérification dans 250 ms)
+  state = liveSent;
+
+  if (xSemaphoreTake(dataMutex, pdMS_TO_TICKS(20))) {
+    bool tempValid = !isnan(waterTemp) && waterTemp >= -50 && waterTemp <= 100;
+    state.waterTemp = tempValid ? waterTemp : NAN;
+    state.waterPressure = waterPressure;
+    state.extTemp = tempExterieure;
+    state.waterLeak = waterLeak;
+    state.coverOpen = coverOpen;
+    xSemaphoreGive(dataMutex);
+  }
+
+  state.relays = getRelayMask();
+
+  state.activeTimers = 0;
+  for (int i = 0; i < flexTimerCount; i++) {
+    if (flexTimers[i].enabled && flexTimers[i].context.state == TIMER_RUNNING) {
+      state.activeTimers++;
+    }
+  }
+
+  struct tm timeinfo;
+  if (getCachedTime(&timeinfo)) {
+    strftime(state.time, sizeof(state.time), "%d/%m/%Y %H:%M:%S", &timeinfo);
+  } else {
+    state.time[0] = '\0';
+  }
+}
+
+// ============================================================================
+// FORMATAGE
+// ============================================================================
+
+/**
+ * Ajoute un champ "nom":valeur à l'objet JSON en cours.
+ */
+void appendLiveField(char* buf, size_t size, size_t& len, const char* name, const char* format, ...) {
+  if (len >= size) return;
+
+  int n = snprintf(buf + len, size - len, "%s\"%s\":", buf[len - 1] == '{' ? "" : ",", name);
+  if (n < 0) return;
+  len += n;
+  if (len >= size) return;
+
+  va_list args;
+  va_start(args, format);
+  n = vsnprintf(buf + len, size - len, format, args);
+  va_end(args);
+  if (n > 0) len += n;
+}
+
+void appendLiveFloat(char* buf, size_t size, size_t& len, const char* name, float value) {
+  if (isnan(value)) appendLiveField(buf, size, len, name, "null");
+  else appendLiveField(buf, size, len, name, "%.2f", value);
+}
+
+bool liveFloatChanged(float current, float sent, float deadband) {
+  if (isnan(current) || isnan(sent)) return isnan(current) != isnan(sent);
+  return fabsf(current - sent) >= deadband;
+}
+
+/**
+ * Formate un événement SSE complet.
+ *
+ * @param full true : tous les champs (événement "state"), false : seulement
+ *             ceux qui diffèrent de "sent" (événement "delta")
+ * @param sent Valeurs déjà diffusées, mises à jour pour les champs émis
+ * @return longueur de l'événement, 0 si rien n'a changé
+ */
+size_t formatLiveEvent(const LiveState& current, LiveState& sent, bool full, char* buf, size_t size) {
+  size_t len = snprintf(buf, size, "id: %lu\nevent: %s\ndata: {",
+                        (unsigned long)(liveEventId + 1), full ? "state" : "delta");
+  size_t header = len;
+
+  if (full || liveFloatChanged(current.waterTemp, sent.waterTemp, LIVE_TEMP_DEADBAND)) {
+    appendLiveFloat(buf, size, len, "waterTemp", current.waterTemp);
+    sent.waterTemp = current.waterTemp;
+  }
+  if (full || liveFloatChanged(current.waterPressure, sent.waterPressure, LIVE_PRESSURE_DEADBAND)) {
+    appendLiveFloat(buf, size, len, "waterPressure", current.waterPressure);
+    sent.waterPressure = current.waterPressure;
+  }
+  if (full || liveFloatChanged(current.extTemp, sent.extTemp, LIVE_TEMP_DEADBAND)) {
+    appendLiveFloat(buf, size, len, "extTemp", current.extTemp);
+    sent.extTemp = current.extTemp;
+  }
+  if (full || current.waterLeak != sent.waterLeak) {
+    appendLiveField(buf, size, len, "waterLeak", current.waterLeak ? "true" : "false");
+    sent.waterLeak = current.waterLeak;
+  }
+  if (full || current.coverOpen != sent.coverOpen) {
+    appendLiveField(buf, size, len, "coverOpen", current.coverOpen ? "true" : "false");
+    sent.coverOpen = current.coverOpen;
+  }
+  if (full || current.relays != sent.relays) {
+    appendLiveField(buf, size, len, "relays", "[%d,%d,%d,%d,%d]",
+                    current.relays & 1, (current.relays >> 1) & 1, (current.relays >> 2) & 1,
+                    (current.relays >> 3) & 1, (current.relays >> 4) & 1);
+    sent.relays = current.relays;
+  }
+  if (full || current.activeTimers != sent.activeTimers) {
+    appendLiveField(buf, size, len, "activeTimers", "%d", current.activeTimers);
+    sent.activeTimers = current.activeTimers;
+  }
+  if (full || strcmp(current.time, sent.time) != 0) {
+    if (current.time[0] != '\0') appendLiveField(buf, size, len, "time", "\"%s\"", current.time);
+    strlcpy(sent.time, current.time, sizeof(sent.time));
+  }
+
+  if (len == header || len + 4 > size) return 0;
+
+  memcpy(buf + len, "}\n\n", 4);
+  liveEventId++;
+  return len + 3;
+}
+
+// ============================================================================
+// CLIENTS
+// ============================================================================
+
+int getLiveClientCount() {
+  int count = 0;
+  for (int i = 0; i < LIVE_MAX_CLIENTS; i++) {
+    if (liveClients[i].active) count++;
+  }
+  return count;
+}
+
+void dropLiveClient(int slot) {
+  liveClients[slot].client.stop();
+  liveClients[slot].client = WiFiClient();
+  liveClients[slot].active = false;
+  liveClients[slot].pendingLength = 0;
+  liveClientsDropped++;
+  LOG_D(LOG_WEB, "Flux direct %d ferme (%d actifs)", slot, getLiveClientCount());
+}
+
+/**
+ * Envoie ce que la socket accepte du tampon d'un client, le ferme s'il
+ * est déconnecté.
+ */
+bool flushLiveClient(int slot) {
+  LiveClient& live = liveClients[slot];
+  if (live.pendingLength == 0) return true;
+
+  int n = live.client.connected() ? writeSocketNow(live.client, live.pending, live.pendingLength) : -1;
+  if (n < 0) {
+    dropLiveClient(slot);
+    return false;
+  }
+  if (n > 0) {
+    live.pendingLength -= n;
+    memmove(live.pending, live.pending + n, live.pendingLength);
+  }
+  return true;
+}
+
+/**
+ * Ajoute un événement au tampon d'un client, le ferme s'il est déconnecté
+ * ou trop lent (tampon plein).
+ */
+bool writeLiveClient(int slot, const char* data, size_t len) {
+  LiveClient& live = liveClients[slot];
+
+  if (!flushLiveClient(slot)) return false;
+  if (live.pendingLength + len > sizeof(live.pending)) {
+    LOG_D(LOG_WEB, "Flux direct %d: client trop lent", slot);
+    dropLiveClient(slot);
+    return false;
+  }
+
+  memcpy(live.pending + live.pendingLength, data, len);
+  live.pendingLength += len;
+  live.lastWrite = millis();
+  return flushLiveClient(slot);
+}
+
+void broadcastLiveEvent(const char* data, size_t len) {
+  for (int i = 0; i < LIVE_MAX_CLIENTS; i++) {
+    if (liveClients[i].active) writeLiveClient(i, data, len);
+  }
+  liveEventsSent++;
+}
+
+// ============================================================================
+// HANDLER & POMPE D'ÉVÉNEMENTS
+// ============================================================================
+
+/**
+ * GET /api/events
+ *
+ * Les en-têtes sont écrits directement sur la socket, puis le client est
+ * retiré du serveur (copie gardée dans liveClients) : handleClient() voit
+ * une connexion terminée et passe immédiatement à la requête suivante.
+ */
+void handleApiEvents() {
+  LOG_WEB_REQUEST("GET", "/api/events");
+
+  int slot = -1;
+  for (int i = 0; i < LIVE_MAX_CLIENTS; i++) {
+    if (liveClients[i].active && !liveClients[i].client.connected()) dropLiveClient(i);
+    if (!liveClients[i].active && slot < 0) slot = i;
+  }
+
+  if (slot < 0) {
+    LOG_W(LOG_WEB, "Flux direct refuse: %d clients max", LIVE_MAX_CLIENTS);
+    server.send(503, "text/plain", "Too many live clients");
+    return;
+  }
+
+  // Premier client : point de départ des deltas
+  if (getLiveClientCount() == 0) captureLiveState(liveSent);
+
+  WiFiClient& client = server.client();
+  client.setNoDelay(true);
+  size_t headerBytes = client.printf("HTTP/1.1 200 OK\r\n"
+                "Content-Type: text/event-stream\r\n"
+                "Cache-Control: no-cache\r\n"
+                "Connection: keep-alive\r\n"
+                "\r\n"
+                "retry: %d\n\n", LIVE_RETRY_MS);
+  server.noteResponse(200, headerBytes);
+
+  liveClients[slot].client = client;
+  liveClients[slot].active = true;
+  liveClients[slot].lastWrite = millis();
+  liveClients[slot].pendingLength = 0;
+  client = WiFiClient();
+
+  // État complet pour ce client uniquement
+  LiveState current;
+  LiveState snapshot = liveSent;
+  captureLiveState(current);
+  char event[LIVE_EVENT_MAX];
+  size_t len = formatLiveEvent(current, snapshot, true, event, sizeof(event));
+  if (len > 0) writeLiveClient(slot, event, len);
+
+  LOG_I(LOG_WEB, "Flux direct %d ouvert (%d actifs)", slot, getLiveClientCount());
+}
+
+/**
+ * Appelé par la tâche web après chaque handleClient().
+ */
+void processLiveEvents() {
+  EventBits_t bits = xEventGroupClearBits(systemEvents, EVT_LIVE_CHANGED);
+  if (getLiveClientCount() == 0) return;
+
+  // Reste des événements précédents
+  for (int i = 0; i < LIVE_MAX_CLIENTS; i++) {
+    if (liveClients[i].active) flushLiveClient(i);
+  }
+
+  unsigned long now = millis();
+  if (!(bits & EVT_LIVE_CHANGED) && now - lastLiveCheck < LIVE_CHECK_INTERVAL_MS) return;
+  lastLiveCheck = now;
+
+  LiveState current;
+  captureLiveState(current);
+
+  char event[LIVE_EVENT_MAX];
+  size_t len = formatLiveEvent(current, liveSent, false, event, sizeof(event));
+  if (len > 0) {
+    broadcastLiveEvent(event, len);
+    return;
+  }
+
+  for (int i = 0; i < LIVE_MAX_CLIENTS; i++) {
+    if (liveClients[i].active && now - liveClients[i].lastWrite >= LIVE_KEEPALIVE_MS) {
+      writeLiveClient(i, ": keep-alive\n\n", 14);
+    }
+  }
+}
+
+#endif // WEB_EVENTS_H
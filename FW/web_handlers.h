@@ -1,7 +1,7 @@
 /* 
  * POOL CONNECT - WEB HANDLERS IMPLEMENTATION
  * Implémentations complètes des handlers HTTP
- * web_handlers.h   V0.4
+ * web_handlers.h   V1.3
  */
 
 #ifndef WEB_HANDLERS_IMPL_H
@@ -12,6 +12,7 @@
 #include <LittleFS.h>
 #include <ArduinoJson.h>
 #include "globals.h"
+#include "time_service.h"
 #include "config.h"
 #include "logging.h"
 #include "users.h"
@@ -22,311 +23,14 @@
 #include "backup_restore.h"
 #include "scenarios.h"
 #include "chart_event_points.h"
-
-// ============================================================================
-// FICHIERS STATIQUES
-// ============================================================================
-
-void handleRoot() {
-  LOG_WEB_REQUEST("GET", "/");
-  
-  File file = LittleFS.open("/index.html", "r");
-  if (!file) {
-    LOG_E(LOG_WEB, "Fichier /index.html non trouve");
-    server.send(404, "text/plain", "index.html not found");
-    return;
-  }
-  
-  LOG_V(LOG_WEB, "Envoi de /index.html (%d bytes)", file.size());
-  server.streamFile(file, "text/html");
-  file.close();
-}
-
-void handleCss() {
-  LOG_WEB_REQUEST("GET", "/style.css");
-  
-  File file = LittleFS.open("/style.css", "r");
-  if (!file) {
-    LOG_E(LOG_WEB, "Fichier /style.css non trouve");
-    server.send(404, "text/plain", "CSS not found");
-    return;
-  }
-  
-  LOG_V(LOG_WEB, "Envoi de /style.css (%d bytes)", file.size());
-  server.streamFile(file, "text/css");
-  file.close();
-}
-
-void handleJs() {
-  LOG_WEB_REQUEST("GET", "/app.js");
-  
-  File file = LittleFS.open("/app.js", "r");
-  if (!file) {
-    LOG_E(LOG_WEB, "Fichier /app.js non trouve");
-    server.send(404, "text/plain", "JS not found");
-    return;
-  }
-  
-  LOG_V(LOG_WEB, "Envoi de /app.js (%d bytes)", file.size());
-  server.streamFile(file, "application/javascript");
-  file.close();
-}
-
-void handleJSauth() {
-  LOG_WEB_REQUEST("GET", "/modules/auth.js");
-  
-  File file = LittleFS.open("/modules/auth.js", "r");
-  if (!file) {
-    LOG_E(LOG_WEB, "Fichier /modules/auth.js non trouve");
-    server.send(404, "text/plain", "JS not found");
-    return;
-  }
-  
-  LOG_V(LOG_WEB, "Envoi de /modules/auth.js (%d bytes)", file.size());
-  server.streamFile(file, "application/javascript");
-  file.close();
-}
-
-void handleJsbackup() {
-  LOG_WEB_REQUEST("GET", "/modules/backup.js");
-  
-  File file = LittleFS.open("/modules/backup.js", "r");
-  if (!file) {
-    LOG_E(LOG_WEB, "Fichier /modules/backup.js non trouve");
-    server.send(404, "text/plain", "JS not found");
-    return;
-  }
-  
-  LOG_V(LOG_WEB, "Envoi de /modules/backup.js (%d bytes)", file.size());
-  server.streamFile(file, "application/javascript");
-  file.close();
-}
-
-void handleJscalib() {
-  LOG_WEB_REQUEST("GET", "/modules/calibration.js");
-  
-  File file = LittleFS.open("/modules/calibration.js", "r");
-  if (!file) {
-    LOG_E(LOG_WEB, "Fichier /modules/calibration.js non trouve");
-    server.send(404, "text/plain", "JS not found");
-    return;
-  }
-  
-  LOG_V(LOG_WEB, "Envoi de /modules/calibration.js (%d bytes)", file.size());
-  server.streamFile(file, "application/javascript");
-  file.close();
-}
-
-void handleJschart() {
-  LOG_WEB_REQUEST("GET", "/modules/chart.js");
-  
-  File file = LittleFS.open("/modules/chart.js", "r");
-  if (!file) {
-    LOG_E(LOG_WEB, "Fichier /modules/chart.js non trouve");
-    server.send(404, "text/plain", "JS not found");
-    return;
-  }
-  
-  LOG_V(LOG_WEB, "Envoi de /modules/chart.js (%d bytes)", file.size());
-  server.streamFile(file, "application/javascript");
-  file.close();
-}
-
-void handleJscontrol() {
-  LOG_WEB_REQUEST("GET", "/modules/control.js");
-  
-  File file = LittleFS.open("/modules/control.js", "r");
-  if (!file) {
-    LOG_E(LOG_WEB, "Fichier /modules/control.js non trouve");
-    server.send(404, "text/plain", "JS not found");
-    return;
-  }
-  
-  LOG_V(LOG_WEB, "Envoi de /modules/control.js (%d bytes)", file.size());
-  server.streamFile(file, "application/javascript");
-  file.close();
-}
-
-void handleJsdashboard() {
-  LOG_WEB_REQUEST("GET", "/modules/dashboard.js");
-  
-  File file = LittleFS.open("/modules/dashboard.js", "r");
-  if (!file) {
-    LOG_E(LOG_WEB, "Fichier /modules/dashboard.js non trouve");
-    server.send(404, "text/plain", "JS not found");
-    return;
-  }
-  
-  LOG_V(LOG_WEB, "Envoi de /modules/dashboard.js (%d bytes)", file.size());
-  server.streamFile(file, "application/javascript");
-  file.close();
-}
-
-void handleJspref() {
-  LOG_WEB_REQUEST("GET", "/modules/preferences.js");
-  
-  File file = LittleFS.open("/modules/preferences.js", "r");
-  if (!file) {
-    LOG_E(LOG_WEB, "Fichier /modules/preferences.js non trouve");
-    server.send(404, "text/plain", "JS not found");
-    return;
-  }
-  
-  LOG_V(LOG_WEB, "Envoi de /modules/preferences.js (%d bytes)", file.size());
-  server.streamFile(file, "application/javascript");
-  file.close();
-}
-
-void handleJsscenar() {
-  LOG_WEB_REQUEST("GET", "/modules/scenarios.js");
-  
-  File file = LittleFS.open("/modules/scenarios.js", "r");
-  if (!file) {
-    LOG_E(LOG_WEB, "Fichier /modules/scenarios.js non trouve");
-    server.send(404, "text/plain", "JS not found");
-    return;
-  }
-  
-  LOG_V(LOG_WEB, "Envoi de /modules/scenarios.js (%d bytes)", file.size());
-  server.streamFile(file, "application/javascript");
-  file.close();
-}
-
-void handleJssettings() {
-  LOG_WEB_REQUEST("GET", "/modules/settings.js");
-  
-  File file = LittleFS.open("/modules/settings.js", "r");
-  if (!file) {
-    LOG_E(LOG_WEB, "Fichier /modules/settings.js non trouve");
-    server.send(404, "text/plain", "JS not found");
-    return;
-  }
-  
-  LOG_V(LOG_WEB, "Envoi de /modules/settings.js (%d bytes)", file.size());
-  server.streamFile(file, "application/javascript");
-  file.close();
-}
-
-void handleJstheme() {
-  LOG_WEB_REQUEST("GET", "/modules/theme.js");
-  
-  File file = LittleFS.open("/modules/theme.js", "r");
-  if (!file) {
-    LOG_E(LOG_WEB, "Fichier /modules/theme.js non trouve");
-    server.send(404, "text/plain", "JS not found");
-    return;
-  }
-  
-  LOG_V(LOG_WEB, "Envoi de /modules/theme.js (%d bytes)", file.size());
-  server.streamFile(file, "application/javascript");
-  file.close();
-}
-
-void handleJstimers() {
-  LOG_WEB_REQUEST("GET", "/modules/timers.js");
-  
-  File file = LittleFS.open("/modules/timers.js", "r");
-  if (!file) {
-    LOG_E(LOG_WEB, "Fichier /modules/timers.js non trouve");
-    server.send(404, "text/plain", "JS not found");
-    return;
-  }
-  
-  LOG_V(LOG_WEB, "Envoi de /modules/timers.js (%d bytes)", file.size());
-  server.streamFile(file, "application/javascript");
-  file.close();
-}
-
-void handleJsunits() {
-  LOG_WEB_REQUEST("GET", "/modules/units.js");
-  
-  File file = LittleFS.open("/modules/units.js", "r");
-  if (!file) {
-    LOG_E(LOG_WEB, "Fichier /modules/units.js non trouve");
-    server.send(404, "text/plain", "JS not found");
-    return;
-  }
-  
-  LOG_V(LOG_WEB, "Envoi de /modules/units.js (%d bytes)", file.size());
-  server.streamFile(file, "application/javascript");
-  file.close();
-}
-
-void handleJsusers() {
-  LOG_WEB_REQUEST("GET", "/modules/users.js");
-  
-  File file = LittleFS.open("/modules/users.js", "r");
-  if (!file) {
-    LOG_E(LOG_WEB, "Fichier /modules/users.js non trouve");
-    server.send(404, "text/plain", "JS not found");
-    return;
-  }
-  
-  LOG_V(LOG_WEB, "Envoi de /modules/users.js (%d bytes)", file.size());
-  server.streamFile(file, "application/javascript");
-  file.close();
-}
-
-void handlelangageJs() {
-  LOG_WEB_REQUEST("GET", "/modules/translations.js");
-  
-  File file = LittleFS.open("/modules/translations.js", "r");
-  if (!file) {
-    LOG_E(LOG_WEB, "Fichier /modules/translations.js non trouve");
-    server.send(404, "text/plain", "JS not found");
-    return;
-  }
-  
-  LOG_V(LOG_WEB, "Envoi de /modules/translations.js (%d bytes)", file.size());
-  server.streamFile(file, "application/javascript");
-  file.close();
-}
-
-void handleotaJs() {
-  LOG_WEB_REQUEST("GET", "/modules/ota.js");
-  
-  File file = LittleFS.open("/modules/ota.js", "r");
-  if (!file) {
-    LOG_E(LOG_WEB, "Fichier /modules/ota.js non trouve");
-    server.send(404, "text/plain", "JS not found");
-    return;
-  }
-  
-  LOG_V(LOG_WEB, "Envoi de /modules/ota.js (%d bytes)", file.size());
-  server.streamFile(file, "application/javascript");
-  file.close();
-}
-
-void handleLogo() {
-  LOG_WEB_REQUEST("GET", "/img/logo.png");
-  
-  File file = LittleFS.open("/img/logo.png", "r");
-  if (!file) {
-    LOG_E(LOG_WEB, "Fichier /img/logo.png non trouve");
-    server.send(404, "text/plain", "logo not found");
-    return;
-  }
-  
-  LOG_V(LOG_WEB, "Envoi de /img/logo.png (%d bytes)", file.size());
-  server.streamFile(file, "image/png");
-  file.close();
-}
-
-void handleFavicon() {
-  LOG_WEB_REQUEST("GET", "/img/favicon.png");
-  
-  File file = LittleFS.open("/img/favicon.png", "r");
-  if (!file) {
-    LOG_E(LOG_WEB, "Fichier /img/favicon.png non trouve");
-    server.send(404, "text/plain", "Favicon not found");
-    return;
-  }
-  
-  LOG_V(LOG_WEB, "Envoi de /img/favicon.png (%d bytes)", file.size());
-  server.streamFile(file, "image/png");
-  file.close();
-}
-
+#include "task_bus.h"
+#include "timer_processor.h"
+#include "relay_service.h"
+#include "energy_meter.h"
+#include "heat_pump_control.h"
+#include "mqtt_buffer.h"
+#include "web_static.h"
+#include "web_stream.h"
 
 // ============================================================================
 // API BASIQUE - TEMPS ET CAPTEURS
@@ -336,7 +40,7 @@ void handleApiTime() {
   LOG_WEB_REQUEST("GET", "/api/time");
   
   struct tm timeinfo;
-  if (getLocalTime(&timeinfo)) {
+  if (getCachedTime(&timeinfo)) {
     char buf[64];
     strftime(buf, sizeof(buf), "%d/%m/%Y %H:%M:%S", &timeinfo);
     LOG_V(LOG_WEB, "Heure envoyee: %s", buf);
@@ -366,7 +70,7 @@ void handleApiRelays() {
   DynamicJsonDocument doc(256);
   JsonArray arr = doc.to<JsonArray>();
   for (int i = 0; i < NUM_RELAYS; i++) {
-    bool state = (digitalRead(relayPins[i]) == HIGH);
+    bool state = isRelayOn(i);
     arr.add(state);
     LOG_V(LOG_WEB, "Relais %d: %s", i, state ? "ON" : "OFF");
   }
@@ -376,6 +80,32 @@ void handleApiRelays() {
   server.send(200, "application/json", out);
 }
 
+/**
+ * GET /api/relays/status : état en cache, source et heure du dernier
+ * changement de chaque relais.
+ */
+void handleApiRelaysStatus() {
+  LOG_WEB_REQUEST("GET", "/api/relays/status");
+  
+  DynamicJsonDocument doc(1024);
+  JsonArray arr = doc.createNestedArray("relays");
+  unsigned long now = millis();
+  for (int i = 0; i < NUM_RELAYS; i++) {
+    RelayInfo info = getRelayInfo(i);
+    JsonObject obj = arr.createNestedObject();
+    obj["on"] = info.on;
+    obj["source"] = getRelaySourceName(info.source);
+    obj["since"] = (now - info.changedAt) / 1000;
+    obj["epoch"] = info.changedEpoch;
+    obj["transitions"] = info.transitions;
+  }
+  doc["refused"] = relayCommandsRefused;
+  
+  String out;
+  serializeJson(doc, out);
+  server.send(200, "application/json", out);
+}
+
 void handleApiRelay() {
   LOG_WEB_REQUEST("POST", "/api/relay");
   
@@ -396,27 +126,16 @@ void handleApiRelay() {
     return;
   }
   
-  // Protection électrolyseur - nécessite pompe active
-  if (ch == 1 && state == 1) {
-    bool pompeActive = (digitalRead(relayPins[0]) == HIGH);
-    if (!pompeActive) {
-      LOG_W(LOG_WEB, "PROTECTION: Tentative d'activation electrolyseur sans pompe");
-      server.send(400, "text/plain", "Erreur: Pompe doit être active");
-      return;
-    }
+  // Règles de sécurité appliquées par le service relais (graphique et MQTT aussi)
+  RelayRuleResult refusal;
+  if (!setRelay(ch, state, RELAY_SOURCE_WEB, &refusal)) {
+    char reason[64];
+    formatRelayRefusal(refusal, reason, sizeof(reason));
+    LOG_W(LOG_WEB, "Commande relais %d refusee: %s", ch, reason);
+    server.send(409, "text/plain", String("Erreur: ") + reason);
+    return;
   }
-  
-  digitalWrite(relayPins[ch], state ? HIGH : LOW);
   LOG_I(LOG_WEB, "Relais %d -> %s", ch, state ? "ON" : "OFF");
-
-  //Capturer le changement d'état sur le graphique
-  captureCurrentStateToChart();
-
-  if (mqttClient.connected()) {
-    String topic = mqttTopic + "/relay/" + String(ch) + "/state";
-    mqttClient.publish(topic.c_str(), state ? "1" : "0");
-    LOG_MQTT_PUB(topic.c_str(), state ? "1" : "0");
-  }
   
   server.send(200, "text/plain", "OK");
 }
@@ -567,83 +286,112 @@ void handleApiResetCalibration() {
 // API TIMERS FLEXIBLES
 // ============================================================================
 
-void handleApiFlexTimers() {
-  LOG_WEB_REQUEST("GET", "/api/timers/flex");
-  
-  DynamicJsonDocument doc(32768);
-  JsonArray arr = doc.to<JsonArray>();
-  
-  LOG_D(LOG_WEB, "Generation JSON pour %d timers", flexTimerCount);
-  
-  for (int i = 0; i < flexTimerCount; i++) {
-    JsonObject obj = arr.createNestedObject();
-    FlexibleTimer* t = &flexTimers[i];
-    
-    obj["id"] = t->id;
-    obj["name"] = t->name;
-    obj["enabled"] = t->enabled;
-    
-    JsonArray days = obj.createNestedArray("days");
-    for (int d = 0; d < 7; d++) days.add(t->days[d]);
-    
-    JsonObject startObj = obj.createNestedObject("startTime");
-    startObj["type"] = (int)t->startTime.type;
-    startObj["hour"] = t->startTime.hour;
-    startObj["minute"] = t->startTime.minute;
-    startObj["sunriseOffset"] = t->startTime.sunriseOffset;
-    
-    obj["conditionCount"] = t->conditionCount;
-    obj["actionCount"] = t->actionCount;
-    
-    JsonObject ctx = obj.createNestedObject("context");
-    ctx["state"] = (int)t->context.state;
-    ctx["currentAction"] = t->context.currentActionIndex;
-    ctx["totalElapsedMinutes"] = t->context.totalElapsedMinutes;
-    if (t->context.lastError.length() > 0) {
-      ctx["lastError"] = t->context.lastError;
-    }
+/**
+ * Identifiant du timer dans l'URI (/api/timers/flex/{id}[/toggle]).
+ *
+ * @return 0 si absent ou invalide
+ */
+int getFlexTimerIdFromUri() {
+  String uri = server.uri();
+  int flexPos = uri.indexOf("flex/");
+  if (flexPos == -1) return 0;
 
-    JsonArray actArr = obj.createNestedArray("actions");
-    for (int a = 0; a < t->actionCount; a++) {
-      JsonObject act = actArr.createNestedObject();
-      act["type"] = (int)t->actions[a].type;
-      act["relay"] = t->actions[a].relay;
-      act["state"] = t->actions[a].state;
-      act["delayMinutes"] = t->actions[a].delayMinutes;
-      act["conditionValue"] = t->actions[a].conditionValue;
-      act["maxWaitMinutes"] = t->actions[a].maxWaitMinutes;
-      act["description"] = t->actions[a].description;
-      act["buzzerCount"] = t->actions[a].buzzerCount;
-      act["ledColor"] = t->actions[a].ledColor;
-      act["ledMode"] = t->actions[a].ledMode;
-      act["ledDuration"] = t->actions[a].ledDuration;
-      
-      if (t->actions[a].type == ACTION_AUTO_DURATION) {
-        JsonObject eq = act.createNestedObject("customEquation");
-        eq["useCustom"] = t->actions[a].customEquation.useCustom;
-        eq["expression"] = t->actions[a].customEquation.expression;
-      }
-    }
-    
-    LOG_V(LOG_WEB, "Timer %d: '%s' (enabled=%d, actions=%d, state=%d)",
-          i, t->name.c_str(), t->enabled, t->actionCount, (int)t->context.state);
+  int idStart = flexPos + 5;
+  int idEnd = uri.indexOf('/', idStart);
+  return (idEnd == -1 ? uri.substring(idStart) : uri.substring(idStart, idEnd)).toInt();
+}
+
+/**
+ * Timer de l'URI, ou réponse d'erreur déjà envoyée (400/404).
+ */
+FlexibleTimer* getFlexTimerFromRequest() {
+  int id = getFlexTimerIdFromUri();
+  if (id == 0) {
+    LOG_E(LOG_WEB, "ID timer invalide: %s", server.uri().c_str());
+    server.send(400, "text/plain", "Invalid ID");
+    return nullptr;
   }
-  
-  String output;
-  size_t jsonSize = serializeJson(doc, output);
-  LOG_I(LOG_WEB, "JSON timers genere: %d timers, %d bytes", flexTimerCount, jsonSize);
-  
-  server.send(200, "application/json", output);
+
+  FlexibleTimer* timer = findFlexTimer(id);
+  if (!timer) {
+    LOG_W(LOG_WEB, "Timer ID %d non trouve", id);
+    server.send(404, "text/plain", "Timer not found");
+  }
+  return timer;
 }
 
-void handleApiAddFlexTimer() {
-  LOG_WEB_REQUEST("POST", "/api/timers/flex");
-  
+/**
+ * Lit le corps JSON d'une requête timer (réponse 400 envoyée en cas d'erreur) :
+ * l'en-tête dans head, les actions seulement validées (appliquées ensuite
+ * par timerActionsFromJson, une à la fois).
+ *
+ * @param actionCount -1 si le corps n'a pas de champ "actions"
+ */
+bool parseFlexTimerBody(String& body, JsonDocument& head, int* actionCount) {
   if (!server.hasArg("plain")) {
     LOG_E(LOG_WEB, "Corps de requete manquant");
     server.send(400, "text/plain", "Missing body");
-    return;
+    return false;
+  }
+
+  body = server.arg("plain");
+  TimerJsonStream in(body);
+  DeserializationError err = readTimerHead(in, head);
+  if (err) {
+    LOG_E(LOG_WEB, "Erreur parsing JSON timer: %s", err.c_str());
+    server.send(400, "text/plain", "Invalid JSON");
+    return false;
+  }
+
+  in.rewind();
+  if (!readTimerActions(in, NULL, actionCount)) {
+    LOG_E(LOG_WEB, "Erreur parsing JSON timer: actions invalides");
+    server.send(400, "text/plain", "Invalid JSON");
+    return false;
+  }
+  return true;
+}
+
+/**
+ * GET /api/timers/flex
+ * Liste envoyée timer par timer : mémoire constante quel que soit le nombre
+ * de timers et d'actions.
+ */
+void handleApiFlexTimers() {
+  LOG_WEB_REQUEST("GET", "/api/timers/flex");
+
+  ChunkedResponse response;
+  response.begin(200, "application/json");
+  response.print("[");
+
+  for (int i = 0; i < flexTimerCount; i++) {
+    if (i > 0) response.print(",");
+    writeTimerJson(response, flexTimers[i], true);
   }
+
+  response.print("]");
+  response.end();
+
+  LOG_I(LOG_WEB, "JSON timers envoye: %d timers, %d bytes", flexTimerCount, response.bytesSent());
+}
+
+/**
+ * GET /api/timers/flex/{id}
+ */
+void handleApiGetFlexTimer() {
+  LOG_WEB_REQUEST("GET", "/api/timers/flex/[id]");
+
+  FlexibleTimer* timer = getFlexTimerFromRequest();
+  if (!timer) return;
+
+  ChunkedResponse response;
+  response.begin(200, "application/json");
+  writeTimerJson(response, *timer, true);
+  response.end();
+}
+
+void handleApiAddFlexTimer() {
+  LOG_WEB_REQUEST("POST", "/api/timers/flex");
   
   if (flexTimerCount >= MAX_TIMERS) {
     LOG_E(LOG_WEB, "Limite de timers atteinte: %d/%d", flexTimerCount, MAX_TIMERS);
@@ -651,242 +399,102 @@ void handleApiAddFlexTimer() {
     return;
   }
   
-  DynamicJsonDocument doc(8192);
-  DeserializationError err = deserializeJson(doc, server.arg("plain"));
-  
-  if (err) {
-    LOG_E(LOG_WEB, "Erreur parsing JSON timer: %s", err.c_str());
-    server.send(400, "text/plain", "Invalid JSON");
-    return;
-  }
+  String body;
+  int actionCount;
+  DynamicJsonDocument head(TIMER_HEAD_DOC_SIZE);
+  if (!parseFlexTimerBody(body, head, &actionCount)) return;
   
   FlexibleTimer* t = &flexTimers[flexTimerCount];
-  JsonObject obj = doc.as<JsonObject>();
+  JsonObject obj = head.as<JsonObject>();
   
+  *t = FlexibleTimer();
   t->id = obj["id"] | (int)(millis() & 0x7FFFFFFF);
-  t->name = obj["name"].as<String>();
-  t->enabled = obj["enabled"] | true;
-  
-  LOG_D(LOG_WEB, "Ajout timer: ID=%d, Nom='%s', Enabled=%d", t->id, t->name.c_str(), t->enabled);
-  
-  JsonArray days = obj["days"];
-  for (int i = 0; i < 7; i++) t->days[i] = days[i];
-  
-  JsonObject startObj = obj["startTime"];
-  t->startTime.type = (StartTimeType)(int)startObj["type"];
-  t->startTime.hour = startObj["hour"];
-  t->startTime.minute = startObj["minute"];
-  t->startTime.sunriseOffset = startObj["sunriseOffset"] | 0;
-  
-  JsonArray condArr = obj["conditions"];
-  t->conditionCount = condArr.size();
-  LOG_V(LOG_WEB, "Conditions: %d", t->conditionCount);
-  
-  for (int i = 0; i < t->conditionCount && i < 10; i++) {
-    JsonObject c = condArr[i];
-    t->conditions[i].type = (ConditionType)(int)c["type"];
-    t->conditions[i].value = c["value"];
-    t->conditions[i].required = c["required"] | true;
-  }
-  
-  JsonArray actArr = obj["actions"];
-  t->actionCount = actArr.size();
-  LOG_V(LOG_WEB, "Actions: %d", t->actionCount);
-  
-  for (int i = 0; i < t->actionCount && i < 50; i++) {
-    JsonObject a = actArr[i];
-    t->actions[i].type = (ActionType)(int)a["type"];
-    t->actions[i].relay = a["relay"];
-    t->actions[i].state = a["state"];
-    t->actions[i].delayMinutes = a["delayMinutes"];
-    t->actions[i].conditionValue = a["conditionValue"] | 0.0;
-    t->actions[i].maxWaitMinutes = a["maxWaitMinutes"] | 0;
-    t->actions[i].description = a["description"].as<String>();
-    t->actions[i].buzzerCount = a["buzzerCount"] | 1;
-    t->actions[i].ledColor = a["ledColor"] | 0;
-    t->actions[i].ledMode = a["ledMode"] | 0;
-    t->actions[i].ledDuration = a["ledDuration"] | 0;
-    
-    if (a.containsKey("customEquation")) {
-      JsonObject eq = a["customEquation"];
-      t->actions[i].customEquation.useCustom = eq["useCustom"] | false;
-      t->actions[i].customEquation.expression = eq["expression"].as<String>();
-    }
-  }
+  timerFromJson(*t, obj);
+  TimerJsonStream in(body);
+  timerActionsFromJson(*t, in);
   
-  t->context.state = TIMER_IDLE;
-  t->context.currentActionIndex = 0;
-  t->lastTriggeredDay = -1;
+  LOG_D(LOG_WEB, "Ajout timer: ID=%d, Nom='%s', Enabled=%d, Conditions: %d, Actions: %d",
+        t->id, t->name.c_str(), t->enabled, t->conditionCount, t->actionCount);
   
   flexTimerCount++;
   LOG_I(LOG_WEB, "Timer ajoute avec succes: '%s' (total: %d/%d)",
         t->name.c_str(), flexTimerCount, MAX_TIMERS);
   
-  saveFlexTimers();
+  saveFlexTimer(*t);
+  saveFlexTimerIndex();
   
   server.send(200, "text/plain", "OK");
 }
 
+/**
+ * PUT /api/timers/flex/{id} : remplace le timer complet.
+ */
 void handleApiUpdateFlexTimer() {
   LOG_WEB_REQUEST("PUT", "/api/timers/flex/[id]");
   
-  String uri = server.uri();
-  int flexPos = uri.indexOf("flex/");
-  if (flexPos == -1) {
-    LOG_E(LOG_WEB, "URI invalide: %s", uri.c_str());
-    server.send(400, "text/plain", "Invalid URI");
-    return;
-  }
+  FlexibleTimer* timer = getFlexTimerFromRequest();
+  if (!timer) return;
   
-  int idStart = flexPos + 5;
-  String idStr = uri.substring(idStart);
-  int id = idStr.toInt();
+  String body;
+  int actionCount;
+  DynamicJsonDocument head(TIMER_HEAD_DOC_SIZE);
+  if (!parseFlexTimerBody(body, head, &actionCount)) return;
   
-  LOG_D(LOG_WEB, "Mise a jour timer ID: %d", id);
+  // Arrêter le timer s'il était en cours (avec ses anciennes actions)
+  stopFlexTimer(timer);
+  timerFromJson(*timer, head.as<JsonObject>());
+  TimerJsonStream in(body);
+  timerActionsFromJson(*timer, in);
   
-  if (id == 0) {
-    LOG_E(LOG_WEB, "ID timer invalide: %d", id);
-    server.send(400, "text/plain", "Invalid ID");
-    return;
-  }
+  LOG_I(LOG_WEB, "Timer ID %d mis a jour avec succes: '%s', enabled=%d",
+        timer->id, timer->name.c_str(), timer->enabled);
   
-  FlexibleTimer* timer = nullptr;
-  for (int i = 0; i < flexTimerCount; i++) {
-    if (flexTimers[i].id == id) {
-      timer = &flexTimers[i];
-      break;
-    }
-  }
-  
-  if (!timer) {
-    LOG_W(LOG_WEB, "Timer ID %d non trouve", id);
-    server.send(404, "text/plain", "Timer not found");
-    return;
-  }
-  
-  if (!server.hasArg("plain")) {
-    LOG_E(LOG_WEB, "Corps de requete manquant");
-    server.send(400, "text/plain", "Missing body");
-    return;
-  }
-  
-  DynamicJsonDocument doc(8192);
-  DeserializationError err = deserializeJson(doc, server.arg("plain"));
+  saveFlexTimer(*timer);
+  server.send(200, "text/plain", "OK");
+}
+
+/**
+ * PATCH /api/timers/flex/{id} : applique uniquement les champs présents.
+ * Le timer n'est arrêté que si sa programmation change (jours, heure,
+ * conditions, actions) ou s'il est désactivé.
+ */
+void handleApiPatchFlexTimer() {
+  LOG_WEB_REQUEST("PATCH", "/api/timers/flex/[id]");
   
-  if (err) {
-    LOG_E(LOG_WEB, "Erreur parsing JSON: %s", err.c_str());
-    server.send(400, "text/plain", "Invalid JSON");
-    return;
-  }
+  FlexibleTimer* timer = getFlexTimerFromRequest();
+  if (!timer) return;
   
-  JsonObject obj = doc.as<JsonObject>();
-  timer->name = obj["name"].as<String>();
-  timer->enabled = obj["enabled"] | true;
-  
-  LOG_I(LOG_WEB, "Mise a jour timer ID %d: '%s', enabled=%d", id, timer->name.c_str(), timer->enabled);
-  
-  JsonArray days = obj["days"];
-  for (int i = 0; i < 7; i++) timer->days[i] = days[i];
-  
-  JsonObject startObj = obj["startTime"];
-  timer->startTime.type = (StartTimeType)(int)startObj["type"];
-  timer->startTime.hour = startObj["hour"];
-  timer->startTime.minute = startObj["minute"];
-  timer->startTime.sunriseOffset = startObj["sunriseOffset"] | 0;
-  
-  JsonArray condArr = obj["conditions"];
-  timer->conditionCount = condArr.size();
-  for (int i = 0; i < timer->conditionCount && i < 10; i++) {
-    JsonObject c = condArr[i];
-    timer->conditions[i].type = (ConditionType)(int)c["type"];
-    timer->conditions[i].value = c["value"];
-    timer->conditions[i].required = c["required"] | true;
-  }
-  
-  JsonArray actArr = obj["actions"];
-  timer->actionCount = actArr.size();
-  for (int i = 0; i < timer->actionCount && i < 50; i++) {
-    JsonObject a = actArr[i];
-    timer->actions[i].type = (ActionType)(int)a["type"];
-    timer->actions[i].relay = a["relay"];
-    timer->actions[i].state = a["state"];
-    timer->actions[i].delayMinutes = a["delayMinutes"];
-    timer->actions[i].conditionValue = a["conditionValue"] | 0.0;
-    timer->actions[i].maxWaitMinutes = a["maxWaitMinutes"] | 0;
-    timer->actions[i].description = a["description"].as<String>();
-    timer->actions[i].buzzerCount = a["buzzerCount"] | 1;
-    timer->actions[i].ledColor = a["ledColor"] | 0;
-    timer->actions[i].ledMode = a["ledMode"] | 0;
-    timer->actions[i].ledDuration = a["ledDuration"] | 0;
-    
-    if (a.containsKey("customEquation")) {
-      JsonObject eq = a["customEquation"];
-      timer->actions[i].customEquation.useCustom = eq["useCustom"] | false;
-      timer->actions[i].customEquation.expression = eq["expression"].as<String>();
-    }
-  }
+  String body;
+  int actionCount;
+  DynamicJsonDocument head(TIMER_HEAD_DOC_SIZE);
+  if (!parseFlexTimerBody(body, head, &actionCount)) return;
   
-  // Arrêter le timer s'il était en cours
-  if (timer->context.state == TIMER_RUNNING) {
-    LOG_W(LOG_WEB, "Timer ID %d en cours d'execution - Arret des relais", id);
-    for (int a = 0; a < timer->actionCount; a++) {
-      if (timer->actions[a].type == ACTION_RELAY && timer->actions[a].state) {
-        digitalWrite(relayPins[timer->actions[a].relay], LOW);
-        LOG_V(LOG_WEB, "Relais %d eteint", timer->actions[a].relay);
-      }
-    }
-  }
+  JsonObject obj = head.as<JsonObject>();
+  bool reschedule = obj.containsKey("days") || obj.containsKey("startTime") ||
+                    obj.containsKey("recurrence") || obj.containsKey("conditions") || actionCount >= 0;
+  bool disable = obj.containsKey("enabled") && !(obj["enabled"] | true);
   
-  timer->context.state = TIMER_IDLE;
-  timer->context.currentActionIndex = 0;
-  timer->context.tempMeasured = false;
-  timer->context.lastError = "";
-  timer->lastTriggeredDay = -1;
+  if (reschedule || disable) stopFlexTimer(timer);
+  timerFromJson(*timer, obj, true);
+  TimerJsonStream in(body);
+  timerActionsFromJson(*timer, in, true);
   
-  LOG_I(LOG_WEB, "Timer ID %d mis a jour avec succes", id);
+  LOG_I(LOG_WEB, "Timer ID %d modifie: '%s', enabled=%d%s",
+        timer->id, timer->name.c_str(), timer->enabled, reschedule ? " (reprogramme)" : "");
   
-  saveFlexTimers();
+  saveFlexTimer(*timer);
   server.send(200, "text/plain", "OK");
 }
 
 void handleApiDeleteFlexTimer() {
   LOG_WEB_REQUEST("DELETE", "/api/timers/flex/[id]");
   
-  String uri = server.uri();
-  int flexPos = uri.indexOf("flex/");
-  if (flexPos == -1) {
-    LOG_E(LOG_WEB, "URI invalide: %s", uri.c_str());
-    server.send(400, "text/plain", "Invalid URI");
-    return;
-  }
-  
-  int idStart = flexPos + 5;
-  String idStr = uri.substring(idStart);
-  int id = idStr.toInt();
-  
-  LOG_D(LOG_WEB, "Suppression timer ID: %d", id);
-  
-  if (id == 0) {
-    LOG_E(LOG_WEB, "ID timer invalide: %d", id);
-    server.send(400, "text/plain", "Invalid ID");
-    return;
-  }
-  
-  int index = -1;
-  for (int i = 0; i < flexTimerCount; i++) {
-    if (flexTimers[i].id == id) {
-      index = i;
-      break;
-    }
-  }
+  FlexibleTimer* timer = getFlexTimerFromRequest();
+  if (!timer) return;
   
-  if (index == -1) {
-    LOG_W(LOG_WEB, "Timer ID %d non trouve", id);
-    server.send(404, "text/plain", "Timer not found");
-    return;
-  }
-  
-  String timerName = flexTimers[index].name;
+  int id = timer->id;
+  int index = timer - flexTimers;
+  String timerName = timer->name;
   
   // Décalage des timers
   for (int i = index; i < flexTimerCount - 1; i++) {
@@ -897,54 +505,16 @@ void handleApiDeleteFlexTimer() {
   LOG_I(LOG_WEB, "Timer '%s' (ID %d) supprime (total: %d/%d)",
         timerName.c_str(), id, flexTimerCount, MAX_TIMERS);
   
-  saveFlexTimers();
+  removeFlexTimerFile(id);
+  saveFlexTimerIndex();
   server.send(200, "text/plain", "OK");
 }
 
 void handleApiToggleFlexTimer() {
   LOG_WEB_REQUEST("POST", "/api/timers/flex/[id]/toggle");
   
-  String uri = server.uri();
-  int flexPos = uri.indexOf("flex/");
-  if (flexPos == -1) {
-    LOG_E(LOG_WEB, "URI invalide: %s", uri.c_str());
-    server.send(400, "text/plain", "Invalid URI");
-    return;
-  }
-  
-  int idStart = flexPos + 5;
-  int idEnd = uri.indexOf('/', idStart);
-  
-  if (idEnd == -1) {
-    LOG_E(LOG_WEB, "URI invalide (pas de slash apres ID): %s", uri.c_str());
-    server.send(400, "text/plain", "Invalid URI");
-    return;
-  }
-  
-  String idStr = uri.substring(idStart, idEnd);
-  int id = idStr.toInt();
-  
-  LOG_D(LOG_WEB, "Toggle timer ID: %d", id);
-  
-  if (id == 0) {
-    LOG_E(LOG_WEB, "ID timer invalide: %d", id);
-    server.send(400, "text/plain", "Invalid ID");
-    return;
-  }
-  
-  FlexibleTimer* timer = nullptr;
-  for (int i = 0; i < flexTimerCount; i++) {
-    if (flexTimers[i].id == id) {
-      timer = &flexTimers[i];
-      break;
-    }
-  }
-  
-  if (!timer) {
-    LOG_W(LOG_WEB, "Timer ID %d non trouve", id);
-    server.send(404, "text/plain", "Timer not found");
-    return;
-  }
+  FlexibleTimer* timer = getFlexTimerFromRequest();
+  if (!timer) return;
   
   if (!server.hasArg("plain")) {
     LOG_E(LOG_WEB, "Corps de requete manquant");
@@ -964,23 +534,15 @@ void handleApiToggleFlexTimer() {
   bool newEnabled = doc["enabled"];
   
   LOG_I(LOG_WEB, "Toggle timer '%s' (ID %d): %s -> %s",
-        timer->name.c_str(), id, timer->enabled ? "ON" : "OFF", newEnabled ? "ON" : "OFF");
+        timer->name.c_str(), timer->id, timer->enabled ? "ON" : "OFF", newEnabled ? "ON" : "OFF");
   
   // Si on désactive un timer en cours, arrêter les relais
   if (!newEnabled && timer->context.state == TIMER_RUNNING) {
-    LOG_W(LOG_WEB, "Timer ID %d desactive - Arret des relais actifs", id);
-    for (int a = 0; a < timer->actionCount; a++) {
-      if (timer->actions[a].type == ACTION_RELAY && timer->actions[a].state) {
-        digitalWrite(relayPins[timer->actions[a].relay], LOW);
-        LOG_V(LOG_WEB, "Relais %d eteint", timer->actions[a].relay);
-      }
-    }
-    timer->context.state = TIMER_IDLE;
-    timer->context.currentActionIndex = 0;
+    stopFlexTimer(timer);
   }
   
   timer->enabled = newEnabled;
-  saveFlexTimers();
+  saveFlexTimer(*timer);
   server.send(200, "text/plain", "OK");
 }
 
@@ -997,6 +559,10 @@ void handleApiMQTTConfig() {
   doc["user"] = mqttUser;
   doc["password"] = "";  // Ne pas renvoyer le mot de passe
   doc["topic"] = mqttTopic;
+  doc["tempDeadband"] = mqttPublishConfig.tempDeadband;
+  doc["pressureDeadband"] = mqttPublishConfig.pressureDeadband;
+  doc["heartbeat"] = mqttPublishConfig.heartbeatSec;
+  doc["stateJson"] = mqttPublishConfig.stateJson;
   
   LOG_V(LOG_WEB, "Config MQTT envoyee: server=%s, port=%d, user=%s, topic=%s",
         mqttServer.c_str(), mqttPort, mqttUser.c_str(), mqttTopic.c_str());
@@ -1022,20 +588,34 @@ void handleApiSaveMQTT() {
     return;
   }
   
+  // Topic refusé plutôt que tronqué
+  String topic = doc["topic"].as<String>();
+  if (!isValidMqttBaseTopic(topic)) {
+    LOG_E(LOG_WEB, "Topic MQTT trop long: %d caracteres (max %d)", topic.length(), MQTT_BASE_TOPIC_LEN - 1);
+    server.send(400, "text/plain", "Topic too long");
+    return;
+  }
+  
   mqttServer = doc["server"].as<String>();
   mqttPort = doc["port"] | 1883;
   mqttUser = doc["user"].as<String>();
   mqttPassword = doc["password"].as<String>();
-  mqttTopic = doc["topic"].as<String>();
+  mqttTopic = topic;
+  
+  // Options de publication : valeurs actuelles si absentes
+  mqttPublishConfig.tempDeadband = doc["tempDeadband"] | mqttPublishConfig.tempDeadband;
+  mqttPublishConfig.pressureDeadband = doc["pressureDeadband"] | mqttPublishConfig.pressureDeadband;
+  mqttPublishConfig.heartbeatSec = constrain(doc["heartbeat"] | (int)mqttPublishConfig.heartbeatSec, 10, 3600);
+  mqttPublishConfig.stateJson = doc["stateJson"] | mqttPublishConfig.stateJson;
   
   LOG_I(LOG_WEB, "Config MQTT sauvegardee: server=%s:%d, user=%s, topic=%s",
         mqttServer.c_str(), mqttPort, mqttUser.c_str(), mqttTopic.c_str());
   
   saveMQTTConfig();
-  mqttClient.setServer(mqttServer.c_str(), mqttPort);
-  mqttClient.setCallback(mqttCallback);
   
-  LOG_D(LOG_WEB, "Client MQTT reconfigure");
+  // Reconnexion effectuée par la tâche réseau
+  postSystemEvent(EVT_MQTT_RECONFIGURE);
+  LOG_D(LOG_WEB, "Reconfiguration du client MQTT demandee");
   
   server.send(200, "text/plain", "OK");
 }
@@ -1045,9 +625,16 @@ void handleApiMQTTStatus() {
   
   bool connected = mqttClient.connected();
   
-  DynamicJsonDocument doc(128);
+  DynamicJsonDocument doc(256);
   doc["connected"] = connected;
   
+  JsonObject buffer = doc.createNestedObject("buffer");
+  buffer["pending"] = mqttBufferCount;
+  buffer["capacity"] = mqttBufferCapacity;
+  buffer["stored"] = mqttBufferStats.stored;
+  buffer["replayed"] = mqttBufferStats.replayed;
+  buffer["overwritten"] = mqttBufferStats.overwritten;
+  
   LOG_V(LOG_WEB, "Status MQTT: %s", connected ? "CONNECTE" : "DECONNECTE");
   
   String out;
@@ -1059,9 +646,8 @@ void handleApiMQTTRediscover() {
   LOG_WEB_REQUEST("POST", "/api/mqtt/rediscover");
   
   if (mqttClient.connected()) {
-    LOG_I(LOG_WEB, "Republication Home Assistant Discovery");
-    publishHomeAssistantDiscovery();
-    publishSensorStates();
+    LOG_I(LOG_WEB, "Republication Home Assistant Discovery demandee");
+    postSystemEvent(EVT_MQTT_REDISCOVER);
     server.send(200, "text/plain", "Discovery published");
   } else {
     LOG_W(LOG_WEB, "MQTT non connecte - Impossible de publier discovery");
@@ -1081,6 +667,11 @@ void handleApiWeatherConfig() {
   doc["latitude"] = latitude;
   doc["longitude"] = longitude;
   
+  // État du client météo
+  doc["lastUpdate"] = (uint32_t)weatherLastSuccess;
+  doc["lastHttpCode"] = weatherLastHttpCode;
+  doc["failures"] = weatherFailures;
+  
   LOG_V(LOG_WEB, "Config meteo envoyee: lat=%s, lon=%s, apiKey=%s",
         latitude.c_str(), longitude.c_str(), 
         weatherApiKey.length() > 0 ? "configuree" : "non configuree");
@@ -1116,7 +707,142 @@ void handleApiWeatherSave() {
   saveWeatherConfig();
   
   LOG_I(LOG_WEB, "Declenchement mise a jour meteo");
-  updateWeatherData();
+  postSystemEvent(EVT_WEATHER_REFRESH);
+  
+  server.send(200, "text/plain", "OK");
+}
+
+// ============================================================================
+// API ÉNERGIE
+// ============================================================================
+
+/**
+ * GET /api/energy : configuration, tarif en cours et compteurs par relais
+ * (heures, kWh et coût estimés du jour, du mois et total).
+ */
+void handleApiEnergy() {
+  LOG_WEB_REQUEST("GET", "/api/energy");
+  
+  DynamicJsonDocument doc(2048);
+  writeEnergyConfigJson(doc.createNestedObject("config"));
+  
+  bool offPeak = isOffPeakNow();
+  doc["offPeakNow"] = offPeak;
+  doc["priceNow"] = getTariffPrice(offPeak);
+  
+  JsonArray arr = doc.createNestedArray("relays");
+  for (int i = 0; i < NUM_RELAYS; i++) {
+    RelayRuntimeCounters c;
+    getRelayRuntime(i, &c);
+    
+    JsonObject obj = arr.createNestedObject();
+    obj["name"] = getRelayName(i);
+    obj["daySec"] = c.daySec;
+    obj["dayKwh"] = runtimeToKwh(i, c.daySec);
+    obj["dayCost"] = runtimeToCost(i, c.daySec, c.dayOffPeakSec);
+    obj["monthSec"] = c.monthSec;
+    obj["monthKwh"] = runtimeToKwh(i, c.monthSec);
+    obj["monthCost"] = runtimeToCost(i, c.monthSec, c.monthOffPeakSec);
+    obj["totalSec"] = c.lifetimeSec;
+    obj["totalKwh"] = runtimeToKwh(i, c.lifetimeSec);
+  }
+  
+  String out;
+  serializeJson(doc, out);
+  server.send(200, "application/json", out);
+}
+
+void handleApiEnergyConfig() {
+  LOG_WEB_REQUEST("POST", "/api/energy/config");
+  
+  if (!server.hasArg("plain")) {
+    LOG_E(LOG_WEB, "Corps de requete manquant");
+    server.send(400, "text/plain", "Missing body");
+    return;
+  }
+  
+  DynamicJsonDocument doc(512);
+  if (deserializeJson(doc, server.arg("plain")) || !doc.is<JsonObject>()) {
+    LOG_E(LOG_WEB, "Erreur parsing JSON energie");
+    server.send(400, "text/plain", "Invalid JSON");
+    return;
+  }
+  
+  readEnergyConfigJson(doc.as<JsonObject>());
+  saveEnergyConfig();
+  energyHour = -1;   // Tarif de l'heure en cours réévalué par la tâche maintenance
+  
+  LOG_I(LOG_WEB, "Config energie sauvegardee: HP=%.4f, HC=%.4f, masque HC=0x%06lX",
+        energyConfig.tariff.pricePeak, energyConfig.tariff.priceOffPeak,
+        (unsigned long)tariffOffPeakMask);
+  
+  server.send(200, "text/plain", "OK");
+}
+
+// ============================================================================
+// API THERMOSTAT PAC
+// ============================================================================
+
+/**
+ * GET /api/heatpump : réglages et état de la régulation.
+ */
+void handleApiHeatPump() {
+  LOG_WEB_REQUEST("GET", "/api/heatpump");
+  
+  DynamicJsonDocument doc(1024);
+  writeHeatPumpJson(doc.createNestedObject("config"));
+  
+  ThermostatParams params = getHeatPumpParams();
+  ThermostatState hp = getHeatPumpState();
+  
+  JsonObject state = doc.createNestedObject("state");
+  state["on"] = isRelayOn(RELAY_HEAT_PUMP);
+  state["heating"] = hp.heating;
+  state["lock"] = getThermostatLockName(hp.lock);
+  if (hp.filterReady) state["waterTemp"] = hp.filteredTemp;
+  state["duty"] = hp.duty;
+  state["integral"] = hp.integral;
+  if (params.mode == THERMOSTAT_PID && hp.cycleStarted) {
+    uint32_t elapsed = millis() - hp.cycleStartMs;
+    state["cycleOn"] = hp.cycleOnMs / 1000;
+    state["cycleElapsed"] = elapsed / 1000;
+  }
+  
+  String out;
+  serializeJson(doc, out);
+  server.send(200, "application/json", out);
+}
+
+void handleApiHeatPumpConfig() {
+  LOG_WEB_REQUEST("POST", "/api/heatpump/config");
+  
+  if (!server.hasArg("plain")) {
+    LOG_E(LOG_WEB, "Corps de requete manquant");
+    server.send(400, "text/plain", "Missing body");
+    return;
+  }
+  
+  DynamicJsonDocument doc(512);
+  if (deserializeJson(doc, server.arg("plain")) || !doc.is<JsonObject>()) {
+    LOG_E(LOG_WEB, "Erreur parsing JSON thermostat PAC");
+    server.send(400, "text/plain", "Invalid JSON");
+    return;
+  }
+  
+  // Mode inconnu refusé plutôt qu'ignoré
+  const char* mode = doc["mode"].as<const char*>();
+  if (mode != NULL && parseThermostatMode(mode, (ThermostatMode)-1) == (ThermostatMode)-1) {
+    LOG_E(LOG_WEB, "Mode thermostat invalide: %s", mode);
+    server.send(400, "text/plain", "Invalid mode");
+    return;
+  }
+  
+  readHeatPumpJson(doc.as<JsonObject>());
+  saveHeatPumpConfig();
+  
+  LOG_I(LOG_WEB, "Thermostat PAC: mode %s, consigne %.1fC, kp=%.2f ki=%.2f kd=%.2f",
+        getThermostatModeName(heatPumpParams.mode), heatPumpParams.setpoint,
+        heatPumpParams.kp, heatPumpParams.ki, heatPumpParams.kd);
   
   server.send(200, "text/plain", "OK");
 }
@@ -1192,6 +918,9 @@ void handleApiRestart() {
   LOG_W(LOG_WEB, "REDEMARRAGE SYSTEME DEMANDE");
   
   server.send(200, "text/plain", "Restarting...");
+  
+  // Points graphique et compteurs en attente écrits par la tâche maintenance
+  flushPersistenceBeforeRestart();
   delay(1000);
   
   LOG_I(LOG_WEB, "Redemarrage en cours...");
@@ -1712,7 +1441,7 @@ void handleBackupSave() {
   struct tm timeinfo;
   char filename[32];
   
-  if (getLocalTime(&timeinfo)) {
+  if (getCachedTime(&timeinfo)) {
     strftime(filename, sizeof(filename), "/backup_%Y%m%d.json", &timeinfo);
     LOG_D(LOG_WEB, "Nom fichier backup: %s", filename);
   } else {
@@ -1777,23 +1506,11 @@ void handleApplyScenario() {
   
   // Créer timer depuis scénario
   LOG_I(LOG_WEB, "Creation timer depuis scenario %d", scenarioId);
-  FlexibleTimer newTimer = createTimerFromScenario((ScenarioType)scenarioId);
-  
-  // Ajouter aux timers
-  if (flexTimerCount >= MAX_TIMERS) {
-    LOG_E(LOG_WEB, "Limite timers atteinte: %d/%d", flexTimerCount, MAX_TIMERS);
+  if (addScenarioTimer(scenarioId) == nullptr) {
     server.send(400, "text/plain", "Max timers reached");
     return;
   }
   
-  flexTimers[flexTimerCount] = newTimer;
-  flexTimerCount++;
-  
-  LOG_I(LOG_WEB, "Timer cree depuis scenario: '%s' (total: %d/%d)",
-        newTimer.name.c_str(), flexTimerCount, MAX_TIMERS);
-  
-  saveFlexTimers();
-  
   server.send(200, "text/plain", "Scénario appliqué");
 }
 
@@ -1807,7 +1524,7 @@ void handleApiPumpStatus() {
   DynamicJsonDocument doc(512);
   
   // État de la pompe (relais 0)
-  bool pumpOn = (digitalRead(relayPins[0]) == HIGH);
+  bool pumpOn = isRelayOn(RELAY_PUMP);
   doc["pumpOn"] = pumpOn;
   
   // Initialiser les valeurs par défaut
@@ -0,0 +1,264 @@
+/*
+ * POOL CONNECT - WEB METRICS
+ * Mesures par route HTTP : nombre, latence, octets, mémoire, erreurs
+ * web_metrics.h   V0.1
+ *
+ * Chaque route de web_routes.h est exécutée entre beginRouteSample() et
+ * endRouteSample() :
+ * - latence rangée dans un histogramme à seuils fixes (p50/p95/p99 estimés)
+ * - octets du corps de la réponse et code HTTP (PoolWebServer)
+ * - baisse maximale de la mémoire libre pendant le handler (approximative :
+ *   les autres tâches allouent aussi)
+ * Coût par requête : deux micros() et quatre lectures du tas, sans
+ * allocation. Tout est mis à jour par la tâche web uniquement.
+ *
+ * GET /api/metrics              format texte Prometheus (avec les jauges
+ *                               de system_metrics.h)
+ * GET /api/metrics?format=json  JSON (percentiles calculés)
+ */
+
+#ifndef WEB_METRICS_H
+#define WEB_METRICS_H
+
+#include <Arduino.h>
+#include <WebServer.h>
+#include "globals.h"
+#include "logging.h"
+#include "web_stream.h"
+#include "system_metrics.h"
+
+// ============================================================================
+// CONSTANTES
+// ============================================================================
+
+#define WEB_METRICS_MAX_ROUTES 72
+#define WEB_LATENCY_BUCKET_COUNT 11      // 10 seuils + infini
+
+// Seuils de l'histogramme (ms)
+const uint16_t WEB_LATENCY_BUCKETS_MS[WEB_LATENCY_BUCKET_COUNT - 1] = {
+  1, 5, 10, 25, 50, 100, 250, 500, 1000, 2500
+};
+
+// ============================================================================
+// STRUCTURES
+// ============================================================================
+
+struct RouteMetrics {
+  const char* path;
+  HTTPMethod method;
+  uint32_t count;
+  uint32_t errors;                     // Réponses 4xx/5xx
+  uint64_t bytesSent;
+  uint64_t latencySumUs;
+  uint32_t latencyMaxUs;
+  uint32_t peakHeapDelta;              // Octets
+  uint32_t buckets[WEB_LATENCY_BUCKET_COUNT];
+};
+
+struct RouteSample {
+  unsigned long startUs;
+  uint32_t freeHeap;
+  uint32_t minFreeHeap;
+};
+
+// ============================================================================
+// VARIABLES GLOBALES
+// ============================================================================
+
+RouteMetrics routeMetrics[WEB_METRICS_MAX_ROUTES];
+int routeMetricsCount = 0;
+
+// ============================================================================
+// ENREGISTREMENT
+// ============================================================================
+
+/**
+ * Réserve une entrée pour une route (appelé à l'enregistrement des routes).
+ *
+ * @return index de l'entrée, -1 si la table est pleine
+ */
+int addRouteMetrics(const char* path, HTTPMethod method) {
+  if (routeMetricsCount >= WEB_METRICS_MAX_ROUTES) {
+    LOG_W(LOG_WEB, "Table des metriques pleine - %s non mesuree", path);
+    return -1;
+  }
+
+  RouteMetrics& m = routeMetrics[routeMetricsCount];
+  memset(&m, 0, sizeof(RouteMetrics));
+  m.path = path;
+  m.method = method;
+  return routeMetricsCount++;
+}
+
+RouteSample beginRouteSample() {
+  RouteSample sample;
+  server.resetResponseStats();
+  sample.freeHeap = ESP.getFreeHeap();
+  sample.minFreeHeap = ESP.getMinFreeHeap();
+  sample.startUs = micros();
+  return sample;
+}
+
+void endRouteSample(int slot, const RouteSample& sample) {
+  uint32_t elapsedUs = micros() - sample.startUs;
+  if (slot < 0 || slot >= routeMetricsCount) return;
+
+  RouteMetrics& m = routeMetrics[slot];
+  m.count++;
+  m.latencySumUs += elapsedUs;
+  if (elapsedUs > m.latencyMaxUs) m.latencyMaxUs = elapsedUs;
+
+  int bucket = 0;
+  while (bucket < WEB_LATENCY_BUCKET_COUNT - 1 && elapsedUs > WEB_LATENCY_BUCKETS_MS[bucket] * 1000UL) {
+    bucket++;
+  }
+  m.buckets[bucket]++;
+
+  m.bytesSent += server.lastResponseBytes();
+  if (server.lastResponseCode() >= 400) m.errors++;
+
+  // Nouveau minimum atteint pendant le handler : pic exact, sinon écart fin - début
+  uint32_t minFreeHeap = ESP.getMinFreeHeap();
+  uint32_t freeHeap = ESP.getFreeHeap();
+  uint32_t delta = 0;
+  if (minFreeHeap < sample.minFreeHeap) delta = sample.freeHeap - minFreeHeap;
+  else if (freeHeap < sample.freeHeap) delta = sample.freeHeap - freeHeap;
+  if (delta > m.peakHeapDelta) m.peakHeapDelta = delta;
+}
+
+/**
+ * Exécute un handler en le mesurant.
+ */
+void runMeteredRoute(int slot, void (*handler)()) {
+  RouteSample sample = beginRouteSample();
+  handler();
+  endRouteSample(slot, sample);
+}
+
+// ============================================================================
+// PERCENTILES
+// ============================================================================
+
+/**
+ * Percentile estimé depuis l'histogramme (interpolation dans le seuil).
+ *
+ * @param p 0-100
+ * @return latence en ms
+ */
+float getRouteLatencyPercentile(const RouteMetrics& m, float p) {
+  if (m.count == 0) return 0;
+
+  float target = m.count * p / 100.0f;
+  uint32_t cumulative = 0;
+
+  for (int b = 0; b < WEB_LATENCY_BUCKET_COUNT; b++) {
+    if (m.buckets[b] == 0) continue;
+    if (cumulative + m.buckets[b] >= target) {
+      float lower = b == 0 ? 0 : WEB_LATENCY_BUCKETS_MS[b - 1];
+      float upper = b < WEB_LATENCY_BUCKET_COUNT - 1 ? WEB_LATENCY_BUCKETS_MS[b] : m.latencyMaxUs / 1000.0f;
+      float fraction = (target - cumulative) / m.buckets[b];
+      float value = lower + (upper - lower) * fraction;
+      float maxMs = m.latencyMaxUs / 1000.0f;
+      return value < maxMs ? value : maxMs;
+    }
+    cumulative += m.buckets[b];
+  }
+  return m.latencyMaxUs / 1000.0f;
+}
+
+const char* getHttpMethodName(HTTPMethod method) {
+  switch (method) {
+    case HTTP_GET:    return "GET";
+    case HTTP_POST:   return "POST";
+    case HTTP_PUT:    return "PUT";
+    case HTTP_PATCH:  return "PATCH";
+    case HTTP_DELETE: return "DELETE";
+    default:          return "ANY";
+  }
+}
+
+// ============================================================================
+// EXPORT
+// ============================================================================
+
+void writeMetricsPrometheus(ChunkedResponse& response) {
+  response.print("# HELP poolconnect_http_requests_total Requetes HTTP par route\n"
+                 "# TYPE poolconnect_http_requests_total counter\n"
+                 "# HELP poolconnect_http_errors_total Reponses 4xx/5xx par route\n"
+                 "# TYPE poolconnect_http_errors_total counter\n"
+                 "# HELP poolconnect_http_response_bytes_total Octets de corps envoyes\n"
+                 "# TYPE poolconnect_http_response_bytes_total counter\n"
+                 "# HELP poolconnect_http_peak_heap_delta_bytes Baisse max du tas pendant le handler\n"
+                 "# TYPE poolconnect_http_peak_heap_delta_bytes gauge\n"
+                 "# HELP poolconnect_http_request_duration_seconds Duree de traitement\n"
+                 "# TYPE poolconnect_http_request_duration_seconds histogram\n");
+
+  for (int i = 0; i < routeMetricsCount; i++) {
+    const RouteMetrics& m = routeMetrics[i];
+    if (m.count == 0) continue;
+
+    char labels[96];
+    snprintf(labels, sizeof(labels), "route=\"%s\",method=\"%s\"", m.path, getHttpMethodName(m.method));
+
+    response.printf("poolconnect_http_requests_total{%s} %lu\n", labels, (unsigned long)m.count);
+    response.printf("poolconnect_http_errors_total{%s} %lu\n", labels, (unsigned long)m.errors);
+    response.printf("poolconnect_http_response_bytes_total{%s} %llu\n", labels, (unsigned long long)m.bytesSent);
+    response.printf("poolconnect_http_peak_heap_delta_bytes{%s} %lu\n", labels, (unsigned long)m.peakHeapDelta);
+
+    uint32_t cumulative = 0;
+    for (int b = 0; b < WEB_LATENCY_BUCKET_COUNT - 1; b++) {
+      cumulative += m.buckets[b];
+      response.printf("poolconnect_http_request_duration_seconds_bucket{%s,le=\"%.3f\"} %lu\n",
+                      labels, WEB_LATENCY_BUCKETS_MS[b] / 1000.0f, (unsigned long)cumulative);
+    }
+    response.printf("poolconnect_http_request_duration_seconds_bucket{%s,le=\"+Inf\"} %lu\n",
+                    labels, (unsigned long)m.count);
+    response.printf("poolconnect_http_request_duration_seconds_sum{%s} %.6f\n",
+                    labels, m.latencySumUs / 1000000.0);
+    response.printf("poolconnect_http_request_duration_seconds_count{%s} %lu\n",
+                    labels, (unsigned long)m.count);
+  }
+}
+
+void writeMetricsJson(ChunkedResponse& response) {
+  response.printf("{\"uptime\":%lu,\"routes\":[", millis() / 1000);
+
+  bool first = true;
+  for (int i = 0; i < routeMetricsCount; i++) {
+    const RouteMetrics& m = routeMetrics[i];
+    if (m.count == 0) continue;
+
+    response.printf("%s{\"path\":\"%s\",\"method\":\"%s\",\"count\":%lu,\"errors\":%lu,",
+                    first ? "" : ",", m.path, getHttpMethodName(m.method),
+                    (unsigned long)m.count, (unsigned long)m.errors);
+    response.printf("\"bytes\":%llu,\"avgMs\":%.2f,\"p50Ms\":%.2f,\"p95Ms\":%.2f,\"p99Ms\":%.2f,",
+                    (unsigned long long)m.bytesSent, m.latencySumUs / 1000.0 / m.count,
+                    getRouteLatencyPercentile(m, 50), getRouteLatencyPercentile(m, 95),
+                    getRouteLatencyPercentile(m, 99));
+    response.printf("\"maxMs\":%.2f,\"peakHeapDelta\":%lu}",
+                    m.latencyMaxUs / 1000.0f, (unsigned long)m.peakHeapDelta);
+    first = false;
+  }
+
+  response.print("]}");
+}
+
+void handleApiMetrics() {
+  LOG_WEB_REQUEST("GET", "/api/metrics");
+
+  bool json = server.hasArg("format") && server.arg("format") == "json";
+
+  ChunkedResponse response;
+  response.begin(200, json ? "application/json" : "text/plain; version=0.0.4");
+  if (json) {
+    writeMetricsJson(response);
+  } else {
+    static SystemMetrics sample;           // Tâche web uniquement
+    getSystemMetrics(sample);
+    writeMetricsPrometheus(response);
+    writeSystemMetricsPrometheus(response, sample);
+  }
+  response.end();
+}
+
+#endif // WEB_METRICS_H
@@ -0,0 +1,224 @@
+/*
+ * POOL CONNECT - WEB ROUTES
+ * Table des routes HTTP du serveur web
+ * web_routes.h   V0.5
+ *
+ * - WEB_ROUTES : routes exactes (chemin, méthode, handler)
+ * - WEB_PREFIX_ROUTES : routes avec identifiant dans le chemin
+ *   (/api/timers/flex/{id}...), testées dans l'ordre
+ * - Les fichiers de l'interface sont servis par la table de web_static.h
+ * - Chaque route (et les fichiers statiques, les 404) est mesurée par
+ *   web_metrics.h
+ *
+ * À inclure après tous les modules qui définissent des handlers.
+ */
+
+#ifndef WEB_ROUTES_H
+#define WEB_ROUTES_H
+
+#include <Arduino.h>
+#include <WebServer.h>
+#include "globals.h"
+#include "logging.h"
+#include "web_static.h"
+#include "web_handlers.h"
+#include "backup_restore.h"
+#include "scenarios.h"
+#include "chart_web_handlers.h"
+#include "web_events.h"
+#include "web_state.h"
+#include "web_metrics.h"
+#include "system_metrics.h"
+#include "log_manager.h"
+
+// ============================================================================
+// STRUCTURES
+// ============================================================================
+
+struct WebRoute {
+  const char* path;
+  HTTPMethod method;        // HTTP_ANY = toutes méthodes
+  void (*handler)();
+};
+
+struct WebPrefixRoute {
+  HTTPMethod method;
+  const char* prefix;
+  const char* suffix;       // NULL = pas de contrainte de fin
+  void (*handler)();
+};
+
+// ============================================================================
+// TABLES DES ROUTES
+// ============================================================================
+
+const WebRoute WEB_ROUTES[] = {
+  // Interface
+  { "/", HTTP_GET, handleRoot },
+
+  // API Basique
+  { "/api/time", HTTP_ANY, handleApiTime },
+  { "/api/temp", HTTP_ANY, handleApiTemp },
+  { "/api/relays", HTTP_ANY, handleApiRelays },
+  { "/api/relay", HTTP_ANY, handleApiRelay },
+  { "/api/relays/status", HTTP_GET, handleApiRelaysStatus },
+  { "/api/sensors", HTTP_ANY, handleApiSensors },
+  { "/api/buzzer/mute", HTTP_ANY, handleApiBuzzerMute },
+  { "/api/pump/status", HTTP_ANY, handleApiPumpStatus },
+  { "/api/events", HTTP_GET, handleApiEvents },
+  { "/api/state", HTTP_GET, handleApiState },
+  { "/api/metrics", HTTP_GET, handleApiMetrics },
+  { "/api/system/metrics", HTTP_GET, handleApiSystemMetrics },
+  { "/api/logs", HTTP_GET, handleApiLogs },
+  { "/api/logs/levels", HTTP_GET, handleApiGetLogLevels },
+  { "/api/logs/levels", HTTP_POST, handleApiSetLogLevels },
+
+  // API MQTT
+  { "/api/mqtt/config", HTTP_GET, handleApiMQTTConfig },
+  { "/api/saveMQTT", HTTP_POST, handleApiSaveMQTT },
+  { "/api/mqtt/status", HTTP_GET, handleApiMQTTStatus },
+  { "/api/mqtt/rediscover", HTTP_POST, handleApiMQTTRediscover },
+
+  // API Météo
+  { "/api/weather/config", HTTP_GET, handleApiWeatherConfig },
+  { "/api/weather/save", HTTP_POST, handleApiWeatherSave },
+
+  // API Énergie
+  { "/api/energy", HTTP_GET, handleApiEnergy },
+  { "/api/energy/config", HTTP_POST, handleApiEnergyConfig },
+
+  // API Thermostat PAC
+  { "/api/heatpump", HTTP_GET, handleApiHeatPump },
+  { "/api/heatpump/config", HTTP_POST, handleApiHeatPumpConfig },
+
+  // API Système
+  { "/api/system", HTTP_GET, handleApiSystem },
+  { "/api/system/config", HTTP_GET, handleApiGetSystemConfig },
+  { "/api/system/config", HTTP_POST, handleApiSaveSystemConfig },
+  { "/api/system/restart", HTTP_POST, handleApiRestart },
+
+  // API Calibration
+  { "/api/calibration", HTTP_GET, handleApiGetCalibration },
+  { "/api/calibration", HTTP_POST, handleApiSaveCalibration },
+  { "/api/calibration/reset", HTTP_POST, handleApiResetCalibration },
+
+  // API Historique
+  { "/api/history", HTTP_GET, handleApiHistory },
+
+  // API Configuration Graphique
+  { "/api/chart/config", HTTP_ANY, handleApiChartConfig },
+
+  // API Chart Data (nouveau système d'historique)
+  { "/api/chart/data", HTTP_GET, handleApiChartData },
+  { "/api/chart/available-dates", HTTP_GET, handleApiChartAvailableDates },
+  { "/api/chart/storage-info", HTTP_GET, handleApiChartStorageInfo },
+  { "/api/chart/force-archive", HTTP_POST, handleApiChartForceArchive },
+  { "/api/chart/data", HTTP_DELETE, handleApiChartDeleteDay },
+  { "/api/chart/export-csv", HTTP_GET, handleApiChartExportCSV },
+
+  // API Authentification & Utilisateurs
+  { "/api/auth", HTTP_POST, handleApiAuth },
+  { "/api/users", HTTP_GET, handleApiGetUsers },
+  { "/api/users/add", HTTP_POST, handleApiAddUser },
+  { "/api/users/delete", HTTP_POST, handleApiDeleteUser },
+  { "/api/users/change-password", HTTP_POST, handleApiChangePassword },
+
+  // API Timers Flexibles
+  { "/api/timers/flex", HTTP_GET, handleApiFlexTimers },
+  { "/api/timers/flex", HTTP_POST, handleApiAddFlexTimer },
+
+  // API Backup/Restore
+  { "/api/backup/download", HTTP_GET, handleBackupDownload },
+  { "/api/backup/upload", HTTP_POST, handleBackupUpload },
+  { "/api/backup/list", HTTP_GET, handleBackupList },
+  { "/api/backup/save", HTTP_POST, handleBackupSave },
+
+  // API Scénarios
+  { "/api/scenarios", HTTP_GET, handleGetScenarios },
+  { "/api/scenarios/apply", HTTP_POST, handleApplyScenario },
+
+  // API Préférence
+  { "/api/preferences", HTTP_GET, handleApiGetPreferences },
+  { "/api/preferences", HTTP_POST, handleApiSavePreferences },
+};
+
+// Routes dynamiques (/api/timers/flex/{id}), la plus spécifique en premier
+const WebPrefixRoute WEB_PREFIX_ROUTES[] = {
+  { HTTP_POST,   "/api/timers/flex/", "/toggle", handleApiToggleFlexTimer },
+  { HTTP_GET,    "/api/timers/flex/", NULL,      handleApiGetFlexTimer },
+  { HTTP_PUT,    "/api/timers/flex/", NULL,      handleApiUpdateFlexTimer },
+  { HTTP_PATCH,  "/api/timers/flex/", NULL,      handleApiPatchFlexTimer },
+  { HTTP_DELETE, "/api/timers/flex/", NULL,      handleApiDeleteFlexTimer },
+};
+
+#define WEB_ROUTE_COUNT (sizeof(WEB_ROUTES) / sizeof(WEB_ROUTES[0]))
+#define WEB_PREFIX_ROUTE_COUNT (sizeof(WEB_PREFIX_ROUTES) / sizeof(WEB_PREFIX_ROUTES[0]))
+
+// Entrées de web_metrics.h
+int webRouteMetricSlots[WEB_ROUTE_COUNT];
+int webPrefixMetricSlots[WEB_PREFIX_ROUTE_COUNT];
+int webStaticMetricSlot = -1;
+int webNotFoundMetricSlot = -1;
+
+// ============================================================================
+// DISPATCH
+// ============================================================================
+
+/**
+ * Appelé quand aucune route exacte ne correspond :
+ * fichiers statiques, puis routes à préfixe, sinon 404.
+ */
+void handleWebNotFound() {
+  RouteSample sample = beginRouteSample();
+  String uri = server.uri();
+  HTTPMethod method = server.method();
+
+  if (method == HTTP_GET && serveStaticAsset(uri.c_str())) {
+    endRouteSample(webStaticMetricSlot, sample);
+    return;
+  }
+
+  for (size_t i = 0; i < WEB_PREFIX_ROUTE_COUNT; i++) {
+    const WebPrefixRoute& route = WEB_PREFIX_ROUTES[i];
+    if (route.method != method) continue;
+    if (!uri.startsWith(route.prefix)) continue;
+    if (route.suffix != NULL && !uri.endsWith(route.suffix)) continue;
+
+    route.handler();
+    endRouteSample(webPrefixMetricSlots[i], sample);
+    return;
+  }
+
+  LOG_W(LOG_WEB, "Route non trouvee: %s", uri.c_str());
+  server.send(404, "text/plain", "Not Found");
+  endRouteSample(webNotFoundMetricSlot, sample);
+}
+
+/**
+ * Enregistre toutes les routes de la table auprès du serveur.
+ */
+void registerWebRoutes() {
+  for (size_t i = 0; i < WEB_ROUTE_COUNT; i++) {
+    webRouteMetricSlots[i] = addRouteMetrics(WEB_ROUTES[i].path, WEB_ROUTES[i].method);
+    server.on(WEB_ROUTES[i].path, WEB_ROUTES[i].method, [i]() {
+      runMeteredRoute(webRouteMetricSlots[i], WEB_ROUTES[i].handler);
+    });
+  }
+
+  // Routes à préfixe : chemin affiché avec son identifiant générique
+  static char prefixPaths[WEB_PREFIX_ROUTE_COUNT][48];
+  for (size_t i = 0; i < WEB_PREFIX_ROUTE_COUNT; i++) {
+    const WebPrefixRoute& route = WEB_PREFIX_ROUTES[i];
+    snprintf(prefixPaths[i], sizeof(prefixPaths[i]), "%s{id}%s", route.prefix, route.suffix ? route.suffix : "");
+    webPrefixMetricSlots[i] = addRouteMetrics(prefixPaths[i], route.method);
+  }
+  webStaticMetricSlot = addRouteMetrics("(static)", HTTP_GET);
+  webNotFoundMetricSlot = addRouteMetrics("(not found)", HTTP_ANY);
+
+  server.onNotFound(handleWebNotFound);
+
+  LOG_I(LOG_WEB, "Routes enregistrees: %d exactes, %d dynamiques",
+        (int)WEB_ROUTE_COUNT, (int)WEB_PREFIX_ROUTE_COUNT);
+}
+
+#endif // WEB_ROUTES_H
@@ -0,0 +1,75 @@
+/*
+ * POOL CONNECT - WEB SERVER
+ * Serveur HTTP avec comptage des réponses (code, octets envoyés)
+ * web_server.h   V0.1
+ *
+ * WebServer ne donne accès ni au code de la réponse ni à sa taille : les
+ * méthodes d'envoi utilisées par les handlers sont redéfinies pour les
+ * noter avant d'appeler la version d'origine. Lu par web_metrics.h après
+ * chaque requête.
+ */
+
+#ifndef WEB_SERVER_H
+#define WEB_SERVER_H
+
+#include <Arduino.h>
+#include <WebServer.h>
+
+class PoolWebServer : public WebServer {
+public:
+  PoolWebServer(int port = 80) : WebServer(port), responseCode(0), responseBytes(0) {}
+
+  void send(int code, const char* contentType = NULL, const String& content = String("")) {
+    noteResponse(code, content.length());
+    WebServer::send(code, contentType, content);
+  }
+
+  void send(int code, const String& contentType, const String& content) {
+    noteResponse(code, content.length());
+    WebServer::send(code, contentType, content);
+  }
+
+  void send(int code, const char* contentType, const char* content) {
+    noteResponse(code, content ? strlen(content) : 0);
+    WebServer::send(code, contentType, content);
+  }
+
+  void sendContent(const String& content) {
+    responseBytes += content.length();
+    WebServer::sendContent(content);
+  }
+
+  void sendContent(const char* content, size_t contentLength) {
+    responseBytes += contentLength;
+    WebServer::sendContent(content, contentLength);
+  }
+
+  template<typename T>
+  size_t streamFile(T& file, const String& contentType, const int code = 200) {
+    size_t sent = WebServer::streamFile(file, contentType, code);
+    noteResponse(code, sent);
+    return sent;
+  }
+
+  /**
+   * Réponse écrite directement sur la socket (flux SSE).
+   */
+  void noteResponse(int code, size_t bytes) {
+    responseCode = code;
+    responseBytes += bytes;
+  }
+
+  void resetResponseStats() {
+    responseCode = 0;
+    responseBytes = 0;
+  }
+
+  int lastResponseCode() const { return responseCode; }
+  size_t lastResponseBytes() const { return responseBytes; }
+
+private:
+  int responseCode;
+  size_t responseBytes;
+};
+
+#endif // WEB_SERVER_H
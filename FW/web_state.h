@@ -0,0 +1,365 @@
+/*
+ * POOL CONNECT - WEB STATE
+ * Instantané combiné de l'état pour l'interface (/api/state)
+ * web_state.h   V0.2
+ *
+ * GET /api/state?fields=sensors,relays,timers,system,preferences,mqtt,weather
+ * (tous les blocs si "fields" est absent) :
+ *   {"version":42,"sensors":{...},"relays":[...],...}
+ *
+ * - Chaque bloc est sérialisé par la tâche web, hors requête, quand sa
+ *   signature change (révision capteurs, hash des timers, des préférences...)
+ *   et gardé tel quel en mémoire
+ * - "version" augmente à chaque fois qu'un bloc sérialisé change réellement
+ * - ETag = version + blocs demandés : If-None-Match identique -> 304 sans
+ *   lire les capteurs ni prendre le mutex
+ * - Le bloc "system" (uptime, mémoire) n'est rafraîchi qu'une fois par minute
+ */
+
+#ifndef WEB_STATE_H
+#define WEB_STATE_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <WebServer.h>
+#include <ArduinoJson.h>
+#include "globals.h"
+#include "config.h"
+#include "logging.h"
+#include "weather.h"
+#include "relay_service.h"
+
+// ============================================================================
+// CONSTANTES
+// ============================================================================
+
+#define STATE_REFRESH_INTERVAL_MS 250
+#define STATE_SYSTEM_REFRESH_MS 60000
+
+enum StateSection {
+  STATE_SENSORS = 0,
+  STATE_RELAYS,
+  STATE_TIMERS,
+  STATE_SYSTEM,
+  STATE_PREFERENCES,
+  STATE_MQTT,
+  STATE_WEATHER,
+  STATE_SECTION_COUNT
+};
+
+#define STATE_ALL_SECTIONS ((1u << STATE_SECTION_COUNT) - 1)
+
+// ============================================================================
+// STRUCTURES
+// ============================================================================
+
+struct StateSectionDef {
+  const char* name;
+  size_t docSize;
+  uint32_t (*signature)();
+  bool (*serialize)(JsonDocument& doc);     // false = réessayer plus tard
+};
+
+struct StateCacheEntry {
+  String json;
+  uint32_t signature;
+  bool valid;
+};
+
+// ============================================================================
+// VARIABLES GLOBALES
+// ============================================================================
+
+StateCacheEntry stateCache[STATE_SECTION_COUNT];
+uint32_t stateVersion = 0;
+volatile uint32_t sensorsRevision = 0;    // Incrémenté par la tâche contrôle
+unsigned long lastStateRefresh = 0;
+unsigned long stateNotModifiedCount = 0;
+
+// ============================================================================
+// SIGNATURES
+// ============================================================================
+
+/**
+ * Hash djb2 (même principe que hashPassword), chaînable.
+ */
+uint32_t stateHash(uint32_t hash, const void* data, size_t len) {
+  const uint8_t* bytes = (const uint8_t*)data;
+  for (size_t i = 0; i < len; i++) {
+    hash = ((hash << 5) + hash) + bytes[i];
+  }
+  return hash;
+}
+
+uint32_t stateHashString(uint32_t hash, const String& value) {
+  return stateHash(hash, value.c_str(), value.length() + 1);
+}
+
+/**
+ * Nouvelles mesures disponibles (appelé par la tâche contrôle).
+ */
+void markSensorsChanged() {
+  sensorsRevision++;
+}
+
+uint32_t sensorsSignature() {
+  return sensorsRevision;
+}
+
+uint32_t relaysSignature() {
+  return getRelayMask();
+}
+
+uint32_t timersSignature() {
+  uint32_t hash = stateHash(5381, &flexTimerCount, sizeof(flexTimerCount));
+  for (int i = 0; i < flexTimerCount; i++) {
+    const FlexibleTimer& t = flexTimers[i];
+    hash = stateHash(hash, &t.id, sizeof(t.id));
+    hash = stateHash(hash, &t.enabled, sizeof(t.enabled));
+    hash = stateHash(hash, &t.actionCount, sizeof(t.actionCount));
+    hash = stateHash(hash, &t.context.state, sizeof(t.context.state));
+    hash = stateHash(hash, &t.context.currentActionIndex, sizeof(t.context.currentActionIndex));
+    hash = stateHashString(hash, t.name);
+  }
+  return hash;
+}
+
+uint32_t systemSignature() {
+  return millis() / STATE_SYSTEM_REFRESH_MS;
+}
+
+uint32_t preferencesSignature() {
+  uint32_t hash = stateHashString(5381, userPrefs.language);
+  hash = stateHashString(hash, userPrefs.temperatureUnit);
+  hash = stateHashString(hash, userPrefs.pressureUnit);
+  hash = stateHashString(hash, userPrefs.theme);
+  return stateHash(hash, &userPrefs.chartUpdateInterval, sizeof(userPrefs.chartUpdateInterval));
+}
+
+uint32_t mqttSignature() {
+  return mqttClient.connected() ? 1 : 0;
+}
+
+uint32_t weatherSignature() {
+  uint32_t hash = stateHashString(5381, weatherApiKey);
+  hash = stateHashString(hash, latitude);
+  hash = stateHashString(hash, longitude);
+  hash = stateHash(hash, &weatherLastSuccess, sizeof(weatherLastSuccess));
+  hash = stateHash(hash, &weatherLastHttpCode, sizeof(weatherLastHttpCode));
+  return stateHash(hash, &weatherFailures, sizeof(weatherFailures));
+}
+
+// ============================================================================
+// SÉRIALISATION DES BLOCS
+// ============================================================================
+
+bool serializeSensorsState(JsonDocument& doc) {
+  if (!xSemaphoreTake(dataMutex, pdMS_TO_TICKS(20))) return false;
+
+  // Même validité que /api/temp ("ERREUR" -> null)
+  if (isnan(waterTemp) || waterTemp < -50 || waterTemp > 100) doc["waterTemp"] = nullptr;
+  else doc["waterTemp"] = waterTemp;
+  doc["waterPressure"] = waterPressure;
+  doc["waterLeak"] = waterLeak;
+  doc["coverOpen"] = coverOpen;
+  doc["extTemp"] = tempExterieure;
+  xSemaphoreGive(dataMutex);
+  return true;
+}
+
+bool serializeRelaysState(JsonDocument& doc) {
+  JsonArray arr = doc.to<JsonArray>();
+  for (int i = 0; i < NUM_RELAYS; i++) {
+    arr.add(isRelayOn(i));
+  }
+  return true;
+}
+
+/**
+ * Résumé des timers (la liste complète reste sur /api/timers/flex).
+ */
+bool serializeTimersState(JsonDocument& doc) {
+  JsonArray arr = doc.to<JsonArray>();
+  for (int i = 0; i < flexTimerCount; i++) {
+    const FlexibleTimer& t = flexTimers[i];
+    JsonObject obj = arr.createNestedObject();
+    obj["id"] = t.id;
+    obj["name"] = t.name;
+    obj["enabled"] = t.enabled;
+    obj["state"] = (int)t.context.state;
+    obj["currentAction"] = t.context.currentActionIndex;
+    obj["actionCount"] = t.actionCount;
+  }
+  return true;
+}
+
+bool serializeSystemState(JsonDocument& doc) {
+  doc["version"] = FIRMWARE_VERSION;
+  doc["ip"] = WiFi.localIP().toString();
+  doc["uptime"] = millis() / 1000;
+  doc["freeHeap"] = ESP.getFreeHeap();
+  doc["chipId"] = (uint32_t)ESP.getEfuseMac();
+  return true;
+}
+
+bool serializePreferencesState(JsonDocument& doc) {
+  doc["language"] = userPrefs.language;
+  doc["temperatureUnit"] = userPrefs.temperatureUnit;
+  doc["pressureUnit"] = userPrefs.pressureUnit;
+  doc["theme"] = userPrefs.theme;
+  doc["chartUpdateInterval"] = userPrefs.chartUpdateInterval;
+  return true;
+}
+
+bool serializeMqttState(JsonDocument& doc) {
+  doc["connected"] = mqttClient.connected();
+  return true;
+}
+
+bool serializeWeatherState(JsonDocument& doc) {
+  doc["apiKey"] = weatherApiKey;
+  doc["latitude"] = latitude;
+  doc["longitude"] = longitude;
+  doc["lastUpdate"] = (uint32_t)weatherLastSuccess;
+  doc["lastHttpCode"] = weatherLastHttpCode;
+  doc["failures"] = weatherFailures;
+  return true;
+}
+
+// Même ordre que StateSection
+const StateSectionDef STATE_SECTIONS[STATE_SECTION_COUNT] = {
+  { "sensors",     256,  sensorsSignature,     serializeSensorsState },
+  { "relays",      128,  relaysSignature,      serializeRelaysState },
+  { "timers",      4096, timersSignature,      serializeTimersState },
+  { "system",      256,  systemSignature,      serializeSystemState },
+  { "preferences", 384,  preferencesSignature, serializePreferencesState },
+  { "mqtt",        64,   mqttSignature,        serializeMqttState },
+  { "weather",     512,  weatherSignature,     serializeWeatherState },
+};
+
+// ============================================================================
+// CACHE
+// ============================================================================
+
+/**
+ * Resérialise les blocs dont la signature a changé (tâche web uniquement).
+ * La version n'augmente que si le JSON obtenu est différent.
+ *
+ * @param force Ignorer l'intervalle de rafraîchissement
+ */
+void refreshStateCache(bool force = false) {
+  unsigned long now = millis();
+  if (!force && now - lastStateRefresh < STATE_REFRESH_INTERVAL_MS) return;
+  lastStateRefresh = now;
+
+  for (int i = 0; i < STATE_SECTION_COUNT; i++) {
+    const StateSectionDef& def = STATE_SECTIONS[i];
+    StateCacheEntry& entry = stateCache[i];
+
+    uint32_t signature = def.signature();
+    if (entry.valid && entry.signature == signature) continue;
+
+    DynamicJsonDocument doc(def.docSize);
+    if (!def.serialize(doc)) continue;
+
+    String json;
+    serializeJson(doc, json);
+    entry.signature = signature;
+    entry.valid = true;
+
+    if (json != entry.json) {
+      entry.json = json;
+      stateVersion++;
+      LOG_V(LOG_WEB, "Etat '%s' modifie - version %lu", def.name, (unsigned long)stateVersion);
+    }
+  }
+}
+
+/**
+ * Convertit "sensors,relays" en masque de blocs.
+ *
+ * @return false si un nom est inconnu
+ */
+bool parseStateFields(const String& fields, uint32_t& mask) {
+  mask = 0;
+  int start = 0;
+  while (start <= (int)fields.length()) {
+    int comma = fields.indexOf(',', start);
+    if (comma < 0) comma = fields.length();
+
+    String name = fields.substring(start, comma);
+    name.trim();
+    if (name.length() > 0) {
+      int found = -1;
+      for (int i = 0; i < STATE_SECTION_COUNT; i++) {
+        if (name == STATE_SECTIONS[i].name) found = i;
+      }
+      if (found < 0) {
+        LOG_W(LOG_WEB, "Bloc d'etat inconnu: %s", name.c_str());
+        return false;
+      }
+      mask |= (1u << found);
+    }
+    start = comma + 1;
+  }
+
+  if (mask == 0) mask = STATE_ALL_SECTIONS;
+  return true;
+}
+
+// ============================================================================
+// HANDLER
+// ============================================================================
+
+void handleApiState() {
+  LOG_WEB_REQUEST("GET", "/api/state");
+
+  uint32_t mask = STATE_ALL_SECTIONS;
+  if (server.hasArg("fields") && !parseStateFields(server.arg("fields"), mask)) {
+    server.send(400, "text/plain", "Unknown field");
+    return;
+  }
+
+  // Premier appel avant le premier passage de la tâche web
+  if (stateVersion == 0) refreshStateCache(true);
+
+  char etag[24];
+  snprintf(etag, sizeof(etag), "\"%lx-%lx\"", (unsigned long)stateVersion, (unsigned long)mask);
+  server.sendHeader("ETag", etag);
+  server.sendHeader("Cache-Control", "no-cache");
+
+  if (server.hasHeader("If-None-Match") && server.header("If-None-Match").indexOf(etag) >= 0) {
+    stateNotModifiedCount++;
+    LOG_V(LOG_WEB, "/api/state: 304 Not Modified");
+    server.send(304);
+    return;
+  }
+
+  // Blocs déjà sérialisés : envoyés à la suite, sans copie
+  char head[32];
+  int headLen = snprintf(head, sizeof(head), "{\"version\":%lu", (unsigned long)stateVersion);
+
+  size_t total = headLen + 1;
+  for (int i = 0; i < STATE_SECTION_COUNT; i++) {
+    if (!(mask & (1u << i)) || !stateCache[i].valid) continue;
+    total += strlen(STATE_SECTIONS[i].name) + 4 + stateCache[i].json.length();
+  }
+
+  server.setContentLength(total);
+  server.send(200, "application/json", "");
+  server.sendContent(head, headLen);
+
+  for (int i = 0; i < STATE_SECTION_COUNT; i++) {
+    if (!(mask & (1u << i)) || !stateCache[i].valid) continue;
+
+    char key[24];
+    int keyLen = snprintf(key, sizeof(key), ",\"%s\":", STATE_SECTIONS[i].name);
+    server.sendContent(key, keyLen);
+    server.sendContent(stateCache[i].json);
+  }
+  server.sendContent("}", 1);
+
+  LOG_V(LOG_WEB, "/api/state version %lu envoye (%u bytes)", (unsigned long)stateVersion, (unsigned)total);
+}
+
+#endif // WEB_STATE_H
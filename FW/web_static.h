@@ -0,0 +1,329 @@
+/*
+ * POOL CONNECT - WEB STATIC
+ * Service des fichiers de l'interface (HTML, CSS, JS, images)
+ * web_static.h   V0.4
+ *
+ * Un seul handler pour tous les fichiers statiques :
+ * - Sert la version .gz quand elle existe (générée par tools/build_web.py),
+ *   streamFile() ajoute alors "Content-Encoding: gzip"
+ * - ETag fort lu dans /assets.json (hash du contenu calculé au build),
+ *   à défaut taille + date d'écriture du fichier ; suffixe "-gz" pour la
+ *   version compressée (représentation différente, même contenu)
+ * - 304 Not Modified sans aucune lecture flash : la table des fichiers est
+ *   construite une seule fois au démarrage
+ * - Les fichiers dont le nom contient un hash (bundle "app.1a2b3c4d.js")
+ *   sont mis en cache définitivement par le navigateur
+ * - Les fichiers de plus d'un segment partent en transfert d'arrière-plan
+ *   (web_stream.h) tant qu'il reste un transfert libre pour l'API : un
+ *   client lent ne bloque plus les autres requêtes
+ */
+
+#ifndef WEB_STATIC_H
+#define WEB_STATIC_H
+
+#include <Arduino.h>
+#include <WebServer.h>
+#include <LittleFS.h>
+#include <ArduinoJson.h>
+#include "globals.h"
+#include "config.h"
+#include "logging.h"
+#include "web_stream.h"
+
+// ============================================================================
+// CONSTANTES
+// ============================================================================
+
+#define STATIC_ASSET_MAX 32
+#define STATIC_ASSET_PATH_LEN 40
+#define STATIC_ETAG_LEN 24
+#define STATIC_MANIFEST_FILE "/assets.json"
+
+#define STATIC_CACHE_REVALIDATE "no-cache"              // HTML/JS/CSS : revalidation ETag
+#define STATIC_CACHE_IMAGES "public, max-age=604800"    // Images : 7 jours
+#define STATIC_CACHE_IMMUTABLE "public, max-age=31536000, immutable"  // Noms hashés
+#define STATIC_HASH_LEN 8                               // "app.<8 hex>.js"
+
+// Répertoires parcourus au démarrage (les .json de la racine ne sont jamais servis)
+const char* const STATIC_ASSET_DIRS[] = { "/", "/modules", "/img" };
+
+// ============================================================================
+// STRUCTURES
+// ============================================================================
+
+struct StaticAsset {
+  char path[STATIC_ASSET_PATH_LEN];   // URL ("/modules/chart.js")
+  char etag[STATIC_ETAG_LEN];         // Avec guillemets
+  const char* mimeType;
+  const char* cacheControl;
+  bool hasGzip;                       // <path>.gz présent
+  bool hasPlain;                      // <path> présent
+  uint32_t size;                      // Taille de la version servie
+};
+
+// ============================================================================
+// VARIABLES GLOBALES
+// ============================================================================
+
+StaticAsset staticAssets[STATIC_ASSET_MAX];
+int staticAssetCount = 0;
+unsigned long staticServedCount = 0;
+unsigned long staticNotModifiedCount = 0;
+
+// ============================================================================
+// UTILITAIRES
+// ============================================================================
+
+/**
+ * Type MIME d'après l'extension (NULL = fichier non servi).
+ */
+const char* getStaticMimeType(const char* path) {
+  const char* ext = strrchr(path, '.');
+  if (ext == NULL) return NULL;
+
+  if (strcmp(ext, ".html") == 0) return "text/html";
+  if (strcmp(ext, ".css") == 0)  return "text/css";
+  if (strcmp(ext, ".js") == 0)   return "application/javascript";
+  if (strcmp(ext, ".png") == 0)  return "image/png";
+  if (strcmp(ext, ".ico") == 0)  return "image/x-icon";
+  if (strcmp(ext, ".svg") == 0)  return "image/svg+xml";
+  return NULL;
+}
+
+StaticAsset* findStaticAsset(const char* path) {
+  for (int i = 0; i < staticAssetCount; i++) {
+    if (strcmp(staticAssets[i].path, path) == 0) return &staticAssets[i];
+  }
+  return NULL;
+}
+
+/**
+ * Nom de la forme "<nom>.<8 hex>.<ext>" (contenu identifié par son nom).
+ */
+bool isHashedAssetName(const char* path) {
+  const char* ext = strrchr(path, '.');
+  if (ext == NULL || ext - path < STATIC_HASH_LEN + 1) return false;
+
+  const char* hash = ext - STATIC_HASH_LEN;
+  if (hash[-1] != '.') return false;
+
+  for (int i = 0; i < STATIC_HASH_LEN; i++) {
+    if (!isxdigit((unsigned char)hash[i])) return false;
+  }
+  return true;
+}
+
+/**
+ * Politique de cache d'un fichier (fixée au démarrage).
+ */
+const char* getStaticCacheControl(const char* path, const char* mimeType) {
+  if (isHashedAssetName(path)) return STATIC_CACHE_IMMUTABLE;
+  if (strncmp(mimeType, "image/", 6) == 0) return STATIC_CACHE_IMAGES;
+  return STATIC_CACHE_REVALIDATE;
+}
+
+// ============================================================================
+// INITIALISATION
+// ============================================================================
+
+/**
+ * Ajoute un fichier trouvé sur la flash à la table.
+ * Les versions brute et .gz d'un même fichier partagent une entrée.
+ */
+void registerStaticFile(const char* dir, File& file) {
+  const char* name = file.name();
+  const char* slash = strrchr(name, '/');
+  if (slash != NULL) name = slash + 1;
+
+  char path[STATIC_ASSET_PATH_LEN];
+  snprintf(path, sizeof(path), "%s%s%s", dir, strcmp(dir, "/") == 0 ? "" : "/", name);
+
+  bool gz = false;
+  size_t len = strlen(path);
+  if (len > 3 && strcmp(path + len - 3, ".gz") == 0) {
+    path[len - 3] = '\0';
+    gz = true;
+  }
+
+  const char* mime = getStaticMimeType(path);
+  if (mime == NULL) return;
+
+  StaticAsset* asset = findStaticAsset(path);
+  if (asset == NULL) {
+    if (staticAssetCount >= STATIC_ASSET_MAX) {
+      LOG_W(LOG_WEB, "Table des fichiers statiques pleine - %s ignore", path);
+      return;
+    }
+    asset = &staticAssets[staticAssetCount++];
+    memset(asset, 0, sizeof(StaticAsset));
+    strlcpy(asset->path, path, sizeof(asset->path));
+    asset->mimeType = mime;
+    asset->cacheControl = getStaticCacheControl(path, mime);
+  }
+
+  // ETag de repli, remplacé par le manifeste s'il existe
+  if (gz || !asset->hasGzip) {
+    asset->size = file.size();
+    snprintf(asset->etag, sizeof(asset->etag), "\"%lx-%lx\"",
+             (unsigned long)file.size(), (unsigned long)file.getLastWrite());
+  }
+
+  if (gz) asset->hasGzip = true;
+  else asset->hasPlain = true;
+}
+
+/**
+ * Lit les ETags calculés au build (hash du contenu d'origine).
+ */
+void loadStaticManifest() {
+  File file = LittleFS.open(STATIC_MANIFEST_FILE, "r");
+  if (!file) {
+    LOG_D(LOG_WEB, "Pas de manifeste %s - ETags taille/date", STATIC_MANIFEST_FILE);
+    return;
+  }
+
+  DynamicJsonDocument doc(3072);
+  DeserializationError error = deserializeJson(doc, file);
+  file.close();
+
+  if (error) {
+    LOG_W(LOG_WEB, "Manifeste %s invalide: %s", STATIC_MANIFEST_FILE, error.c_str());
+    return;
+  }
+
+  int matched = 0;
+  for (JsonPair kv : doc.as<JsonObject>()) {
+    StaticAsset* asset = findStaticAsset(kv.key().c_str());
+    const char* hash = kv.value().as<const char*>();
+    if (asset == NULL || hash == NULL) continue;
+
+    snprintf(asset->etag, sizeof(asset->etag), "\"%s\"", hash);
+    matched++;
+  }
+
+  LOG_D(LOG_WEB, "Manifeste: %d ETags charges", matched);
+}
+
+/**
+ * Construit la table des fichiers statiques (à appeler après initFilesystem).
+ */
+void initStaticAssets() {
+  staticAssetCount = 0;
+
+  for (size_t d = 0; d < sizeof(STATIC_ASSET_DIRS) / sizeof(STATIC_ASSET_DIRS[0]); d++) {
+    File dir = LittleFS.open(STATIC_ASSET_DIRS[d], "r");
+    if (!dir || !dir.isDirectory()) continue;
+
+    File file = dir.openNextFile();
+    while (file) {
+      if (!file.isDirectory()) {
+        registerStaticFile(STATIC_ASSET_DIRS[d], file);
+      }
+      file.close();
+      file = dir.openNextFile();
+    }
+    dir.close();
+  }
+
+  loadStaticManifest();
+
+  int gzCount = 0;
+  uint32_t totalSize = 0;
+  for (int i = 0; i < staticAssetCount; i++) {
+    if (staticAssets[i].hasGzip) gzCount++;
+    totalSize += staticAssets[i].size;
+  }
+
+  LOG_I(LOG_WEB, "Fichiers statiques: %d (%d compresses, %lu bytes)",
+        staticAssetCount, gzCount, (unsigned long)totalSize);
+}
+
+// ============================================================================
+// HANDLER
+// ============================================================================
+
+void sendStaticHeaders(const StaticAsset* asset, const char* etag) {
+  server.sendHeader("ETag", etag);
+  server.sendHeader("Cache-Control", asset->cacheControl);
+  if (asset->hasGzip) server.sendHeader("Vary", "Accept-Encoding");
+}
+
+/**
+ * Sert un fichier statique de la table.
+ *
+ * @param path URL demandée
+ * @return false si le fichier n'est pas un fichier statique connu
+ */
+bool serveStaticAsset(const char* path) {
+  StaticAsset* asset = findStaticAsset(path);
+  if (asset == NULL) return false;
+
+  LOG_WEB_REQUEST("GET", path);
+
+  // Version brute uniquement si le client refuse gzip (ou pas de .gz)
+  bool useGzip = asset->hasGzip;
+  if (useGzip && asset->hasPlain && server.header("Accept-Encoding").indexOf("gzip") < 0) {
+    useGzip = false;
+  }
+
+  // ETag de la représentation envoyée : "<hash>-gz" pour la version .gz
+  char etag[STATIC_ETAG_LEN + 3];
+  if (useGzip) {
+    snprintf(etag, sizeof(etag), "%.*s-gz\"", (int)strlen(asset->etag) - 1, asset->etag);
+  } else {
+    strlcpy(etag, asset->etag, sizeof(etag));
+  }
+
+  // Le navigateur a déjà la bonne version
+  if (server.hasHeader("If-None-Match") && server.header("If-None-Match").indexOf(etag) >= 0) {
+    sendStaticHeaders(asset, etag);
+    staticNotModifiedCount++;
+    LOG_V(LOG_WEB, "%s: 304 Not Modified", path);
+    server.send(304);
+    return true;
+  }
+
+  char filePath[STATIC_ASSET_PATH_LEN + 3];
+  snprintf(filePath, sizeof(filePath), "%s%s", asset->path, useGzip ? ".gz" : "");
+
+  File file = LittleFS.open(filePath, "r");
+  if (!file) {
+    LOG_E(LOG_WEB, "Fichier %s non trouve", filePath);
+    server.send(404, "text/plain", "File not found");
+    return true;
+  }
+
+  staticServedCount++;
+  LOG_V(LOG_WEB, "Envoi de %s (%d bytes)", filePath, file.size());
+
+  // Gros fichier : envoyé par la tâche web entre deux requêtes (un
+  // transfert toujours gardé pour le graphique et l'export CSV)
+  if (file.size() > WEB_CHUNK_SIZE && getWebTransferCount() < WEB_TRANSFER_MAX - 1) {
+    char headers[192];
+    snprintf(headers, sizeof(headers),
+             "ETag: %s\r\nCache-Control: %s\r\n%s%sContent-Length: %u\r\n",
+             etag, asset->cacheControl,
+             asset->hasGzip ? "Vary: Accept-Encoding\r\n" : "",
+             useGzip ? "Content-Encoding: gzip\r\n" : "",
+             (unsigned)file.size());
+
+    WebTransfer* t = startWebTransfer(asset->mimeType, headers, fillWebTransferFile);
+    if (t) t->file = file;
+    else file.close();
+    return true;
+  }
+
+  sendStaticHeaders(asset, etag);
+  server.streamFile(file, asset->mimeType);
+  file.close();
+  return true;
+}
+
+void handleRoot() {
+  if (!serveStaticAsset("/index.html")) {
+    LOG_E(LOG_WEB, "Fichier /index.html non trouve");
+    server.send(404, "text/plain", "index.html not found");
+  }
+}
+
+#endif // WEB_STATIC_H
@@ -0,0 +1,357 @@
+/*
+ * POOL CONNECT - WEB STREAM
+ * Réponses HTTP envoyées par morceaux (Transfer-Encoding: chunked)
+ * web_stream.h   V0.4
+ *
+ * Les grosses réponses (graphique du jour, export CSV) ne sont plus
+ * construites en mémoire avant l'envoi : elles sont écrites au fil de
+ * l'eau dans un tampon de la taille d'un segment TCP, envoyé dès qu'il
+ * est plein. Mémoire constante quel que soit le nombre de points et
+ * premier octet envoyé immédiatement.
+ *
+ * ChunkedResponse est un Print : serializeJson() peut écrire directement
+ * dedans.
+ *
+ * Transferts en arrière-plan (WebTransfer) : comme le flux SSE, le
+ * handler écrit les en-têtes sur la socket et garde le client
+ * (Connection: close, fin du corps à la fermeture). La tâche web envoie
+ * ensuite un segment par transfert entre deux handleClient() : un
+ * téléchargement long ne bloque plus les autres requêtes (commande d'un
+ * relais pendant l'export CSV), il est servi en parallèle.
+ *
+ * Écriture sans attente (writeSocketNow) : seul ce que le tampon TCP
+ * accepte est envoyé, le reste du segment attend le passage suivant. Un
+ * client lent ne ralentit ni la tâche web ni les autres transferts ; sans
+ * progrès pendant WEB_TRANSFER_STALL_MS, il est fermé.
+ *
+ * Limite connue : WebServer traite une requête à la fois et ferme chaque
+ * connexion (pas de keep-alive). Seules les réponses longues (graphique,
+ * CSV, fichiers de l'interface) et le flux SSE quittent ce chemin.
+ */
+
+#ifndef WEB_STREAM_H
+#define WEB_STREAM_H
+
+#include <Arduino.h>
+#include <WebServer.h>
+#include <WiFi.h>
+#include <FS.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <lwip/sockets.h>
+#include "globals.h"
+#include "logging.h"
+
+// ============================================================================
+// CONSTANTES
+// ============================================================================
+
+#define WEB_CHUNK_SIZE 1436            // Un segment TCP (MSS)
+#define WEB_CHUNK_LINE_MAX 192         // Ligne formatée max (printf)
+#define WEB_TRANSFER_MAX 3             // Transferts en arrière-plan simultanés
+#define WEB_TRANSFER_RETRY_S 2         // Retry-After si tous sont occupés
+#define WEB_TRANSFER_STALL_MS 10000    // Client fermé sans progrès pendant ce délai
+
+// ============================================================================
+// ÉCRITURE SANS ATTENTE
+// ============================================================================
+
+/**
+ * Écrit ce que la socket accepte immédiatement (WiFiClient::write attend
+ * que tout soit parti).
+ *
+ * @return octets écrits (0 si le tampon TCP est plein), -1 si la connexion
+ *         est perdue
+ */
+int writeSocketNow(WiFiClient& client, const char* data, size_t size) {
+  int fd = client.fd();
+  if (fd < 0) return -1;
+
+  int n = lwip_send(fd, data, size, MSG_DONTWAIT);
+  if (n >= 0) return n;
+  return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+}
+
+// ============================================================================
+// RÉPONSE PAR MORCEAUX
+// ============================================================================
+
+class ChunkedResponse : public Print {
+public:
+  ChunkedResponse() : length(0), totalBytes(0) {}
+
+  /**
+   * Envoie les en-têtes (sans Content-Length : encodage chunked en HTTP/1.1,
+   * fin de connexion en HTTP/1.0).
+   */
+  void begin(int code, const char* contentType) {
+    length = 0;
+    totalBytes = 0;
+    server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    server.send(code, contentType, "");
+  }
+
+  size_t write(const uint8_t* data, size_t size) override {
+    size_t total = size;
+    while (size > 0) {
+      size_t room = WEB_CHUNK_SIZE - length;
+      size_t n = size < room ? size : room;
+
+      memcpy(buffer + length, data, n);
+      length += n;
+      data += n;
+      size -= n;
+
+      if (length == WEB_CHUNK_SIZE) flush();
+    }
+    return total;
+  }
+
+  size_t write(uint8_t c) override {
+    return write(&c, 1);
+  }
+
+  size_t write(const char* data, size_t size) {
+    return write((const uint8_t*)data, size);
+  }
+
+  size_t print(const char* text) {
+    return write(text, strlen(text));
+  }
+
+  void printf(const char* format, ...) {
+    char line[WEB_CHUNK_LINE_MAX];
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+
+    if (n > 0) write(line, (size_t)n < sizeof(line) ? n : sizeof(line) - 1);
+  }
+
+  void flush() override {
+    if (length == 0) return;
+    sendChunk(buffer, length);
+    totalBytes += length;
+    length = 0;
+  }
+
+  /**
+   * Envoie le reste du tampon puis le morceau final (taille 0).
+   */
+  void end() {
+    flush();
+    server.sendContent("");
+  }
+
+  size_t bytesSent() const { return totalBytes + length; }
+
+protected:
+  virtual void sendChunk(const char* data, size_t size) {
+    server.sendContent(data, size);
+  }
+
+  char buffer[WEB_CHUNK_SIZE];
+  size_t length;
+  size_t totalBytes;
+};
+
+// ============================================================================
+// TRANSFERTS EN ARRIÈRE-PLAN
+// ============================================================================
+
+class WebTransfer;
+
+/**
+ * Produit la suite du corps (quelques centaines d'octets au plus par appel).
+ *
+ * @return false quand le corps est complet
+ */
+typedef bool (*WebTransferFill)(WebTransfer& transfer);
+
+class WebTransfer : public ChunkedResponse {
+public:
+  WebTransfer() : active(false), failed(false), complete(false), fill(NULL), stage(0), cursor(0), end(0), tag(0),
+                  items(0), pendingLength(0), pendingSent(0) {}
+
+  bool active;
+  bool failed;                   // Client parti ou bloqué
+  bool complete;                 // Corps entièrement produit
+  WebTransferFill fill;
+  WiFiClient client;
+  unsigned long startedAt;
+  unsigned long lastProgress;
+
+  // État du producteur
+  int stage;
+  uint32_t cursor;
+  uint32_t end;
+  uint32_t tag;
+  int items;
+  File file;
+
+  /**
+   * Écrit les en-têtes sur la socket de la requête en cours et la retire
+   * du serveur (handleClient() passe à la requête suivante).
+   *
+   * @param extraHeaders Lignes "Nom: valeur\r\n" ajoutées (Cache-Control:
+   *        no-cache si elles n'en donnent pas)
+   */
+  void start(const char* contentType, const char* extraHeaders, WebTransferFill producer) {
+    if (extraHeaders == NULL) extraHeaders = "";
+    client = server.client();
+    size_t headerBytes = client.printf("HTTP/1.1 200 OK\r\n"
+                                       "Content-Type: %s\r\n"
+                                       "%s"
+                                       "%s"
+                                       "Connection: close\r\n"
+                                       "\r\n", contentType,
+                                       strstr(extraHeaders, "Cache-Control:") ? "" : "Cache-Control: no-cache\r\n",
+                                       extraHeaders);
+    server.noteResponse(200, headerBytes);
+    server.client() = WiFiClient();
+
+    active = true;
+    failed = false;
+    complete = false;
+    fill = producer;
+    startedAt = millis();
+    lastProgress = startedAt;
+    stage = 0;
+    cursor = 0;
+    end = 0;
+    tag = 0;
+    items = 0;
+    length = 0;
+    totalBytes = 0;
+    pendingLength = 0;
+    pendingSent = 0;
+  }
+
+  /**
+   * Sans attente : envoie ce que la socket accepte du segment en cours,
+   * puis produit le segment suivant (producteur appelé jusqu'à ce que le
+   * tampon soit plein ou le corps complet) une fois le précédent parti.
+   *
+   * @return false quand le transfert est terminé (fermé)
+   */
+  bool step() {
+    drain();
+
+    if (!failed && pendingLength == 0) {
+      size_t producedBefore = totalBytes;
+      while (!complete && !failed && totalBytes == producedBefore) {
+        complete = !fill(*this);
+      }
+      if (complete && pendingLength == 0) flush();
+      drain();
+    }
+
+    if (!failed && pendingLength > 0 && millis() - lastProgress > WEB_TRANSFER_STALL_MS) {
+      LOG_W(LOG_WEB, "Transfert abandonne: client bloque depuis %lu ms", millis() - lastProgress);
+      failed = true;
+    }
+
+    if (failed || (complete && pendingLength == 0 && length == 0)) {
+      finish();
+      return false;
+    }
+    return true;
+  }
+
+  void finish() {
+    if (file) file.close();
+    client.stop();
+    client = WiFiClient();
+    active = false;
+  }
+
+protected:
+  // Segment en cours d'envoi (le tampon de ChunkedResponse se remplit
+  // pendant ce temps)
+  char pending[WEB_CHUNK_SIZE];
+  size_t pendingLength;
+  size_t pendingSent;
+
+  void sendChunk(const char* data, size_t size) override {
+    if (failed) return;
+
+    // Un segment à la fois : step() ne produit que si le précédent est parti
+    if (pendingLength != 0 || size > sizeof(pending)) {
+      failed = true;
+      return;
+    }
+    memcpy(pending, data, size);
+    pendingLength = size;
+    pendingSent = 0;
+  }
+
+  void drain() {
+    if (failed || pendingLength == 0) return;
+
+    int n = writeSocketNow(client, pending + pendingSent, pendingLength - pendingSent);
+    if (n < 0) {
+      failed = true;
+      return;
+    }
+    if (n > 0) {
+      pendingSent += n;
+      lastProgress = millis();
+    }
+    if (pendingSent == pendingLength) {
+      pendingLength = 0;
+      pendingSent = 0;
+    }
+  }
+};
+
+WebTransfer webTransfers[WEB_TRANSFER_MAX];
+unsigned long webTransfersRefused = 0;
+
+int getWebTransferCount() {
+  int count = 0;
+  for (int i = 0; i < WEB_TRANSFER_MAX; i++) {
+    if (webTransfers[i].active) count++;
+  }
+  return count;
+}
+
+/**
+ * Réserve un transfert pour la requête en cours, ou répond 503 avec
+ * Retry-After si tous sont occupés. Le producteur ne démarre qu'au
+ * prochain processWebTransfers() : l'appelant initialise d'abord son état.
+ */
+WebTransfer* startWebTransfer(const char* contentType, const char* extraHeaders, WebTransferFill producer) {
+  for (int i = 0; i < WEB_TRANSFER_MAX; i++) {
+    if (webTransfers[i].active) continue;
+    webTransfers[i].start(contentType, extraHeaders, producer);
+    return &webTransfers[i];
+  }
+
+  webTransfersRefused++;
+  server.sendHeader("Retry-After", String(WEB_TRANSFER_RETRY_S));
+  server.send(503, "text/plain", "Too many transfers");
+  return nullptr;
+}
+
+/**
+ * Producteur générique : fichier ouvert dans transfer.file, recopié tel quel.
+ */
+bool fillWebTransferFile(WebTransfer& t) {
+  uint8_t buf[512];
+  size_t n = t.file.read(buf, sizeof(buf));
+  if (n == 0) return false;
+  t.write(buf, n);
+  return true;
+}
+
+/**
+ * Appelé par la tâche web après chaque handleClient().
+ */
+void processWebTransfers() {
+  for (int i = 0; i < WEB_TRANSFER_MAX; i++) {
+    if (webTransfers[i].active) webTransfers[i].step();
+  }
+}
+
+#endif // WEB_STREAM_H